@@ -61,16 +61,54 @@ if errorlevel 1 exit /b 1
 cl %CXXFLAGS% -c -Foobj/NvHdr.obj src/NvHdr.cpp
 if errorlevel 1 exit /b 1
 
+cl %CXXFLAGS% -c -Foobj/Timeline.obj src/Timeline.cpp
+if errorlevel 1 exit /b 1
+
+cl %CXXFLAGS% -c -Foobj/HidAls.obj src/HidAls.cpp
+if errorlevel 1 exit /b 1
+
+:: Brightness core (also the sbpp_core library in CMakeLists.txt; the tools below link it too)
+cl %CXXFLAGS% -c -Foobj/BrightnessCore.obj src/BrightnessCore.cpp
+if errorlevel 1 exit /b 1
+
 :: Compile resources
 rc -Iinclude -foobj/studio-brightness-plusplus.res studio-brightness-plusplus.rc
 if errorlevel 1 exit /b 1
 
 :: Link everything
-cl -Fe./bin/studio-brightness-plusplus.exe obj/main.obj obj/hid.obj obj/Settings.obj obj/OSDWindow.obj obj/TrayPopup.obj obj/Log.obj obj/LogWindow.obj obj/Updater.obj obj/HdrMonitor.obj obj/PresetConfirm.obj obj/NvHdr.obj obj/studio-brightness-plusplus.res ^
+cl -Fe./bin/studio-brightness-plusplus.exe obj/main.obj obj/hid.obj obj/Settings.obj obj/OSDWindow.obj obj/TrayPopup.obj obj/Log.obj obj/LogWindow.obj obj/Updater.obj obj/HdrMonitor.obj obj/PresetConfirm.obj obj/NvHdr.obj obj/Timeline.obj obj/HidAls.obj obj/BrightnessCore.obj obj/studio-brightness-plusplus.res ^
     -link /MANIFEST:EMBED /MANIFESTINPUT:studio-brightness-plusplus.manifest ^
     hid.lib setupapi.lib shlwapi.lib wbemuuid.lib comctl32.lib User32.lib Shell32.lib Gdi32.lib ^
     sensorsapi.lib ole32.lib Advapi32.lib gdiplus.lib PortableDeviceGuids.lib ^
     winhttp.lib runtimeobject.lib oleaut32.lib dxgi.lib
 if errorlevel 1 exit /b 1
 
+:: Replay tool for recorded ALS traces (tools/lux-replay.cpp)
+cl %CXXFLAGS% -Fe./bin/lux-replay.exe -Foobj/lux-replay.obj tools/lux-replay.cpp
+if errorlevel 1 exit /b 1
+
+:: ALS checks against fake sources and synthetic data (tools/als-check.cpp)
+cl %CXXFLAGS% -Fe./bin/als-check.exe -Foobj/als-check.obj tools/als-check.cpp
+if errorlevel 1 exit /b 1
+
+:: Log store benchmark (tools/log-ring-bench.cpp)
+cl %CXXFLAGS% -Fe./bin/log-ring-bench.exe -Foobj/log-ring-bench.obj tools/log-ring-bench.cpp
+if errorlevel 1 exit /b 1
+
+:: File log decoder (tools/log-decode.cpp)
+cl %CXXFLAGS% -Fe./bin/log-decode.exe -Foobj/log-decode.obj tools/log-decode.cpp
+if errorlevel 1 exit /b 1
+
+:: Metrics endpoint client (tools/metrics-query.cpp)
+cl %CXXFLAGS% -Fe./bin/metrics-query.exe -Foobj/metrics-query.obj tools/metrics-query.cpp
+if errorlevel 1 exit /b 1
+
+:: Hotkey-to-write latency under load (tools/hotkey-latency-bench.cpp)
+cl %CXXFLAGS% -Fe./bin/hotkey-latency-bench.exe -Foobj/hotkey-latency-bench.obj tools/hotkey-latency-bench.cpp obj/BrightnessCore.obj
+if errorlevel 1 exit /b 1
+
+:: Brightness core benchmark (tools/core-bench.cpp)
+cl %CXXFLAGS% -Fe./bin/core-bench.exe -Foobj/core-bench.obj tools/core-bench.cpp obj/BrightnessCore.obj
+if errorlevel 1 exit /b 1
+
 echo Build successful.
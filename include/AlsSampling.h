@@ -0,0 +1,70 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+
+// Report-interval policy for one ambient light source. Every sample costs the sensor a wakeup and
+// us a COM callback, so the rate follows demand instead of a fixed 500 ms:
+//   - nobody consumes the source (auto-brightness off, HDR, reference preset): kIdleMs
+//   - lux moving quickly, or a ramp running on a display that reads it:       kFastMs
+//   - otherwise:                                                              kNormalMs
+// Fast mode is held for kFastHoldMs after the last trigger so a changing room does not flap
+// between rates on every sample.
+//
+// Plain single-threaded state: the worker drives it once per tick with the source's latest lux and
+// its running sample count, so it can be exercised with synthetic timelines.
+class AlsSamplingPolicy {
+public:
+	static constexpr uint32_t kIdleMs     = 5000;
+	static constexpr uint32_t kNormalMs   = 500;
+	static constexpr uint32_t kFastMs     = 200;
+	static constexpr double   kFastHoldMs = 3000.0;
+	static constexpr double   kFastRate   = 0.5;     // |d log2(lux)| per second that counts as "changing"
+	static constexpr double   kRateWindow = 10000.0; // achieved-rate measurement window
+
+	// Returns the interval the source should run at now.
+	uint32_t update(double nowMs, float lux, uint32_t samples, bool consumed, bool rampActive) {
+		if (samples != lastSamples_) {
+			double l = std::log2((double)(lux > 1.f ? lux : 1.f));
+			if (haveLux_ && nowMs > lastSampleMs_) {
+				double rate = std::fabs(l - lastLog_) * 1000.0 / (nowMs - lastSampleMs_);
+				rate_       = 0.5 * rate_ + 0.5 * rate;
+			}
+			lastLog_      = l;
+			lastSampleMs_ = nowMs;
+			haveLux_      = true;
+		}
+
+		if (windowStartMs_ < 0.0) {
+			windowStartMs_      = nowMs;
+			windowStartSamples_ = samples;
+		} else if (nowMs - windowStartMs_ >= kRateWindow) {
+			achievedHz_         = (double)(samples - windowStartSamples_) * 1000.0 / (nowMs - windowStartMs_);
+			windowStartMs_      = nowMs;
+			windowStartSamples_ = samples;
+		}
+		lastSamples_ = samples;
+
+		if (!consumed)
+			return kIdleMs;
+		if (rampActive || rate_ >= kFastRate)
+			fastUntilMs_ = nowMs + kFastHoldMs;
+		return nowMs < fastUntilMs_ ? kFastMs : kNormalMs;
+	}
+
+	// Samples per second actually delivered over the last complete window (0 until one completes).
+	double achievedHz() const { return achievedHz_; }
+	double changeRate() const { return rate_; }
+
+	uint32_t applied = kNormalMs; // interval last pushed to the source
+
+private:
+	uint32_t lastSamples_        = 0;
+	bool     haveLux_            = false;
+	double   lastLog_            = 0.0;
+	double   lastSampleMs_       = 0.0;
+	double   rate_               = 0.0;
+	double   fastUntilMs_        = 0.0;
+	double   windowStartMs_      = -1.0;
+	uint32_t windowStartSamples_ = 0;
+	double   achievedHz_         = 0.0;
+};
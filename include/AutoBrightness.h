@@ -0,0 +1,67 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+
+// Apple-style auto-brightness transition (hysteresis + asymmetric perceptual ramp), kept free of
+// Win32 so the worker loop and tools/lux-replay.cpp run the exact same engine.
+constexpr float  kRelLuxHysteresis = 0.20f;  // re-target only when |dLux|/lastTargetLux >= 20%
+constexpr double kRampBrightenMs   = 1500.0; // fast brightening
+constexpr double kRampDimMs        = 5000.0; // slow, gentle dimming
+
+inline double   brightToPerc(uint32_t v) { return std::log2((double)v + 1.0); }
+inline uint32_t percToBright(double l) { return (uint32_t)std::llround(std::exp2(l) - 1.0); }
+
+// Brightness for an ambient level, scaled from the user's last manual (lux, brightness) anchor.
+inline uint32_t mapLuxToBrightness(float lux, float baseLux, uint32_t baseBrightness, uint32_t minB, uint32_t maxB) {
+	float l   = lux < 2.f ? 2.f : (lux > 5000.f ? 5000.f : lux);
+	float tgt = (float)baseBrightness * (l / baseLux);
+	if (tgt < (float)minB) tgt = (float)minB;
+	if (tgt > (float)maxB) tgt = (float)maxB;
+	return (uint32_t)tgt;
+}
+
+// Per-display ramp state.
+struct AutoRamp {
+	float    lastTargetLux = 0.f;
+	uint32_t start         = 0;
+	uint32_t goal          = 0;
+	double   startMs       = 0.0;
+	double   durationMs    = 0.0;
+
+	bool active() const { return durationMs > 0.0; }
+	void reset() {
+		durationMs    = 0.0;
+		lastTargetLux = 0.f;
+	}
+
+	// One engine tick. `target` is mapLuxToBrightness(lux) for this display. Returns true with the
+	// brightness to write in `out` when the display should change.
+	bool step(double now, float lux, uint32_t target, uint32_t current, uint32_t minB, uint32_t maxB, uint32_t &out) {
+		bool retarget = (lastTargetLux <= 0.f) || (std::fabs(lux - lastTargetLux) / lastTargetLux >= kRelLuxHysteresis);
+		if (retarget) {
+			if (target != goal || durationMs == 0.0) {
+				start      = current;
+				goal       = target;
+				startMs    = now;
+				durationMs = (target >= current) ? kRampBrightenMs : kRampDimMs;
+			}
+			lastTargetLux = lux;
+		}
+
+		if (durationMs <= 0.0)
+			return false;
+		double t = (now - startMs) / durationMs;
+		if (t >= 1.0) {
+			durationMs = 0.0;
+			out        = goal;
+			return current != goal;
+		}
+		if (t < 0.0) t = 0.0;
+		double   a    = brightToPerc(start), b = brightToPerc(goal);
+		uint32_t next = percToBright(a + t * (b - a));
+		if (next < minB) next = minB;
+		if (next > maxB) next = maxB;
+		out = next;
+		return next != current;
+	}
+};
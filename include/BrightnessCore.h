@@ -0,0 +1,236 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "AutoBrightness.h"
+#include "DeviceScheduler.h"
+#include "DisplayStates.h"
+#include "LinkedFanOut.h"
+
+// The brightness policy of the app: hotkey steps, linked displays, writes and the auto-brightness
+// tick, free of Win32. src/main.cpp drives it for the HID displays; the tools and benchmarks drive
+// it for simulated ones. Built as the sbpp_core library (CMakeLists.txt) and linked into the app
+// (build.bat) from the same source, src/BrightnessCore.cpp.
+//
+// Nothing here locks: callers hold the display lock around every call, as they did before.
+
+// Per-display brightness state, and the transport that writes it (DisplayDevice: a HID feature
+// report). The numbers live in a DisplayStates slot, not in the object; the accessors return
+// references into it.
+class BrightnessDisplay {
+public:
+	BrightnessDisplay() : slot_(DisplayStates::shared().acquire(this)) {}
+	BrightnessDisplay(const BrightnessDisplay &)            = delete;
+	BrightnessDisplay &operator=(const BrightnessDisplay &) = delete;
+	BrightnessDisplay(BrightnessDisplay &&o) noexcept
+	    : rampTx(std::move(o.rampTx)), staged_(o.staged_), slot_(o.slot_) {
+		o.slot_ = DisplayStates::kNoSlot;
+		hot().display[index()] = this;
+	}
+	BrightnessDisplay &operator=(BrightnessDisplay &&o) noexcept {
+		if (this != &o) {
+			if (slot_ != DisplayStates::kNoSlot)
+				DisplayStates::shared().release(slot_);
+			rampTx  = std::move(o.rampTx);
+			staged_ = o.staged_;
+			slot_   = o.slot_;
+			o.slot_ = DisplayStates::kNoSlot;
+			hot().display[index()] = this;
+		}
+		return *this;
+	}
+	virtual ~BrightnessDisplay() {
+		if (slot_ != DisplayStates::kNoSlot)
+			DisplayStates::shared().release(slot_);
+	}
+
+	uint32_t &currentBrightness() { return hot().current[index()]; }
+	uint32_t &baseBrightness() { return hot().base[index()]; } // the user's last manual level
+	uint32_t &minBrightness() { return hot().minB[index()]; }
+	uint32_t &maxBrightness() { return hot().maxB[index()]; }
+	float    &baseLux() { return hot().baseLux[index()]; } // with baseBrightness, the auto anchor
+	float    &maxNits() { return hot().maxNits[index()]; }
+	AutoRamp &ramp() { return hot().ramp[index()]; }         // auto-brightness ramp/hysteresis (Apple-style)
+	uint32_t &commitUs() { return hot().commitUs[index()]; } // running estimate of one commitBrightness
+	uint32_t &rampVal() { return hot().rampVal[index()]; }   // the value of rampTx
+	uint32_t &rampFrom() { return hot().rampFrom[index()]; } // the last level known written before it
+	uint32_t  currentBrightness() const { return hot().current[index()]; }
+	uint32_t  baseBrightness() const { return hot().base[index()]; }
+	uint32_t  minBrightness() const { return hot().minB[index()]; }
+	uint32_t  maxBrightness() const { return hot().maxB[index()]; }
+	float     baseLux() const { return hot().baseLux[index()]; }
+	float     maxNits() const { return hot().maxNits[index()]; }
+	const AutoRamp &ramp() const { return hot().ramp[index()]; }
+	uint32_t        commitUs() const { return hot().commitUs[index()]; }
+
+	// A reference-mode preset fixes the brightness (macOS parity). Cached here for the tick: the
+	// subclass sets it whenever its active preset or preset list changes.
+	bool brightnessLocked() const { return hot().locked[index()] != 0; }
+	void setBrightnessLocked(bool locked) { hot().locked[index()] = locked; }
+
+	uint32_t slot() const { return slot_; }
+
+	// The auto-brightness step posted to the scheduler and not settled yet (autoBrightnessStep)
+	std::shared_ptr<TxTicket> rampTx;
+
+	virtual int writeBrightness(uint32_t val) = 0; // 0 = written
+	// The queue every transaction on this display goes through (DeviceScheduler.h); nullptr: the
+	// writes are made on the calling thread.
+	virtual DeviceScheduler *scheduler() { return nullptr; }
+
+	// A linked write in two halves, so that every display's write can be released at once: stage
+	// prepares the report (and may read the device for it), commit sends it. By default the value
+	// is kept and written by writeBrightness.
+	virtual int stageBrightness(uint32_t val) {
+		staged_ = val;
+		return 0;
+	}
+	virtual int commitBrightness() { return writeBrightness(staged_); }
+
+private:
+	DisplayStates::Page       &hot() { return DisplayStates::shared().page(slot_); }
+	const DisplayStates::Page &hot() const { return DisplayStates::shared().page(slot_); }
+	uint32_t                   index() const { return slot_ % DisplayStates::kPage; }
+
+	uint32_t staged_ = 0;
+	uint32_t slot_;
+};
+
+// What the policy asks of the app around a write. The defaults do nothing.
+class BrightnessHost {
+public:
+	virtual ~BrightnessHost() = default;
+	virtual bool  writesSuspended() { return false; }                       // HDR: Windows owns brightness
+	virtual float ambientLux(const BrightnessDisplay &, bool /*predicted*/) { return 100.f; }
+	virtual void  userAction(const BrightnessDisplay &, uint32_t /*val*/) {} // before a user's write
+	virtual void  written(const BrightnessDisplay &, uint32_t /*val*/) {}    // after it, anchors updated
+	virtual void  writeFailed(const BrightnessDisplay &, int /*rc*/) {}
+	virtual void  showOsd(const BrightnessDisplay &) {} // after a write asked to show it
+	// After a linked write reached two or more displays: the spread between the first and the last
+	// write completing.
+	virtual void linkedWritten(size_t /*displays*/, uint64_t /*skewUs*/) {}
+};
+
+/* ---------- arithmetic ---------- */
+
+// The brightness one hotkey step away (`direction` > 0 up, < 0 down): 1/`steps` of the range, at
+// least 1, never past the ends. Returns `current` when already at the end it is moving toward.
+uint32_t stepBrightness(uint32_t current, uint32_t minB, uint32_t maxB, uint32_t steps, int direction);
+
+// Map a brightness from one display's range to another's so both show the same nits: displays
+// with different nit ceilings look equally bright in linked mode.
+uint32_t mapBrightnessAcrossDisplays(uint32_t val, const BrightnessDisplay &from, const BrightnessDisplay &to);
+
+// Target brightness for an ambient level, from the display's manual anchor.
+inline uint32_t mapLuxToBrightness(float lux, const BrightnessDisplay &dev) {
+	return mapLuxToBrightness(lux, dev.baseLux(), dev.baseBrightness(), dev.minBrightness(),
+	                          dev.maxBrightness());
+}
+
+/* ---------- policy ---------- */
+
+class BrightnessCore {
+public:
+	explicit BrightnessCore(BrightnessHost &host) : host_(host) {}
+
+	// The one place brightness is written. A user action also re-anchors auto-brightness and stops
+	// its ramp. On a display with a scheduler the write is a User transaction (Ramp when not the
+	// user's), waited for.
+	void SetBrightness(BrightnessDisplay &dev, uint32_t val, bool isUserAction, bool showOSD);
+
+	// One auto-brightness tick for `dev`; true when it wrote. On a display with a scheduler the step
+	// is posted, not waited for: currentBrightness moves at once, and the next tick reports the
+	// write (or puts the level back when it failed).
+	bool autoBrightnessStep(BrightnessDisplay &dev, double nowMs, bool predicted);
+
+	// autoBrightnessTick covers `dev` from now until it is detached or destroyed.
+	void attach(BrightnessDisplay &dev);
+	void detach(BrightnessDisplay &dev);
+
+	// One auto-brightness tick of every attached display. It walks the DisplayStates pages and
+	// reaches a display object only when its range and preset let it step.
+	struct TickResult {
+		size_t steps        = 0; // displays that wrote
+		size_t rampsStarted = 0;
+	};
+	TickResult autoBrightnessTick(double nowMs, bool predicted);
+
+	// Linked writes one display after the other, on the calling thread, as before the fan-out (for
+	// comparison in the benchmarks).
+	void setConcurrentLinked(bool on) { concurrentLinked_ = on; }
+
+	// `Displays` is any random-access container of BrightnessDisplay subclasses (std::vector<DisplayDevice>).
+
+	// Apply to all displays (linked mode, proportional nit mapping from `refDev`). The writes go out
+	// concurrently, one lane per display (LinkedFanOut.h, or each display's scheduler when they all
+	// have one), unless setConcurrentLinked(false).
+	template <class Displays>
+	void SetBrightnessLinked(Displays &displays, uint32_t val, const BrightnessDisplay &refDev, bool isUserAction,
+	                         bool showOSD) {
+		linked_.clear();
+		for (auto &dev : displays)
+			linked_.push_back({&dev, mapBrightnessAcrossDisplays(val, refDev, dev)});
+		writeLinked(isUserAction, showOSD);
+	}
+
+	// Apply to the active display, or to all of them in linked mode (or when there is only one)
+	template <class Displays>
+	void ApplyBrightness(Displays &displays, size_t active, bool linked, uint32_t val, bool isUserAction,
+	                     bool showOSD) {
+		if (displays.empty())
+			return;
+		auto &ref = displays[std::min(displays.size() - 1, active)];
+		if (linked || displays.size() == 1)
+			SetBrightnessLinked(displays, val, ref, isUserAction, showOSD);
+		else
+			SetBrightness(ref, val, isUserAction, showOSD);
+	}
+
+	// A hotkey step on the active display, shown on the OSD
+	template <class Displays>
+	void adjustBrightnessByStep(Displays &displays, size_t active, bool linked, uint32_t steps, int direction) {
+		if (displays.empty())
+			return;
+		auto    &ref  = displays[std::min(displays.size() - 1, active)];
+		uint32_t next =
+		    stepBrightness(ref.currentBrightness(), ref.minBrightness(), ref.maxBrightness(), steps, direction);
+		if (next == ref.currentBrightness())
+			return;
+		if (linked || displays.size() == 1)
+			SetBrightnessLinked(displays, next, ref, true, true);
+		else
+			SetBrightness(ref, next, true, true);
+	}
+
+private:
+	static constexpr uint32_t kMaxLeadUs = 20000; // never hold a display back longer than this
+
+	struct LinkedWrite {
+		BrightnessDisplay *dev;
+		uint32_t           val;
+		int64_t            leadNs = 0; // wait after the barrier: the faster displays send later
+		int64_t            sentNs = 0;
+	};
+
+	void writeLinked(bool isUserAction, bool showOSD);
+	// `write` through the display's scheduler (User, or Ramp when not the user's), waited for; called
+	// directly without one, where a std::function would only cost an allocation.
+	template <class F>
+	int send(BrightnessDisplay &dev, bool isUserAction, F &&write) {
+		DeviceScheduler *tx = dev.scheduler();
+		return tx ? tx->run(isUserAction ? TxClass::User : TxClass::Ramp, std::forward<F>(write)) : write();
+	}
+	void settleRamp(BrightnessDisplay &dev);
+	void finishWrite(BrightnessDisplay &dev, uint32_t val, int rc, bool isUserAction, bool showOSD);
+
+	BrightnessHost                        &host_;
+	bool                                   concurrentLinked_ = true;
+	LinkedFanOut                           fanOut_;
+	std::vector<LinkedWrite>               linked_; // scratch of SetBrightnessLinked, reused
+	std::vector<int>                       rc_;     // per lane of the fan-out
+	std::vector<int64_t>                   doneNs_;
+	std::vector<std::shared_ptr<TxTicket>> tickets_; // per display, when the lanes are schedulers
+};
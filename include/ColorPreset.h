@@ -0,0 +1,48 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/* ---------- Color preset (Apple Reference Mode) ---------- */
+struct ColorPreset {
+	uint32_t     index;   // hardware index written to 0xFF20/0x03 to select
+	std::wstring name;    // UTF-16 name read from 0xFF20/0x08
+	std::wstring desc;    // UTF-16 secondary string read from 0xFF20/0x09 (Boot Camp reads it too)
+
+	// The factory "Apple ..." presets are the general-use modes: brightness stays adjustable and,
+	// on the XDR panels, they are the only presets compatible with Windows HDR (anything else can
+	// blank the panel). Everything else is a fixed-calibration reference mode; macOS locks
+	// brightness on those as well. The HID protocol carries no per-preset flag (verified against
+	// Boot Camp, which only reads name and desc), so classify by name.
+	bool isHdrCompatible() const { return name.rfind(L"Apple XDR Display", 0) == 0 || name.rfind(L"Pro Display XDR", 0) == 0; }
+	bool allowsBrightness() const {
+		return name.rfind(L"Apple XDR Display", 0) == 0 || name.rfind(L"Pro Display XDR", 0) == 0 || name.rfind(L"Apple Display", 0) == 0;
+	}
+};
+
+// The preset with hardware index `activeIndex`; nullptr when unknown (-1) or not in the list.
+inline const ColorPreset *findPreset(const std::vector<ColorPreset> &presets, int activeIndex) {
+	if (activeIndex < 0)
+		return nullptr;
+	for (const auto &p : presets)
+		if ((int)p.index == activeIndex)
+			return &p;
+	return nullptr;
+}
+
+// Any preset matches the known Apple naming. Otherwise the list cannot be classified.
+inline bool presetsClassifiable(const std::vector<ColorPreset> &presets) {
+	for (const auto &p : presets)
+		if (p.allowsBrightness())
+			return true;
+	return false;
+}
+
+// macOS parity: the active preset is a reference mode, which fixes brightness. Never locks on a
+// list that cannot be classified (unknown naming scheme: never lock controls on a guess).
+inline bool presetLocksBrightness(const std::vector<ColorPreset> &presets, int activeIndex) {
+	if (!presetsClassifiable(presets))
+		return false;
+	const ColorPreset *p = findPreset(presets, activeIndex);
+	return p && !p->allowsBrightness();
+}
@@ -0,0 +1,232 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "Metrics.h"
+#include "Trace.h"
+
+// Every HID transaction on one display goes through its scheduler: one thread per display, and a
+// queue per priority class instead of whatever order the code reaches the device in.
+//
+//   User    a brightness change the user asked for (hotkey, slider, linked fan-out)
+//   Preset  a color preset switch or revert
+//   Ramp    one auto-brightness step
+//   Probe   background reads: liveness, range queries
+//
+// The thread always takes the oldest transaction of the most urgent non-empty class. A transaction
+// already on the wire cannot be stopped, so a user command cannot interrupt one, but it jumps every
+// queue and cancels a ramp step still waiting: that step would be overwritten anyway. A new ramp
+// step likewise replaces one still waiting (only the newest matters).
+//
+// Callers either wait (run) or keep the ticket and look at it later (post): the worker posts ramp
+// steps and probes and settles them on its next tick, so it never waits on the device. Transactions
+// run without any app lock held; what they touch must stay put until they are done, which is what
+// idle() is for (DisplayDevice waits in it before it is moved or closed).
+//
+// Per class, across all displays: queue depth (sbpp_tx_queue_depth), time from submit to start
+// (sbpp_tx_wait_us) and cancellations (sbpp_tx_cancelled_total).
+
+enum class TxClass : uint8_t { User, Preset, Ramp, Probe };
+constexpr size_t kTxClasses = 4;
+constexpr int    kTxCancelled = -100; // result of a transaction that never ran
+
+inline const char *txClassName(TxClass c) {
+	static const char *const kNames[kTxClasses] = {"user", "preset", "ramp", "probe"};
+	return kNames[(size_t)c];
+}
+
+// The result of one posted transaction.
+class TxTicket {
+public:
+	bool done() const { return rc_.load(std::memory_order_acquire) != kPending; }
+	int  result() const { return rc_.load(std::memory_order_acquire); } // valid once done()
+	int  wait() const {
+		int rc;
+		while ((rc = rc_.load(std::memory_order_acquire)) == kPending)
+			rc_.wait(kPending, std::memory_order_acquire);
+		return rc;
+	}
+
+private:
+	friend class DeviceScheduler;
+	static constexpr int kPending = INT_MIN;
+
+	void finish(int rc) {
+		rc_.store(rc, std::memory_order_release);
+		rc_.notify_all();
+	}
+
+	std::atomic<int> rc_{kPending};
+};
+
+class DeviceScheduler {
+public:
+	using Fn = std::function<int()>; // 0 = ok, like the DisplayDevice calls it wraps
+
+	// What one scheduler has seen, per class (the tools read these; the app reads the metrics).
+	struct Stats {
+		uint64_t done = 0, cancelled = 0;
+		uint64_t waitUsTotal = 0, waitUsMax = 0;
+		size_t   depthMax = 0;
+	};
+
+	DeviceScheduler() = default;
+	DeviceScheduler(const DeviceScheduler &)            = delete;
+	DeviceScheduler &operator=(const DeviceScheduler &) = delete;
+
+	// Cancels what is still queued and waits for the transaction on the wire.
+	~DeviceScheduler() {
+		{
+			std::lock_guard<std::mutex> lock(m_);
+			stop_ = true;
+			for (size_t c = 0; c < kTxClasses; ++c)
+				while (!queues_[c].empty())
+					cancelFront((TxClass)c);
+		}
+		wake_.notify_all();
+		if (thread_.joinable())
+			thread_.join();
+	}
+
+	std::shared_ptr<TxTicket> post(TxClass c, Fn fn) {
+		auto ticket = std::make_shared<TxTicket>();
+		{
+			std::lock_guard<std::mutex> lock(m_);
+			if (stop_) {
+				ticket->finish(kTxCancelled);
+				return ticket;
+			}
+			if (c == TxClass::User || c == TxClass::Ramp) // the pending ramp step is moot
+				while (!queues_[(size_t)TxClass::Ramp].empty())
+					cancelFront(TxClass::Ramp);
+			auto &q = queues_[(size_t)c];
+			q.push_back({std::move(fn), ticket, std::chrono::steady_clock::now()});
+			metrics().depth[(size_t)c].add(1);
+			stats_[(size_t)c].depthMax = (std::max)(stats_[(size_t)c].depthMax, q.size());
+			if (!thread_.joinable())
+				thread_ = std::thread([this] { loop(); });
+		}
+		wake_.notify_one();
+		return ticket;
+	}
+
+	int run(TxClass c, Fn fn) { return post(c, std::move(fn))->wait(); }
+
+	// Returns once nothing is queued or on the wire.
+	void idle() {
+		std::unique_lock<std::mutex> lock(m_);
+		idle_.wait(lock, [this] { return !busy_ && queued() == 0; });
+	}
+
+	size_t depth(TxClass c) const {
+		std::lock_guard<std::mutex> lock(m_);
+		return queues_[(size_t)c].size();
+	}
+	Stats stats(TxClass c) const {
+		std::lock_guard<std::mutex> lock(m_);
+		return stats_[(size_t)c];
+	}
+
+private:
+	struct Tx {
+		Fn                                    fn;
+		std::shared_ptr<TxTicket>             ticket;
+		std::chrono::steady_clock::time_point queued;
+	};
+
+	static constexpr uint64_t    kBoundsUs[] = {100, 500, 1000, 2000, 5000, 10000, 20000, 50000, 100000, 500000};
+	static constexpr const char *kLabels[kTxClasses] = {"class=\"user\"", "class=\"preset\"", "class=\"ramp\"",
+	                                                    "class=\"probe\""};
+	static constexpr const char *kDepth = "sbpp_tx_queue_depth", *kDepthHelp = "HID transactions waiting, per class";
+	static constexpr const char *kWait = "sbpp_tx_wait_us", *kWaitHelp = "HID transaction submit to start, per class";
+	static constexpr const char *kCancelled     = "sbpp_tx_cancelled_total";
+	static constexpr const char *kCancelledHelp = "HID transactions dropped before they ran, per class";
+
+	struct Metrics {
+		MetricGauge     depth[kTxClasses] = {{kDepth, kDepthHelp, kLabels[0]}, {kDepth, kDepthHelp, kLabels[1]},
+		                                     {kDepth, kDepthHelp, kLabels[2]}, {kDepth, kDepthHelp, kLabels[3]}};
+		MetricHistogram wait[kTxClasses]  = {{kWait, kWaitHelp, kBoundsUs, kLabels[0]},
+		                                     {kWait, kWaitHelp, kBoundsUs, kLabels[1]},
+		                                     {kWait, kWaitHelp, kBoundsUs, kLabels[2]},
+		                                     {kWait, kWaitHelp, kBoundsUs, kLabels[3]}};
+		MetricCounter cancelled[kTxClasses] = {
+		    {kCancelled, kCancelledHelp, kLabels[0]}, {kCancelled, kCancelledHelp, kLabels[1]},
+		    {kCancelled, kCancelledHelp, kLabels[2]}, {kCancelled, kCancelledHelp, kLabels[3]}};
+	};
+
+	// Shared by every scheduler, never destroyed (a display may be closed during static destruction).
+	static Metrics &metrics() {
+		static Metrics *m = new Metrics();
+		return *m;
+	}
+
+	size_t queued() const {
+		size_t n = 0;
+		for (const auto &q : queues_)
+			n += q.size();
+		return n;
+	}
+
+	void cancelFront(TxClass c) { // m_ held
+		auto &q = queues_[(size_t)c];
+		q.front().ticket->finish(kTxCancelled);
+		q.pop_front();
+		metrics().depth[(size_t)c].add(-1);
+		metrics().cancelled[(size_t)c].add();
+		++stats_[(size_t)c].cancelled;
+	}
+
+	void loop() {
+		Trace::NameThread("device");
+		std::unique_lock<std::mutex> lock(m_);
+		for (;;) {
+			wake_.wait(lock, [this] { return stop_ || queued() > 0; });
+			if (stop_)
+				return;
+			size_t c = 0;
+			while (queues_[c].empty())
+				++c;
+			Tx tx = std::move(queues_[c].front());
+			queues_[c].pop_front();
+			metrics().depth[c].add(-1);
+			uint64_t waitUs = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+			                      std::chrono::steady_clock::now() - tx.queued)
+			                      .count();
+			metrics().wait[c].observe(waitUs);
+			Stats &s = stats_[c];
+			++s.done;
+			s.waitUsTotal += waitUs;
+			s.waitUsMax = (std::max)(s.waitUsMax, waitUs);
+			busy_       = true;
+			lock.unlock();
+			int rc;
+			{
+				TRACE_SCOPE("device.tx");
+				rc = tx.fn();
+			}
+			tx.ticket->finish(rc);
+			lock.lock();
+			busy_ = false;
+			if (queued() == 0)
+				idle_.notify_all();
+		}
+	}
+
+	mutable std::mutex      m_;
+	std::condition_variable wake_, idle_;
+	std::deque<Tx>          queues_[kTxClasses];
+	Stats                   stats_[kTxClasses];
+	bool                    busy_ = false;
+	bool                    stop_ = false;
+	std::thread             thread_;
+};
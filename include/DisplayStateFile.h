@@ -0,0 +1,268 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <thread>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// What the app knows about each display it has driven, kept across restarts and reconnects in one
+// small mapped file: the range, the last brightness written, the auto-brightness anchor, the
+// brightness cap the descriptor resolved to and the color preset. A display that comes back is
+// usable at once from its record; the device is read in the background only to confirm it.
+//
+// File layout (little-endian, one 4 KB page): DisplayStateFileHeader, then kRecords slots of 64
+// bytes, one per ContainerId; when all are taken the least recently saved is reused. A slot is a
+// seqlock: its counter is odd while the slot is rewritten, so a reader (in this process or another)
+// retries instead of seeing half a record, and one left odd by a crash is cleared on open. A
+// checksum over the payload drops a record the disk only kept part of. Like the file log, the OS
+// owns the dirty page: a save is a few stores into the view.
+
+// One display's record, as load and save see it.
+struct DisplayState {
+	uint8_t  containerId[16];
+	uint32_t minB, maxB;         // the brightness range
+	uint32_t current;            // the last brightness written
+	uint32_t base;               // with baseLux, the manual anchor auto-brightness maps from
+	float    baseLux;
+	uint16_t capPage, capUsage;  // the brightness cap hid_enumerate resolved
+	uint16_t capLen;
+	uint8_t  capId;
+	uint8_t  reserved;
+	int32_t  presetIndex;        // -1: no preset interface
+};
+static_assert(sizeof(DisplayState) == 48, "display state must stay 48 bytes (12 words)");
+
+struct DisplayStateFileHeader {
+	char                  magic[8]; // "SBPPDST1"
+	uint16_t              version;  // kDisplayStateVersion
+	uint16_t              recordBytes;
+	uint32_t              records;
+	std::atomic<uint32_t> clock; // saves so far: a slot's stamp, for reuse
+	uint8_t               reserved[44];
+};
+static_assert(sizeof(DisplayStateFileHeader) == 64, "display state header must stay 64 bytes");
+
+constexpr uint16_t kDisplayStateVersion = 1;
+
+class DisplayStateFile {
+public:
+	static constexpr size_t kBytes   = 4096;
+	static constexpr size_t kRecords = (kBytes - sizeof(DisplayStateFileHeader)) / 64;
+
+	DisplayStateFile() = default;
+	~DisplayStateFile() { close(); }
+	DisplayStateFile(const DisplayStateFile &)            = delete;
+	DisplayStateFile &operator=(const DisplayStateFile &) = delete;
+
+	// Maps `path`, creating it if needed. A file that is not a state file (or of another version)
+	// starts over empty.
+	bool open(const std::filesystem::path &path) {
+		close();
+#ifdef _WIN32
+		file_ = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+		                    OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file_ == INVALID_HANDLE_VALUE)
+			return false;
+		mapping_ = CreateFileMappingW(file_, nullptr, PAGE_READWRITE, 0, (DWORD)kBytes, nullptr); // sizes the file
+		void *v  = mapping_ ? MapViewOfFile(mapping_, FILE_MAP_WRITE, 0, 0, kBytes) : nullptr;
+#else
+		fd_ = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+		struct stat st;
+		if (fd_ < 0 || fstat(fd_, &st) != 0 || ((size_t)st.st_size < kBytes && ftruncate(fd_, kBytes) != 0)) {
+			close();
+			return false;
+		}
+		void *v = mmap(nullptr, kBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+		if (v == MAP_FAILED)
+			v = nullptr;
+#endif
+		if (!v) {
+			close();
+			return false;
+		}
+		base_ = static_cast<uint8_t *>(v);
+		auto *h = header();
+		if (memcmp(h->magic, "SBPPDST1", 8) != 0 || h->version != kDisplayStateVersion || h->recordBytes != 64 ||
+		    h->records != kRecords) {
+			memset(base_, 0, kBytes);
+			h->version     = kDisplayStateVersion;
+			h->recordBytes = 64;
+			h->records     = kRecords;
+			memcpy(h->magic, "SBPPDST1", 8); // last: a crash before here starts over next time
+		}
+		for (size_t i = 0; i < kRecords; ++i) // torn by a crash mid-save
+			if (slot(i).seq.load(std::memory_order_relaxed) & 1)
+				clearSlot(slot(i));
+		return true;
+	}
+
+	void close() {
+#ifdef _WIN32
+		if (base_)
+			UnmapViewOfFile(base_);
+		if (mapping_)
+			CloseHandle(mapping_);
+		if (file_ != INVALID_HANDLE_VALUE)
+			CloseHandle(file_);
+		mapping_ = nullptr;
+		file_    = INVALID_HANDLE_VALUE;
+#else
+		if (base_)
+			munmap(base_, kBytes);
+		if (fd_ >= 0)
+			::close(fd_);
+		fd_ = -1;
+#endif
+		base_ = nullptr;
+	}
+
+	bool isOpen() const { return base_ != nullptr; }
+
+	// The record for `containerId`. Any thread, lock-free.
+	bool load(const uint8_t (&containerId)[16], DisplayState &out) const {
+		if (!base_)
+			return false;
+		for (size_t i = 0; i < kRecords; ++i) {
+			uint32_t stamp;
+			if (holds(slot(i), containerId) && read(slot(i), out, stamp) &&
+			    memcmp(out.containerId, containerId, 16) == 0)
+				return true;
+		}
+		return false;
+	}
+
+	// Writes `s` into its display's slot. Not synchronized against other saves: the app saves with
+	// the display lock held.
+	bool save(const DisplayState &s) {
+		if (!base_)
+			return false;
+		Slot    *target = nullptr, *empty = nullptr, *oldest = nullptr;
+		uint32_t oldestStamp = UINT32_MAX;
+		for (size_t i = 0; i < kRecords && !target; ++i) { // the only writer: the slots hold still
+			Slot &sl = slot(i);
+			if (sl.seq.load(std::memory_order_relaxed) == 0) {
+				if (!empty)
+					empty = &sl;
+			} else if (holds(sl, s.containerId)) {
+				target = &sl;
+			} else if (uint32_t stamp = sl.words[kStampWord].load(std::memory_order_relaxed); stamp < oldestStamp) {
+				oldestStamp = stamp;
+				oldest      = &sl;
+			}
+		}
+		if (!target)
+			target = empty ? empty : oldest;
+
+		uint32_t w[kPayloadWords];
+		memcpy(w, &s, sizeof(s));
+		w[kStampWord] = header()->clock.fetch_add(1, std::memory_order_relaxed) + 1;
+		uint32_t seq  = target->seq.load(std::memory_order_relaxed);
+		// Odd first: a reader that sees any new word (release) also sees the odd counter after it.
+		target->seq.store(seq + 1, std::memory_order_relaxed);
+		for (size_t k = 0; k < kPayloadWords; ++k)
+			target->words[k].store(w[k], std::memory_order_release);
+		target->words[kSumWord].store(checksum(w), std::memory_order_release);
+		target->seq.store(seq + 2, std::memory_order_release);
+		return true;
+	}
+
+	// Calls fn(const DisplayState &) for every record; returns how many there are.
+	template <class F>
+	size_t forEach(F &&fn) const {
+		size_t n = 0;
+		for (size_t i = 0; base_ && i < kRecords; ++i) {
+			DisplayState s;
+			uint32_t     stamp;
+			if (read(slot(i), s, stamp)) {
+				fn(s);
+				++n;
+			}
+		}
+		return n;
+	}
+
+private:
+	static constexpr size_t kPayloadWords = sizeof(DisplayState) / 4 + 1; // the state, then its stamp
+	static constexpr size_t kStampWord    = kPayloadWords - 1;
+	static constexpr size_t kSumWord      = kPayloadWords;
+
+	struct Slot {
+		std::atomic<uint32_t> seq; // 0: never written; odd: being written
+		std::atomic<uint32_t> words[15];
+	};
+	static_assert(sizeof(Slot) == 64 && kSumWord < 15, "a slot is 64 bytes");
+	static_assert(std::atomic<uint32_t>::is_always_lock_free, "the slots live in a file mapping");
+
+	static uint32_t checksum(const uint32_t *w) { // FNV-1a
+		uint32_t h = 2166136261u;
+		for (size_t k = 0; k < kPayloadWords; ++k)
+			h = (h ^ w[k]) * 16777619u;
+		return h;
+	}
+
+	// A consistent copy of a slot; false if it is empty, being written, or fails its checksum.
+	static bool read(const Slot &sl, DisplayState &out, uint32_t &stamp) {
+		for (int attempt = 0; attempt < 64; ++attempt) {
+			uint32_t seq = sl.seq.load(std::memory_order_acquire);
+			if (seq == 0)
+				return false;
+			if (seq & 1) {
+				if (attempt >= 8)
+					std::this_thread::yield(); // the writer was preempted mid-save
+				continue;
+			}
+			uint32_t w[kPayloadWords];
+			for (size_t k = 0; k < kPayloadWords; ++k)
+				w[k] = sl.words[k].load(std::memory_order_acquire);
+			uint32_t sum = sl.words[kSumWord].load(std::memory_order_acquire);
+			if (sl.seq.load(std::memory_order_relaxed) != seq) // a save started meanwhile
+				continue;
+			if (sum != checksum(w))
+				return false;
+			memcpy(&out, w, sizeof(out));
+			stamp = w[kStampWord];
+			return true;
+		}
+		return false; // a writer that never finishes: treat as absent
+	}
+
+	// The slot's ContainerId words match (a filter: read() confirms).
+	static bool holds(const Slot &sl, const uint8_t (&containerId)[16]) {
+		for (size_t k = 0; k < 4; ++k) {
+			uint32_t v;
+			memcpy(&v, containerId + 4 * k, 4);
+			if (sl.words[k].load(std::memory_order_relaxed) != v)
+				return false;
+		}
+		return true;
+	}
+
+	static void clearSlot(Slot &sl) {
+		for (auto &w : sl.words)
+			w.store(0, std::memory_order_relaxed);
+		sl.seq.store(0, std::memory_order_release);
+	}
+
+	DisplayStateFileHeader *header() const { return reinterpret_cast<DisplayStateFileHeader *>(base_); }
+	Slot &slot(size_t i) const { return reinterpret_cast<Slot *>(base_ + sizeof(DisplayStateFileHeader))[i]; }
+
+	uint8_t *base_ = nullptr;
+#ifdef _WIN32
+	HANDLE file_    = INVALID_HANDLE_VALUE;
+	HANDLE mapping_ = nullptr;
+#else
+	int fd_ = -1;
+#endif
+};
@@ -0,0 +1,88 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "AutoBrightness.h"
+
+class BrightnessDisplay;
+
+// The hot per-display state, the numbers the auto-brightness tick and the writes read on every
+// display every tick, kept apart from the display objects (handles, names, preset lists) in
+// struct-of-arrays pages: one array per field, 64 displays to a page. A tick over a video wall
+// walks a few contiguous arrays instead of every large DisplayDevice.
+//
+// A BrightnessDisplay holds a slot from construction to destruction (moves carry it along).
+// Pages never move once allocated, so a reference to a field stays valid while its display
+// exists. Not locked: slots are taken and released with the display lock held, like every other
+// access to display state (hid_enumerate runs under it).
+class DisplayStates {
+public:
+	static constexpr uint32_t kPage   = 64;
+	static constexpr uint32_t kNoSlot = UINT32_MAX;
+
+	struct Page {
+		uint32_t           current[kPage];
+		uint32_t           base[kPage]; // the user's last manual level; with baseLux, the auto anchor
+		uint32_t           minB[kPage];
+		uint32_t           maxB[kPage];
+		float              baseLux[kPage];
+		float              maxNits[kPage]; // nit calibration for proportional brightness matching
+		uint8_t            locked[kPage];  // a reference-mode preset fixes the brightness
+		uint32_t           commitUs[kPage];
+		uint32_t           rampVal[kPage], rampFrom[kPage];
+		AutoRamp           ramp[kPage];
+		BrightnessDisplay *display[kPage]; // the slot's owner, nullptr when free
+		const void        *ticker[kPage];  // the BrightnessCore whose tick includes it (attach)
+	};
+
+	// The one store every display lives in. Never destroyed: displays held in statics outlive it.
+	static DisplayStates &shared() {
+		static DisplayStates *s = new DisplayStates();
+		return *s;
+	}
+
+	uint32_t acquire(BrightnessDisplay *owner) {
+		uint32_t slot;
+		if (!free_.empty()) {
+			slot = free_.back();
+			free_.pop_back();
+		} else {
+			if (slots_ % kPage == 0)
+				pages_.push_back(std::make_unique<Page>());
+			slot = slots_++;
+		}
+		Page    &p = page(slot);
+		uint32_t i = slot % kPage;
+		p.current[i]  = 30000;
+		p.base[i]     = 30000;
+		p.minB[i]     = 1000;
+		p.maxB[i]     = 60000;
+		p.baseLux[i]  = 100.f;
+		p.maxNits[i]  = 600.f;
+		p.locked[i]   = 0;
+		p.commitUs[i] = 0;
+		p.rampVal[i]  = 0;
+		p.rampFrom[i] = 0;
+		p.ramp[i]     = AutoRamp{};
+		p.display[i]  = owner;
+		p.ticker[i]   = nullptr;
+		return slot;
+	}
+	void release(uint32_t slot) {
+		Page &p                 = page(slot);
+		p.display[slot % kPage] = nullptr;
+		p.ticker[slot % kPage]  = nullptr;
+		free_.push_back(slot);
+	}
+
+	Page       &page(uint32_t slot) { return *pages_[slot / kPage]; }
+	const Page &page(uint32_t slot) const { return *pages_[slot / kPage]; }
+	size_t      pages() const { return pages_.size(); }
+	Page       &pageAt(size_t n) { return *pages_[n]; }
+
+private:
+	std::vector<std::unique_ptr<Page>> pages_;
+	std::vector<uint32_t>              free_;
+	uint32_t                           slots_ = 0;
+};
@@ -0,0 +1,59 @@
+#pragma once
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <hidsdi.h>
+#include <hidpi.h>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "HidAlsReport.h"
+#include "LuxSource.h"
+
+constexpr DWORD kHidAlsPollMs = 500;
+
+// Ambient light read straight from a display's HID sensor collection, for panels whose Windows ALS
+// interface never loads. The Studio Display XDR's MI_08 sensor fails with Code 10 (see
+// docs/hid-map.md), but MI_07&col01/col02 still expose sensor usages over plain HID.
+//
+// The reader prefers Input reports (a blocking overlapped ReadFile on its own thread: the display
+// pushes samples, no polling); only when the collection has no matching Input usage does it fall
+// back to reading the Feature report (every kHidAlsPollMs unless the sampling policy says otherwise).
+class HidLuxSource : public LuxSource {
+public:
+	~HidLuxSource() override;
+
+	bool  alive() const override { return alive_.load(std::memory_order_relaxed); }
+	uint32_t samples() const override { return samples_.load(std::memory_order_relaxed); }
+	// Input reports arrive at the display's own rate; only the Feature polling fallback follows this.
+	void setReportInterval(uint32_t ms) override { pollMs_.store(ms); }
+
+	GUID         containerId = {};
+	std::wstring path;
+	uint8_t      slot = 0; // Timeline slot
+
+	// Open the first Apple HID collection on this ContainerId that exposes an ambient light usage and
+	// start reading it. `onFirstSample` runs once, on the reader thread, when data starts flowing.
+	static std::unique_ptr<HidLuxSource> Open(const GUID &containerId, std::function<void()> onFirstSample);
+
+private:
+	HidLuxSource() = default;
+	void run();
+	void publish(uint32_t raw);
+
+	HANDLE               h_         = INVALID_HANDLE_VALUE;
+	HANDLE               stop_      = nullptr;
+	HIDP_REPORT_TYPE     type_      = HidP_Input;
+	HidAlsLayout         layout_;
+	USHORT               reportLen_ = 0;
+	int                  logged_    = 0; // raw samples logged so far (reader thread)
+	std::function<void()> onFirstSample_;
+	std::thread           thread_;
+	std::atomic<bool>     alive_{false};
+	std::atomic<uint32_t> samples_{0};
+	std::atomic<uint32_t> pollMs_{kHidAlsPollMs};
+};
+
@@ -0,0 +1,43 @@
+#pragma once
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// Where an ambient light value sits in a HID report, and how it becomes lux. HidLuxSource
+// (HidAls.h) fills one in from the collection's value caps once, at open; decoding a report is then
+// plain byte work, so it can be checked against synthetic reports without a device (als-check --hid).
+//
+// Reports are laid out the way Windows hands them over: byte 0 is the report ID (0 when the
+// collection declares none) and bit offsets count from the start of that byte.
+struct HidAlsLayout {
+	uint16_t page      = 0;
+	uint16_t usage     = 0;
+	uint8_t  reportId  = 0;
+	uint16_t bitOffset = 0;
+	uint16_t bitSize   = 0; // 1-32
+	float    scale     = 1.f; // hidUnitScale(UnitsExp)
+
+	// The raw value in `report`, if it is this layout's report and long enough to hold it.
+	bool decode(const uint8_t *report, size_t n, uint32_t &raw) const {
+		if (n == 0 || report[0] != reportId || bitSize == 0 || bitSize > 32 ||
+		    (size_t)bitOffset + bitSize > n * 8)
+			return false;
+		uint64_t v = 0;
+		size_t   first = bitOffset / 8, last = ((size_t)bitOffset + bitSize - 1) / 8;
+		for (size_t i = last + 1; i-- > first;) // little-endian
+			v = v << 8 | report[i];
+		v >>= bitOffset % 8;
+		raw = (uint32_t)(bitSize == 32 ? v : v & ((1ull << bitSize) - 1));
+		return true;
+	}
+
+	float lux(uint32_t raw) const { return (float)raw * scale; }
+};
+
+// HID unit exponent: a 4-bit two's complement nibble (0x0-0x7 = 10^0..10^7, 0x8-0xF = 10^-8..10^-1).
+inline float hidUnitScale(uint32_t unitsExp) {
+	int e = (int)(unitsExp & 0xF);
+	if (e > 7)
+		e -= 16;
+	return (float)std::pow(10.0, e);
+}
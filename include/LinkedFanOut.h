@@ -0,0 +1,111 @@
+#pragma once
+#include <barrier>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Trace.h"
+
+// Runs one linked write on every display at once. Each display gets a lane: lane 0 is the calling
+// thread, the others are threads parked here between writes (started on first use, one per extra
+// display ever linked). A write has two halves: every lane stages its report (which may read the
+// device), all lanes meet at a barrier, then every lane sends its report. Staging the slow part
+// before the barrier is what makes the sends leave together: the panels change within the spread
+// of one round trip instead of one round trip apart per display.
+//
+// Not reentrant: BrightnessCore calls it with the display lock held.
+class LinkedFanOut {
+public:
+	using Step = std::function<int(size_t lane)>; // 0 = ok
+
+	LinkedFanOut() = default;
+	LinkedFanOut(const LinkedFanOut &)            = delete;
+	LinkedFanOut &operator=(const LinkedFanOut &) = delete;
+	~LinkedFanOut() {
+		{
+			std::lock_guard<std::mutex> lock(m_);
+			stop_ = true;
+		}
+		wake_.notify_all();
+		for (auto &t : threads_)
+			t.join();
+	}
+
+	// stage(i) then, once every lane has staged, commit(i) for i in [0, n). commit is skipped on a
+	// lane whose stage failed. rc[i] is the lane's result and doneNs[i] the steady-clock time its
+	// commit returned. Returns when every lane is done.
+	void run(size_t n, const Step &stage, const Step &commit, int *rc, int64_t *doneNs) {
+		if (n == 0)
+			return;
+		while (threads_.size() + 1 < n)
+			threads_.emplace_back([this, lane = threads_.size() + 1] { laneLoop(lane); });
+		std::barrier<> sync((std::ptrdiff_t)n);
+		{
+			std::lock_guard<std::mutex> lock(m_);
+			job_     = {n, &stage, &commit, rc, doneNs, &sync};
+			pending_ = n - 1;
+			++gen_;
+		}
+		wake_.notify_all();
+		work(0);
+		std::unique_lock<std::mutex> lock(m_);
+		done_.wait(lock, [this] { return pending_ == 0; });
+	}
+
+	static int64_t nowNs() {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+		    .count();
+	}
+
+private:
+	struct Job {
+		size_t          n = 0;
+		const Step     *stage = nullptr, *commit = nullptr;
+		int            *rc     = nullptr;
+		int64_t        *doneNs = nullptr;
+		std::barrier<> *sync   = nullptr;
+	};
+
+	void work(size_t lane) {
+		TRACE_SCOPE("linked.lane");
+		int rc = (*job_.stage)(lane);
+		job_.sync->arrive_and_wait(); // every report staged: send them together
+		if (rc == 0)
+			rc = (*job_.commit)(lane);
+		job_.doneNs[lane] = nowNs();
+		job_.rc[lane]     = rc;
+	}
+
+	void laneLoop(size_t lane) {
+		Trace::NameThread("linked");
+		uint64_t seen = 0;
+		for (;;) {
+			{
+				std::unique_lock<std::mutex> lock(m_);
+				wake_.wait(lock, [&] { return stop_ || gen_ != seen; });
+				if (stop_)
+					return;
+				seen = gen_;
+				if (lane >= job_.n)
+					continue; // fewer displays linked this time
+			}
+			work(lane);
+			std::lock_guard<std::mutex> lock(m_);
+			if (--pending_ == 0)
+				done_.notify_one();
+		}
+	}
+
+	std::mutex               m_;
+	std::condition_variable  wake_, done_;
+	std::vector<std::thread> threads_;
+	Job                      job_;
+	size_t                   pending_ = 0;
+	uint64_t                 gen_     = 0;
+	bool                     stop_    = false;
+};
@@ -0,0 +1,216 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+// The file log (Log::StartFileLog): a fixed-size file mapped into the process and used as a
+// circular buffer of fixed-size records. A line is a memcpy into the view; the OS owns the dirty
+// pages, so everything written survives the process crashing and reaches the disk on its own.
+// Only a machine reset can lose the tail, which is what the optional explicit flush is for.
+// Each file is one segment: Log switches to a new one, created ahead in the background, before this
+// one would wrap (it only wraps if none is ready) and re-encodes the closed one compactly
+// (LogSegment.h). logFileText turns a file back into text; tools/log-decode.cpp does it for files
+// left behind by a crash or a reset.
+//
+// File layout (little-endian):
+//   LogFileHeader, padded to kLogFileHeaderBytes, then `records` LogFileRecords of recordBytes.
+// Record n (0-based, counting every record ever written) lives at slot n % records. A line longer
+// than one record's text continues in the following records. A record's seq is cleared while it
+// is rewritten and set last, so one torn by a crash mid-write reads as empty.
+
+#pragma pack(push, 1)
+struct LogFileHeader {
+	char     magic[8];      // "SBPPLOG1"
+	uint16_t version;       // kLogFileVersion
+	uint16_t headerBytes;   // kLogFileHeaderBytes
+	uint32_t recordBytes;   // sizeof(LogFileRecord)
+	uint32_t records;       // slots in the file
+	uint32_t reserved0;
+	uint64_t nextRecord;    // write cursor: records ever written
+	int64_t  untilEpoch;    // the session deadline (unix seconds), for reference
+	uint16_t startTime[7];  // local time the file was created: year, month, day, h, m, s, ms
+	uint8_t  reserved[18];
+};
+
+struct LogFileRecord {
+	uint64_t seq;     // record number + 1; 0 = empty (or being written)
+	uint16_t time[7]; // local time of the line: year, month, day, h, m, s, ms
+	uint8_t  level;   // LogLevel
+	uint8_t  flags;   // kLogFileFirst / kLogFileMore
+	uint16_t len;     // bytes of text in this record
+	uint8_t  reserved[6];
+	char     text[224]; // UTF-8, not terminated
+};
+#pragma pack(pop)
+static_assert(sizeof(LogFileHeader) == 72, "log file header must stay 72 bytes");
+static_assert(sizeof(LogFileRecord) == 256, "log file records must stay 256 bytes");
+
+constexpr uint16_t kLogFileVersion     = 1;
+constexpr size_t   kLogFileHeaderBytes = 4096; // a page, so records never share one with the header
+constexpr size_t   kLogFileBytes       = 4 * 1024 * 1024;
+constexpr size_t   kLogFileRecords     = (kLogFileBytes - kLogFileHeaderBytes) / sizeof(LogFileRecord);
+constexpr uint8_t  kLogFileFirst       = 1; // the line starts in this record
+constexpr uint8_t  kLogFileMore        = 2; // ...and continues in the next
+
+// Writes lines into a mapped file. Not synchronized: Log calls it under its lock.
+class LogFileWriter {
+public:
+	// `base` is the whole mapped file (kLogFileBytes). A new file: fills in the header.
+	LogFileWriter(void *base, const uint16_t (&startTime)[7], int64_t untilEpoch) {
+		header_ = static_cast<LogFileHeader *>(base);
+		memset(header_, 0, kLogFileHeaderBytes);
+		memcpy(header_->magic, "SBPPLOG1", 8);
+		header_->version     = kLogFileVersion;
+		header_->headerBytes = (uint16_t)kLogFileHeaderBytes;
+		header_->recordBytes = (uint32_t)sizeof(LogFileRecord);
+		header_->records     = (uint32_t)kLogFileRecords;
+		memcpy(header_->startTime, startTime, sizeof(header_->startTime));
+		header_->untilEpoch = untilEpoch;
+		records_            = reinterpret_cast<LogFileRecord *>(static_cast<char *>(base) + kLogFileHeaderBytes);
+	}
+
+	// True if a line of `len` bytes still fits without overwriting the oldest records.
+	bool fits(size_t len) const {
+		size_t need = len ? (len + sizeof(LogFileRecord::text) - 1) / sizeof(LogFileRecord::text) : 1;
+		return header_->nextRecord + need <= kLogFileRecords;
+	}
+
+	// Records written so far (a long line takes several).
+	uint64_t written() const { return header_->nextRecord; }
+
+	// One line of `len` bytes of UTF-8.
+	void write(const uint16_t (&time)[7], uint8_t level, const char *text, size_t len) {
+		uint64_t n     = header_->nextRecord;
+		size_t   count = 0;
+		uint8_t  flags = kLogFileFirst;
+		do {
+			LogFileRecord &r    = records_[(n + count) % kLogFileRecords];
+			size_t         part = len < sizeof(r.text) ? len : sizeof(r.text);
+			r.seq               = 0;
+			memcpy(r.time, time, sizeof(r.time));
+			r.level = level;
+			r.flags = (uint8_t)(flags | (len > part ? kLogFileMore : 0));
+			r.len   = (uint16_t)part;
+			memcpy(r.text, text, part);
+			r.seq = n + count + 1;
+			text += part;
+			len -= part;
+			flags = 0;
+			++count;
+		} while (len && count < kLogFileRecords);
+		header_->nextRecord = n + count;
+	}
+
+private:
+	LogFileHeader *header_;
+	LogFileRecord *records_;
+};
+
+// One decoded line.
+struct LogFileLine {
+	uint64_t        seq;  // of its first record
+	const uint16_t *time; // year, month, day, h, m, s, ms
+	uint8_t         level;
+	size_t          len;
+	const char     *text; // valid until the next call
+};
+
+// Walks the lines of a mapped (or fully read) log file, oldest first. Lines whose start was
+// overwritten, or that were torn by a crash, are skipped.
+class LogFileCursor {
+public:
+	LogFileCursor(const void *data, size_t size) {
+		const auto *hdr = static_cast<const LogFileHeader *>(data);
+		if (size < kLogFileHeaderBytes || memcmp(hdr->magic, "SBPPLOG1", 8) != 0 ||
+		    hdr->recordBytes != sizeof(LogFileRecord) || hdr->headerBytes < sizeof(LogFileHeader) ||
+		    size < hdr->headerBytes + (size_t)hdr->records * sizeof(LogFileRecord) || !hdr->records)
+			return;
+		header_  = hdr;
+		records_ = reinterpret_cast<const LogFileRecord *>(static_cast<const char *>(data) + hdr->headerBytes);
+		// The cursor in the header can lag the records after a crash: trust the records.
+		for (size_t i = 0; i < hdr->records; ++i)
+			if (records_[i].seq > end_)
+				end_ = records_[i].seq;
+		next_ = end_ > hdr->records ? end_ - hdr->records : 0;
+	}
+
+	bool valid() const { return header_ != nullptr; }
+	const LogFileHeader *header() const { return header_; }
+
+	bool next(LogFileLine &out) {
+		while (next_ < end_) {
+			const LogFileRecord &r = record(next_);
+			if (r.seq != next_ + 1 || !(r.flags & kLogFileFirst)) {
+				++next_; // overwritten start, torn, or a continuation without its start
+				continue;
+			}
+			text_.clear();
+			uint64_t n = next_;
+			bool     ok = true;
+			for (;;) {
+				const LogFileRecord &p = record(n);
+				if (p.seq != n + 1 || (n != next_ && (p.flags & kLogFileFirst))) {
+					ok = false;
+					break;
+				}
+				text_.append(p.text, p.len);
+				++n;
+				if (!(p.flags & kLogFileMore))
+					break;
+				if (n >= end_) {
+					ok = false;
+					break;
+				}
+			}
+			uint64_t seq = next_;
+			next_        = n;
+			if (!ok)
+				continue;
+			out = {seq, r.time, r.level, text_.size(), text_.data()};
+			return true;
+		}
+		return false;
+	}
+
+private:
+	const LogFileRecord &record(uint64_t n) const { return records_[n % header_->records]; }
+
+	const LogFileHeader *header_  = nullptr;
+	const LogFileRecord *records_ = nullptr;
+	uint64_t             next_    = 0;
+	uint64_t             end_     = 0;
+	std::string          text_; // reassembles lines split across records
+};
+
+// Text export, shared with the compact segments (LogSegment.h): a UTF-8 BOM and a title line, then
+// one "YYYY-MM-DD hh:mm:ss.mmm [LEVEL] text" line per entry.
+inline void appendLogTextHeader(std::string &out, const uint16_t (&start)[7]) {
+	char buf[96];
+	snprintf(buf, sizeof(buf), "\xEF\xBB\xBF==== Studio Brightness++ file log, %04u-%02u-%02u %02u:%02u:%02u local ====\r\n",
+	         start[0], start[1], start[2], start[3], start[4], start[5]);
+	out += buf;
+}
+inline void appendLogTextLine(std::string &out, const uint16_t *t, uint8_t level, const char *text, size_t len) {
+	static const char *const kTags[] = {"INFO ", "WARN ", "ERROR"};
+	char                     buf[64];
+	snprintf(buf, sizeof(buf), "%04u-%02u-%02u %02u:%02u:%02u.%03u [%s] ", t[0], t[1], t[2], t[3], t[4], t[5], t[6],
+	         level < 3 ? kTags[level] : "?????");
+	out += buf;
+	out.append(text, len);
+	out += "\r\n";
+}
+
+// The whole file as text (see appendLogTextHeader). Empty if `data` is not a log file.
+inline std::string logFileText(const void *data, size_t size) {
+	LogFileCursor cur(data, size);
+	if (!cur.valid())
+		return {};
+	std::string out;
+	appendLogTextHeader(out, cur.header()->startTime);
+	LogFileLine line;
+	while (cur.next(line))
+		appendLogTextLine(out, line.time, line.level, line.text, line.len);
+	return out;
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cwchar>
+#include <tuple>
+#include <type_traits>
+
+#include "LogRing.h"
+
+// Deferred formatting for log calls: Log::Info(fmt, args...) stores the format pointer plus the
+// argument bytes, and the printf runs only when something reads the line as text (log window,
+// clipboard, file). LogRecord<A...> is instantiated per argument-type list, so packing is a few
+// memcpy and string copies, and LogRecord<A...>::format is the thunk that unpacks and prints.
+//
+// Arguments are stored after the default argument promotions (what printf receives anyway), so
+// the deferred text is byte-for-byte the text an immediate printf would have produced. Strings are
+// copied (the caller's buffer may be gone by then) behind a one-character null marker.
+
+template <class T>
+struct LogArg {
+	static_assert(std::is_arithmetic_v<T> || std::is_enum_v<T> || std::is_pointer_v<T> || std::is_null_pointer_v<T>,
+	              "log arguments must be printf-compatible scalars or strings");
+	using Promoted = std::conditional_t<std::is_enum_v<T>, std::underlying_type<T>, std::common_type<T>>;
+	using U        = typename Promoted::type;
+	using Stored   = std::conditional_t<
+	      std::is_null_pointer_v<T>, const void *,
+	      std::conditional_t<std::is_floating_point_v<U>, double,
+	                         std::conditional_t<std::is_integral_v<U> && (sizeof(U) < sizeof(int)), int, U>>>;
+
+	static size_t size(const T &) { return sizeof(Stored); }
+	static void   put(uint8_t *&p, const T &v) {
+		Stored s = (Stored)v;
+		memcpy(p, &s, sizeof(s));
+		p += sizeof(s);
+	}
+	static Stored get(const uint8_t *&p) {
+		Stored s;
+		memcpy(&s, p, sizeof(s));
+		p += sizeof(s);
+		return s;
+	}
+};
+
+// Wide and narrow strings, copied in. Sizes are kept to whole wchar_t units so wide strings that
+// follow stay aligned.
+template <class C>
+struct LogStringArg {
+	using Stored = const C *;
+	static size_t units(const C *s) { return s ? std::char_traits<C>::length(s) + 1 : 0; }
+	static size_t size(const C *s) {
+		size_t bytes = sizeof(wchar_t) + units(s) * sizeof(C);
+		return (bytes + sizeof(wchar_t) - 1) / sizeof(wchar_t) * sizeof(wchar_t);
+	}
+	static void put(uint8_t *&p, const C *s) {
+		wchar_t present = s ? 1 : 0;
+		memcpy(p, &present, sizeof(present));
+		if (s)
+			memcpy(p + sizeof(wchar_t), s, units(s) * sizeof(C));
+		p += size(s);
+	}
+	static Stored get(const uint8_t *&p) {
+		wchar_t present;
+		memcpy(&present, p, sizeof(present));
+		const C *s = present ? reinterpret_cast<const C *>(p + sizeof(wchar_t)) : nullptr;
+		p += size(s);
+		return s;
+	}
+};
+template <> struct LogArg<const wchar_t *> : LogStringArg<wchar_t> {};
+template <> struct LogArg<wchar_t *> : LogStringArg<wchar_t> {};
+template <> struct LogArg<const char *> : LogStringArg<char> {};
+template <> struct LogArg<char *> : LogStringArg<char> {};
+
+template <class... A>
+struct LogRecord {
+	static size_t size(const A &...a) { return (size_t{0} + ... + LogArg<A>::size(a)); }
+
+	static void pack(void *dst, const A &...a) {
+		uint8_t *p = static_cast<uint8_t *>(dst);
+		(LogArg<A>::put(p, a), ...);
+		(void)p; // no arguments
+	}
+
+	// LogFormatFn for this argument list.
+	static int format(const wchar_t *fmt, const void *data, wchar_t *out, size_t cap) {
+		const uint8_t *p = static_cast<const uint8_t *>(data);
+		std::tuple<typename LogArg<A>::Stored...> args{LogArg<A>::get(p)...}; // braces: left to right
+		(void)p;
+		return std::apply([&](auto... v) { return logPrintf(out, cap, fmt, v...); }, args);
+	}
+};
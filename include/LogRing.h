@@ -0,0 +1,200 @@
+#pragma once
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cwchar>
+
+enum class LogLevel { Info, Warn, Error };
+
+// printf into a fixed buffer, truncating like _TRUNCATE on every platform. Returns the length.
+inline int logVPrintf(wchar_t *out, size_t cap, const wchar_t *fmt, va_list args) {
+#ifdef _WIN32
+	int n = _vsnwprintf_s(out, cap, _TRUNCATE, fmt, args);
+#else
+	int n = vswprintf(out, cap, fmt, args);
+#endif
+	if (n < 0) { // truncated (or a bad format): keep what fits
+		out[cap - 1] = L'\0';
+		n = (int)wcslen(out);
+	}
+	return n;
+}
+inline int logPrintf(wchar_t *out, size_t cap, const wchar_t *fmt, ...) {
+	va_list ap;
+	va_start(ap, fmt);
+	int n = logVPrintf(out, cap, fmt, ap);
+	va_end(ap);
+	return n;
+}
+
+// Prints a deferred record (LogRecord.h) into `out`; returns the length.
+using LogFormatFn = int (*)(const wchar_t *fmt, const void *data, wchar_t *out, size_t cap);
+
+// One entry as stored: text, or a deferred record (format string, packed arguments and the thunk
+// that prints them). Points into the ring, so it is only valid while the caller holds the lock
+// that guards it (see Log::Visit).
+struct LogView {
+	uint32_t       tick;     // first occurrence
+	LogLevel       level;
+	const wchar_t *text;     // the text, or the record's format string
+	uint32_t       len;      // text length in characters; 0 for records
+	LogFormatFn    fn;       // null for text
+	const void    *data;     // record arguments
+	uint32_t       repeats;    // identical lines collapsed into this one after the first
+	uint32_t       lastTick;   // last occurrence
+	uint32_t       suppressed; // lines from the same site rate-limited away just before this one
+
+	// The entry as text, into `out` (cap characters including the terminator); returns the length.
+	size_t format(wchar_t *out, size_t cap) const {
+		if (fn)
+			return (size_t)fn(text, data, out, cap);
+		size_t n = len < cap ? len : cap - 1;
+		wmemcpy(out, text, n);
+		out[n] = L'\0';
+		return n;
+	}
+};
+
+// Preallocated log storage: kSlots fixed-size entry headers plus one arena that the formatter (or
+// the record packer) writes into in place. Appending never allocates; the oldest entries are
+// evicted when either the slots or the arena run out. Not synchronized: the owner (Log) wraps it
+// in an SRW lock.
+//
+// Entries are laid out in append order. Each append reserves kLineChars at the arena head
+// (wrapping to the start when the tail is too short), which only ever overlaps the oldest live
+// entries.
+class LogRing {
+public:
+	static constexpr size_t kSlots          = 2000;
+	static constexpr size_t kLineChars      = 1024;       // longest line, including the terminator
+	static constexpr size_t kArenaChars     = 256 * 1024; // 512 KB of text
+	static constexpr size_t kMaxRecordBytes = kLineChars * sizeof(wchar_t);
+
+	// Text entry: `write(dst, cap)` prints into the arena and returns the length.
+	template <class W>
+	LogView appendText(uint32_t tick, LogLevel level, W &&write) {
+		size_t pos = reserve();
+		int    n   = write(arena_ + pos, kLineChars);
+		if (n < 0)
+			n = 0;
+		return commit(tick, level, pos, (size_t)n + 1, (uint32_t)n, nullptr, nullptr);
+	}
+
+	LogView append(uint32_t tick, LogLevel level, const wchar_t *fmt, va_list args) {
+		return appendText(tick, level, [&](wchar_t *dst, size_t cap) { return logVPrintf(dst, cap, fmt, args); });
+	}
+
+	// Copies an entry in: a deferred record of `bytes` (at most kMaxRecordBytes) for `fn`, or with fn
+	// null, text of bytes / sizeof(wchar_t) characters (truncated to a line). `fmt` is kept by
+	// pointer, so it must be a string literal.
+	LogView append(uint32_t tick, LogLevel level, const wchar_t *fmt, LogFormatFn fn, const void *data, size_t bytes,
+	               uint32_t suppressed = 0) {
+		size_t pos = reserve();
+		if (!fn) {
+			size_t n = bytes / sizeof(wchar_t) < kLineChars ? bytes / sizeof(wchar_t) : kLineChars - 1;
+			wmemcpy(arena_ + pos, static_cast<const wchar_t *>(data), n);
+			arena_[pos + n] = L'\0';
+			return commit(tick, level, pos, n + 1, (uint32_t)n, fmt, nullptr, suppressed);
+		}
+		memcpy(arena_ + pos, data, bytes);
+		size_t used = (bytes + sizeof(wchar_t) - 1) / sizeof(wchar_t);
+		// never empty: the next entry would evict it
+		return commit(tick, level, pos, used ? used : 1, (uint32_t)bytes, fmt, fn, suppressed);
+	}
+
+	// The same line again (see append): counted on the newest entry when it is identical (same
+	// level, format and arguments, or same text) instead of stored. Returns false if it is not.
+	bool repeat(uint32_t tick, LogLevel level, const wchar_t *fmt, LogFormatFn fn, const void *data, size_t bytes) {
+		if (!count())
+			return false;
+		Slot &s = slot(total_ - 1);
+		if (s.level != level || s.fn != fn || s.fmt != fmt)
+			return false;
+		if (fn ? (s.len != bytes || memcmp(arena_ + s.pos, data, bytes) != 0)
+		       : (s.len * sizeof(wchar_t) != bytes || wmemcmp(arena_ + s.pos, static_cast<const wchar_t *>(data), s.len) != 0))
+			return false;
+		++s.repeats;
+		s.lastTick = tick;
+		return true;
+	}
+
+	// The most recent entry; count() must be nonzero.
+	LogView newest() const { return view(slot(total_ - 1)); }
+
+	size_t total() const { return total_; } // entries ever appended
+	size_t first() const { return first_; } // index of the oldest live entry
+	size_t count() const { return total_ - first_; }
+
+	// The entry at `index`, if it is still live.
+	bool get(size_t index, LogView &out) const {
+		if (index < first_ || index >= total_)
+			return false;
+		out = view(slot(index));
+		return true;
+	}
+
+	// Call f(index, view) for every live entry from `fromIndex` on (clamped to the oldest).
+	template <class F>
+	void visit(size_t fromIndex, F &&f) const {
+		for (size_t i = fromIndex < first_ ? first_ : fromIndex; i < total_; ++i)
+			f(i, view(slot(i)));
+	}
+
+private:
+	struct Slot {
+		uint32_t       tick;
+		LogLevel       level;
+		uint32_t       pos;
+		uint32_t       len; // characters of text, bytes of a record
+		const wchar_t *fmt; // null for text printed in place
+		LogFormatFn    fn;  // null for text
+		uint32_t       repeats;
+		uint32_t       lastTick;
+		uint32_t       suppressed;
+	};
+	Slot       &slot(size_t index) { return slots_[index % kSlots]; }
+	const Slot &slot(size_t index) const { return slots_[index % kSlots]; }
+	LogView     view(const Slot &s) const {
+		if (s.fn)
+			return {s.tick, s.level, s.fmt, 0, s.fn, arena_ + s.pos, s.repeats, s.lastTick, s.suppressed};
+		return {s.tick, s.level, arena_ + s.pos, s.len, nullptr, nullptr, s.repeats, s.lastTick, s.suppressed};
+	}
+	bool overlapsHead(const Slot &s) const { return s.pos >= head_ && s.pos < head_ + kLineChars; }
+
+	// Make room for kLineChars at the head; returns its position.
+	size_t reserve() {
+		if (head_ + kLineChars > kArenaChars) {
+			// Wrap. Live entries past the old head belong to the previous lap: they are the oldest.
+			while (count() && slot(first_).pos >= head_)
+				++first_;
+			head_ = 0;
+		}
+		while (count() && (count() == kSlots || overlapsHead(slot(first_))))
+			++first_;
+		return head_;
+	}
+
+	LogView commit(uint32_t tick, LogLevel level, size_t pos, size_t used, uint32_t len, const wchar_t *fmt,
+	               LogFormatFn fn, uint32_t suppressed = 0) {
+		Slot &s = slot(total_);
+		s.tick       = tick;
+		s.level      = level;
+		s.pos        = (uint32_t)pos;
+		s.len        = len;
+		s.fmt        = fmt;
+		s.fn         = fn;
+		s.repeats    = 0;
+		s.lastTick   = tick;
+		s.suppressed = suppressed;
+		head_        = pos + used;
+		++total_;
+		return view(s);
+	}
+
+	Slot    slots_[kSlots];
+	wchar_t arena_[kArenaChars];
+	size_t  head_  = 0; // next free arena position
+	size_t  first_ = 0;
+	size_t  total_ = 0;
+};
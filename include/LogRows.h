@@ -0,0 +1,50 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+#include "LogRing.h"
+
+// The log viewer's rows: the ring indices of the entries that pass the level filter, oldest first.
+// A virtual list shows row i by formatting ring entry at(i) when it is painted, so a batch of new
+// lines costs one index each and changing the filter only re-walks the ring headers. Not
+// synchronized: sync() runs under the ring's lock (Log::Sync).
+class LogRows {
+public:
+	struct Change {
+		size_t removed; // rows dropped from the front (evicted from the ring)
+		size_t added;   // rows appended
+	};
+
+	// Catch up with the ring: drop rows whose entries were evicted, append the new matching ones.
+	Change sync(const LogRing &ring) {
+		Change c{0, 0};
+		while (c.removed < rows_.size() && rows_[c.removed] < ring.first())
+			++c.removed;
+		rows_.erase(rows_.begin(), rows_.begin() + (ptrdiff_t)c.removed);
+		ring.visit(next_, [&](size_t index, const LogView &v) {
+			if ((int)v.level >= (int)minLevel_) {
+				rows_.push_back(index);
+				++c.added;
+			}
+		});
+		next_ = ring.total();
+		return c;
+	}
+
+	// Entries below `level` are hidden. Clears the rows: the next sync rebuilds them.
+	void setMinLevel(LogLevel level) {
+		minLevel_ = level;
+		rows_.clear();
+		next_ = 0;
+	}
+	LogLevel minLevel() const { return minLevel_; }
+
+	size_t size() const { return rows_.size(); }
+	size_t at(size_t row) const { return rows_[row]; } // ring index
+	bool   empty() const { return rows_.empty(); }
+
+private:
+	std::vector<size_t> rows_; // at most LogRing::kSlots
+	size_t              next_     = 0; // next ring index to look at
+	LogLevel            minLevel_ = LogLevel::Info;
+};
@@ -0,0 +1,251 @@
+#pragma once
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "LogFile.h"
+
+// Compact storage for finished file-log segments (.sbz). The live segment is the mapped .sblog
+// (LogFile.h): 256 bytes per line so it can be written in place. Once it is closed it is
+// re-encoded here, typically 15-20x smaller than the .sblog (5-6x smaller than the text), and the
+// .sblog is deleted:
+//   - timestamps as the signed millisecond delta from the previous line (varint)
+//   - message text split into a template and its numbers: every decimal run becomes a varint,
+//     every hex run after "0x" (and any number with leading zeros) a short string, and each
+//     distinct template is written once and referred to by index afterwards
+// logSegmentText decodes a segment to the same text logFileText produces for the original.
+//
+// File layout: LogSegmentHeader, then one entry per line:
+//   tag (u8): level in bits 0-1, kSegNewTemplate, kSegRaw
+//   zigzag varint: milliseconds since the previous line (the first: since the header's start)
+//   kSegRaw: varint length + text bytes. Otherwise a new template as varint length + bytes (its
+//   index is the number of templates so far), or the varint index of a known one; then a value per
+//   placeholder in the template: kSegNumber -> varint, kSegString -> varint length + bytes.
+
+#pragma pack(push, 1)
+struct LogSegmentHeader {
+	char     magic[4];     // "SBZ1"
+	uint16_t version;      // kLogSegmentVersion
+	uint16_t startTime[7]; // copied from the .sblog header
+	uint32_t lines;
+	uint8_t  reserved[8];
+};
+#pragma pack(pop)
+static_assert(sizeof(LogSegmentHeader) == 32, "segment header must stay 32 bytes");
+
+constexpr uint16_t kLogSegmentVersion = 1;
+constexpr uint8_t  kSegNewTemplate    = 0x04;
+constexpr uint8_t  kSegRaw            = 0x08; // the text itself uses a placeholder byte
+constexpr char     kSegNumber         = '\x11';
+constexpr char     kSegString         = '\x12';
+
+/* ---------- encoding helpers ---------- */
+
+inline void segPutVarint(std::string &out, uint64_t v) {
+	while (v >= 0x80) {
+		out += (char)(v | 0x80);
+		v >>= 7;
+	}
+	out += (char)v;
+}
+
+inline bool segGetVarint(const uint8_t *&p, const uint8_t *end, uint64_t &v) {
+	v = 0;
+	for (int shift = 0; p < end && shift < 64; shift += 7) {
+		uint8_t b = *p++;
+		v |= (uint64_t)(b & 0x7F) << shift;
+		if (!(b & 0x80))
+			return true;
+	}
+	return false;
+}
+
+// Local wall-clock fields <-> milliseconds since 1970-01-01 (proleptic Gregorian, no time zone).
+inline int64_t segTimeToMs(const uint16_t *t) {
+	int64_t  y   = (int64_t)t[0] - (t[1] <= 2);
+	int64_t  era = (y >= 0 ? y : y - 399) / 400;
+	unsigned yoe = (unsigned)(y - era * 400);
+	unsigned doy = (153 * (t[1] + (t[1] > 2 ? -3 : 9)) + 2) / 5 + t[2] - 1;
+	unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+	int64_t  day = era * 146097 + (int64_t)doe - 719468;
+	return ((day * 24 + t[3]) * 60 + t[4]) * 60000 + (int64_t)t[5] * 1000 + t[6];
+}
+
+inline void segMsToTime(int64_t ms, uint16_t (&t)[7]) {
+	int64_t day = (ms >= 0 ? ms : ms - 86399999) / 86400000;
+	int64_t rem = ms - day * 86400000;
+	day += 719468;
+	int64_t  era = (day >= 0 ? day : day - 146096) / 146097;
+	unsigned doe = (unsigned)(day - era * 146097);
+	unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+	unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+	unsigned mp  = (5 * doy + 2) / 153;
+	unsigned m   = mp < 10 ? mp + 3 : mp - 9;
+	t[0]         = (uint16_t)((int64_t)yoe + era * 400 + (m <= 2));
+	t[1]         = (uint16_t)m;
+	t[2]         = (uint16_t)(doy - (153 * mp + 2) / 5 + 1);
+	t[3]         = (uint16_t)(rem / 3600000);
+	t[4]         = (uint16_t)(rem / 60000 % 60);
+	t[5]         = (uint16_t)(rem / 1000 % 60);
+	t[6]         = (uint16_t)(rem % 1000);
+}
+
+/* ---------- encoder ---------- */
+
+// Re-encode a .sblog (mapped or read whole). Empty if it is not a log file.
+inline std::string compactLogFile(const void *data, size_t size) {
+	LogFileCursor cur(data, size);
+	if (!cur.valid())
+		return {};
+	LogSegmentHeader hdr = {};
+	memcpy(hdr.magic, "SBZ1", 4);
+	hdr.version = kLogSegmentVersion;
+	memcpy(hdr.startTime, cur.header()->startTime, sizeof(hdr.startTime));
+	std::string out((const char *)&hdr, sizeof(hdr));
+
+	std::unordered_map<std::string, uint32_t> templates;
+	std::string                               tmpl, values;
+	int64_t                                   prevMs = segTimeToMs(hdr.startTime);
+	uint32_t                                  lines  = 0;
+	LogFileLine                               line;
+	while (cur.next(line)) {
+		int64_t  ms    = segTimeToMs(line.time);
+		int64_t  delta = ms - prevMs;
+		uint64_t zz    = ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63);
+		prevMs         = ms;
+		uint8_t  tag   = (uint8_t)(line.level & 3);
+		bool     raw   = memchr(line.text, kSegNumber, line.len) || memchr(line.text, kSegString, line.len);
+
+		tmpl.clear();
+		values.clear();
+		for (size_t i = 0; !raw && i < line.len;) {
+			const char *p = line.text + i;
+			size_t      n = 0;
+			if (i + 2 < line.len && p[0] == '0' && (p[1] == 'x' || p[1] == 'X') && isxdigit((unsigned char)p[2])) {
+				tmpl.append(p, 2);
+				for (n = 2; i + n < line.len && isxdigit((unsigned char)p[n]);)
+					++n;
+				tmpl += kSegString;
+				segPutVarint(values, n - 2);
+				values.append(p + 2, n - 2);
+			} else if (isdigit((unsigned char)*p)) {
+				while (i + n < line.len && isdigit((unsigned char)p[n]))
+					++n;
+				if ((n == 1 || p[0] != '0') && n <= 18) {
+					tmpl += kSegNumber;
+					segPutVarint(values, strtoull(std::string(p, n).c_str(), nullptr, 10));
+				} else {
+					tmpl += kSegString;
+					segPutVarint(values, n);
+					values.append(p, n);
+				}
+			} else {
+				tmpl += *p;
+				n = 1;
+			}
+			i += n;
+		}
+
+		if (raw) {
+			out += (char)(tag | kSegRaw);
+			segPutVarint(out, zz);
+			segPutVarint(out, line.len);
+			out.append(line.text, line.len);
+		} else {
+			auto it = templates.find(tmpl);
+			out += (char)(tag | (it == templates.end() ? kSegNewTemplate : 0));
+			segPutVarint(out, zz);
+			if (it == templates.end()) {
+				uint32_t id = (uint32_t)templates.size();
+				templates.emplace(tmpl, id);
+				segPutVarint(out, tmpl.size());
+				out += tmpl;
+			} else {
+				segPutVarint(out, it->second);
+			}
+			out += values;
+		}
+		++lines;
+	}
+	memcpy(&out[offsetof(LogSegmentHeader, lines)], &lines, sizeof(lines));
+	return out;
+}
+
+/* ---------- decoder ---------- */
+
+// A segment as text (appendLogTextHeader format). Empty if `data` is not a segment; a truncated
+// segment decodes up to its last complete line.
+inline std::string logSegmentText(const void *data, size_t size) {
+	const auto *hdr = static_cast<const LogSegmentHeader *>(data);
+	if (size < sizeof(LogSegmentHeader) || memcmp(hdr->magic, "SBZ1", 4) != 0 || hdr->version != kLogSegmentVersion)
+		return {};
+	std::string out;
+	appendLogTextHeader(out, hdr->startTime);
+
+	const uint8_t           *p   = static_cast<const uint8_t *>(data) + sizeof(LogSegmentHeader);
+	const uint8_t           *end = static_cast<const uint8_t *>(data) + size;
+	std::vector<std::string> templates;
+	std::string              text;
+	int64_t                  ms = segTimeToMs(hdr->startTime);
+	auto getBytes = [&](std::string &dst, bool append) {
+		uint64_t n;
+		if (!segGetVarint(p, end, n) || n > (uint64_t)(end - p))
+			return false;
+		if (!append)
+			dst.clear();
+		dst.append((const char *)p, (size_t)n);
+		p += n;
+		return true;
+	};
+	while (p < end) {
+		uint8_t  tag = *p++;
+		uint64_t zz;
+		if (!segGetVarint(p, end, zz))
+			break;
+		ms += (int64_t)(zz >> 1) ^ -(int64_t)(zz & 1);
+
+		if (tag & kSegRaw) {
+			if (!getBytes(text, false))
+				break;
+		} else {
+			const std::string *tmpl;
+			if (tag & kSegNewTemplate) {
+				templates.emplace_back();
+				if (!getBytes(templates.back(), false))
+					break;
+				tmpl = &templates.back();
+			} else {
+				uint64_t id;
+				if (!segGetVarint(p, end, id) || id >= templates.size())
+					break;
+				tmpl = &templates[(size_t)id];
+			}
+			text.clear();
+			bool ok = true;
+			for (char c : *tmpl) {
+				if (c == kSegNumber) {
+					uint64_t v;
+					ok = segGetVarint(p, end, v);
+					text += std::to_string(v);
+				} else if (c == kSegString) {
+					ok = getBytes(text, true);
+				} else {
+					text += c;
+				}
+				if (!ok)
+					break;
+			}
+			if (!ok)
+				break;
+		}
+		uint16_t t[7];
+		segMsToTime(ms, t);
+		appendLogTextLine(out, t, (uint8_t)(tag & 3), text.data(), text.size());
+	}
+	return out;
+}
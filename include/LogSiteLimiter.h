@@ -0,0 +1,78 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Per-call-site storm guard for the log, keyed on the format string. A site is limited only while it
+// is in a storm: kBusyLines or more lines in each of kStormWindows consecutive kWindowMs windows, the
+// shape of a display failing on every 100 ms tick. A burst that ends (hid_enumerate dumping every cap
+// after a reconnect) is not a storm, so each enumeration is logged in full, however many came
+// before. In a storm the site gets one line per kRefillMs and the rest are only counted; the count
+// is handed back with the site's next admitted line so the log can say what it left out. A quieter
+// window ends the storm. Identical consecutive lines never get here: they are collapsed first
+// (LogRing::repeat) and cost nothing.
+//
+// Open-addressed on the format pointer with a short probe; when the probe is full the stalest site
+// is forgotten (its pending count is lost). Not synchronized: used under Log's lock.
+class LogSiteLimiter {
+public:
+	static constexpr size_t   kSites        = 256; // power of two; the app has well under 100 sites
+	static constexpr size_t   kProbe        = 8;
+	static constexpr uint32_t kWindowMs     = 1000;
+	static constexpr uint32_t kBusyLines    = 5;
+	static constexpr uint32_t kStormWindows = 10;
+	static constexpr uint32_t kRefillMs     = 10000;
+
+	// True if a line from `site` may be stored now. `dropped` receives the number of lines from the
+	// site suppressed since its last admitted one (only when admitting).
+	bool admit(const void *site, uint32_t tick, uint32_t &dropped) {
+		Site    &s       = find(site, tick);
+		uint32_t windows = (tick - s.windowTick) / kWindowMs;
+		if (windows) { // a gap of more than one window had empty windows in it
+			bool busy     = windows == 1 && s.windowLines >= kBusyLines;
+			s.busyWindows = busy ? (s.busyWindows < kStormWindows ? s.busyWindows + 1 : kStormWindows) : 0;
+			s.windowTick += windows * kWindowMs;
+			s.windowLines = 0;
+		}
+		++s.windowLines;
+		s.lastTick = tick;
+		if (s.busyWindows >= kStormWindows && tick - s.admitTick < kRefillMs) {
+			++s.dropped;
+			return false;
+		}
+		s.admitTick = tick;
+		dropped     = s.dropped;
+		s.dropped   = 0;
+		return true;
+	}
+
+private:
+	struct Site {
+		const void *site;
+		uint32_t    windowTick; // the current window started here
+		uint32_t    windowLines;
+		uint32_t    busyWindows; // consecutive, up to kStormWindows
+		uint32_t    admitTick;   // the last admitted line
+		uint32_t    lastTick;
+		uint32_t    dropped; // since the last admitted line
+	};
+
+	Site &find(const void *site, uint32_t tick) {
+		size_t h     = (size_t)((((uintptr_t)site >> 1) * 0x9E3779B1u) >> 16);
+		Site  *stale = nullptr;
+		for (size_t i = 0; i < kProbe; ++i) {
+			Site &s = sites_[(h + i) & (kSites - 1)];
+			if (s.site == site)
+				return s;
+			if (!s.site) {
+				stale = &s;
+				break;
+			}
+			if (!stale || tick - s.lastTick > tick - stale->lastTick)
+				stale = &s;
+		}
+		*stale = {site, tick, 0, 0, tick, tick, 0};
+		return *stale;
+	}
+
+	Site sites_[kSites] = {};
+};
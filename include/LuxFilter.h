@@ -0,0 +1,85 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+
+// Streaming cleanup of raw ALS samples before the engine sees them. Flicker, passing shadows and
+// single bad reports otherwise cross the 20% hysteresis and start a full ramp (and a burst of HID
+// writes) each time. Three stages, O(1) per sample, no allocation:
+//   1. outlier rejection: a sample more than kOutlierLog2 stops (2^n) away from the running median
+//      is held back; a second one on the same side confirms a real change (lights switched on) and
+//      resets the window to it
+//   2. median of the last kMedianN samples, in a fixed ring
+//   3. exponential smoothing with time constant kTauMs, in log2(lux) (perceptual) space
+// Driven from the source's delivery thread only.
+class LuxFilter {
+public:
+	static constexpr int    kMedianN     = 5;
+	static constexpr double kOutlierLog2 = 2.0;    // 4x off the median
+	static constexpr double kTauMs       = 1000.0; // EMA time constant
+
+	// Feed one raw sample taken at `nowMs`; returns the filtered lux.
+	float push(double nowMs, float raw) {
+		double l = std::log2((double)(raw > 1.f ? raw : 1.f));
+
+		if (count_ > 0) {
+			double d = l - median();
+			if (std::fabs(d) > kOutlierLog2) {
+				int side = d > 0 ? 1 : -1;
+				if (pending_ != side) {
+					pending_ = side; // hold it back until the next sample agrees
+					++rejected_;
+					return value();
+				}
+				count_ = 0; // confirmed step: restart the window at the new level
+			}
+		}
+		pending_ = 0;
+
+		ring_[head_] = l;
+		head_        = (head_ + 1) % kMedianN;
+		if (count_ < kMedianN) ++count_;
+
+		double m = median();
+		if (!haveEma_) {
+			ema_     = m;
+			haveEma_ = true;
+		} else if (nowMs > lastMs_) {
+			double a = 1.0 - std::exp(-(nowMs - lastMs_) / kTauMs);
+			ema_ += a * (m - ema_);
+		}
+		lastMs_ = nowMs;
+		return value();
+	}
+
+	float    value() const { return haveEma_ ? (float)std::exp2(ema_) : 100.f; }
+	uint32_t rejected() const { return rejected_; }
+	void     reset() {
+		count_   = 0;
+		head_    = 0;
+		pending_ = 0;
+		haveEma_ = false;
+	}
+
+private:
+	// Median of the filled part of the ring (insertion sort of at most kMedianN values).
+	double median() const {
+		double v[kMedianN];
+		for (int i = 0; i < count_; ++i) {
+			double x = ring_[(head_ - 1 - i + kMedianN) % kMedianN];
+			int    j = i;
+			for (; j > 0 && v[j - 1] > x; --j)
+				v[j] = v[j - 1];
+			v[j] = x;
+		}
+		return count_ & 1 ? v[count_ / 2] : 0.5 * (v[count_ / 2 - 1] + v[count_ / 2]);
+	}
+
+	double   ring_[kMedianN] = {};
+	int      head_           = 0;
+	int      count_          = 0;
+	int      pending_        = 0; // side (+1/-1) of a held-back outlier, 0 = none
+	bool     haveEma_        = false;
+	double   ema_            = 0.0;
+	double   lastMs_         = 0.0;
+	uint32_t rejected_       = 0;
+};
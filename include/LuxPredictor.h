@@ -0,0 +1,66 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+
+// Optional lead on the filtered lux: a least-squares line through the last few filtered samples in
+// log2(lux), extrapolated kHorizonMs ahead. When someone opens the blinds the engine starts ramping
+// toward where the room is going instead of where it was one report interval (plus the filter)
+// ago; as the trend flattens the prediction falls back onto the measured value and the ramp
+// re-targets if it overshot. Only clean, steep trends are extrapolated: a weak slope or a poor fit
+// returns the input unchanged, and the lead is capped at kMaxLeadLog2 stops.
+// Driven from the source's delivery thread only, after LuxFilter.
+class LuxPredictor {
+public:
+	static constexpr int    kN           = 8;      // samples in the fit
+	static constexpr double kWindowMs    = 3000.0; // ...and no older than this
+	static constexpr double kHorizonMs   = 1500.0; // about one brighten ramp
+	static constexpr double kMinSlope    = 0.5;    // stops per second before we extrapolate at all
+	static constexpr double kMinR2       = 0.8;
+	static constexpr double kMaxLeadLog2 = 1.0;
+
+	// Feed one filtered sample; returns the predicted lux.
+	float push(double nowMs, float lux) {
+		double l  = std::log2((double)(lux > 1.f ? lux : 1.f));
+		t_[head_] = nowMs;
+		l_[head_] = l;
+		head_     = (head_ + 1) % kN;
+		if (count_ < kN) ++count_;
+
+		// Fit over the recent part of the ring, times relative to now (seconds) for conditioning.
+		double st = 0, sl = 0, stt = 0, stl = 0, sll = 0;
+		int    n  = 0;
+		for (int i = 0; i < count_; ++i) {
+			int    k = (head_ - 1 - i + kN) % kN;
+			double t = (t_[k] - nowMs) / 1000.0;
+			if (-t * 1000.0 > kWindowMs)
+				break;
+			st += t;
+			sl += l_[k];
+			stt += t * t;
+			stl += t * l_[k];
+			sll += l_[k] * l_[k];
+			++n;
+		}
+		slope_ = 0.0;
+		if (n >= 3) {
+			double vt = stt - st * st / n, vl = sll - sl * sl / n, cov = stl - st * sl / n;
+			if (vt > 1e-9 && vl > 1e-9 && cov * cov / (vt * vl) >= kMinR2)
+				slope_ = cov / vt;
+		}
+		if (std::fabs(slope_) < kMinSlope)
+			return lux;
+		double lead = slope_ * kHorizonMs / 1000.0;
+		if (lead > kMaxLeadLog2) lead = kMaxLeadLog2;
+		if (lead < -kMaxLeadLog2) lead = -kMaxLeadLog2;
+		return (float)std::exp2(l + lead);
+	}
+
+	double slope() const { return slope_; } // stops per second, 0 when no trend
+
+private:
+	double t_[kN]  = {};
+	double l_[kN]  = {};
+	int    head_   = 0;
+	int    count_  = 0;
+	double slope_  = 0.0;
+};
@@ -0,0 +1,60 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+#include "AlsSampling.h"
+#include "LuxFilter.h"
+#include "LuxPredictor.h"
+
+// An ambient light reading a display can be bound to. Implemented by the Sensor API listener
+// (AlsSensorListener in main.cpp); each DisplayDevice holds a resolved pointer to one, so reading
+// lux on the hot path is an atomic load plus two relaxed loads, with no lock and no search.
+//
+// Lifetime: a source stays valid for as long as any DisplayDevice points at it. Bindings are only
+// changed, and sources only released, with g_displayMutex held, which is also what every reader
+// holds while it dereferences the binding.
+class LuxSource {
+public:
+	virtual ~LuxSource() = default;
+	virtual bool alive() const = 0; // delivered at least one sample and has not left
+
+	// Filtered lux (LuxFilter.h), and the same extrapolated along its current trend (LuxPredictor.h).
+	float lux() const { return lux_.load(std::memory_order_relaxed); }
+	float predictedLux() const { return predicted_.load(std::memory_order_relaxed); }
+
+	// Running count of delivered samples, and a request to change the sampling rate.
+	virtual uint32_t samples() const = 0;
+	virtual void     setReportInterval(uint32_t ms) = 0;
+
+	AlsSamplingPolicy sampling; // driven by the worker only
+
+protected:
+	// Called by the source's delivery thread with each raw sample.
+	void deliver(double nowMs, float raw) {
+		float f = filter_.push(nowMs, raw);
+		lux_.store(f, std::memory_order_relaxed);
+		predicted_.store(predictor_.push(nowMs, f), std::memory_order_relaxed);
+	}
+
+private:
+	LuxFilter          filter_;
+	LuxPredictor       predictor_;
+	std::atomic<float> lux_{100.f};
+	std::atomic<float> predicted_{100.f};
+};
+
+// Lux for a display: its bound source if that one is live, otherwise `master`, otherwise the last
+// value either delivered (`lastKnown`, so an ALS re-init does not snap to a hard default). A couple
+// of atomic loads; `predicted` returns the trend-extrapolated value instead, with the same fallback.
+inline float resolveAmbientLux(const std::atomic<LuxSource *> &bound, const std::atomic<LuxSource *> &master,
+                               std::atomic<float> &lastKnown, bool predicted) {
+	const LuxSource *src = bound.load(std::memory_order_acquire);
+	if (!src || !src->alive())
+		src = master.load(std::memory_order_acquire);
+	if (src && src->alive()) {
+		float lx = src->lux();
+		lastKnown.store(lx, std::memory_order_relaxed);
+		return predicted ? src->predictedLux() : lx;
+	}
+	return lastKnown.load(std::memory_order_relaxed);
+}
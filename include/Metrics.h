@@ -0,0 +1,267 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+// Process-wide runtime counters, for scraping over the metrics endpoint (MetricsEndpoint.h).
+// Metrics are namespace-scope statics in the module that updates them:
+//
+//   static MetricCounter g_hidWrites("sbpp_hid_writes_total", "HID feature writes");
+//   g_hidWrites.add();
+//
+// Updating one is a relaxed atomic add (no lock, no allocation). Each metric links itself into a
+// global list when it is constructed and stays for the life of the process; a snapshot walks the
+// list and reads every value with relaxed loads, so it is consistent per value but not across them.
+// Several metrics can share a name when they carry different labels (`mutex="display"`), to break
+// one quantity down by where it comes from.
+//
+// Snapshot formats: Prometheus text exposition (metricsText) and a flat JSON object (metricsJson).
+
+enum class MetricKind { Counter, Gauge, Histogram };
+
+class Metric {
+public:
+	const char *name() const { return name_; }
+	const char *help() const { return help_; }
+	const char *labels() const { return labels_; } // Prometheus label pairs without braces, or nullptr
+	MetricKind  kind() const { return kind_; }
+	Metric     *next() const { return next_; }
+
+	Metric(const Metric &)            = delete;
+	Metric &operator=(const Metric &) = delete;
+
+	// The first registered metric; follow next().
+	static Metric *first() { return head().load(std::memory_order_acquire); }
+
+protected:
+	Metric(const char *name, const char *help, MetricKind kind, const char *labels)
+	    : name_(name), help_(help), labels_(labels), kind_(kind) {
+		next_ = head().load(std::memory_order_relaxed);
+		while (!head().compare_exchange_weak(next_, this, std::memory_order_release, std::memory_order_relaxed)) {
+		}
+	}
+
+private:
+	static std::atomic<Metric *> &head() {
+		static std::atomic<Metric *> h{nullptr}; // constant-initialized: safe from other statics' constructors
+		return h;
+	}
+
+	const char *name_;
+	const char *help_;
+	const char *labels_;
+	MetricKind  kind_;
+	Metric     *next_;
+};
+
+// Monotonic count of events.
+class MetricCounter : public Metric {
+public:
+	MetricCounter(const char *name, const char *help, const char *labels = nullptr)
+	    : Metric(name, help, MetricKind::Counter, labels) {}
+	void     add(uint64_t n = 1) { value_.fetch_add(n, std::memory_order_relaxed); }
+	uint64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+	std::atomic<uint64_t> value_{0};
+};
+
+// A level that goes up and down (connected displays, bound sensors).
+class MetricGauge : public Metric {
+public:
+	MetricGauge(const char *name, const char *help, const char *labels = nullptr)
+	    : Metric(name, help, MetricKind::Gauge, labels) {}
+	void    set(int64_t v) { value_.store(v, std::memory_order_relaxed); }
+	void    add(int64_t n) { value_.fetch_add(n, std::memory_order_relaxed); }
+	void    setMax(int64_t v) { // a high-water mark
+		int64_t cur = value_.load(std::memory_order_relaxed);
+		while (v > cur && !value_.compare_exchange_weak(cur, v, std::memory_order_relaxed)) {
+		}
+	}
+	int64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+	std::atomic<int64_t> value_{0};
+};
+
+// Distribution of integer observations (microseconds, usually) over fixed upper bounds. `bounds`
+// must be ascending, static, and at most kMaxBuckets long; larger values land in the +Inf bucket.
+class MetricHistogram : public Metric {
+public:
+	static constexpr size_t kMaxBuckets = 16;
+
+	template <size_t N>
+	MetricHistogram(const char *name, const char *help, const uint64_t (&bounds)[N], const char *labels = nullptr)
+	    : Metric(name, help, MetricKind::Histogram, labels), bounds_(bounds), buckets_(N) {
+		static_assert(N <= kMaxBuckets, "too many histogram buckets");
+	}
+
+	void observe(uint64_t v) {
+		size_t i = 0;
+		while (i < buckets_ && v > bounds_[i])
+			++i;
+		counts_[i].fetch_add(1, std::memory_order_relaxed);
+		sum_.fetch_add(v, std::memory_order_relaxed);
+	}
+
+	size_t   buckets() const { return buckets_; }                 // finite buckets; the +Inf one is extra
+	uint64_t bound(size_t i) const { return bounds_[i]; }
+	uint64_t countIn(size_t i) const { return counts_[i].load(std::memory_order_relaxed); } // i <= buckets()
+	uint64_t sum() const { return sum_.load(std::memory_order_relaxed); }
+
+private:
+	const uint64_t       *bounds_;
+	size_t                buckets_;
+	std::atomic<uint64_t> counts_[kMaxBuckets + 1] = {};
+	std::atomic<uint64_t> sum_{0};
+};
+
+// Observes the microseconds from construction to the end of the scope.
+class MetricTimer {
+public:
+	explicit MetricTimer(MetricHistogram &h) : h_(h), t0_(std::chrono::steady_clock::now()) {}
+	~MetricTimer() {
+		auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - t0_);
+		h_.observe((uint64_t)us.count());
+	}
+	MetricTimer(const MetricTimer &)            = delete;
+	MetricTimer &operator=(const MetricTimer &) = delete;
+
+private:
+	MetricHistogram                      &h_;
+	std::chrono::steady_clock::time_point t0_;
+};
+
+/* ---------- snapshots ---------- */
+
+// `name{labels}`, `name{labels,extra}`, or the bare name, into `out`.
+inline void metricSeries(std::string &out, const char *name, const char *suffix, const char *labels,
+                         const char *extra = nullptr) {
+	out += name;
+	out += suffix;
+	bool any = labels && *labels;
+	if (!any && !extra)
+		return;
+	out += '{';
+	if (any)
+		out += labels;
+	if (extra) {
+		if (any)
+			out += ',';
+		out += extra;
+	}
+	out += '}';
+}
+
+// One metric's sample lines in the Prometheus text format.
+inline void metricSamples(std::string &out, const Metric *m) {
+	char buf[64];
+	switch (m->kind()) {
+	case MetricKind::Counter:
+		metricSeries(out, m->name(), "", m->labels());
+		snprintf(buf, sizeof(buf), " %llu\n", (unsigned long long)static_cast<const MetricCounter *>(m)->value());
+		out += buf;
+		break;
+	case MetricKind::Gauge:
+		metricSeries(out, m->name(), "", m->labels());
+		snprintf(buf, sizeof(buf), " %lld\n", (long long)static_cast<const MetricGauge *>(m)->value());
+		out += buf;
+		break;
+	case MetricKind::Histogram: {
+		const auto        *h     = static_cast<const MetricHistogram *>(m);
+		unsigned long long total = 0;
+		for (size_t i = 0; i <= h->buckets(); ++i) {
+			total += h->countIn(i);
+			if (i < h->buckets())
+				snprintf(buf, sizeof(buf), "le=\"%llu\"", (unsigned long long)h->bound(i));
+			else
+				snprintf(buf, sizeof(buf), "le=\"+Inf\"");
+			metricSeries(out, m->name(), "_bucket", m->labels(), buf);
+			snprintf(buf, sizeof(buf), " %llu\n", total);
+			out += buf;
+		}
+		metricSeries(out, m->name(), "_sum", m->labels());
+		snprintf(buf, sizeof(buf), " %llu\n", (unsigned long long)h->sum());
+		out += buf;
+		metricSeries(out, m->name(), "_count", m->labels());
+		snprintf(buf, sizeof(buf), " %llu\n", total);
+		out += buf;
+		break;
+	}
+	}
+}
+
+// Prometheus text exposition format (version 0.0.4). Metrics sharing a name are one family: HELP
+// and TYPE once, then every labelled series of it together.
+inline std::string metricsText() {
+	std::string out;
+	char        buf[160];
+	for (const Metric *m = Metric::first(); m; m = m->next()) {
+		static const char *const kTypes[] = {"counter", "gauge", "histogram"};
+		bool                     seen     = false;
+		for (const Metric *p = Metric::first(); p != m && !seen; p = p->next())
+			seen = strcmp(p->name(), m->name()) == 0;
+		if (seen)
+			continue; // printed with the family
+		snprintf(buf, sizeof(buf), "# HELP %s %s\n# TYPE %s %s\n", m->name(), m->help(), m->name(),
+		         kTypes[(int)m->kind()]);
+		out += buf;
+		for (const Metric *q = m; q; q = q->next())
+			if (q == m || strcmp(q->name(), m->name()) == 0)
+				metricSamples(out, q);
+	}
+	return out;
+}
+
+// {"name": value, ..., "hist": {"le": [..], "counts": [.., +Inf], "sum": n, "count": n}}. A labelled
+// metric's key is its Prometheus series name, `name{mutex=\"display\"}`.
+inline std::string metricsJson() {
+	std::string out = "{";
+	char        buf[160];
+	for (const Metric *m = Metric::first(); m; m = m->next()) {
+		if (out.size() > 1)
+			out += ",";
+		std::string key;
+		metricSeries(key, m->name(), "", m->labels());
+		out += "\n  \"";
+		for (char c : key) {
+			if (c == '"' || c == '\\')
+				out += '\\';
+			out += c;
+		}
+		out += "\": ";
+		switch (m->kind()) {
+		case MetricKind::Counter:
+			snprintf(buf, sizeof(buf), "%llu", (unsigned long long)static_cast<const MetricCounter *>(m)->value());
+			out += buf;
+			break;
+		case MetricKind::Gauge:
+			snprintf(buf, sizeof(buf), "%lld", (long long)static_cast<const MetricGauge *>(m)->value());
+			out += buf;
+			break;
+		case MetricKind::Histogram: {
+			const auto        *h = static_cast<const MetricHistogram *>(m);
+			std::string        le, counts;
+			unsigned long long total = 0;
+			for (size_t i = 0; i <= h->buckets(); ++i) {
+				if (i < h->buckets()) {
+					snprintf(buf, sizeof(buf), "%s%llu", i ? "," : "", (unsigned long long)h->bound(i));
+					le += buf;
+				}
+				snprintf(buf, sizeof(buf), "%s%llu", i ? "," : "", (unsigned long long)h->countIn(i));
+				counts += buf;
+				total += h->countIn(i);
+			}
+			snprintf(buf, sizeof(buf), "], \"sum\": %llu, \"count\": %llu}", (unsigned long long)h->sum(), total);
+			out += "{\"le\": [" + le + "], \"counts\": [" + counts + buf;
+			break;
+		}
+		}
+	}
+	out += "\n}\n";
+	return out;
+}
@@ -0,0 +1,261 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "Metrics.h"
+
+// Local, read-only query endpoint for the metrics registry: a named pipe (\\.\pipe\<name>) on
+// Windows, a Unix socket (/tmp/<name>.sock) elsewhere. Remote clients are rejected. A client
+// connects, writes one request line, "text" (Prometheus format, also the default) or "json", and
+// reads the snapshot until the server closes the connection:
+//
+//   metrics-query.exe [text|json]
+//
+// One thread serves clients one after another; a snapshot takes microseconds. A client gets
+// kClientTimeoutMs to send its request and take the reply, so one that connects and goes quiet
+// only delays the next. All waits also end on stop(), which therefore returns at once (it runs
+// in WM_DESTROY) whatever the clients do.
+class MetricsEndpoint {
+public:
+	static constexpr const char *kDefaultName     = "StudioBrightnessPlusPlus.metrics";
+	static constexpr int         kClientTimeoutMs = 1000;
+
+	~MetricsEndpoint() { stop(); }
+
+	bool start(const char *name = kDefaultName) {
+		if (thread_.joinable())
+			return true;
+		path_ = endpointPath(name);
+#ifdef _WIN32
+		wake_ = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+		if (!wake_)
+			return false;
+#else
+		listen_ = socket(AF_UNIX, SOCK_STREAM, 0);
+		sockaddr_un addr = unixAddress(path_);
+		unlink(path_.c_str()); // a stale socket from a crash
+		if (listen_ < 0 || bind(listen_, (const sockaddr *)&addr, sizeof(addr)) != 0 || listen(listen_, 4) != 0 ||
+		    pipe(wake_) != 0) {
+			if (listen_ >= 0)
+				close(listen_);
+			listen_ = -1;
+			unlink(path_.c_str());
+			return false;
+		}
+#endif
+		stop_.store(false);
+		thread_ = std::thread([this] { serve(); });
+		return true;
+	}
+
+	void stop() {
+		if (!thread_.joinable())
+			return;
+		stop_.store(true);
+#ifdef _WIN32
+		SetEvent(wake_); // ends any wait of the server thread: for a client, a request or a write
+		thread_.join();
+		CloseHandle(wake_);
+		wake_ = nullptr;
+#else
+		char c = 0;
+		while (write(wake_[1], &c, 1) < 0 && errno == EINTR) {
+		}
+		thread_.join();
+		close(listen_);
+		close(wake_[0]);
+		close(wake_[1]);
+		listen_ = wake_[0] = wake_[1] = -1;
+		unlink(path_.c_str());
+#endif
+	}
+
+	// Full pipe or socket path for `name`.
+	static std::string endpointPath(const char *name) {
+#ifdef _WIN32
+		return std::string("\\\\.\\pipe\\") + name;
+#else
+		return std::string("/tmp/") + name + ".sock";
+#endif
+	}
+
+	// Client side: send `request` and read the reply into `out`. False if nothing is listening.
+	static bool metricsQuery(const std::string &path, const char *request, std::string &out) {
+		out.clear();
+		std::string line = std::string(request) + "\n";
+		char        buf[4096];
+#ifdef _WIN32
+		// Busy while the server is with another client, for kClientTimeoutMs at most.
+		HANDLE h = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, 0, nullptr);
+		if (h == INVALID_HANDLE_VALUE && GetLastError() == ERROR_PIPE_BUSY &&
+		    WaitNamedPipeA(path.c_str(), 2 * kClientTimeoutMs))
+			h = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, 0, nullptr);
+		if (h == INVALID_HANDLE_VALUE)
+			return false;
+		DWORD n = 0;
+		WriteFile(h, line.data(), (DWORD)line.size(), &n, nullptr);
+		while (ReadFile(h, buf, sizeof(buf), &n, nullptr) && n)
+			out.append(buf, n);
+		CloseHandle(h);
+#else
+		int         fd   = socket(AF_UNIX, SOCK_STREAM, 0);
+		sockaddr_un addr = unixAddress(path);
+		if (fd < 0 || connect(fd, (const sockaddr *)&addr, sizeof(addr)) != 0) {
+			if (fd >= 0)
+				close(fd);
+			return false;
+		}
+		if (write(fd, line.data(), line.size()) < 0) {
+			close(fd);
+			return false;
+		}
+		ssize_t n;
+		while ((n = read(fd, buf, sizeof(buf))) > 0)
+			out.append(buf, (size_t)n);
+		close(fd);
+#endif
+		return true;
+	}
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	// Milliseconds left until `deadline`, at least 0.
+	static int msLeft(Clock::time_point deadline) {
+		auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count();
+		return ms > 0 ? (int)ms : 0;
+	}
+
+	// The reply to one request line.
+	static std::string reply(const std::string &request) {
+		return request.compare(0, 4, "json") == 0 ? metricsJson() : metricsText();
+	}
+
+	// Read up to the end of the request line (short; anything after it is ignored).
+	template <class ReadFn>
+	static std::string readRequest(ReadFn &&readSome) {
+		std::string req;
+		char        c[64];
+		int         n;
+		while (req.size() < 64 && req.find('\n') == std::string::npos && (n = readSome(c, sizeof(c))) > 0)
+			req.append(c, (size_t)n);
+		return req;
+	}
+
+#ifdef _WIN32
+	// Finish overlapped I/O on `pipe` that `ok`/GetLastError say was started: wait for it, stop() or
+	// `timeoutMs`, and cancel it if it is still running. True if it completed.
+	bool finish(HANDLE pipe, OVERLAPPED &ov, BOOL ok, DWORD timeoutMs, DWORD &n) {
+		if (!ok && GetLastError() != ERROR_IO_PENDING)
+			return false;
+		HANDLE events[2] = {ov.hEvent, wake_};
+		if (WaitForMultipleObjects(2, events, FALSE, timeoutMs) != WAIT_OBJECT_0)
+			CancelIo(pipe);
+		return GetOverlappedResult(pipe, &ov, &n, TRUE) != FALSE;
+	}
+
+	void serve() {
+		OVERLAPPED ov = {};
+		ov.hEvent     = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+		if (!ov.hEvent)
+			return;
+		while (!stop_.load()) {
+			// More than one instance: a served client's instance stays open until it has read the reply.
+			HANDLE pipe = CreateNamedPipeA(path_.c_str(), PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED,
+			                               PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+			                               PIPE_UNLIMITED_INSTANCES, 64 * 1024, 256, 0, nullptr);
+			if (pipe == INVALID_HANDLE_VALUE)
+				break;
+			DWORD n  = 0;
+			BOOL  ok = ConnectNamedPipe(pipe, &ov);
+			if ((!ok && GetLastError() == ERROR_PIPE_CONNECTED) || finish(pipe, ov, ok, INFINITE, n)) {
+				Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(kClientTimeoutMs);
+				std::string       req      = readRequest([&](char *b, int cap) {
+					DWORD got     = 0;
+					BOOL  started = ReadFile(pipe, b, (DWORD)cap, nullptr, &ov);
+					return finish(pipe, ov, started, msLeft(deadline), got) ? (int)got : -1;
+				});
+				if (!stop_.load() && msLeft(deadline) > 0) { // not for a client that never asked
+					std::string out = reply(req);
+					ok              = WriteFile(pipe, out.data(), (DWORD)out.size(), nullptr, &ov);
+					finish(pipe, ov, ok, msLeft(deadline), n);
+				}
+			}
+			// No DisconnectNamedPipe (it drops what the client has not read yet) and no FlushFileBuffers
+			// (it waits for the client without a timeout): closing our end keeps the written reply
+			// readable, and the client then sees the end of it.
+			CloseHandle(pipe);
+		}
+		CloseHandle(ov.hEvent);
+	}
+#else
+	// Wait until `fd` is ready for `events`, stop() is called, or `timeoutMs` (-1: no limit) passes.
+	bool waitFor(int fd, short events, int timeoutMs) {
+		pollfd p[2] = {{fd, events, 0}, {wake_[0], POLLIN, 0}};
+		int    r;
+		while ((r = poll(p, 2, timeoutMs)) < 0 && errno == EINTR) {
+		}
+		return r > 0 && !p[1].revents && p[0].revents;
+	}
+
+	void serve() {
+		while (!stop_.load()) {
+			if (!waitFor(listen_, POLLIN, -1))
+				continue;
+			int fd = accept(listen_, nullptr, nullptr);
+			if (fd < 0)
+				continue;
+			fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK); // only ever read or written when ready
+			Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(kClientTimeoutMs);
+			std::string       req      = readRequest([&](char *b, int cap) {
+				return waitFor(fd, POLLIN, msLeft(deadline)) ? (int)read(fd, b, (size_t)cap) : -1;
+			});
+			if (!stop_.load() && msLeft(deadline) > 0) { // not for a client that never asked
+				std::string out = reply(req);
+				for (size_t at = 0; at < out.size();) {
+					if (!waitFor(fd, POLLOUT, msLeft(deadline)))
+						break;
+					ssize_t n = write(fd, out.data() + at, out.size() - at);
+					if (n <= 0)
+						break;
+					at += (size_t)n;
+				}
+			}
+			close(fd);
+		}
+	}
+
+	static sockaddr_un unixAddress(const std::string &path) {
+		sockaddr_un addr = {};
+		addr.sun_family  = AF_UNIX;
+		strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+		return addr;
+	}
+#endif
+
+#ifdef _WIN32
+	HANDLE wake_ = nullptr; // set by stop(): ends every wait of the server thread
+#else
+	int listen_  = -1;
+	int wake_[2] = {-1, -1}; // written by stop(): ends every wait of the server thread
+#endif
+	std::string       path_;
+	std::thread       thread_;
+	std::atomic<bool> stop_{false};
+};
@@ -0,0 +1,215 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <type_traits>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+#include "Metrics.h"
+
+// Lock contention profiling. Mutexes that several threads take are named, and locked through
+// PROFILED_LOCK instead of std::lock_guard:
+//
+//   static ProfiledMutex g_displayMutex{"display"};
+//   ...
+//   PROFILED_LOCK(g_displayMutex);
+//
+// Every PROFILED_LOCK line is a call site with its own metrics, labelled by mutex, file:line and
+// function: the wait to acquire (sbpp_lock_wait_us), the time held (sbpp_lock_hold_us) and the
+// longest wait seen (sbpp_lock_wait_max_us). A stall shows up as the site with the long waits, and
+// the sites with the long holds on the same mutex are what it waited for. `metrics-query locks`
+// lists them.
+//
+// Building with SBPP_LOCK_PROFILING=0 makes ProfiledMutex a plain std::mutex, SrwLock a plain
+// SRWLOCK and PROFILED_LOCK a plain scoped lock: no clock reads, no metrics.
+
+#ifndef SBPP_LOCK_PROFILING
+#define SBPP_LOCK_PROFILING 1
+#endif
+
+#define LOCK_CONCAT2(a, b) a##b
+#define LOCK_CONCAT(a, b)  LOCK_CONCAT2(a, b)
+
+#if SBPP_LOCK_PROFILING
+
+class ProfiledMutex : public std::mutex {
+public:
+	explicit ProfiledMutex(const char *name) : name_(name) {}
+	const char *name() const { return name_; }
+
+private:
+	const char *name_;
+};
+
+#ifdef _WIN32
+// SRWLOCK with the std lockable interface (lock_shared for readers).
+class SrwLock {
+public:
+	explicit SrwLock(const char *name) : name_(name) {}
+	const char *name() const { return name_; }
+	void        lock() { AcquireSRWLockExclusive(&lock_); }
+	bool        try_lock() { return TryAcquireSRWLockExclusive(&lock_) != 0; }
+	void        unlock() { ReleaseSRWLockExclusive(&lock_); }
+	void        lock_shared() { AcquireSRWLockShared(&lock_); }
+	bool        try_lock_shared() { return TryAcquireSRWLockShared(&lock_) != 0; }
+	void        unlock_shared() { ReleaseSRWLockShared(&lock_); }
+
+private:
+	SRWLOCK     lock_ = SRWLOCK_INIT;
+	const char *name_;
+};
+#endif
+
+// The metrics of one PROFILED_LOCK line (of every instantiation of it, in a template). Looked up
+// once per line and never destroyed: the log locks during static destruction.
+class LockSite {
+public:
+	static constexpr uint64_t kBoundsUs[] = {1, 4, 16, 64, 250, 1000, 4000, 16000, 64000, 250000, 1000000};
+
+	static LockSite &at(const char *mutex, const char *file, int line, const char *func) {
+		static std::mutex *lock = new std::mutex();
+		static LockSite   *head = nullptr;
+		std::string        labels = makeLabels(mutex, file, line, func);
+		std::lock_guard<std::mutex> guard(*lock);
+		for (LockSite *s = head; s; s = s->next_)
+			if (s->labels_ == labels)
+				return *s;
+		head = new LockSite(std::move(labels), head);
+		return *head;
+	}
+
+	void acquired(uint64_t waitUs) {
+		wait_.observe(waitUs);
+		maxWait_.setMax((int64_t)waitUs);
+	}
+	void released(uint64_t holdUs) { hold_.observe(holdUs); }
+
+private:
+	LockSite(std::string labels, LockSite *next)
+	    : labels_(std::move(labels)), next_(next),
+	      wait_("sbpp_lock_wait_us", "Time to acquire a lock, per call site", kBoundsUs, labels_.c_str()),
+	      hold_("sbpp_lock_hold_us", "Time a lock was held, per call site", kBoundsUs, labels_.c_str()),
+	      maxWait_("sbpp_lock_wait_max_us", "Longest wait to acquire a lock, per call site", labels_.c_str()) {}
+
+	static std::string makeLabels(const char *mutex, const char *file, int line, const char *func) {
+		const char *base = file;
+		for (const char *p = file; *p; ++p)
+			if (*p == '/' || *p == '\\')
+				base = p + 1;
+		char buf[256];
+		snprintf(buf, sizeof(buf), "mutex=\"%s\",site=\"%s:%d\",fn=\"%s\"", mutex, base, line, func);
+		return buf;
+	}
+
+	std::string     labels_; // first: the metrics below keep a pointer to it
+	LockSite       *next_;
+	MetricHistogram wait_;
+	MetricHistogram hold_;
+	MetricGauge     maxWait_;
+};
+
+// Scoped lock (shared when `Shared`) that reports its wait and hold times to a LockSite.
+template <class M, bool Shared = false>
+class ProfiledGuard {
+public:
+	ProfiledGuard(M &m, LockSite &site) : m_(m), site_(site) {
+		// Uncontended, there is no wait to time: one clock read instead of two
+		if (Shared ? tryLockShared() : m_.try_lock()) {
+			t1_ = std::chrono::steady_clock::now();
+			site_.acquired(0);
+			return;
+		}
+		auto t0 = std::chrono::steady_clock::now();
+		if constexpr (Shared)
+			m_.lock_shared();
+		else
+			m_.lock();
+		t1_ = std::chrono::steady_clock::now();
+		site_.acquired(micros(t1_ - t0));
+	}
+	~ProfiledGuard() {
+		if constexpr (Shared)
+			m_.unlock_shared();
+		else
+			m_.unlock();
+		site_.released(micros(std::chrono::steady_clock::now() - t1_));
+	}
+	ProfiledGuard(const ProfiledGuard &)            = delete;
+	ProfiledGuard &operator=(const ProfiledGuard &) = delete;
+
+private:
+	bool tryLockShared() {
+		if constexpr (Shared)
+			return m_.try_lock_shared();
+		return false;
+	}
+	static uint64_t micros(std::chrono::steady_clock::duration d) {
+		return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+	}
+
+	M                                    &m_;
+	LockSite                             &site_;
+	std::chrono::steady_clock::time_point t1_;
+};
+
+#define PROFILED_LOCK_AT(m, shared, n)                                                                              \
+	static LockSite &LOCK_CONCAT(lockSite_, n) = LockSite::at((m).name(), __FILE__, __LINE__, __func__);           \
+	ProfiledGuard<std::remove_reference_t<decltype(m)>, shared> LOCK_CONCAT(lockGuard_, n)(m, LOCK_CONCAT(lockSite_, n))
+
+#else // !SBPP_LOCK_PROFILING
+
+class ProfiledMutex : public std::mutex {
+public:
+	explicit ProfiledMutex(const char *) {}
+};
+
+#ifdef _WIN32
+class SrwLock {
+public:
+	explicit SrwLock(const char *) {}
+	void lock() { AcquireSRWLockExclusive(&lock_); }
+	void unlock() { ReleaseSRWLockExclusive(&lock_); }
+	void lock_shared() { AcquireSRWLockShared(&lock_); }
+	void unlock_shared() { ReleaseSRWLockShared(&lock_); }
+
+private:
+	SRWLOCK lock_ = SRWLOCK_INIT;
+};
+#endif
+
+template <class M, bool Shared = false>
+class ProfiledGuard {
+public:
+	explicit ProfiledGuard(M &m) : m_(m) {
+		if constexpr (Shared)
+			m_.lock_shared();
+		else
+			m_.lock();
+	}
+	~ProfiledGuard() {
+		if constexpr (Shared)
+			m_.unlock_shared();
+		else
+			m_.unlock();
+	}
+	ProfiledGuard(const ProfiledGuard &)            = delete;
+	ProfiledGuard &operator=(const ProfiledGuard &) = delete;
+
+private:
+	M &m_;
+};
+
+#define PROFILED_LOCK_AT(m, shared, n)                                                                              \
+	ProfiledGuard<std::remove_reference_t<decltype(m)>, shared> LOCK_CONCAT(lockGuard_, n)(m)
+
+#endif // SBPP_LOCK_PROFILING
+
+#define PROFILED_LOCK(m)        PROFILED_LOCK_AT(m, false, __COUNTER__)
+#define PROFILED_LOCK_SHARED(m) PROFILED_LOCK_AT(m, true, __COUNTER__)
@@ -0,0 +1,213 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// The app's settings as immutable, versioned snapshots. A change copies the current snapshot,
+// edits the copy and publishes it with one atomic pointer store, so a reader (the worker, a
+// hotkey, the UI) takes one acquire load and sees every field of one version: no lock, no field
+// half-written. Persistence runs on its own thread and writes only the keys that changed,
+// coalescing changes that arrive while it is busy.
+//
+// Snapshots are never freed while the store lives, so a reader may keep one as long as it likes.
+// Changes come from the user (~100 bytes each), which keeps that small.
+//
+//   const SettingsValues &s = g_settings.snapshot();   // one version for the whole handler
+//   if (s.linkedMode) ...
+//   g_settings.Update([](SettingsValues &v) { v.linkedMode = !v.linkedMode; });
+
+struct HotkeySpec {
+	uint32_t mods;
+	uint32_t vk;
+};
+
+struct SettingsValues {
+	uint64_t version = 0; // 1 for the loaded settings, +1 per published change
+
+	// Core Brightness Logic
+	bool     autoAdjustEnabled = true;
+	uint32_t brightnessSteps   = 10;
+	// Ramp toward where the ambient light is heading, not where it was (LuxPredictor.h)
+	bool predictiveAls = false;
+
+	// User Interface
+	bool showOSD      = true;
+	bool runAtStartup = false;
+
+	// Multi-display
+	bool     linkedMode         = true;
+	uint32_t activeDisplayIndex = 0;
+
+	// Input / Hotkeys
+	bool       enableCustomHotkeys = false;
+	HotkeySpec hkUp{0, 0};
+	HotkeySpec hkDown{0, 0};
+
+	// Updates: 0 = stable only, 1 = include beta (pre-release) versions
+	int updateChannel = 0;
+
+	// Diagnostics: record the ALS/brightness timeline (Timeline.h) across restarts
+	bool recordTimeline = false;
+	// Diagnostics: flush the file log to disk on warnings so it survives a PC reset (Log::SetDurable)
+	bool logSurviveReset = false;
+};
+
+// One persisted key: its registry value name, default, and how it maps onto SettingsValues.
+struct SettingKey {
+	const wchar_t *name;
+	uint32_t       defValue;
+	uint32_t (*get)(const SettingsValues &);
+	void (*set)(SettingsValues &, uint32_t);
+};
+
+inline const SettingKey kSettingKeys[] = {
+    {L"AutoBrightnessEnabled", 1, [](const SettingsValues &s) -> uint32_t { return s.autoAdjustEnabled; },
+     [](SettingsValues &s, uint32_t v) { s.autoAdjustEnabled = v != 0; }},
+    {L"ShowOSD", 1, [](const SettingsValues &s) -> uint32_t { return s.showOSD; },
+     [](SettingsValues &s, uint32_t v) { s.showOSD = v != 0; }},
+    {L"CustomHotkeysEnabled", 0, [](const SettingsValues &s) -> uint32_t { return s.enableCustomHotkeys; },
+     [](SettingsValues &s, uint32_t v) { s.enableCustomHotkeys = v != 0; }},
+    {L"RunAtStartup", 0, [](const SettingsValues &s) -> uint32_t { return s.runAtStartup; },
+     [](SettingsValues &s, uint32_t v) { s.runAtStartup = v != 0; }},
+    {L"HotkeyUpMods", 0, [](const SettingsValues &s) { return s.hkUp.mods; },
+     [](SettingsValues &s, uint32_t v) { s.hkUp.mods = v; }},
+    {L"HotkeyUpVK", 0, [](const SettingsValues &s) { return s.hkUp.vk; },
+     [](SettingsValues &s, uint32_t v) { s.hkUp.vk = v; }},
+    {L"HotkeyDownMods", 0, [](const SettingsValues &s) { return s.hkDown.mods; },
+     [](SettingsValues &s, uint32_t v) { s.hkDown.mods = v; }},
+    {L"HotkeyDownVK", 0, [](const SettingsValues &s) { return s.hkDown.vk; },
+     [](SettingsValues &s, uint32_t v) { s.hkDown.vk = v; }},
+    {L"BrightnessSteps", 10, [](const SettingsValues &s) { return s.brightnessSteps; },
+     [](SettingsValues &s, uint32_t v) { s.brightnessSteps = v; }},
+    {L"LinkedMode", 1, [](const SettingsValues &s) -> uint32_t { return s.linkedMode; },
+     [](SettingsValues &s, uint32_t v) { s.linkedMode = v != 0; }},
+    {L"ActiveDisplayIndex", 0, [](const SettingsValues &s) { return s.activeDisplayIndex; },
+     [](SettingsValues &s, uint32_t v) { s.activeDisplayIndex = v; }},
+    {L"UpdateChannel", 0, [](const SettingsValues &s) { return (uint32_t)s.updateChannel; },
+     [](SettingsValues &s, uint32_t v) { s.updateChannel = (int)v; }},
+    {L"RecordTimeline", 0, [](const SettingsValues &s) -> uint32_t { return s.recordTimeline; },
+     [](SettingsValues &s, uint32_t v) { s.recordTimeline = v != 0; }},
+    {L"LogSurviveReset", 0, [](const SettingsValues &s) -> uint32_t { return s.logSurviveReset; },
+     [](SettingsValues &s, uint32_t v) { s.logSurviveReset = v != 0; }},
+    {L"PredictiveAutoBrightness", 0, [](const SettingsValues &s) -> uint32_t { return s.predictiveAls; },
+     [](SettingsValues &s, uint32_t v) { s.predictiveAls = v != 0; }},
+};
+constexpr size_t kSettingKeyCount = sizeof(kSettingKeys) / sizeof(kSettingKeys[0]);
+static_assert(kSettingKeyCount <= 32, "the changed-key mask is 32 bits");
+
+// Bit i set: kSettingKeys[i] differs between the two.
+inline uint32_t changedSettingKeys(const SettingsValues &a, const SettingsValues &b) {
+	uint32_t mask = 0;
+	for (size_t i = 0; i < kSettingKeyCount; ++i)
+		if (kSettingKeys[i].get(a) != kSettingKeys[i].get(b))
+			mask |= 1u << i;
+	return mask;
+}
+
+class SettingsStore {
+public:
+	// Writes the keys in `mask` (bits of kSettingKeys) from `values`; on the persistence thread.
+	using Persist = std::function<void(uint32_t mask, const SettingsValues &values)>;
+
+	explicit SettingsStore(Persist persist) : persist_(std::move(persist)) {
+		all_.push_back(std::make_unique<SettingsValues>());
+		current_.store(all_.back().get(), std::memory_order_release);
+	}
+	SettingsStore(const SettingsStore &)            = delete;
+	SettingsStore &operator=(const SettingsStore &) = delete;
+	~SettingsStore() {
+		Flush();
+		{
+			std::lock_guard<std::mutex> lock(persistMutex_);
+			stop_ = true;
+		}
+		persistCv_.notify_all();
+		if (persistThread_.joinable())
+			persistThread_.join();
+	}
+
+	// The current snapshot; valid for the life of the store. Any thread, lock-free.
+	const SettingsValues &snapshot() const { return *current_.load(std::memory_order_acquire); }
+	const SettingsValues *operator->() const { return &snapshot(); } // one field: g_settings->showOSD
+
+	// Publishes `values` as they are (the loaded settings): nothing is persisted.
+	void Reset(const SettingsValues &values) {
+		std::lock_guard<std::mutex> lock(writeMutex_);
+		publish(values);
+	}
+
+	// Applies `edit` to a copy of the current snapshot and publishes it if anything changed; the
+	// changed keys are persisted in the background. Returns the changed-key mask. Writers are
+	// serialized among themselves only.
+	template <class Edit>
+	uint32_t Update(Edit &&edit) {
+		uint32_t mask;
+		{
+			std::lock_guard<std::mutex> lock(writeMutex_);
+			const SettingsValues &cur  = snapshot();
+			SettingsValues        next = cur;
+			edit(next);
+			mask = changedSettingKeys(cur, next);
+			if (mask == 0)
+				return 0;
+			publish(next);
+		}
+		{
+			std::lock_guard<std::mutex> lock(persistMutex_);
+			dirty_ |= mask;
+			if (!persistThread_.joinable())
+				persistThread_ = std::thread([this] { persistLoop(); });
+		}
+		persistCv_.notify_one();
+		return mask;
+	}
+
+	// Returns once every change published so far has been persisted.
+	void Flush() {
+		std::unique_lock<std::mutex> lock(persistMutex_);
+		persistedCv_.wait(lock, [this] { return dirty_ == 0 && !persisting_; });
+	}
+
+private:
+	void publish(SettingsValues values) { // writeMutex_ held
+		values.version = snapshot().version + 1;
+		all_.push_back(std::make_unique<SettingsValues>(values));
+		current_.store(all_.back().get(), std::memory_order_release);
+	}
+
+	void persistLoop() {
+		std::unique_lock<std::mutex> lock(persistMutex_);
+		for (;;) {
+			persistCv_.wait(lock, [this] { return stop_ || dirty_ != 0; });
+			if (dirty_ == 0)
+				return; // stop_, nothing left
+			uint32_t mask = dirty_;
+			dirty_        = 0;
+			persisting_   = true;
+			lock.unlock();
+			persist_(mask, snapshot()); // the newest values: later changes of a key coalesce
+			lock.lock();
+			persisting_ = false;
+			if (dirty_ == 0)
+				persistedCv_.notify_all();
+		}
+	}
+
+	std::atomic<const SettingsValues *>          current_{nullptr};
+	std::mutex                                   writeMutex_;
+	std::vector<std::unique_ptr<SettingsValues>> all_; // every snapshot published (writeMutex_)
+
+	Persist                 persist_;
+	std::mutex              persistMutex_;
+	std::condition_variable persistCv_, persistedCv_;
+	std::thread             persistThread_;
+	uint32_t                dirty_      = 0;
+	bool                    persisting_ = false;
+	bool                    stop_       = false;
+};
@@ -0,0 +1,115 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+// Compact binary recording of the auto-brightness timeline: raw ALS lux samples, every brightness
+// write that reached a display, and the user adjustments that caused them. Cheap enough to leave
+// on all day (8 bytes per event, buffered, never flushed per record), and the file is a flat array
+// of fixed-width records, so it can be memory-mapped and replayed without parsing.
+//
+// File layout (little-endian):
+//   TimelineHeader (32 bytes), then TimelineRecord (8 bytes) until end of file.
+// Each record carries the milliseconds elapsed since the previous one. A delta that does not fit in
+// 16 bits is preceded by a Gap record whose value holds the extra milliseconds.
+
+enum class TimelineKind : uint8_t {
+	Gap   = 0, // value = milliseconds to add before the next record
+	Lux   = 1, // source = sensor slot, value = float lux (bit pattern)
+	Write = 2, // source = display slot, value = brightness written to the device
+	User  = 3, // source = display slot, value = brightness requested by the user
+};
+
+#pragma pack(push, 1)
+struct TimelineHeader {
+	char     magic[4];     // "SBTL"
+	uint16_t version;      // kTimelineVersion
+	uint16_t recordSize;   // sizeof(TimelineRecord)
+	int64_t  startEpochMs; // wall clock when recording started, t = 0 of the deltas (unix epoch, ms)
+	uint8_t  reserved[16];
+};
+struct TimelineRecord {
+	uint16_t deltaMs;
+	uint8_t  kind;
+	uint8_t  source;
+	uint32_t value;
+};
+#pragma pack(pop)
+static_assert(sizeof(TimelineHeader) == 32, "timeline header must stay 32 bytes");
+static_assert(sizeof(TimelineRecord) == 8, "timeline records must stay 8 bytes");
+
+constexpr uint16_t kTimelineVersion = 1;
+
+// One decoded event, with the delta chain resolved to milliseconds since the start of the file.
+struct TimelineSample {
+	uint64_t     tMs;
+	TimelineKind kind;
+	uint8_t      source;
+	uint32_t     value;
+
+	float lux() const {
+		float f;
+		memcpy(&f, &value, sizeof(f));
+		return f;
+	}
+};
+
+// Walks the records of a mapped (or fully read) timeline file. Gap records are folded into the
+// timestamps and never returned.
+class TimelineCursor {
+public:
+	TimelineCursor(const void *data, size_t size) {
+		const auto *hdr = static_cast<const TimelineHeader *>(data);
+		if (size < sizeof(TimelineHeader) || memcmp(hdr->magic, "SBTL", 4) != 0 ||
+		    hdr->recordSize != sizeof(TimelineRecord))
+			return;
+		header_ = hdr;
+		cur_    = reinterpret_cast<const TimelineRecord *>(hdr + 1);
+		end_    = cur_ + (size - sizeof(TimelineHeader)) / sizeof(TimelineRecord);
+	}
+
+	bool valid() const { return header_ != nullptr; }
+	const TimelineHeader *header() const { return header_; }
+
+	bool next(TimelineSample &out) {
+		while (cur_ < end_) {
+			const TimelineRecord &r = *cur_++;
+			tMs_ += r.deltaMs;
+			if (r.kind == (uint8_t)TimelineKind::Gap) {
+				tMs_ += r.value;
+				continue;
+			}
+			out = {tMs_, (TimelineKind)r.kind, r.source, r.value};
+			return true;
+		}
+		return false;
+	}
+
+private:
+	const TimelineHeader *header_ = nullptr;
+	const TimelineRecord *cur_    = nullptr;
+	const TimelineRecord *end_    = nullptr;
+	uint64_t              tMs_    = 0;
+};
+
+// Recorder. All Record* calls are no-ops (one relaxed atomic load) while recording is off.
+class Timeline {
+public:
+	// Start a new sbpp-YYYYMMDD-HHMMSS.sbtl in the logs folder (Log::LogsFolderPath).
+	static bool         Start();
+	// Write out the buffer, close the file and convert it to a .csv next to it.
+	static void         Stop();
+	static bool         Active();
+	static std::wstring CurrentPath();
+
+	static void Lux(uint8_t sensor, float lux);
+	static void Write(uint8_t display, uint32_t value);
+	static void User(uint8_t display, uint32_t value);
+
+	// Hand buffered records to the OS. Called from the worker loop; only touches the file when the
+	// buffer has been sitting for a while (or when `force`), so a crash loses a few seconds at most.
+	static void Flush(bool force = false);
+
+	// Memory-map a recorded .sbtl and write it out as "t_ms,kind,source,value" CSV.
+	static bool ExportCsv(const std::wstring &binPath, const std::wstring &csvPath);
+};
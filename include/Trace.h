@@ -0,0 +1,179 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Scoped timing spans for "why did that feel slow" reports, exported as Chrome trace-event JSON
+// (load in chrome://tracing or ui.perfetto.dev):
+//
+//   void RefreshHdrState() {
+//       TRACE_SCOPE("RefreshHdrState");
+//       ...
+//
+// Off by default. Disabled, a span is one relaxed load and a branch. Enabled, it is two clock
+// reads and a store into the calling thread's own ring (kRingEvents spans; the oldest are
+// overwritten), so threads never contend. Trace::SetEnabled toggles it at run time, and
+// Trace::Json dumps every ring. Span names must be string literals: they are kept by pointer.
+//
+// A ring is only written by its thread. Json reads rings while they are being written and drops
+// the spans that were overwritten during the copy; a span being written right then can come out
+// torn, which for a diagnostic dump is an acceptable trade for a lock-free hot path.
+
+#define TRACE_CONCAT2(a, b) a##b
+#define TRACE_CONCAT(a, b)  TRACE_CONCAT2(a, b)
+#define TRACE_SCOPE(name)   TraceScope TRACE_CONCAT(traceScope_, __COUNTER__)(name)
+
+class Trace {
+public:
+	static constexpr size_t kRingEvents = 8192;
+
+	struct Event {
+		const char *name;
+		uint64_t    startUs; // since the process started tracing (first use)
+		uint64_t    durUs;
+	};
+
+	static bool Enabled() { return enabled().load(std::memory_order_relaxed); }
+	// Enabling clears what was recorded before.
+	static void SetEnabled(bool on) {
+		if (on && !Enabled()) {
+			std::lock_guard<std::mutex> lock(registry().lock);
+			for (Ring *r : registry().rings)
+				r->head.store(0, std::memory_order_relaxed);
+		}
+		enabled().store(on, std::memory_order_relaxed);
+	}
+
+	// Label the calling thread in the dump ("worker", "ui"). A string literal.
+	static void NameThread(const char *name) { ring().name = name; }
+
+	static uint64_t NowUs() {
+		return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() -
+		                                                                      epoch())
+		    .count();
+	}
+
+	static void Record(const char *name, uint64_t startUs, uint64_t durUs) {
+		Ring    &r = ring();
+		uint64_t h = r.head.load(std::memory_order_relaxed);
+		r.events[h % kRingEvents] = {name, startUs, durUs};
+		r.head.store(h + 1, std::memory_order_release);
+	}
+
+	// Every ring as {"traceEvents": [...]}: complete ("X") events in microseconds, plus the thread
+	// names as metadata events.
+	static std::string Json() {
+		std::string        out = "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+		char               buf[256];
+		bool               first = true;
+		std::vector<Event> copy;
+		std::lock_guard<std::mutex> lock(registry().lock);
+		for (Ring *r : registry().rings) {
+			uint64_t h1   = r->head.load(std::memory_order_acquire);
+			uint64_t from = h1 > kRingEvents ? h1 - kRingEvents : 0;
+			copy.assign(r->events.begin(), r->events.end());
+			uint64_t h2 = r->head.load(std::memory_order_acquire);
+			if (h2 > kRingEvents && h2 - kRingEvents > from) // overwritten while copying
+				from = h2 - kRingEvents;
+			if (r->name) {
+				snprintf(buf, sizeof(buf), "%s\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %u, "
+				                           "\"args\": {\"name\": \"%s\"}}",
+				         first ? "" : ",", r->tid, r->name);
+				out += buf;
+				first = false;
+			}
+			for (uint64_t i = from; i < h1; ++i) {
+				const Event &e = copy[i % kRingEvents];
+				if (!e.name)
+					continue;
+				snprintf(buf, sizeof(buf),
+				         "%s\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %u, \"ts\": %llu, \"dur\": %llu}",
+				         first ? "" : ",", e.name, r->tid, (unsigned long long)e.startUs, (unsigned long long)e.durUs);
+				out += buf;
+				first = false;
+			}
+		}
+		out += "\n]}\n";
+		return out;
+	}
+
+private:
+	// Rings outlive their threads and are handed to the next new thread, so a dump still has the
+	// spans of a helper thread that has finished, and short-lived threads do not pile up rings.
+	struct Ring {
+		std::vector<Event>    events = std::vector<Event>(kRingEvents);
+		std::atomic<uint64_t> head{0};
+		uint32_t              tid  = 0;
+		const char           *name = nullptr;
+		bool                  inUse = true; // registry lock
+	};
+	struct Registry {
+		std::mutex         lock;
+		std::vector<Ring *> rings;
+	};
+	// Returns the ring to the registry when its thread exits.
+	struct RingHandle {
+		Ring *ring = nullptr;
+		~RingHandle() {
+			if (!ring)
+				return;
+			std::lock_guard<std::mutex> lock(registry().lock);
+			ring->inUse = false;
+		}
+	};
+
+	static std::atomic<bool> &enabled() {
+		static std::atomic<bool> on{false};
+		return on;
+	}
+	static std::chrono::steady_clock::time_point epoch() {
+		static const auto t0 = std::chrono::steady_clock::now();
+		return t0;
+	}
+	static Registry &registry() {
+		static Registry *r = new Registry(); // never destroyed: threads may trace during exit
+		return *r;
+	}
+	static Ring &ring() {
+		thread_local RingHandle handle;
+		if (!handle.ring) {
+			std::lock_guard<std::mutex> lock(registry().lock);
+			for (Ring *r : registry().rings)
+				if (!r->inUse) {
+					handle.ring = r;
+					break;
+				}
+			if (handle.ring) {
+				handle.ring->inUse = true;
+				handle.ring->name  = nullptr;
+			} else {
+				handle.ring      = new Ring();
+				handle.ring->tid = (uint32_t)registry().rings.size() + 1;
+				registry().rings.push_back(handle.ring);
+			}
+		}
+		return *handle.ring;
+	}
+};
+
+class TraceScope {
+public:
+	explicit TraceScope(const char *name) : name_(Trace::Enabled() ? name : nullptr) {
+		if (name_)
+			start_ = Trace::NowUs();
+	}
+	~TraceScope() {
+		if (name_)
+			Trace::Record(name_, start_, Trace::NowUs() - start_);
+	}
+	TraceScope(const TraceScope &)            = delete;
+	TraceScope &operator=(const TraceScope &) = delete;
+
+private:
+	const char *name_;
+	uint64_t    start_ = 0;
+};
@@ -2,12 +2,19 @@
 #define HID_INCLUDED
 
 #define WIN32_LEAN_AND_MEAN
+#define NOMINMAX // BrightnessCore.h and its headers call std::min/std::max
 #include <windows.h>
 #include <hidsdi.h>
 #include <hidpi.h>
 #include <vector>
 #include <string>
 #include <cstdint>
+#include <atomic>
+#include <memory>
+
+#include "BrightnessCore.h"
+#include "ColorPreset.h"
+#include "LuxSource.h"
 
 /* ---------- Display types ---------- */
 enum class DisplayType {
@@ -35,24 +42,7 @@ struct HidCaps {
 	UCHAR  id    = 0;
 };
 
-/* ---------- Color preset (Apple Reference Mode) ---------- */
-struct ColorPreset {
-	uint32_t     index;   // hardware index written to 0xFF20/0x03 to select
-	std::wstring name;    // UTF-16 name read from 0xFF20/0x08
-	std::wstring desc;    // UTF-16 secondary string read from 0xFF20/0x09 (Boot Camp reads it too)
-
-	// The factory "Apple ..." presets are the general-use modes: brightness stays adjustable and,
-	// on the XDR panels, they are the only presets compatible with Windows HDR (anything else can
-	// blank the panel). Everything else is a fixed-calibration reference mode; macOS locks
-	// brightness on those as well. The HID protocol carries no per-preset flag (verified against
-	// Boot Camp, which only reads name and desc), so classify by name.
-	bool isHdrCompatible() const { return name.rfind(L"Apple XDR Display", 0) == 0 || name.rfind(L"Pro Display XDR", 0) == 0; }
-	bool allowsBrightness() const {
-		return name.rfind(L"Apple XDR Display", 0) == 0 || name.rfind(L"Pro Display XDR", 0) == 0 || name.rfind(L"Apple Display", 0) == 0;
-	}
-};
-
-struct DisplayDevice {
+struct DisplayDevice : BrightnessDisplay {
 	HANDLE               hDev  = INVALID_HANDLE_VALUE;
 	PHIDP_PREPARSED_DATA prep  = nullptr;
 	HidCaps              featCaps;
@@ -69,24 +59,29 @@ struct DisplayDevice {
 	std::vector<ColorPreset> presets;
 	int                      activePresetIndex = -1;
 
-	// Per-device brightness state
-	ULONG currentBrightness = 30000;
-	ULONG baseBrightness    = 30000;
-	ULONG minBrightness     = 1000;
-	ULONG maxBrightness          = 60000;
+	// Brightness state, anchors, ramp and nit calibration: BrightnessDisplay (a DisplayStates slot)
+
+	// Sensor bound to this display (ContainerId match), resolved when sensors or displays change.
+	// nullptr = no matched sensor; getAmbientLux then falls back to the master sensor.
+	std::atomic<LuxSource *> luxSource{nullptr};
 
-	// Per-device ALS state
-	float baseLux = 100.f;
+	std::vector<uint8_t> stagedReport; // brightness feature report between stage and commit
 
-	// Auto-brightness ramp/hysteresis (Apple-style)
-	float  lastTargetLux  = 0.f;
-	ULONG  rampStart      = 0;
-	ULONG  rampGoal       = 0;
-	double rampStartMs    = 0.0;
-	double rampDurationMs = 0.0;
+	// Every HID transaction on this display once it is in g_displays (main.cpp creates it), and the
+	// liveness probe posted there, settled on the worker's next pass.
+	std::unique_ptr<DeviceScheduler> tx;
+	std::shared_ptr<TxTicket>        probeTx;
 
-	// Nit calibration for proportional brightness matching
-	float maxNits = 600.f;
+	// A display brought up from its saved state (DisplayStateFile.h) is read back once in the
+	// background; the worker compares on a later pass. `expected*` are what was assumed when posted.
+	struct Readback {
+		std::shared_ptr<TxTicket> tx;
+		uint32_t                  expected       = 0;
+		int                       expectedPreset = -1;
+		ULONG                     brightness     = 0;
+		int                       preset         = -1;
+	};
+	std::shared_ptr<Readback> readback;
 
 	DisplayDevice() = default;
 	~DisplayDevice() { close(); }
@@ -95,17 +90,14 @@ struct DisplayDevice {
 	DisplayDevice(const DisplayDevice &)            = delete;
 	DisplayDevice &operator=(const DisplayDevice &) = delete;
 	DisplayDevice(DisplayDevice &&o) noexcept
-	    : hDev(o.hDev), prep(o.prep), featCaps(o.featCaps),
+	    : BrightnessDisplay(drained(o)), hDev(o.hDev), prep(o.prep), featCaps(o.featCaps),
 	      type(o.type), name(std::move(o.name)), devicePath(std::move(o.devicePath)),
 	      containerId(o.containerId),
 	      hPreset(o.hPreset), presetPrep(o.presetPrep), presetReportLen(o.presetReportLen),
 	      presetCursorMax(o.presetCursorMax), presets(std::move(o.presets)),
 	      activePresetIndex(o.activePresetIndex),
-	      currentBrightness(o.currentBrightness), baseBrightness(o.baseBrightness),
-	      minBrightness(o.minBrightness), maxBrightness(o.maxBrightness), baseLux(o.baseLux),
-	      lastTargetLux(o.lastTargetLux), rampStart(o.rampStart), rampGoal(o.rampGoal),
-	      rampStartMs(o.rampStartMs), rampDurationMs(o.rampDurationMs),
-	      maxNits(o.maxNits) {
+	      luxSource(o.luxSource.load()), tx(std::move(o.tx)), probeTx(std::move(o.probeTx)),
+	      readback(std::move(o.readback)) {
 		o.hDev = INVALID_HANDLE_VALUE;
 		o.prep = nullptr;
 		o.hPreset = INVALID_HANDLE_VALUE;
@@ -114,6 +106,7 @@ struct DisplayDevice {
 	DisplayDevice &operator=(DisplayDevice &&o) noexcept {
 		if (this != &o) {
 			close();
+			BrightnessDisplay::operator=(drained(o));
 			hDev = o.hDev; prep = o.prep;
 			featCaps = o.featCaps;
 			type = o.type; name = std::move(o.name); devicePath = std::move(o.devicePath);
@@ -121,11 +114,8 @@ struct DisplayDevice {
 			hPreset = o.hPreset; presetPrep = o.presetPrep;
 			presetReportLen = o.presetReportLen; presetCursorMax = o.presetCursorMax;
 			presets = std::move(o.presets); activePresetIndex = o.activePresetIndex;
-			currentBrightness = o.currentBrightness; baseBrightness = o.baseBrightness;
-			minBrightness = o.minBrightness; maxBrightness = o.maxBrightness;
-			baseLux = o.baseLux; maxNits = o.maxNits;
-			lastTargetLux = o.lastTargetLux; rampStart = o.rampStart; rampGoal = o.rampGoal;
-			rampStartMs = o.rampStartMs; rampDurationMs = o.rampDurationMs;
+			luxSource.store(o.luxSource.load());
+			tx = std::move(o.tx); probeTx = std::move(o.probeTx); readback = std::move(o.readback);
 			o.hDev = INVALID_HANDLE_VALUE;
 			o.prep = nullptr;
 			o.hPreset = INVALID_HANDLE_VALUE;
@@ -140,10 +130,21 @@ struct DisplayDevice {
 	int   getBrightnessRange(ULONG *mn, ULONG *mx);
 	bool  isOpen() const { return hDev != INVALID_HANDLE_VALUE; }
 
-	// Color presets (0xFF20 interface)
+	// BrightnessDisplay
+	int   writeBrightness(uint32_t val) override { return setBrightness(val); }
+	int   stageBrightness(uint32_t val) override; // the read and HidP_SetUsageValue of setBrightness
+	int   commitBrightness() override;            // its HidD_SetFeature
+	DeviceScheduler *scheduler() override { return tx.get(); }
+
+	// `fn` as a transaction of class `c`, waited for; directly when there is no scheduler yet.
+	template <class F>
+	int   runTx(TxClass c, F &&fn) { return tx ? tx->run(c, std::forward<F>(fn)) : fn(); }
+
+	// Color presets (0xFF20 interface). These keep brightnessLocked() in step with the active preset.
 	bool  hasPresets() const { return hPreset != INVALID_HANDLE_VALUE && !presets.empty(); }
 	int   enumeratePresets();
 	int   getActivePreset(int *outIdx);
+	int   readActivePreset(int *outIdx) const; // the device's answer only, nothing here updated
 	int   setActivePreset(int idx);
 
 	// Name-based preset classification (see ColorPreset). All of these fail open: when the
@@ -152,6 +153,14 @@ struct DisplayDevice {
 	bool  presetsClassifiable() const;                // any preset matches the known Apple naming
 	bool  activePresetLocksBrightness() const;        // macOS parity: reference modes fix brightness
 	int   firstHdrCompatiblePreset() const;           // rescue target when HDR turns on (-1 = none)
+
+private:
+	// `o`, once nothing queued on its scheduler still points at it: ready to be moved from
+	static DisplayDevice &&drained(DisplayDevice &o) {
+		if (o.tx)
+			o.tx->idle();
+		return std::move(o);
+	}
 };
 
 /* ---------- Enumeration ---------- */
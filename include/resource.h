@@ -11,6 +11,7 @@
 #define IDM_CHANNEL_STABLE   132
 #define IDM_CHANNEL_BETA     133
 #define IDM_SELECT_DISPLAY   2000  // 2000 + i for display selection
+#define IDM_SELECT_DISPLAY_LAST 2999 // through this: up to 1000 displays in the tray menu
 #define IDI_MYICON           201
 #define IDI_NOTIFICATIONICON 207
 #define IDC_NOTIFICATIONICON 208
@@ -24,6 +25,7 @@
 #define IDC_ENABLE_HOTKEYS        1002
 #define IDC_RUN_AT_STARTUP        1003
 #define IDC_SHOW_OSD              1004
+#define IDC_PREDICTIVE_ALS        1005
 #define IDC_HOTKEY_UP             1101
 #define IDC_HOTKEY_DOWN           1102
 #define IDC_RESET_SHORTCUTS       1201
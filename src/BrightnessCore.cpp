@@ -0,0 +1,231 @@
+#include "BrightnessCore.h"
+#include <barrier>
+#include <thread>
+
+#include "Trace.h"
+
+uint32_t stepBrightness(uint32_t current, uint32_t minB, uint32_t maxB, uint32_t steps, int direction) {
+	uint32_t step = (maxB - minB) / steps;
+	if (step < 1) step = 1;
+	if (direction > 0 && current < maxB)
+		return current + std::min(step, maxB - current);
+	if (direction < 0 && current > minB)
+		return current - std::min(step, current - minB);
+	return current;
+}
+
+uint32_t mapBrightnessAcrossDisplays(uint32_t val, const BrightnessDisplay &from, const BrightnessDisplay &to) {
+	if (from.maxNits() == to.maxNits() && from.maxBrightness() == to.maxBrightness() &&
+	    from.minBrightness() == to.minBrightness())
+		return val;
+	float fromRange = (float)(from.maxBrightness() - from.minBrightness());
+	if (fromRange <= 0.f) return val;
+	float pct   = (float)(val - from.minBrightness()) / fromRange;
+	float nits  = pct * from.maxNits();
+	float toPct = std::clamp(nits / to.maxNits(), 0.f, 1.f);
+	return to.minBrightness() + (uint32_t)(toPct * (float)(to.maxBrightness() - to.minBrightness()));
+}
+
+void BrightnessCore::SetBrightness(BrightnessDisplay &dev, uint32_t val, bool isUserAction, bool showOSD) {
+	TRACE_SCOPE("SetBrightness");
+	settleRamp(dev);
+	if (host_.writesSuspended()) return; // brightness writes are no-ops under HDR; Windows owns it
+	if (dev.brightnessLocked()) return;  // reference modes fix brightness (macOS locks it too)
+	uint32_t safeVal = std::clamp(val, dev.minBrightness(), dev.maxBrightness());
+	// With a ramp step in flight currentBrightness is only what it should land on: write the user's
+	// level anyway (which also cancels the step if it has not started).
+	if (safeVal == dev.currentBrightness() && !(isUserAction && dev.rampTx))
+		return;
+	if (isUserAction)
+		host_.userAction(dev, safeVal);
+	int rc = send(dev, isUserAction, [&dev, safeVal] { return dev.writeBrightness(safeVal); });
+	finishWrite(dev, safeVal, rc, isUserAction, showOSD);
+}
+
+void BrightnessCore::settleRamp(BrightnessDisplay &dev) {
+	if (!dev.rampTx || !dev.rampTx->done())
+		return;
+	int rc = dev.rampTx->result();
+	dev.rampTx.reset();
+	if (rc == kTxCancelled)
+		return; // a user write took its place
+	if (rc != 0) {
+		dev.currentBrightness() = dev.rampFrom();
+		host_.writeFailed(dev, rc);
+		return;
+	}
+	host_.written(dev, dev.rampVal());
+}
+
+void BrightnessCore::writeLinked(bool isUserAction, bool showOSD) {
+	TRACE_SCOPE("SetBrightnessLinked");
+	if (host_.writesSuspended()) return;
+	// Only the displays that will actually change take part
+	size_t n         = 0;
+	bool   scheduled = true;
+	for (auto &w : linked_) {
+		settleRamp(*w.dev);
+		if (w.dev->brightnessLocked())
+			continue;
+		w.val = std::clamp(w.val, w.dev->minBrightness(), w.dev->maxBrightness());
+		if (w.val != w.dev->currentBrightness() || (isUserAction && w.dev->rampTx)) {
+			linked_[n++] = w;
+			scheduled    = scheduled && w.dev->scheduler();
+		}
+	}
+	if (n == 0)
+		return;
+	if (isUserAction)
+		for (size_t i = 0; i < n; ++i)
+			host_.userAction(*linked_[i].dev, linked_[i].val);
+	if (n == 1) { // nothing to line up
+		BrightnessDisplay &dev = *linked_[0].dev;
+		uint32_t           val = linked_[0].val;
+		finishWrite(dev, val, send(dev, isUserAction, [&dev, val] { return dev.writeBrightness(val); }),
+		            isUserAction, showOSD);
+		return;
+	}
+
+	// The sends leave together, but a faster display would still finish first: hold each one back by
+	// how much faster its sends have been than the slowest one's, so they all land at once.
+	uint32_t slowestUs = 0;
+	for (size_t i = 0; i < n; ++i)
+		slowestUs = std::max(slowestUs, linked_[i].dev->commitUs());
+	for (size_t i = 0; i < n; ++i)
+		linked_[i].leadNs = (int64_t)std::min(slowestUs - linked_[i].dev->commitUs(), kMaxLeadUs) * 1000;
+
+	rc_.resize(n);
+	doneNs_.resize(n);
+	auto stage  = [this](size_t i) { return linked_[i].dev->stageBrightness(linked_[i].val); };
+	auto commit = [this](size_t i) {
+		LinkedWrite &w = linked_[i];
+		w.sentNs       = LinkedFanOut::nowNs();
+		if (w.leadNs > 0) {
+			int64_t until = w.sentNs + w.leadNs;
+			while ((w.sentNs = LinkedFanOut::nowNs()) < until) // a timer sleep is far coarser on Windows
+				std::this_thread::yield();
+		}
+		return w.dev->commitBrightness();
+	};
+	if (concurrentLinked_ && scheduled) {
+		// Each display's own thread is its lane, so the write still queues behind the transaction on
+		// the wire and ahead of anything waiting. Always a User transaction: nothing cancels those,
+		// and a lane that never ran would leave the others at the barrier.
+		std::barrier<> sync((std::ptrdiff_t)n);
+		for (size_t i = 0; i < n; ++i)
+			tickets_.push_back(linked_[i].dev->scheduler()->post(TxClass::User, [&, i] {
+				int rc = stage(i);
+				sync.arrive_and_wait();
+				if (rc == 0)
+					rc = commit(i);
+				doneNs_[i] = LinkedFanOut::nowNs();
+				return rc;
+			}));
+		for (size_t i = 0; i < n; ++i)
+			rc_[i] = tickets_[i]->wait();
+		tickets_.clear();
+	} else if (concurrentLinked_) {
+		fanOut_.run(n, stage, commit, rc_.data(), doneNs_.data());
+	} else {
+		for (size_t i = 0; i < n; ++i) {
+			linked_[i].leadNs = 0;
+			rc_[i]            = send(*linked_[i].dev, isUserAction, [&] {
+				int rc = stage(i);
+				return rc ? rc : commit(i);
+			});
+			doneNs_[i] = LinkedFanOut::nowNs();
+		}
+	}
+
+	size_t  written = 0;
+	int64_t first = 0, last = 0;
+	for (size_t i = 0; i < n; ++i) {
+		BrightnessDisplay &dev = *linked_[i].dev;
+		finishWrite(dev, linked_[i].val, rc_[i], isUserAction, showOSD);
+		if (rc_[i] != 0)
+			continue;
+		uint32_t us  = (uint32_t)std::max<int64_t>(0, doneNs_[i] - linked_[i].sentNs) / 1000;
+		dev.commitUs() = dev.commitUs() ? (dev.commitUs() * 3 + us) / 4 : us;
+		first        = written ? std::min(first, doneNs_[i]) : doneNs_[i];
+		last         = written ? std::max(last, doneNs_[i]) : doneNs_[i];
+		++written;
+	}
+	if (written > 1)
+		host_.linkedWritten(written, (uint64_t)(last - first) / 1000);
+}
+
+void BrightnessCore::finishWrite(BrightnessDisplay &dev, uint32_t val, int rc, bool isUserAction, bool showOSD) {
+	if (rc == kTxCancelled)
+		return; // never ran: nothing written, nothing failed
+	if (rc != 0) {
+		host_.writeFailed(dev, rc);
+		return;
+	}
+	dev.currentBrightness() = val;
+	if (isUserAction) {
+		dev.baseBrightness() = val;
+		if (val != dev.minBrightness() && val != dev.maxBrightness())
+			dev.baseLux() = host_.ambientLux(dev, false);
+		// Stop any auto ramp and drop the hysteresis anchor so auto re-syncs to the user.
+		dev.ramp().reset();
+	}
+	host_.written(dev, val);
+
+	if (showOSD)
+		host_.showOsd(dev);
+}
+
+bool BrightnessCore::autoBrightnessStep(BrightnessDisplay &dev, double nowMs, bool predicted) {
+	settleRamp(dev);
+	if (dev.maxBrightness() <= dev.minBrightness())
+		return false; // brightness locked (e.g. a calibrated color preset); nothing to adjust
+	if (dev.brightnessLocked())
+		return false; // reference mode active: brightness is fixed (macOS parity)
+	// per-device, ContainerId-matched sensor, filtered (and led along its trend if enabled)
+	float    lux  = host_.ambientLux(dev, predicted);
+	uint32_t next = 0;
+	if (!dev.ramp().step(nowMs, lux, mapLuxToBrightness(lux, dev), dev.currentBrightness(), dev.minBrightness(),
+	                     dev.maxBrightness(), next))
+		return false;
+	DeviceScheduler *tx = dev.scheduler();
+	if (!tx) {
+		SetBrightness(dev, next, false, false);
+		return true;
+	}
+	uint32_t val = std::clamp(next, dev.minBrightness(), dev.maxBrightness());
+	if (host_.writesSuspended() || val == dev.currentBrightness())
+		return true;
+	if (!dev.rampTx)
+		dev.rampFrom() = dev.currentBrightness(); // else the step in flight may not have landed either
+	dev.rampVal()           = val;
+	dev.currentBrightness() = val;
+	dev.rampTx            = tx->post(TxClass::Ramp, [&dev, val] { return dev.writeBrightness(val); });
+	return true;
+}
+
+void BrightnessCore::attach(BrightnessDisplay &dev) {
+	DisplayStates::shared().page(dev.slot()).ticker[dev.slot() % DisplayStates::kPage] = this;
+}
+
+void BrightnessCore::detach(BrightnessDisplay &dev) {
+	DisplayStates::shared().page(dev.slot()).ticker[dev.slot() % DisplayStates::kPage] = nullptr;
+}
+
+BrightnessCore::TickResult BrightnessCore::autoBrightnessTick(double nowMs, bool predicted) {
+	TRACE_SCOPE("autoBrightnessTick");
+	TickResult     r;
+	DisplayStates &states = DisplayStates::shared();
+	for (size_t n = 0; n < states.pages(); ++n) {
+		DisplayStates::Page &p = states.pageAt(n);
+		for (uint32_t i = 0; i < DisplayStates::kPage; ++i) {
+			if (p.ticker[i] != this || p.maxB[i] <= p.minB[i] || p.locked[i])
+				continue;
+			bool ramping = p.ramp[i].active();
+			if (autoBrightnessStep(*p.display[i], nowMs, predicted))
+				++r.steps;
+			if (!ramping && p.ramp[i].active())
+				++r.rampsStarted;
+		}
+	}
+	return r;
+}
@@ -0,0 +1,258 @@
+//----------------  HidAls.cpp  ----------------
+#include "HidAls.h"
+#include "Log.h"
+#include "Metrics.h"
+#include "Timeline.h"
+#include <initguid.h>
+#include <devpkey.h>
+#include <setupapi.h>
+#include <shlwapi.h>
+#include <vector>
+
+#pragma comment(lib, "hid.lib")
+#pragma comment(lib, "setupapi.lib")
+
+// Usages that carry ambient light on Apple display sensor collections, best first.
+//   0x0020/0x04D1  HID Sensors page, Data Field: Illuminance (the standard ALS field)
+//   0x000F/0x0050  MI_07&col01 on the Studio Display XDR (16-bit, 0-20000)
+//   0x0020/0x030E  MI_07&col02 on the Studio Display XDR (32-bit)
+// The XDR pair is what docs/hid-map.md shows surviving while MI_08 is in Code 10; raw values are
+// logged on the first samples so tester logs can confirm the scale.
+struct AlsUsage {
+	USAGE page;
+	USAGE usage;
+};
+static const AlsUsage kAlsUsages[] = {
+	{0x0020, 0x04D1},
+	{0x000F, 0x0050},
+	{0x0020, 0x030E},
+};
+
+// Where HidP puts the value in a report: write all ones into an empty report and see which bits
+// turn on. Reading reports then needs no preparsed data (HidAlsLayout::decode).
+static bool locateValue(PHIDP_PREPARSED_DATA prep, HIDP_REPORT_TYPE type, const HIDP_VALUE_CAPS &cap, USHORT len,
+                        HidAlsLayout &out) {
+	if (cap.BitSize == 0 || cap.BitSize > 32 || len < 2)
+		return false;
+	HidAlsLayout l;
+	l.page     = cap.UsagePage;
+	l.usage    = cap.IsRange ? cap.Range.UsageMin : cap.NotRange.Usage;
+	l.reportId = cap.ReportID;
+	l.bitSize  = cap.BitSize;
+	l.scale    = hidUnitScale(cap.UnitsExp);
+	std::vector<BYTE> buf(len, (BYTE)0);
+	buf[0]     = cap.ReportID;
+	ULONG ones = cap.BitSize == 32 ? 0xFFFFFFFFu : (1u << cap.BitSize) - 1;
+	if (HidP_SetUsageValue(type, l.page, 0, l.usage, ones, prep, reinterpret_cast<PCHAR>(buf.data()), len) !=
+	    HIDP_STATUS_SUCCESS)
+		return false;
+	size_t bit = 8;
+	while (bit < (size_t)len * 8 && !(buf[bit / 8] >> (bit % 8) & 1))
+		++bit;
+	l.bitOffset = (uint16_t)bit;
+	uint32_t raw;
+	if (!l.decode(buf.data(), buf.size(), raw) || raw != ones)
+		return false;
+	out = l;
+	return true;
+}
+
+// Best ALS usage on an opened collection, as (rank, caps): Input usages outrank Feature ones, then
+// kAlsUsages order. Returns rank -1 when the collection carries none.
+static int findAlsUsage(PHIDP_PREPARSED_DATA prep, HIDP_REPORT_TYPE &type, HIDP_VALUE_CAPS &out) {
+	HIDP_CAPS caps{};
+	if (HidP_GetCaps(prep, &caps) != HIDP_STATUS_SUCCESS)
+		return -1;
+	const HIDP_REPORT_TYPE types[] = {HidP_Input, HidP_Feature};
+	const USHORT           counts[] = {caps.NumberInputValueCaps, caps.NumberFeatureValueCaps};
+	for (int t = 0; t < 2; ++t) {
+		USHORT n = counts[t];
+		if (!n)
+			continue;
+		std::vector<HIDP_VALUE_CAPS> v(n);
+		if (HidP_GetValueCaps(types[t], v.data(), &n, prep) != HIDP_STATUS_SUCCESS)
+			continue;
+		for (int k = 0; k < (int)(sizeof(kAlsUsages) / sizeof(kAlsUsages[0])); ++k)
+			for (USHORT i = 0; i < n; ++i) {
+				USAGE u = v[i].IsRange ? v[i].Range.UsageMin : v[i].NotRange.Usage;
+				if (v[i].UsagePage == kAlsUsages[k].page && u == kAlsUsages[k].usage) {
+					type = types[t];
+					out  = v[i];
+					return t * 16 + k;
+				}
+			}
+	}
+	return -1;
+}
+
+static GUID containerIdOf(HDEVINFO set, PSP_DEVINFO_DATA devInfo) {
+	GUID  cid  = {};
+	DWORD type = 0, size = 0;
+	SetupDiGetDevicePropertyW(set, devInfo, &DEVPKEY_Device_ContainerId, &type, nullptr, 0, &size, 0);
+	if (size == sizeof(GUID))
+		SetupDiGetDevicePropertyW(set, devInfo, &DEVPKEY_Device_ContainerId, &type, (PBYTE)&cid, sizeof(GUID),
+		                          nullptr, 0);
+	return cid;
+}
+
+std::unique_ptr<HidLuxSource> HidLuxSource::Open(const GUID &containerId, std::function<void()> onFirstSample) {
+	GUID hidGuid;
+	HidD_GetHidGuid(&hidGuid);
+	HDEVINFO set = SetupDiGetClassDevsW(&hidGuid, nullptr, 0, DIGCF_PRESENT | DIGCF_DEVICEINTERFACE);
+	if (set == INVALID_HANDLE_VALUE)
+		return nullptr;
+
+	std::wstring    bestPath;
+	int             bestRank = -1;
+	HIDP_REPORT_TYPE bestType = HidP_Input;
+	HIDP_VALUE_CAPS  bestCap{};
+	HidAlsLayout     bestLayout;
+	USHORT           bestLen = 0;
+
+	SP_DEVICE_INTERFACE_DATA ifd{sizeof(ifd)};
+	for (DWORD i = 0; SetupDiEnumDeviceInterfaces(set, nullptr, &hidGuid, i, &ifd); ++i) {
+		DWORD need = 0;
+		SetupDiGetDeviceInterfaceDetailW(set, &ifd, nullptr, 0, &need, nullptr);
+		if (!need)
+			continue;
+		std::vector<BYTE> buf(need);
+		auto det    = reinterpret_cast<PSP_DEVICE_INTERFACE_DETAIL_DATA_W>(buf.data());
+		det->cbSize = sizeof(SP_DEVICE_INTERFACE_DETAIL_DATA_W);
+		SP_DEVINFO_DATA devInfo{sizeof(devInfo)};
+		if (!SetupDiGetDeviceInterfaceDetailW(set, &ifd, det, need, nullptr, &devInfo))
+			continue;
+		if (!StrStrIW(det->DevicePath, L"vid_05ac"))
+			continue;
+		GUID cid = containerIdOf(set, &devInfo);
+		if (memcmp(&cid, &containerId, sizeof(GUID)) != 0)
+			continue;
+
+		HANDLE h = CreateFileW(det->DevicePath, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+		                       nullptr, OPEN_EXISTING, 0, nullptr);
+		if (h == INVALID_HANDLE_VALUE)
+			continue;
+		PHIDP_PREPARSED_DATA prep = nullptr;
+		if (HidD_GetPreparsedData(h, &prep)) {
+			HIDP_REPORT_TYPE type;
+			HIDP_VALUE_CAPS  cap{};
+			int rank = findAlsUsage(prep, type, cap);
+			if (rank >= 0 && (bestRank < 0 || rank < bestRank)) {
+				HIDP_CAPS caps{};
+				HidP_GetCaps(prep, &caps);
+				USHORT       len = type == HidP_Input ? caps.InputReportByteLength : caps.FeatureReportByteLength;
+				HidAlsLayout layout;
+				if (locateValue(prep, type, cap, len, layout)) {
+					bestRank   = rank;
+					bestPath   = det->DevicePath;
+					bestType   = type;
+					bestCap    = cap;
+					bestLayout = layout;
+					bestLen    = len;
+				} else {
+					Log::Warn(L"HID ALS: usage 0x%04X/0x%04X on %s: value not found in its report", cap.UsagePage,
+					          cap.IsRange ? cap.Range.UsageMin : cap.NotRange.Usage, det->DevicePath);
+				}
+			}
+			HidD_FreePreparsedData(prep);
+		}
+		CloseHandle(h);
+	}
+	SetupDiDestroyDeviceInfoList(set);
+
+	if (bestRank < 0 || !bestLen)
+		return nullptr;
+
+	// Input reports are read with an overlapped ReadFile so the thread can be stopped; the Feature
+	// fallback polls with HidD_GetFeature on a plain synchronous handle.
+	DWORD  flags = bestType == HidP_Input ? FILE_FLAG_OVERLAPPED : 0;
+	HANDLE h     = CreateFileW(bestPath.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+	                           nullptr, OPEN_EXISTING, flags, nullptr);
+	if (h == INVALID_HANDLE_VALUE)
+		return nullptr;
+
+	std::unique_ptr<HidLuxSource> src(new HidLuxSource());
+	src->h_             = h;
+	src->containerId    = containerId;
+	src->path           = bestPath;
+	src->type_          = bestType;
+	src->layout_        = bestLayout;
+	src->reportLen_     = bestLen;
+	src->onFirstSample_ = std::move(onFirstSample);
+	src->stop_          = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+	if (!src->stop_)
+		return nullptr;
+	Log::Info(L"HID ALS: %s usage 0x%04X/0x%04X (%s report 0x%02X, bits %u+%u, range %ld-%ld, exp %lu) on %s",
+	          bestType == HidP_Input ? L"reading" : L"polling", bestLayout.page, bestLayout.usage,
+	          bestType == HidP_Input ? L"Input" : L"Feature", bestLayout.reportId, bestLayout.bitOffset,
+	          bestLayout.bitSize, bestCap.LogicalMin, bestCap.LogicalMax, bestCap.UnitsExp, bestPath.c_str());
+	src->thread_ = std::thread([p = src.get()] { p->run(); });
+	return src;
+}
+
+HidLuxSource::~HidLuxSource() {
+	if (stop_)
+		SetEvent(stop_);
+	if (thread_.joinable())
+		thread_.join();
+	if (stop_)
+		CloseHandle(stop_);
+	if (h_ != INVALID_HANDLE_VALUE)
+		CloseHandle(h_);
+}
+
+static MetricCounter g_mHidAlsSamples("sbpp_als_hid_samples_total", "Lux samples read from display HID sensors");
+
+void HidLuxSource::publish(uint32_t raw) {
+	float lx = layout_.lux(raw);
+	deliver((double)GetTickCount64(), lx);
+	if (logged_ < 5) { // per source: each display, and each reconnect, logs its own first samples
+		++logged_;
+		Log::Info(L"HID ALS: raw %u -> %.1f lux", raw, lx);
+	}
+	samples_.fetch_add(1, std::memory_order_relaxed);
+	g_mHidAlsSamples.add();
+	Timeline::Lux(slot, lx);
+	if (!alive_.exchange(true) && onFirstSample_)
+		onFirstSample_();
+}
+
+void HidLuxSource::run() {
+	std::vector<BYTE> buf(reportLen_);
+	if (type_ == HidP_Feature) {
+		do {
+			std::fill(buf.begin(), buf.end(), (BYTE)0);
+			buf[0]     = layout_.reportId;
+			uint32_t v = 0;
+			if (HidD_GetFeature(h_, buf.data(), (ULONG)buf.size()) && layout_.decode(buf.data(), buf.size(), v))
+				publish(v);
+		} while (WaitForSingleObject(stop_, pollMs_.load()) == WAIT_TIMEOUT);
+		return;
+	}
+
+	OVERLAPPED ov{};
+	ov.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+	if (!ov.hEvent)
+		return;
+	for (;;) {
+		ResetEvent(ov.hEvent);
+		if (!ReadFile(h_, buf.data(), (DWORD)buf.size(), nullptr, &ov) && GetLastError() != ERROR_IO_PENDING)
+			break;
+		HANDLE waits[2] = {ov.hEvent, stop_};
+		DWORD  r        = WaitForMultipleObjects(2, waits, FALSE, INFINITE);
+		DWORD  n        = 0;
+		if (r != WAIT_OBJECT_0) {
+			CancelIoEx(h_, &ov);
+			GetOverlappedResult(h_, &ov, &n, TRUE);
+			break;
+		}
+		if (!GetOverlappedResult(h_, &ov, &n, FALSE)) {
+			Log::Warn(L"HID ALS: read failed (%lu), stopping", GetLastError());
+			alive_.store(false);
+			break;
+		}
+		uint32_t v = 0;
+		if (layout_.decode(buf.data(), n, v)) // another report ID on the same collection: skipped
+			publish(v);
+	}
+	CloseHandle(ov.hEvent);
+}
@@ -1,8 +1,12 @@
 #include "Log.h"
 #include <algorithm>
-#include <vector>
 #include <ctime>
 #include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "LogSegment.h"
+#include "Metrics.h"
 
 static const wchar_t *kLogSettingsKey = L"Software\\StudioBrightnessPlusPlus";
 
@@ -41,72 +45,93 @@ static void writePersistedUntil(long long until) {
 	}
 }
 
+// Kept alive past static destruction: destructors of other statics may still log at exit.
 Log &Log::Instance() {
-	static Log inst;
-	return inst;
+	static Log *inst = new Log();
+	return *inst;
 }
 
-void Log::Add(LogLevel level, const wchar_t *fmt, va_list args) {
-	wchar_t buf[1024];
-	_vsnwprintf_s(buf, _TRUNCATE, fmt, args);
-
-	LogEntry entry;
-	entry.tick    = GetTickCount();
-	entry.level   = level;
-	entry.message = buf;
-
-	Log &self = Instance();
-	AcquireSRWLockExclusive(&self.lock_);
-	self.entries_.push_back(std::move(entry));
-	self.totalCount_++;
-	if (self.entries_.size() > kMaxEntries)
-		self.entries_.pop_front();
-	if (self.file_ != INVALID_HANDLE_VALUE) {
-		if (nowEpoch() >= self.fileUntil_)
-			self.closeFile();
-		else
-			self.writeFileLine(level, buf);
+constexpr size_t kLineChars = LogRing::kLineChars; // longest line
+
+static MetricCounter g_mLogLines[] = {
+    {"sbpp_log_info_total", "Info lines stored"},
+    {"sbpp_log_warnings_total", "Warn lines stored"},
+    {"sbpp_log_errors_total", "Error lines stored"},
+};
+static MetricCounter g_mLogCollapsed("sbpp_log_collapsed_total", "Lines counted as repeats of the newest entry");
+static MetricCounter g_mLogSuppressed("sbpp_log_suppressed_total", "Lines dropped by the per-site rate limit");
+
+void Log::Store(LogLevel level, const wchar_t *fmt, LogFormatFn fn, const void *data, size_t bytes) {
+	Log     &self  = Instance();
+	uint32_t tick  = GetTickCount();
+	bool     flush = false;
+	bool     tidy  = false;
+
+	enum { Stored, Collapsed, Suppressed } outcome = Stored;
+	{
+		PROFILED_LOCK(self.lock_);
+		uint32_t dropped = 0;
+		if (self.ring_->repeat(tick, level, fmt, fn, data, bytes)) {
+			outcome = Collapsed; // counted, not stored (nor written to the file)
+		} else if (!self.limiter_.admit(fmt, tick, dropped)) {
+			outcome = Suppressed;
+		} else {
+			LogView prev = self.ring_->count() ? self.ring_->newest() : LogView{};
+			LogView v    = self.ring_->append(tick, level, fmt, fn, data, bytes, dropped);
+			if (self.file_.load(std::memory_order_relaxed)) {
+				wchar_t line[kLineChars];
+				if (prev.repeats) { // the file only got the first of a collapsed run: say how it ended
+					_snwprintf_s(line, _TRUNCATE, L"(previous line repeated %u more times)", prev.repeats);
+					self.writeFileLine(prev.level, line);
+				}
+				if (dropped) {
+					_snwprintf_s(line, _TRUNCATE, L"(%u more lines like the next one suppressed)", dropped);
+					self.writeFileLine(level, line);
+				}
+				v.format(line, kLineChars);
+				self.writeFileLine(level, line);
+				flush = level != LogLevel::Info && self.durable_.load(std::memory_order_relaxed);
+			}
+		}
+		tidy = self.tidyWanted_; // a segment was swapped out, or the next one is wanted
+		self.tidyWanted_ = false;
+	}
+	if (tidy)
+		requestTidy();
+	if (outcome == Suppressed) {
+		g_mLogSuppressed.add();
+		return;
+	}
+	if (outcome == Collapsed)
+		g_mLogCollapsed.add();
+	else
+		g_mLogLines[(int)level].add();
+	self.notifyWatcher(); // a new line, or a repeat count to show
+
+	if (flush) { // Warn/Error in durable mode: on disk before we return
+		PROFILED_LOCK_SHARED(self.fileLock_);
+		self.flushFile();
 	}
-	ReleaseSRWLockExclusive(&self.lock_);
-}
-
-void Log::Info(const wchar_t *fmt, ...) {
-	va_list ap;
-	va_start(ap, fmt);
-	Add(LogLevel::Info, fmt, ap);
-	va_end(ap);
 }
 
-void Log::Warn(const wchar_t *fmt, ...) {
-	va_list ap;
-	va_start(ap, fmt);
-	Add(LogLevel::Warn, fmt, ap);
-	va_end(ap);
+void Log::notifyWatcher() {
+	HWND h = watcher_.load(std::memory_order_acquire);
+	if (h && !watchPosted_.exchange(true))
+		PostMessageW(h, watchMsg_, 0, 0);
 }
 
-void Log::Error(const wchar_t *fmt, ...) {
-	va_list ap;
-	va_start(ap, fmt);
-	Add(LogLevel::Error, fmt, ap);
-	va_end(ap);
+void Log::Watch(HWND hwnd, UINT msg) {
+	Log &self      = Instance();
+	self.watchMsg_ = msg;
+	self.watchPosted_.store(false);
+	self.watcher_.store(hwnd, std::memory_order_release);
 }
 
-size_t Log::GetEntries(std::vector<LogEntry> &out, size_t fromIndex) {
+LogRows::Change Log::Sync(LogRows &rows) {
 	Log &self = Instance();
-	AcquireSRWLockShared(&self.lock_);
-
-	size_t total   = self.totalCount_;
-	size_t dropped = total - self.entries_.size();
-
-	if (fromIndex < dropped)
-		fromIndex = dropped;
-
-	size_t startOffset = fromIndex - dropped;
-	for (size_t i = startOffset; i < self.entries_.size(); ++i)
-		out.push_back(self.entries_[i]);
-
-	ReleaseSRWLockShared(&self.lock_);
-	return total;
+	self.watchPosted_.store(false); // before reading: a line added meanwhile posts again
+	PROFILED_LOCK_SHARED(self.lock_);
+	return rows.sync(*self.ring_);
 }
 
 static const wchar_t *levelTag(LogLevel lv) {
@@ -118,96 +143,357 @@ static const wchar_t *levelTag(LogLevel lv) {
 	return L"?????";
 }
 
+void Log::AppendLine(std::wstring &out, const LogView &v) {
+	DWORD sec = v.tick / 1000;
+	DWORD ms  = v.tick % 1000;
+	DWORD h   = (sec / 3600) % 24;
+	DWORD m   = (sec / 60) % 60;
+	DWORD s   = sec % 60;
+
+	wchar_t prefix[64];
+	int     n = _snwprintf_s(prefix, _TRUNCATE, L"[%02u:%02u:%02u.%03u] [%s] ", h, m, s, ms, levelTag(v.level));
+	if (n > 0)
+		out.append(prefix, (size_t)n);
+	if (v.fn) {
+		wchar_t text[kLineChars];
+		out.append(text, v.format(text, kLineChars));
+	} else {
+		out.append(v.text, v.len);
+	}
+	if (v.suppressed) {
+		n = _snwprintf_s(prefix, _TRUNCATE, L"  (%u like it suppressed before)", v.suppressed);
+		if (n > 0)
+			out.append(prefix, (size_t)n);
+	}
+	if (v.repeats) {
+		sec = v.lastTick / 1000;
+		n   = _snwprintf_s(prefix, _TRUNCATE, L"  (x%u, last %02u:%02u:%02u.%03u)", v.repeats + 1, (sec / 3600) % 24,
+		                   (sec / 60) % 60, sec % 60, v.lastTick % 1000);
+		if (n > 0)
+			out.append(prefix, (size_t)n);
+	}
+	out += L"\r\n";
+}
+
 std::wstring Log::FormatRecent(size_t maxLines) {
 	Log &self = Instance();
-	AcquireSRWLockShared(&self.lock_);
-
 	std::wstring result;
-	size_t start = 0;
-	if (self.entries_.size() > maxLines)
-		start = self.entries_.size() - maxLines;
+	PROFILED_LOCK_SHARED(self.lock_);
+	size_t total = self.ring_->total();
+	self.ring_->visit(total > maxLines ? total - maxLines : 0,
+	                  [&](size_t, const LogView &v) { AppendLine(result, v); });
+	return result;
+}
 
-	for (size_t i = start; i < self.entries_.size(); ++i) {
-		const auto &e = self.entries_[i];
-		DWORD sec = e.tick / 1000;
-		DWORD ms  = e.tick % 1000;
-		DWORD h   = (sec / 3600) % 24;
-		DWORD m   = (sec / 60) % 60;
-		DWORD s   = sec % 60;
+static void timeFields(const SYSTEMTIME &st, uint16_t (&out)[7]) {
+	out[0] = st.wYear;
+	out[1] = st.wMonth;
+	out[2] = st.wDay;
+	out[3] = st.wHour;
+	out[4] = st.wMinute;
+	out[5] = st.wSecond;
+	out[6] = st.wMilliseconds;
+}
+
+/* ---------- segments ---------- */
+
+// The logs folder keeps at most this much of file log (segments of every session) and ALS traces
+// (.sbtl and their .csv); the oldest files go first. The live segment and trace count but are
+// never deleted.
+constexpr unsigned long long kLogFolderCapBytes = 64ull * 1024 * 1024;
 
-		wchar_t line[1200];
-		_snwprintf_s(line, _TRUNCATE, L"[%02u:%02u:%02u.%03u] [%s] %s\r\n",
-		             h, m, s, ms, levelTag(e.level), e.message.c_str());
-		result += line;
+static bool readWholeFile(const std::wstring &path, std::vector<char> &data) {
+	// Share mode without write: fails on the live segment, which is open for writing.
+	HANDLE f = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, 0, nullptr);
+	if (f == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER size;
+	bool          ok = GetFileSizeEx(f, &size) && size.QuadPart <= (LONGLONG)kLogFileBytes;
+	DWORD         n  = 0;
+	if (ok) {
+		data.resize((size_t)size.QuadPart);
+		ok = ReadFile(f, data.data(), (DWORD)data.size(), &n, nullptr) && n == data.size();
 	}
+	CloseHandle(f);
+	return ok;
+}
 
-	ReleaseSRWLockShared(&self.lock_);
-	return result;
+// .sblog -> .sbz next to it, then delete the .sblog. Written to a temporary name first, so a
+// half-written .sbz never replaces the original.
+static void compactSegment(const std::wstring &path) {
+	std::vector<char> data;
+	if (!readWholeFile(path, data))
+		return;
+	std::string seg = compactLogFile(data.data(), data.size());
+	if (seg.empty())
+		return; // not ours: leave it alone
+	std::wstring base = path.substr(0, path.size() - 6); // strip ".sblog"
+	std::wstring tmp  = base + L".sbz.tmp";
+	HANDLE       f    = CreateFileW(tmp.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (f == INVALID_HANDLE_VALUE)
+		return;
+	DWORD n  = 0;
+	bool  ok = WriteFile(f, seg.data(), (DWORD)seg.size(), &n, nullptr) && n == seg.size();
+	CloseHandle(f);
+	if (ok && MoveFileExW(tmp.c_str(), (base + L".sbz").c_str(), MOVEFILE_REPLACE_EXISTING))
+		DeleteFileW(path.c_str());
+	else
+		DeleteFileW(tmp.c_str());
 }
 
-bool Log::openFile(long long untilEpoch) {
-	std::wstring folder = localAppDataLogs();
+// Sort key for "sbpp-YYYYMMDD-HHMMSS[-n].ext": the start time in the name, then n. Compacting
+// rewrites a segment, so the file times say nothing about its age. 0 (oldest) if it does not parse.
+static unsigned long long nameStartKey(const std::wstring &name) {
+	if (name.size() < 20 || name.compare(0, 5, L"sbpp-") != 0 || name[13] != L'-')
+		return 0;
+	unsigned long long key = 0;
+	for (size_t i = 5; i < 20; ++i) {
+		if (i == 13)
+			continue;
+		if (name[i] < L'0' || name[i] > L'9')
+			return 0;
+		key = key * 10 + (unsigned)(name[i] - L'0');
+	}
+	unsigned n = 0;
+	if (name.size() > 21 && name[20] == L'-')
+		for (size_t i = 21; i < name.size() && name[i] >= L'0' && name[i] <= L'9'; ++i)
+			n = n * 10 + (unsigned)(name[i] - L'0');
+	return key * 100 + (n < 100 ? n : 99);
+}
+
+// Compact every closed .sblog (the previous segment, or leftovers of a crash) and prune the folder
+// to kLogFolderCapBytes, oldest first by the start time in the name.
+static void tidyLogsFolder(const std::wstring &folder) {
+	struct Entry {
+		std::wstring       path;
+		unsigned long long bytes;
+		unsigned long long started; // nameStartKey
+	};
+	std::vector<Entry> entries;
+	for (int pass = 0; pass < 2; ++pass) { // 0: compact, 1: list what is left
+		WIN32_FIND_DATAW fd;
+		HANDLE           h = FindFirstFileW((folder + L"\\sbpp-*").c_str(), &fd);
+		if (h == INVALID_HANDLE_VALUE)
+			return;
+		do {
+			std::wstring name = fd.cFileName;
+			auto         ends = [&](const wchar_t *ext) {
+				size_t n = wcslen(ext);
+				return name.size() > n && name.compare(name.size() - n, n, ext) == 0;
+			};
+			std::wstring path = folder + L"\\" + name;
+			if (pass == 0 && ends(L".sblog"))
+				compactSegment(path);
+			else if (pass == 1 && (ends(L".sblog") || ends(L".sbz") || ends(L".log") || ends(L".sbtl") ||
+			                       ends(L".csv")))
+				entries.push_back({path, ((unsigned long long)fd.nFileSizeHigh << 32) | fd.nFileSizeLow,
+				                   nameStartKey(name)});
+		} while (FindNextFileW(h, &fd));
+		FindClose(h);
+	}
+	std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) { return a.started > b.started; });
+	unsigned long long total = 0;
+	for (const Entry &e : entries) { // newest first: keep until the cap, then delete
+		total += e.bytes;
+		if (total > kLogFolderCapBytes)
+			DeleteFileW(e.path.c_str()); // fails on the live segment and trace, which is fine
+	}
+}
+
+// Runs tidy off the logging path. Requests while it runs make it go round once more.
+void Log::requestTidy() {
+	static std::atomic<int> pending{0};
+	if (pending.fetch_add(1) != 0)
+		return;
+	std::thread([]() {
+		Log         &self   = Instance();
+		std::wstring folder = localAppDataLogs();
+		int          n;
+		do {
+			n = pending.load();
+			self.tidy(folder);
+		} while (pending.fetch_sub(n) != n);
+	}).detach();
+}
+
+// Ask for the next segment once the live one is this full, so it is ready before it is needed.
+constexpr uint64_t  kSpareAtRecords = kLogFileRecords * 3 / 4;
+constexpr ULONGLONG kSpareRetryMs   = 10000; // after failing to create one (disk full, ...)
+
+Log::Segment *Log::createSegment(const std::wstring &folder, long long untilEpoch) {
 	SYSTEMTIME st;
 	GetLocalTime(&st);
-	wchar_t name[80];
-	swprintf_s(name, L"sbpp-%04u%02u%02u-%02u%02u%02u.log",
-	           st.wYear, st.wMonth, st.wDay, st.wHour, st.wMinute, st.wSecond);
-	std::wstring path = folder + L"\\" + name;
-	HANDLE f = CreateFileW(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr,
-	                       CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	std::wstring path;
+	HANDLE       f = INVALID_HANDLE_VALUE;
+	for (int i = 0; i < 10 && f == INVALID_HANDLE_VALUE; ++i) { // a segment can fill within a second
+		wchar_t name[80], suffix[8] = L"";
+		if (i)
+			swprintf_s(suffix, L"-%d", i);
+		swprintf_s(name, L"sbpp-%04u%02u%02u-%02u%02u%02u%s.sblog", st.wYear, st.wMonth, st.wDay, st.wHour,
+		           st.wMinute, st.wSecond, suffix);
+		path = folder + L"\\" + name;
+		f    = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_NEW,
+		                   FILE_ATTRIBUTE_NORMAL, nullptr);
+	}
 	if (f == INVALID_HANDLE_VALUE)
-		return false;
-	if (file_ != INVALID_HANDLE_VALUE)
-		CloseHandle(file_);
-	file_      = f;
+		return nullptr;
+	// The mapping sizes the file; it is all zeros (empty records) until written.
+	HANDLE m = CreateFileMappingW(f, nullptr, PAGE_READWRITE, 0, (DWORD)kLogFileBytes, nullptr);
+	void  *v = m ? MapViewOfFile(m, FILE_MAP_WRITE, 0, 0, kLogFileBytes) : nullptr;
+	if (!v) {
+		if (m)
+			CloseHandle(m);
+		CloseHandle(f);
+		DeleteFileW(path.c_str());
+		return nullptr;
+	}
+	uint16_t start[7];
+	timeFields(st, start);
+	return new Segment{f, m, static_cast<char *>(v), LogFileWriter(v, start, untilEpoch), path};
+}
+
+void Log::destroySegment(Segment *s) {
+	bool empty = s->writer.written() == 0; // a spare that was never used
+	if (!empty)
+		FlushViewOfFile(s->view, kLogFileBytes); // ending a segment is rare: leave it complete on disk
+	UnmapViewOfFile(s->view);
+	CloseHandle(s->mapping);
+	if (!empty)
+		FlushFileBuffers(s->file);
+	CloseHandle(s->file);
+	if (empty)
+		DeleteFileW(s->path.c_str());
+	delete s;
+}
+
+void Log::retire(Segment *s) {
+	if (!s)
+		return;
+	s->next     = retired_;
+	retired_    = s;
+	tidyWanted_ = true;
+}
+
+void Log::installSegment(Segment *s, long long untilEpoch) {
+	closeFile();
 	fileUntil_ = untilEpoch;
-	filePath_  = path;
-	const unsigned char bom[3] = {0xEFu, 0xBBu, 0xBFu};
-	DWORD wn;
-	WriteFile(file_, bom, 3, &wn, nullptr);
-	char hdr[160];
-	int hn = sprintf_s(hdr, "==== Studio Brightness++ file log, %04u-%02u-%02u %02u:%02u:%02u local ====\r\n",
-	                   st.wYear, st.wMonth, st.wDay, st.wHour, st.wMinute, st.wSecond);
-	if (hn > 0)
-		WriteFile(file_, hdr, (DWORD)hn, &wn, nullptr);
-	FlushFileBuffers(file_);
-	return true;
+	file_.store(s, std::memory_order_release);
+}
+
+void Log::closeFile() {
+	retire(file_.exchange(nullptr, std::memory_order_acq_rel)); // compacted to .sbz by the tidy
+	retire(spare_);
+	spare_      = nullptr;
+	spareAsked_ = false;
+	spareRetry_ = 0;
+	fileUntil_  = 0;
+}
+
+void Log::tidy(const std::wstring &folder) {
+	Segment  *retired;
+	bool      prepare;
+	long long until;
+	{
+		PROFILED_LOCK(lock_);
+		retired     = retired_;
+		retired_    = nullptr;
+		tidyWanted_ = false;
+		prepare     = spareAsked_ && !spare_ && file_.load(std::memory_order_relaxed);
+		until       = fileUntil_;
+	}
+	if (retired) { // a durable flush that picked one up before it was swapped out finishes first
+		PROFILED_LOCK(fileLock_);
+	}
+	while (retired) {
+		Segment *next = retired->next;
+		destroySegment(retired);
+		retired = next;
+	}
+
+	if (prepare) {
+		Segment *s = createSegment(folder, until);
+		{
+			PROFILED_LOCK(lock_);
+			if (!s) {
+				spareAsked_ = false;
+				spareRetry_ = GetTickCount64() + kSpareRetryMs;
+			} else if (spareAsked_ && !spare_ && file_.load(std::memory_order_relaxed) && fileUntil_ == until) {
+				spare_ = s;
+				s      = nullptr;
+			}
+		}
+		if (s) // the session ended or restarted meanwhile
+			destroySegment(s);
+	}
+
+	tidyLogsFolder(folder); // compacts the retired segments, and whatever a crash left behind
 }
 
 void Log::writeFileLine(LogLevel level, const wchar_t *msg) {
+	Segment *seg = file_.load(std::memory_order_relaxed);
+	if (!seg)
+		return;
+	if (nowEpoch() >= fileUntil_) { // the session ran out
+		closeFile();
+		return;
+	}
 	SYSTEMTIME st;
 	GetLocalTime(&st);
-	const wchar_t *tag = (level == LogLevel::Warn) ? L"WARN " : (level == LogLevel::Error) ? L"ERROR" : L"INFO ";
-	wchar_t wline[1300];
-	int wn = _snwprintf_s(wline, _TRUNCATE, L"%04u-%02u-%02u %02u:%02u:%02u.%03u [%s] %s\r\n",
-	                      st.wYear, st.wMonth, st.wDay, st.wHour, st.wMinute, st.wSecond, st.wMilliseconds, tag, msg);
-	if (wn <= 0)
-		return;
-	int n8 = WideCharToMultiByte(CP_UTF8, 0, wline, wn, nullptr, 0, nullptr, nullptr);
-	if (n8 <= 0)
+	uint16_t time[7];
+	timeFields(st, time);
+	char   utf8[kLineChars * 3]; // worst case UTF-8 expansion of UTF-16
+	int    n   = WideCharToMultiByte(CP_UTF8, 0, msg, (int)wcslen(msg), utf8, (int)sizeof(utf8), nullptr, nullptr);
+	size_t len = n > 0 ? (size_t)n : 0;
+	if (!seg->writer.fits(len) && spare_) { // segment full: switch to the next instead of wrapping
+		retire(seg);
+		seg         = spare_;
+		spare_      = nullptr;
+		spareAsked_ = false;
+		file_.store(seg, std::memory_order_release);
+	}
+	if (!spareAsked_ && seg->writer.written() >= kSpareAtRecords && GetTickCount64() >= spareRetry_) {
+		spareAsked_ = true; // created on the tidy thread; until it is there a full segment wraps
+		tidyWanted_ = true;
+	}
+	seg->writer.write(time, (uint8_t)level, utf8, len);
+}
+
+void Log::flushFile() {
+	Segment *seg = file_.load(std::memory_order_acquire);
+	if (!seg)
 		return;
-	std::vector<char> u8((size_t)n8);
-	WideCharToMultiByte(CP_UTF8, 0, wline, wn, u8.data(), n8, nullptr, nullptr);
-	DWORD written;
-	WriteFile(file_, u8.data(), (DWORD)n8, &written, nullptr);
-	FlushFileBuffers(file_);
+	FlushViewOfFile(seg->view, kLogFileBytes); // writes only the dirty pages
+	FlushFileBuffers(seg->file);
 }
 
-void Log::closeFile() {
-	if (file_ != INVALID_HANDLE_VALUE) {
-		CloseHandle(file_);
-		file_ = INVALID_HANDLE_VALUE;
+void Log::FlushFile() {
+	Log &self = Instance();
+	if (!self.durable_.load(std::memory_order_relaxed))
+		return; // the OS writes the pages; only a PC reset could lose them
+	PROFILED_LOCK_SHARED(self.fileLock_);
+	self.flushFile();
+}
+
+void Log::SetDurable(bool durable) {
+	Instance().durable_.store(durable, std::memory_order_relaxed);
+}
+
+// Start a session with a new segment: created before taking the lock, swapped in under it.
+bool Log::openFile(long long untilEpoch) {
+	Segment *s = createSegment(localAppDataLogs(), untilEpoch);
+	if (!s)
+		return false;
+	{
+		PROFILED_LOCK(lock_);
+		installSegment(s, untilEpoch);
 	}
-	fileUntil_ = 0;
-	filePath_.clear();
+	requestTidy(); // the previous segment, if any, and whatever a crash left behind
+	return true;
 }
 
 bool Log::StartFileLog(int minutes) {
 	long long until = nowEpoch() + (long long)minutes * 60;
-	Log &self = Instance();
-	AcquireSRWLockExclusive(&self.lock_);
-	bool ok = self.openFile(until);
-	ReleaseSRWLockExclusive(&self.lock_);
+	bool      ok    = Instance().openFile(until);
 	if (ok)
 		writePersistedUntil(until);
 	return ok;
@@ -215,9 +501,11 @@ bool Log::StartFileLog(int minutes) {
 
 void Log::StopFileLog() {
 	Log &self = Instance();
-	AcquireSRWLockExclusive(&self.lock_);
-	self.closeFile();
-	ReleaseSRWLockExclusive(&self.lock_);
+	{
+		PROFILED_LOCK(self.lock_);
+		self.closeFile();
+	}
+	requestTidy();
 	writePersistedUntil(0);
 }
 
@@ -225,28 +513,26 @@ void Log::ResumeIfPending() {
 	long long until = readPersistedUntil();
 	if (until <= nowEpoch())
 		return;
-	Log &self = Instance();
-	AcquireSRWLockExclusive(&self.lock_);
-	self.openFile(until);
-	ReleaseSRWLockExclusive(&self.lock_);
+	Instance().openFile(until);
 }
 
 bool Log::FileLogActive() {
 	Log &self = Instance();
-	AcquireSRWLockShared(&self.lock_);
-	bool a = (self.file_ != INVALID_HANDLE_VALUE) && (nowEpoch() < self.fileUntil_);
-	ReleaseSRWLockShared(&self.lock_);
-	return a;
+	PROFILED_LOCK_SHARED(self.lock_);
+	return self.file_.load(std::memory_order_relaxed) && (nowEpoch() < self.fileUntil_);
 }
 
 int Log::RemainingSeconds() {
 	Log &self = Instance();
-	AcquireSRWLockShared(&self.lock_);
-	long long r = (self.file_ != INVALID_HANDLE_VALUE) ? (self.fileUntil_ - nowEpoch()) : 0;
-	ReleaseSRWLockShared(&self.lock_);
+	PROFILED_LOCK_SHARED(self.lock_);
+	long long r = self.file_.load(std::memory_order_relaxed) ? (self.fileUntil_ - nowEpoch()) : 0;
 	return r > 0 ? (int)r : 0;
 }
 
 std::wstring Log::LogsFolderPath() {
 	return localAppDataLogs();
 }
+
+void Log::TidyLogsFolder() {
+	requestTidy();
+}
@@ -1,55 +1,144 @@
 #pragma once
 #include <windows.h>
+#include <atomic>
 #include <string>
-#include <deque>
-#include <vector>
-#include <cstdarg>
 
-enum class LogLevel { Info, Warn, Error };
-
-struct LogEntry {
-	DWORD       tick;
-	LogLevel    level;
-	std::wstring message;
-};
+#include "LogFile.h"
+#include "LogRecord.h"
+#include "LogRows.h"
+#include "LogSiteLimiter.h"
+#include "ProfiledMutex.h"
 
 class Log {
 public:
-	static void Info(const wchar_t *fmt, ...);
-	static void Warn(const wchar_t *fmt, ...);
-	static void Error(const wchar_t *fmt, ...);
+	// printf-style; `fmt` must be a string literal. The line is stored as the format pointer plus the
+	// argument bytes (see LogRecord.h) and only printed when read, or right away for the file log.
+	template <class... A> static void Info(const wchar_t *fmt, A... a) { Record(LogLevel::Info, fmt, a...); }
+	template <class... A> static void Warn(const wchar_t *fmt, A... a) { Record(LogLevel::Warn, fmt, a...); }
+	template <class... A> static void Error(const wchar_t *fmt, A... a) { Record(LogLevel::Error, fmt, a...); }
+
+	// Call f(size_t index, const LogView &) for each entry from `fromIndex` on, under the shared lock:
+	// the view's text points into the ring and must be copied out (e.g. with AppendLine) before
+	// returning. The newest entry can still change (its repeat count). Returns the index of the next
+	// entry (use as new fromIndex).
+	template <class F>
+	static size_t Visit(size_t fromIndex, F &&f) {
+		Log &self = Instance();
+		PROFILED_LOCK_SHARED(self.lock_);
+		self.ring_->visit(fromIndex, f);
+		return self.ring_->total();
+	}
+
+	// Call f(const LogView &) for entry `index` if it is still in the ring, under the shared lock
+	// (same rules as Visit). For rendering one row of the viewer.
+	template <class F>
+	static bool At(size_t index, F &&f) {
+		Log &self = Instance();
+		PROFILED_LOCK_SHARED(self.lock_);
+		LogView v;
+		bool    live = self.ring_->get(index, v);
+		if (live)
+			f(v);
+		return live;
+	}
 
-	// Retrieve entries starting from `fromIndex`.
-	// Returns the index of the next entry (use as new fromIndex).
-	static size_t GetEntries(std::vector<LogEntry> &out, size_t fromIndex);
+	// Bring the viewer's rows up to date with the ring. Also re-arms Watch.
+	static LogRows::Change Sync(LogRows &rows);
+
+	// Post `msg` to `hwnd` when an entry is added or a repeat counted, once until the next Sync
+	// (so a burst of lines is one message). Null hwnd stops it.
+	static void Watch(HWND hwnd, UINT msg);
+
+	// Append "[hh:mm:ss.mmm] [LEVEL] text\r\n" for one entry, with "(xN, last hh:mm:ss.mmm)" after
+	// the text when identical lines were collapsed into it.
+	static void AppendLine(std::wstring &out, const LogView &v);
 
 	// Format up to `maxLines` recent entries as a single string (for clipboard).
 	static std::wstring FormatRecent(size_t maxLines);
 
-	// File logging (debug): mirror every log line to a timestamped UTF-8 file, flushed per line so it
-	// survives a crash or hard reset. Time-boxed; the deadline is persisted so the session resumes
-	// after a relaunch if still within the window (lets a blank-screen reset still capture the logs).
+	// File logging (debug): mirror every log line to timestamped memory-mapped segments of fixed
+	// records (LogFile.h; read them with log-decode.exe). A full segment is swapped for one created
+	// ahead, then closed and compacted to .sbz in the background (LogSegment.h), and the logs folder
+	// pruned to a size cap. Writing a line is
+	// a copy into the view and the OS owns the pages, so a crash of the app loses nothing. Only a PC
+	// reset can lose what the OS has not written yet: with SetDurable(true), Warn and Error lines
+	// (and FlushFile) also flush the view to disk before the caller continues. Time-boxed; the
+	// deadline is persisted so the session resumes after a relaunch if still within the window
+	// (lets a blank-screen reset still capture the logs).
 	static bool         StartFileLog(int minutes);
 	static void         StopFileLog();
 	static void         ResumeIfPending();  // call once at startup
 	static bool         FileLogActive();
+	static void         SetDurable(bool durable);
+	// Durable mode: put the file log on disk now. Call before a device write that can take the
+	// display or driver down, and at exit. A no-op otherwise.
+	static void         FlushFile();
 	static int          RemainingSeconds();
 	static std::wstring LogsFolderPath();
+	// Compact leftover segments and prune the logs folder to its cap, on a background thread. File
+	// logging does this itself; other writers to the folder (Timeline) call it after adding a file.
+	static void         TidyLogsFolder();
 
 private:
-	static void     Add(LogLevel level, const wchar_t *fmt, va_list args);
+	template <class... A>
+	static void Record(LogLevel level, const wchar_t *fmt, A... a) {
+		using R      = LogRecord<A...>;
+		size_t bytes = R::size(a...);
+		if (bytes <= LogRing::kMaxRecordBytes) {
+			alignas(8) unsigned char data[LogRing::kMaxRecordBytes];
+			R::pack(data, a...);
+			Store(level, fmt, &R::format, data, bytes);
+		} else { // long strings: the printed line is smaller
+			wchar_t text[LogRing::kLineChars];
+			int     n = logPrintf(text, LogRing::kLineChars, fmt, a...);
+			Store(level, fmt, nullptr, text, (size_t)n * sizeof(wchar_t));
+		}
+	}
+	// Collapse, rate-limit, then store one line (LogRing::append arguments).
+	static void     Store(LogLevel level, const wchar_t *fmt, LogFormatFn fn, const void *data, size_t bytes);
 	static Log     &Instance();
-	bool            openFile(long long untilEpoch);                   // lock held
-	void            writeFileLine(LogLevel level, const wchar_t *msg); // lock held
-	void            closeFile();                                       // lock held
 
-	SRWLOCK                lock_ = SRWLOCK_INIT;
-	std::deque<LogEntry>   entries_;
-	size_t                 totalCount_ = 0;
+	// One mapped segment file. Created, flushed and unmapped off the logging path (on the tidy
+	// thread, or before taking lock_ when a session starts); under lock_ segments only change hands.
+	struct Segment {
+		HANDLE        file;
+		HANDLE        mapping;
+		char         *view;
+		LogFileWriter writer;
+		std::wstring  path;
+		Segment      *next = nullptr; // retired_ list
+	};
+	static Segment *createSegment(const std::wstring &folder, long long untilEpoch);
+	static void     destroySegment(Segment *s);                          // flush, unmap, close; deletes an unused one
+	static void     requestTidy();                                       // tidy on a background thread
+	void            tidy(const std::wstring &folder);                    // close retired, prepare spare_, prune
+	bool            openFile(long long untilEpoch);                      // no lock held
+	void            installSegment(Segment *s, long long untilEpoch);    // lock_ held
+	void            closeFile();                                         // lock_ held
+	void            retire(Segment *s);                                  // lock_ held
+	void            writeFileLine(LogLevel level, const wchar_t *msg);   // lock_ held
+	void            flushFile();                                         // fileLock_ held (shared is enough)
+
+	SrwLock        lock_{"log"};
+	LogRing       *ring_ = new LogRing(); // ~610 KB, allocated once
+	LogSiteLimiter limiter_;              // lock_
 
-	HANDLE       file_      = INVALID_HANDLE_VALUE;
-	long long    fileUntil_ = 0;  // unix epoch seconds; 0 = inactive
-	std::wstring filePath_;
+	// File state, under lock_ unless noted. Lines are written into file_; when it is 3/4 full the
+	// tidy thread is asked for spare_, and a full segment is swapped for it and put on retired_ for
+	// the tidy thread to close. A durable flush reads file_ under fileLock_ alone, and the tidy
+	// thread takes fileLock_ before unmapping retired segments, so a flush never holds up loggers.
+	SrwLock                fileLock_{"logFile"};
+	std::atomic<Segment *> file_{nullptr};    // the live segment
+	Segment               *spare_      = nullptr;
+	Segment               *retired_    = nullptr;
+	bool                   spareAsked_ = false;
+	ULONGLONG              spareRetry_ = 0;     // GetTickCount64: no new request before
+	bool                   tidyWanted_ = false; // Store calls requestTidy after releasing lock_
+	long long              fileUntil_  = 0;     // unix epoch seconds; 0 = inactive
+	std::atomic<bool>      durable_{false};
 
-	static constexpr size_t kMaxEntries = 2000;
+	std::atomic<HWND> watcher_{nullptr};
+	UINT              watchMsg_ = 0;
+	std::atomic<bool> watchPosted_{false}; // a message is on its way; cleared by Sync
+	void              notifyWatcher();
 };
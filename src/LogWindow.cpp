@@ -1,30 +1,42 @@
 #include "LogWindow.h"
 #include "Log.h"
 #include "resource.h"
+#include "Settings.h"
+#include "Timeline.h"
+#include "Trace.h"
 #include <vector>
 #include <string>
 #include <shellapi.h>
 
 HWND     LogWindow::hWnd_     = nullptr;
-HWND     LogWindow::hEdit_    = nullptr;
+HWND     LogWindow::hList_    = nullptr;
+HWND     LogWindow::hCmbLevel_ = nullptr;
 HWND     LogWindow::hBtnCopy_ = nullptr;
 HWND     LogWindow::hBtnRecord_ = nullptr;
 HWND     LogWindow::hBtnFolder_ = nullptr;
+HWND     LogWindow::hBtnTrace_ = nullptr;
+HWND     LogWindow::hBtnPerf_ = nullptr;
+HWND     LogWindow::hChkDurable_ = nullptr;
 HFONT    LogWindow::hFont_    = nullptr;
 UINT_PTR LogWindow::timerId_  = 0;
-size_t   LogWindow::nextIndex_ = 0;
+LogRows  LogWindow::rows_;
 
 static const wchar_t *kLogWndClass = L"StudioBrightnessLogWindow";
-static constexpr int   kWndW       = 700;
+static constexpr int   kWndW       = 1276;
 static constexpr int   kWndH       = 460;
 static constexpr int   kBtnH       = 28;
 static constexpr int   kBtnW       = 140;
 static constexpr int   kPad        = 6;
-static constexpr UINT_PTR kTimerRefresh = 100;
-static constexpr UINT  kRefreshMs      = 200;
+static constexpr UINT_PTR kTimerStatus = 100;
+static constexpr UINT  kStatusMs       = 1000; // the record buttons; lines arrive by kMsgLogChanged
+static constexpr UINT  kMsgLogChanged  = WM_APP + 1;
 static constexpr int   kBtnCopyId      = 5001;
 static constexpr int   kBtnRecordId    = 5002;
 static constexpr int   kBtnFolderId    = 5003;
+static constexpr int   kBtnTraceId     = 5004;
+static constexpr int   kChkDurableId   = 5005;
+static constexpr int   kCmbLevelId     = 5006;
+static constexpr int   kBtnPerfId      = 5007;
 
 void LogWindow::Create() {
 	HINSTANCE hInst = GetModuleHandle(nullptr);
@@ -56,26 +68,46 @@ void LogWindow::Create() {
 	                              xRec, kPad, 190, kBtnH, hWnd_, (HMENU)(INT_PTR)kBtnRecordId, hInst, nullptr);
 	hBtnFolder_ = CreateWindowExW(0, L"BUTTON", L"Open logs folder", WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON,
 	                              xRec + 190 + kPad, kPad, 150, kBtnH, hWnd_, (HMENU)(INT_PTR)kBtnFolderId, hInst, nullptr);
+	hBtnTrace_ = CreateWindowExW(0, L"BUTTON", L"Record ALS trace", WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON,
+	                             xRec + 190 + kPad + 150 + kPad, kPad, 160, kBtnH, hWnd_, (HMENU)(INT_PTR)kBtnTraceId,
+	                             hInst, nullptr);
+	int xPerf = xRec + 190 + kPad + 150 + kPad + 160 + kPad;
+	hBtnPerf_ = CreateWindowExW(0, L"BUTTON", L"Record perf trace", WS_CHILD | WS_VISIBLE | BS_PUSHBUTTON,
+	                            xPerf, kPad, 160, kBtnH, hWnd_, (HMENU)(INT_PTR)kBtnPerfId, hInst, nullptr);
+	hChkDurable_ = CreateWindowExW(0, L"BUTTON", L"Survive PC resets (flush on warnings)",
+	                               WS_CHILD | WS_VISIBLE | BS_AUTOCHECKBOX, xPerf + 160 + kPad * 2,
+	                               kPad, 250, kBtnH, hWnd_, (HMENU)(INT_PTR)kChkDurableId, hInst, nullptr);
+	SendMessage(hChkDurable_, BM_SETCHECK, g_settings->logSurviveReset ? BST_CHECKED : BST_UNCHECKED, 0);
+	hCmbLevel_ = CreateWindowExW(0, WC_COMBOBOXW, L"", WS_CHILD | WS_VISIBLE | WS_VSCROLL | CBS_DROPDOWNLIST,
+	                             xPerf + 160 + kPad * 2 + 250 + kPad, kPad + 2, 160, 200,
+	                             hWnd_, (HMENU)(INT_PTR)kCmbLevelId, hInst, nullptr);
+	SendMessageW(hCmbLevel_, CB_ADDSTRING, 0, (LPARAM)L"All lines");
+	SendMessageW(hCmbLevel_, CB_ADDSTRING, 0, (LPARAM)L"Warnings and errors");
+	SendMessageW(hCmbLevel_, CB_ADDSTRING, 0, (LPARAM)L"Errors only");
+	SendMessageW(hCmbLevel_, CB_SETCURSEL, (WPARAM)rows_.minLevel(), 0);
 	UpdateRecordButton();
 
-	// Read-only multiline edit
-	int editTop = kPad + kBtnH + kPad;
+	// Virtual list: one row per entry, rendered from the ring when painted (GetRowText)
+	int listTop = kPad + kBtnH + kPad;
 	RECT rc;
 	GetClientRect(hWnd_, &rc);
-	hEdit_ = CreateWindowExW(WS_EX_CLIENTEDGE, L"EDIT", L"",
-	                         WS_CHILD | WS_VISIBLE | WS_VSCROLL | WS_HSCROLL |
-	                             ES_MULTILINE | ES_READONLY | ES_AUTOVSCROLL | ES_AUTOHSCROLL,
-	                         kPad, editTop,
-	                         rc.right - kPad * 2,
-	                         rc.bottom - editTop - kPad,
+	hList_ = CreateWindowExW(WS_EX_CLIENTEDGE, WC_LISTVIEWW, L"",
+	                         WS_CHILD | WS_VISIBLE | LVS_REPORT | LVS_OWNERDATA | LVS_NOCOLUMNHEADER |
+	                             LVS_SHOWSELALWAYS,
+	                         kPad, listTop, rc.right - kPad * 2, rc.bottom - listTop - kPad,
 	                         hWnd_, nullptr, hInst, nullptr);
+	ListView_SetExtendedListViewStyle(hList_, LVS_EX_FULLROWSELECT | LVS_EX_DOUBLEBUFFER);
+	LVCOLUMNW col = {};
+	col.mask      = LVCF_WIDTH;
+	col.cx        = 4000; // wide enough for a long line; scrolls horizontally
+	ListView_InsertColumn(hList_, 0, &col);
 
 	// Set monospace font
 	hFont_ = CreateFontW(-16, 0, 0, 0, FW_NORMAL, FALSE, FALSE, FALSE,
 	                      DEFAULT_CHARSET, OUT_DEFAULT_PRECIS, CLIP_DEFAULT_PRECIS,
 	                      CLEARTYPE_QUALITY, FIXED_PITCH | FF_MODERN, L"Consolas");
 	if (hFont_)
-		SendMessage(hEdit_, WM_SETFONT, (WPARAM)hFont_, TRUE);
+		SendMessage(hList_, WM_SETFONT, (WPARAM)hFont_, TRUE);
 }
 
 void LogWindow::Show() {
@@ -84,23 +116,22 @@ void LogWindow::Show() {
 	if (!hWnd_)
 		return;
 
-	// Reset read position and populate
-	nextIndex_ = 0;
-	SetWindowTextW(hEdit_, L"");
-	Refresh();
+	Rebuild();
+	Log::Watch(hWnd_, kMsgLogChanged);
 
 	ShowWindow(hWnd_, SW_SHOWNORMAL);
 	SetForegroundWindow(hWnd_);
 
 	if (!timerId_)
-		timerId_ = SetTimer(hWnd_, kTimerRefresh, kRefreshMs, nullptr);
+		timerId_ = SetTimer(hWnd_, kTimerStatus, kStatusMs, nullptr);
 }
 
 void LogWindow::Hide() {
 	if (hWnd_ && IsWindowVisible(hWnd_)) {
 		ShowWindow(hWnd_, SW_HIDE);
+		Log::Watch(nullptr, 0);
 		if (timerId_) {
-			KillTimer(hWnd_, kTimerRefresh);
+			KillTimer(hWnd_, kTimerStatus);
 			timerId_ = 0;
 		}
 	}
@@ -111,43 +142,73 @@ bool LogWindow::IsVisible() {
 }
 
 void LogWindow::Refresh() {
-	if (!hEdit_)
+	if (!hList_)
 		return;
 
-	std::vector<LogEntry> newEntries;
-	size_t newNext = Log::GetEntries(newEntries, nextIndex_);
-	if (newEntries.empty())
-		return;
-	nextIndex_ = newNext;
-
-	// Build text for new entries
-	std::wstring text;
-	for (const auto &e : newEntries) {
-		DWORD sec = e.tick / 1000;
-		DWORD ms  = e.tick % 1000;
-		DWORD h   = (sec / 3600) % 24;
-		DWORD m   = (sec / 60) % 60;
-		DWORD s   = sec % 60;
-
-		const wchar_t *tag = L"INFO ";
-		if (e.level == LogLevel::Warn)
-			tag = L"WARN ";
-		else if (e.level == LogLevel::Error)
-			tag = L"ERROR";
-
-		wchar_t line[1200];
-		_snwprintf_s(line, _TRUNCATE, L"[%02u:%02u:%02u.%03u] [%s] %s\r\n",
-		             h, m, s, ms, tag, e.message.c_str());
-		text += line;
+	// Only the row count changes here; rows are formatted when painted. Stay at the bottom if the
+	// newest row was in view, otherwise keep the same lines in view as old ones are evicted.
+	int  count  = ListView_GetItemCount(hList_);
+	int  top    = ListView_GetTopIndex(hList_);
+	bool follow = count == 0 || top + ListView_GetCountPerPage(hList_) >= count;
+	LogRows::Change c = Log::Sync(rows_);
+	if (c.removed || c.added)
+		ListView_SetItemCountEx(hList_, (int)rows_.size(), LVSICF_NOINVALIDATEALL | LVSICF_NOSCROLL);
+	if (follow && !rows_.empty()) {
+		ListView_EnsureVisible(hList_, (int)rows_.size() - 1, FALSE);
+	} else if (c.removed) {
+		RECT r;
+		if (ListView_GetItemRect(hList_, 0, &r, LVIR_BOUNDS))
+			ListView_Scroll(hList_, 0, -(int)c.removed * (r.bottom - r.top));
 	}
+	int prev = (int)rows_.size() - 1 - (int)c.added; // the newest row before: its repeat count may have changed
+	if (c.removed)
+		InvalidateRect(hList_, nullptr, FALSE);
+	else if (prev >= 0)
+		ListView_RedrawItems(hList_, prev, prev);
+}
+
+// After a filter change, or when the window is shown.
+void LogWindow::Rebuild() {
+	rows_.setMinLevel(rows_.minLevel());
+	Log::Sync(rows_);
+	ListView_SetItemCountEx(hList_, (int)rows_.size(), 0);
+	if (!rows_.empty())
+		ListView_EnsureVisible(hList_, (int)rows_.size() - 1, FALSE);
+	InvalidateRect(hList_, nullptr, TRUE);
+}
 
-	// Append to edit control
-	int len = GetWindowTextLengthW(hEdit_);
-	SendMessage(hEdit_, EM_SETSEL, len, len);
-	SendMessage(hEdit_, EM_REPLACESEL, FALSE, (LPARAM)text.c_str());
+void LogWindow::GetRowText(NMLVDISPINFOW *di) {
+	if (!(di->item.mask & LVIF_TEXT) || di->item.iItem < 0 || (size_t)di->item.iItem >= rows_.size())
+		return;
+	// The list reads the text before the next notification, so one buffer is enough.
+	static std::wstring line;
+	line.clear();
+	if (!Log::At(rows_.at((size_t)di->item.iItem), [](const LogView &v) { Log::AppendLine(line, v); }))
+		line = L"(evicted)";
+	while (!line.empty() && (line.back() == L'\n' || line.back() == L'\r'))
+		line.pop_back();
+	di->item.pszText = line.data();
+}
 
-	// Auto-scroll to end
-	SendMessage(hEdit_, EM_SCROLLCARET, 0, 0);
+// The selected rows, or the most recent 500 lines when nothing is selected.
+void LogWindow::CopySelection() {
+	std::wstring all;
+	for (int i = ListView_GetNextItem(hList_, -1, LVNI_SELECTED); i >= 0; i = ListView_GetNextItem(hList_, i, LVNI_SELECTED))
+		if ((size_t)i < rows_.size())
+			Log::At(rows_.at((size_t)i), [&](const LogView &v) { Log::AppendLine(all, v); });
+	if (all.empty())
+		all = Log::FormatRecent(500);
+	if (!all.empty() && OpenClipboard(hWnd_)) {
+		EmptyClipboard();
+		size_t  bytes = (all.size() + 1) * sizeof(wchar_t);
+		HGLOBAL hg    = GlobalAlloc(GMEM_MOVEABLE, bytes);
+		if (hg) {
+			memcpy(GlobalLock(hg), all.c_str(), bytes);
+			GlobalUnlock(hg);
+			SetClipboardData(CF_UNICODETEXT, hg);
+		}
+		CloseClipboard();
+	}
 }
 
 void LogWindow::UpdateRecordButton() {
@@ -167,31 +228,80 @@ void LogWindow::UpdateRecordButton() {
 		SetWindowTextW(hBtnRecord_, text.c_str());
 		last = text;
 	}
+	static int lastTrace = -1;
+	int        trace     = Timeline::Active() ? 1 : 0;
+	if (hBtnTrace_ && trace != lastTrace) {
+		SetWindowTextW(hBtnTrace_, trace ? L"Stop ALS trace" : L"Record ALS trace");
+		lastTrace = trace;
+	}
+	static int lastPerf = -1;
+	int        perf     = Trace::Enabled() ? 1 : 0;
+	if (hBtnPerf_ && perf != lastPerf) {
+		SetWindowTextW(hBtnPerf_, perf ? L"Save perf trace" : L"Record perf trace");
+		lastPerf = perf;
+	}
+}
+
+// Stops span recording and writes what the rings hold as sbpp-trace-*.json (chrome://tracing).
+void LogWindow::SavePerfTrace() {
+	Trace::SetEnabled(false);
+	SYSTEMTIME st;
+	GetLocalTime(&st);
+	wchar_t name[80];
+	swprintf_s(name, L"sbpp-trace-%04u%02u%02u-%02u%02u%02u.json",
+	           st.wYear, st.wMonth, st.wDay, st.wHour, st.wMinute, st.wSecond);
+	std::wstring path = Log::LogsFolderPath() + L"\\" + name;
+	std::string  json = Trace::Json();
+	HANDLE f = CreateFileW(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+	                       CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (f == INVALID_HANDLE_VALUE) {
+		Log::Warn(L"Perf trace: cannot create %s (%lu)", path.c_str(), GetLastError());
+		return;
+	}
+	DWORD wn = 0;
+	BOOL  ok  = WriteFile(f, json.data(), (DWORD)json.size(), &wn, nullptr);
+	DWORD err = ok ? 0 : GetLastError();
+	CloseHandle(f);
+	if (ok)
+		Log::Info(L"Perf trace saved to %s", path.c_str());
+	else
+		Log::Warn(L"Perf trace: write to %s failed (%lu)", path.c_str(), err);
 }
 
 LRESULT CALLBACK LogWindow::WndProc(HWND h, UINT m, WPARAM w, LPARAM l) {
 	switch (m) {
 	case WM_TIMER:
-		if (w == kTimerRefresh) {
-			Refresh();
+		if (w == kTimerStatus)
 			UpdateRecordButton();
-		}
 		return 0;
 
+	case kMsgLogChanged:
+		Refresh();
+		return 0;
+
+	case WM_NOTIFY: {
+		auto *nh = (NMHDR *)l;
+		if (nh->hwndFrom == hList_ && nh->code == LVN_GETDISPINFOW) {
+			GetRowText((NMLVDISPINFOW *)l);
+			return 0;
+		}
+		if (nh->hwndFrom == hList_ && nh->code == LVN_KEYDOWN && ((NMLVKEYDOWN *)l)->wVKey == 'C' &&
+		    (GetKeyState(VK_CONTROL) & 0x8000)) {
+			CopySelection();
+			return 0;
+		}
+		break;
+	}
+
 	case WM_COMMAND:
 		if (LOWORD(w) == kBtnCopyId) {
-			std::wstring all = Log::FormatRecent(500);
-			if (!all.empty() && OpenClipboard(h)) {
-				EmptyClipboard();
-				size_t bytes = (all.size() + 1) * sizeof(wchar_t);
-				HGLOBAL hg   = GlobalAlloc(GMEM_MOVEABLE, bytes);
-				if (hg) {
-					memcpy(GlobalLock(hg), all.c_str(), bytes);
-					GlobalUnlock(hg);
-					SetClipboardData(CF_UNICODETEXT, hg);
-				}
-				CloseClipboard();
-			}
+			CopySelection();
+			return 0;
+		}
+		if (LOWORD(w) == kCmbLevelId && HIWORD(w) == CBN_SELCHANGE) {
+			LRESULT sel = SendMessageW(hCmbLevel_, CB_GETCURSEL, 0, 0);
+			rows_.setMinLevel(sel == 2 ? LogLevel::Error : sel == 1 ? LogLevel::Warn : LogLevel::Info);
+			Rebuild();
 			return 0;
 		}
 		if (LOWORD(w) == kBtnRecordId) {
@@ -202,6 +312,31 @@ LRESULT CALLBACK LogWindow::WndProc(HWND h, UINT m, WPARAM w, LPARAM l) {
 			UpdateRecordButton();
 			return 0;
 		}
+		if (LOWORD(w) == kBtnTraceId) {
+			// The trace setting persists, so a recording left on keeps going across restarts.
+			if (Timeline::Active())
+				Timeline::Stop();
+			else
+				Timeline::Start();
+			g_settings.Update([](SettingsValues &v) { v.recordTimeline = Timeline::Active(); });
+			UpdateRecordButton();
+			return 0;
+		}
+		if (LOWORD(w) == kBtnPerfId) {
+			// Not persisted: spans are for the slowness being reproduced now.
+			if (Trace::Enabled())
+				SavePerfTrace();
+			else
+				Trace::SetEnabled(true);
+			UpdateRecordButton();
+			return 0;
+		}
+		if (LOWORD(w) == kChkDurableId) {
+			bool durable = SendMessage(hChkDurable_, BM_GETCHECK, 0, 0) == BST_CHECKED;
+			g_settings.Update([&](SettingsValues &v) { v.logSurviveReset = durable; });
+			Log::SetDurable(durable);
+			return 0;
+		}
 		if (LOWORD(w) == kBtnFolderId) {
 			ShellExecuteW(h, L"open", Log::LogsFolderPath().c_str(), nullptr, nullptr, SW_SHOWNORMAL);
 			return 0;
@@ -211,9 +346,9 @@ LRESULT CALLBACK LogWindow::WndProc(HWND h, UINT m, WPARAM w, LPARAM l) {
 	case WM_SIZE: {
 		RECT rc;
 		GetClientRect(h, &rc);
-		int editTop = kPad + kBtnH + kPad;
-		if (hEdit_)
-			MoveWindow(hEdit_, kPad, editTop, rc.right - kPad * 2, rc.bottom - editTop - kPad, TRUE);
+		int listTop = kPad + kBtnH + kPad;
+		if (hList_)
+			MoveWindow(hList_, kPad, listTop, rc.right - kPad * 2, rc.bottom - listTop - kPad, TRUE);
 		return 0;
 	}
 
@@ -226,11 +361,16 @@ LRESULT CALLBACK LogWindow::WndProc(HWND h, UINT m, WPARAM w, LPARAM l) {
 			DeleteObject(hFont_);
 			hFont_ = nullptr;
 		}
+		Log::Watch(nullptr, 0);
 		hWnd_ = nullptr;
-		hEdit_ = nullptr;
+		hList_ = nullptr;
+		hCmbLevel_ = nullptr;
 		hBtnCopy_ = nullptr;
 		hBtnRecord_ = nullptr;
 		hBtnFolder_ = nullptr;
+		hBtnTrace_ = nullptr;
+		hBtnPerf_ = nullptr;
+		hChkDurable_ = nullptr;
 		return 0;
 	}
 	return DefWindowProc(h, m, w, l);
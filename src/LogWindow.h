@@ -1,5 +1,9 @@
 #pragma once
 #include <windows.h>
+#include <commctrl.h>
+#include <cstdint>
+
+#include "LogRows.h"
 
 class LogWindow {
 public:
@@ -11,14 +15,22 @@ private:
 	static void            Create();
 	static LRESULT CALLBACK WndProc(HWND, UINT, WPARAM, LPARAM);
 	static void            Refresh();
+	static void            Rebuild();
+	static void            GetRowText(NMLVDISPINFOW *di);
+	static void            CopySelection();
 	static void            UpdateRecordButton();
+	static void            SavePerfTrace();
 
 	static HWND     hWnd_;
-	static HWND     hEdit_;
+	static HWND     hList_;
+	static HWND     hCmbLevel_;
 	static HWND     hBtnCopy_;
 	static HWND     hBtnRecord_;
 	static HWND     hBtnFolder_;
+	static HWND     hBtnTrace_;
+	static HWND     hBtnPerf_;
+	static HWND     hChkDurable_;
 	static HFONT    hFont_;
 	static UINT_PTR timerId_;
-	static size_t   nextIndex_;
+	static LogRows  rows_; // what the virtual list shows
 };
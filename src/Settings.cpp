@@ -21,54 +21,30 @@ static DWORD GetRegDWORD(HKEY hKey, const wchar_t* name, DWORD defValue) {
     return defValue;
 }
 
-void AppSettings::Load() {
+// Writes the changed keys only; on the store's persistence thread.
+static void PersistKeys(uint32_t mask, const SettingsValues& values) {
     HKEY hKey;
-    if (RegOpenKeyExW(HKEY_CURRENT_USER, kRegKeyPath, 0, KEY_READ, &hKey) == ERROR_SUCCESS) {
-        autoAdjustEnabled.store(GetRegDWORD(hKey, L"AutoBrightnessEnabled", 1) != 0);
-        showOSD = (GetRegDWORD(hKey, L"ShowOSD", 1) != 0); // Default to True
-        runAtStartup = (GetRegDWORD(hKey, L"RunAtStartup", 0) != 0);
-        enableCustomHotkeys = (GetRegDWORD(hKey, L"CustomHotkeysEnabled", 0) != 0);
-        
-        hkUp.mods = GetRegDWORD(hKey, L"HotkeyUpMods", 0);
-        hkUp.vk   = GetRegDWORD(hKey, L"HotkeyUpVK", 0);
-        
-        hkDown.mods = GetRegDWORD(hKey, L"HotkeyDownMods", 0);
-        hkDown.vk   = GetRegDWORD(hKey, L"HotkeyDownVK", 0);
-        
-        DWORD steps = GetRegDWORD(hKey, L"BrightnessSteps", 10);
-        brightnessSteps = std::clamp(steps, kMinBrightnessSteps, kMaxBrightnessSteps);
-
-        linkedMode = (GetRegDWORD(hKey, L"LinkedMode", 1) != 0);
-        activeDisplayIndex = GetRegDWORD(hKey, L"ActiveDisplayIndex", 0);
-        updateChannel = (int)GetRegDWORD(hKey, L"UpdateChannel", 0);
-
+    DWORD disp;
+    if (RegCreateKeyExW(HKEY_CURRENT_USER, kRegKeyPath, 0, nullptr, 0, KEY_WRITE, nullptr, &hKey, &disp) == ERROR_SUCCESS) {
+        for (size_t i = 0; i < kSettingKeyCount; ++i)
+            if (mask & (1u << i))
+                SetRegDWORD(hKey, kSettingKeys[i].name, kSettingKeys[i].get(values));
         RegCloseKey(hKey);
     }
 }
 
-void AppSettings::Save() {
-    HKEY hKey;
-    DWORD disp;
-    if (RegCreateKeyExW(HKEY_CURRENT_USER, kRegKeyPath, 0, nullptr, 0, KEY_WRITE, nullptr, &hKey, &disp) == ERROR_SUCCESS) {
-        SetRegDWORD(hKey, L"AutoBrightnessEnabled", autoAdjustEnabled.load() ? 1 : 0);
-        SetRegDWORD(hKey, L"ShowOSD", showOSD ? 1 : 0);
-        SetRegDWORD(hKey, L"CustomHotkeysEnabled", enableCustomHotkeys ? 1 : 0);
-        SetRegDWORD(hKey, L"RunAtStartup", runAtStartup ? 1 : 0);
-        
-        SetRegDWORD(hKey, L"HotkeyUpMods", hkUp.mods);
-        SetRegDWORD(hKey, L"HotkeyUpVK", hkUp.vk);
-        
-        SetRegDWORD(hKey, L"HotkeyDownMods", hkDown.mods);
-        SetRegDWORD(hKey, L"HotkeyDownVK", hkDown.vk);
-        
-        SetRegDWORD(hKey, L"BrightnessSteps", brightnessSteps);
-
-        SetRegDWORD(hKey, L"LinkedMode", linkedMode ? 1 : 0);
-        SetRegDWORD(hKey, L"ActiveDisplayIndex", activeDisplayIndex);
-        SetRegDWORD(hKey, L"UpdateChannel", (DWORD)updateChannel);
+AppSettings::AppSettings() : SettingsStore(PersistKeys) {}
 
+void AppSettings::Load() {
+    SettingsValues v;
+    HKEY hKey;
+    if (RegOpenKeyExW(HKEY_CURRENT_USER, kRegKeyPath, 0, KEY_READ, &hKey) == ERROR_SUCCESS) {
+        for (const SettingKey& key : kSettingKeys)
+            key.set(v, GetRegDWORD(hKey, key.name, key.defValue));
         RegCloseKey(hKey);
     }
+    v.brightnessSteps = std::clamp((ULONG)v.brightnessSteps, kMinBrightnessSteps, kMaxBrightnessSteps);
+    Reset(v);
 }
 
 bool AppSettings::IsStartupEnabled() {
@@ -1,42 +1,23 @@
 #pragma once
 #include <windows.h>
-#include <atomic>
+#include "SettingsStore.h"
 
 // Brightness step constraints (also used by Options dialog)
 constexpr ULONG kDefaultBrightnessSteps = 10;
 constexpr ULONG kMinBrightnessSteps     = 10;
 constexpr ULONG kMaxBrightnessSteps     = 50;
 
-// Custom hotkeys structure
-struct HotkeySpec {
-    UINT mods;
-    UINT vk;
-};
-
-struct AppSettings {
-    // Core Brightness Logic
-    std::atomic<bool> autoAdjustEnabled{true};
-    ULONG             brightnessSteps{10};
-
-    // User Interface
-    bool showOSD{true};
-    bool runAtStartup{false};
-
-    // Multi-display
-    bool  linkedMode{true};
-    ULONG activeDisplayIndex{0};
-
-    // Input / Hotkeys
-    bool       enableCustomHotkeys{false};
-    HotkeySpec hkUp{0, 0};
-    HotkeySpec hkDown{0, 0};
-
-    // Updates: 0 = stable only, 1 = include beta (pre-release) versions
-    int updateChannel{0};
+// The settings (SettingsValues, in SettingsStore.h) as snapshots; changed keys are written to
+// the registry in the background.
+//
+//   if (g_settings->showOSD) ...                                   // one field
+//   const SettingsValues &s = g_settings.snapshot();               // several, one version
+//   g_settings.Update([](SettingsValues &v) { v.showOSD = false; }); // change and persist
+struct AppSettings : SettingsStore {
+    AppSettings();
 
     // Methods
-    void Load();
-    void Save();
+    void Load();  // publishes the registry's values; writes nothing back
     bool IsStartupEnabled();
     void SetStartup(bool enable);
 };
@@ -0,0 +1,188 @@
+#include "Timeline.h"
+#include "Log.h"
+#include <windows.h>
+#include <atomic>
+#include <cstdio>
+
+// Records are appended to a small in-memory buffer and handed to WriteFile in 4 KB batches. No
+// FlushFileBuffers: unlike the debug text log this is a diagnostic trace, not a crash witness.
+static constexpr size_t kBufferRecords = 512;
+static constexpr DWORD  kFlushAfterMs  = 2000;
+
+static SRWLOCK           g_tlLock  = SRWLOCK_INIT;
+static std::atomic<bool> g_tlActive{false};
+static HANDLE            g_tlFile  = INVALID_HANDLE_VALUE;
+static std::wstring      g_tlPath;
+static TimelineRecord    g_tlBuf[kBufferRecords];
+static size_t            g_tlCount     = 0;
+static ULONGLONG         g_tlLastTick  = 0; // tick of the last record, for the delta chain
+static ULONGLONG         g_tlFirstBuf  = 0; // tick of the oldest buffered record
+
+static void writeBuffer() { // lock held
+	if (g_tlFile != INVALID_HANDLE_VALUE && g_tlCount) {
+		DWORD wn;
+		WriteFile(g_tlFile, g_tlBuf, (DWORD)(g_tlCount * sizeof(TimelineRecord)), &wn, nullptr);
+	}
+	g_tlCount = 0;
+}
+
+static void push(TimelineKind kind, uint8_t source, uint32_t value) { // lock held
+	if (g_tlCount + 2 > kBufferRecords)
+		writeBuffer();
+	ULONGLONG now   = GetTickCount64();
+	ULONGLONG delta = now - g_tlLastTick;
+	g_tlLastTick    = now;
+	if (!g_tlCount)
+		g_tlFirstBuf = now;
+	if (delta > 0xFFFF) {
+		g_tlBuf[g_tlCount++] = {0, (uint8_t)TimelineKind::Gap, 0, delta > 0xFFFFFFFFull ? 0xFFFFFFFFu : (uint32_t)delta};
+		delta                = 0;
+	}
+	g_tlBuf[g_tlCount++] = {(uint16_t)delta, (uint8_t)kind, source, value};
+}
+
+static void record(TimelineKind kind, uint8_t source, uint32_t value) {
+	if (!g_tlActive.load(std::memory_order_relaxed))
+		return;
+	AcquireSRWLockExclusive(&g_tlLock);
+	if (g_tlFile != INVALID_HANDLE_VALUE)
+		push(kind, source, value);
+	ReleaseSRWLockExclusive(&g_tlLock);
+}
+
+bool Timeline::Start() {
+	SYSTEMTIME st;
+	GetLocalTime(&st);
+	wchar_t name[80];
+	swprintf_s(name, L"sbpp-%04u%02u%02u-%02u%02u%02u.sbtl",
+	           st.wYear, st.wMonth, st.wDay, st.wHour, st.wMinute, st.wSecond);
+	std::wstring path = Log::LogsFolderPath() + L"\\" + name;
+	HANDLE f = CreateFileW(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+	                       CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (f == INVALID_HANDLE_VALUE) {
+		Log::Warn(L"Timeline: cannot create %s (%lu)", path.c_str(), GetLastError());
+		return false;
+	}
+
+	// t = 0 of the delta chain: the wall clock and the tick are taken together.
+	FILETIME  ft;
+	GetSystemTimeAsFileTime(&ft);
+	ULONGLONG startTick = GetTickCount64();
+	ULONGLONG ft100ns   = ((ULONGLONG)ft.dwHighDateTime << 32) | ft.dwLowDateTime;
+
+	TimelineHeader hdr = {};
+	memcpy(hdr.magic, "SBTL", 4);
+	hdr.version      = kTimelineVersion;
+	hdr.recordSize   = sizeof(TimelineRecord);
+	hdr.startEpochMs = (int64_t)((ft100ns - 116444736000000000ull) / 10000); // FILETIME is 100 ns since 1601
+	DWORD wn;
+	WriteFile(f, &hdr, sizeof(hdr), &wn, nullptr);
+
+	AcquireSRWLockExclusive(&g_tlLock);
+	if (g_tlFile != INVALID_HANDLE_VALUE) {
+		writeBuffer();
+		CloseHandle(g_tlFile);
+	}
+	g_tlFile     = f;
+	g_tlPath     = path;
+	g_tlCount    = 0;
+	g_tlLastTick = startTick;
+	g_tlActive.store(true);
+	ReleaseSRWLockExclusive(&g_tlLock);
+
+	Log::Info(L"Timeline: recording to %s", path.c_str());
+	Log::TidyLogsFolder(); // one trace per launch: older ones count against the folder cap
+	return true;
+}
+
+void Timeline::Stop() {
+	std::wstring path;
+	AcquireSRWLockExclusive(&g_tlLock);
+	g_tlActive.store(false);
+	if (g_tlFile != INVALID_HANDLE_VALUE) {
+		writeBuffer();
+		CloseHandle(g_tlFile);
+		g_tlFile = INVALID_HANDLE_VALUE;
+		path.swap(g_tlPath);
+	}
+	ReleaseSRWLockExclusive(&g_tlLock);
+
+	if (path.empty())
+		return;
+	std::wstring csv = path.substr(0, path.size() - 5) + L".csv";
+	if (ExportCsv(path, csv))
+		Log::Info(L"Timeline: stopped, exported %s", csv.c_str());
+	else
+		Log::Warn(L"Timeline: stopped, CSV export of %s failed", path.c_str());
+	Log::TidyLogsFolder();
+}
+
+bool Timeline::Active() {
+	return g_tlActive.load(std::memory_order_relaxed);
+}
+
+std::wstring Timeline::CurrentPath() {
+	AcquireSRWLockShared(&g_tlLock);
+	std::wstring p = g_tlPath;
+	ReleaseSRWLockShared(&g_tlLock);
+	return p;
+}
+
+void Timeline::Lux(uint8_t sensor, float lux) {
+	uint32_t bits;
+	memcpy(&bits, &lux, sizeof(bits));
+	record(TimelineKind::Lux, sensor, bits);
+}
+
+void Timeline::Write(uint8_t display, uint32_t value) {
+	record(TimelineKind::Write, display, value);
+}
+
+void Timeline::User(uint8_t display, uint32_t value) {
+	record(TimelineKind::User, display, value);
+}
+
+void Timeline::Flush(bool force) {
+	if (!g_tlActive.load(std::memory_order_relaxed))
+		return;
+	AcquireSRWLockExclusive(&g_tlLock);
+	if (g_tlCount && (force || GetTickCount64() - g_tlFirstBuf >= kFlushAfterMs))
+		writeBuffer();
+	ReleaseSRWLockExclusive(&g_tlLock);
+}
+
+bool Timeline::ExportCsv(const std::wstring &binPath, const std::wstring &csvPath) {
+	HANDLE f = CreateFileW(binPath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+	                       OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (f == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER size{};
+	GetFileSizeEx(f, &size);
+	HANDLE map = size.QuadPart ? CreateFileMappingW(f, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+	const void *view = map ? MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0) : nullptr;
+
+	bool ok = false;
+	TimelineCursor cur(view, view ? (size_t)size.QuadPart : 0);
+	FILE *out = nullptr;
+	if (cur.valid() && _wfopen_s(&out, csvPath.c_str(), L"wb") == 0 && out) {
+		static const char *kKindNames[] = {"gap", "lux", "write", "user"};
+		fprintf(out, "t_ms,kind,source,value\r\n");
+		TimelineSample s;
+		while (cur.next(s)) {
+			const char *kind = (uint8_t)s.kind < 4 ? kKindNames[(uint8_t)s.kind] : "?";
+			if (s.kind == TimelineKind::Lux)
+				fprintf(out, "%llu,%s,%u,%.2f\r\n", (unsigned long long)s.tMs, kind, s.source, s.lux());
+			else
+				fprintf(out, "%llu,%s,%u,%u\r\n", (unsigned long long)s.tMs, kind, s.source, s.value);
+		}
+		fclose(out);
+		ok = true;
+	}
+
+	if (view)
+		UnmapViewOfFile(view);
+	if (map)
+		CloseHandle(map);
+	CloseHandle(f);
+	return ok;
+}
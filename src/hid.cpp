@@ -1,6 +1,8 @@
 //----------------  hid.cpp  ----------------
 #include "hid.h"
 #include "Log.h"
+#include "Metrics.h"
+#include "Trace.h"
 #define _WIN32_DCOM
 #include <initguid.h>
 #include <devpropdef.h>
@@ -17,6 +19,32 @@ DEFINE_DEVPROPKEY(SBPP_DEVPKEY_Device_ContainerId,
 #pragma comment(lib, "setupapi.lib")
 #pragma comment(lib, "shlwapi.lib")
 
+/* ---------- Metrics ---------- */
+static const uint64_t kHidUsBounds[] = {250, 500, 1000, 2000, 5000, 10000, 20000, 50000, 100000, 500000};
+static MetricCounter   g_mHidReads("sbpp_hid_reads_total", "HID feature reports read");
+static MetricCounter   g_mHidWrites("sbpp_hid_writes_total", "HID feature reports written");
+static MetricCounter   g_mHidFailures("sbpp_hid_failures_total", "HID feature reads and writes that failed");
+static MetricHistogram g_mHidBrightnessUs("sbpp_hid_set_brightness_us", "setBrightness round trip (read-modify-write)",
+                                          kHidUsBounds);
+static MetricCounter   g_mHidEnumerations("sbpp_hid_enumerations_total", "Display scans (hid_enumerate)");
+static MetricHistogram g_mHidEnumerateUs("sbpp_hid_enumerate_us", "Display scan duration", kHidUsBounds);
+
+// Every feature report goes through these, so the counters see all of them.
+static bool hidGetFeature(HANDLE h, void *buf, ULONG len) {
+	g_mHidReads.add();
+	bool ok = HidD_GetFeature(h, buf, len) != FALSE;
+	if (!ok)
+		g_mHidFailures.add();
+	return ok;
+}
+static bool hidSetFeature(HANDLE h, void *buf, ULONG len) {
+	g_mHidWrites.add();
+	bool ok = HidD_SetFeature(h, buf, len) != FALSE;
+	if (!ok)
+		g_mHidFailures.add();
+	return ok;
+}
+
 /* ---------- Apple vendor ID ---------- */
 static const wchar_t kAppleVid[]     = L"vid_05ac";
 // kColFilter removed: some displays (e.g. Studio Display XDR) expose
@@ -65,6 +93,7 @@ static GUID queryContainerId(HDEVINFO set, PSP_DEVINFO_DATA devInfo) {
 
 /* ============================================================ */
 void DisplayDevice::close() {
+	tx.reset(); // drops what is queued, waits for the transaction on the wire
 	if (presetPrep) {
 		HidD_FreePreparsedData(presetPrep);
 		presetPrep = nullptr;
@@ -88,7 +117,7 @@ int DisplayDevice::getBrightness(ULONG *val) {
 		return -1;
 	std::vector<uint8_t> buf(featCaps.len, 0);
 	buf[0] = featCaps.id;
-	if (!HidD_GetFeature(hDev, buf.data(), (ULONG)buf.size()))
+	if (!hidGetFeature(hDev, buf.data(), (ULONG)buf.size()))
 		return -2;
 	NTSTATUS s = HidP_GetUsageValue(HidP_Feature, featCaps.page, 0, featCaps.usage, val, prep,
 	                                reinterpret_cast<PCHAR>(buf.data()), featCaps.len);
@@ -96,17 +125,29 @@ int DisplayDevice::getBrightness(ULONG *val) {
 }
 
 int DisplayDevice::setBrightness(ULONG v) {
+	MetricTimer timer(g_mHidBrightnessUs);
+	int rc = stageBrightness(v);
+	return rc ? rc : commitBrightness();
+}
+
+int DisplayDevice::stageBrightness(uint32_t v) {
 	if (hDev == INVALID_HANDLE_VALUE || featCaps.len == 0)
 		return -1;
-	std::vector<uint8_t> buf(featCaps.len, 0);
-	buf[0] = featCaps.id;
-	if (!HidD_GetFeature(hDev, buf.data(), (ULONG)buf.size()))
+	stagedReport.assign(featCaps.len, 0);
+	stagedReport[0] = featCaps.id;
+	if (!hidGetFeature(hDev, stagedReport.data(), (ULONG)stagedReport.size()))
 		return -2;
 	NTSTATUS s = HidP_SetUsageValue(HidP_Feature, featCaps.page, 0, featCaps.usage, v, prep,
-	                                reinterpret_cast<PCHAR>(buf.data()), featCaps.len);
+	                                reinterpret_cast<PCHAR>(stagedReport.data()), featCaps.len);
 	if (s != HIDP_STATUS_SUCCESS)
 		return -3;
-	return HidD_SetFeature(hDev, buf.data(), featCaps.len) ? 0 : -4;
+	return 0;
+}
+
+int DisplayDevice::commitBrightness() {
+	if (hDev == INVALID_HANDLE_VALUE || stagedReport.size() != featCaps.len)
+		return -1;
+	return hidSetFeature(hDev, stagedReport.data(), featCaps.len) ? 0 : -4;
 }
 
 int DisplayDevice::getBrightnessRange(ULONG *mn, ULONG *mx) {
@@ -158,7 +199,9 @@ static bool presetHasFeatureUsage(PHIDP_PREPARSED_DATA prep, USAGE page, USAGE u
 }
 
 int DisplayDevice::enumeratePresets() {
+	TRACE_SCOPE("enumeratePresets");
 	presets.clear();
+	setBrightnessLocked(false);
 	if (hPreset == INVALID_HANDLE_VALUE || !presetPrep)
 		return -1;
 	long lm = 0;
@@ -181,12 +224,12 @@ int DisplayDevice::enumeratePresets() {
 		if (HidP_SetUsageValue(HidP_Feature, 0xFF20, 0, 0x04, (ULONG)i, presetPrep,
 		                       reinterpret_cast<PCHAR>(wr.data()), (ULONG)wr.size()) != HIDP_STATUS_SUCCESS)
 			break;
-		if (!HidD_SetFeature(hPreset, wr.data(), (ULONG)wr.size()))
+		if (!hidSetFeature(hPreset, wr.data(), (ULONG)wr.size()))
 			break;
 		// Read the cursor preset's validity (0xFF20/0x06) and name (0xFF20/0x08) from report 0x05.
 		std::vector<uint8_t> r5(presetReportLen, 0);
 		r5[0] = 0x05;
-		if (!HidD_GetFeature(hPreset, r5.data(), (ULONG)r5.size()))
+		if (!hidGetFeature(hPreset, r5.data(), (ULONG)r5.size()))
 			break;
 		ULONG valid = 0;
 		HidP_GetUsageValue(HidP_Feature, 0xFF20, 0, 0x06, &valid, presetPrep,
@@ -216,7 +259,7 @@ int DisplayDevice::enumeratePresets() {
 			if (descRid != r5[0]) {
 				rd.assign(presetReportLen, 0);
 				rd[0] = descRid;
-				rep = HidD_GetFeature(hPreset, rd.data(), (ULONG)rd.size()) ? &rd : nullptr;
+				rep = hidGetFeature(hPreset, rd.data(), (ULONG)rd.size()) ? &rd : nullptr;
 			}
 			if (rep) {
 				std::vector<uint8_t> descBuf(1040, 0);
@@ -244,30 +287,20 @@ int DisplayDevice::enumeratePresets() {
 		else
 			Log::Info(L"    preset %u (u05=%lu): %s | %s", p.index, flag05s[k], p.name.c_str(), p.desc.c_str());
 	}
+	setBrightnessLocked(activePresetLocksBrightness());
 	return 0;
 }
 
 const ColorPreset *DisplayDevice::activePreset() const {
-	if (activePresetIndex < 0)
-		return nullptr;
-	for (const auto &p : presets)
-		if ((int)p.index == activePresetIndex)
-			return &p;
-	return nullptr;
+	return findPreset(presets, activePresetIndex);
 }
 
 bool DisplayDevice::presetsClassifiable() const {
-	for (const auto &p : presets)
-		if (p.allowsBrightness())
-			return true;
-	return false;
+	return ::presetsClassifiable(presets);
 }
 
 bool DisplayDevice::activePresetLocksBrightness() const {
-	if (!presetsClassifiable())
-		return false; // unknown naming scheme: never lock controls on a guess
-	const ColorPreset *p = activePreset();
-	return p && !p->allowsBrightness();
+	return presetLocksBrightness(presets, activePresetIndex);
 }
 
 int DisplayDevice::firstHdrCompatiblePreset() const {
@@ -277,20 +310,30 @@ int DisplayDevice::firstHdrCompatiblePreset() const {
 	return presets.empty() ? -1 : 0; // fallback: the factory default is the safest known state
 }
 
-int DisplayDevice::getActivePreset(int *outIdx) {
+int DisplayDevice::readActivePreset(int *outIdx) const {
 	if (hPreset == INVALID_HANDLE_VALUE || !presetPrep)
 		return -1;
 	std::vector<uint8_t> r3(presetReportLen, 0);
 	r3[0] = 0x03;
-	if (!HidD_GetFeature(hPreset, r3.data(), (ULONG)r3.size()))
+	if (!hidGetFeature(hPreset, r3.data(), (ULONG)r3.size()))
 		return -2;
 	ULONG v = 0;
 	if (HidP_GetUsageValue(HidP_Feature, 0xFF20, 0, 0x03, &v, presetPrep,
 	                       reinterpret_cast<PCHAR>(r3.data()), (ULONG)r3.size()) != HIDP_STATUS_SUCCESS)
 		return -3;
-	activePresetIndex = (int)v;
+	*outIdx = (int)v;
+	return 0;
+}
+
+int DisplayDevice::getActivePreset(int *outIdx) {
+	int v  = 0;
+	int rc = readActivePreset(&v);
+	if (rc != 0)
+		return rc;
+	activePresetIndex = v;
+	setBrightnessLocked(activePresetLocksBrightness());
 	if (outIdx)
-		*outIdx = (int)v;
+		*outIdx = v;
 	return 0;
 }
 
@@ -304,20 +347,24 @@ int DisplayDevice::setActivePreset(int idx) {
 	if (HidP_SetUsageValue(HidP_Feature, 0xFF20, 0, 0x03, (ULONG)idx, presetPrep,
 	                       reinterpret_cast<PCHAR>(r3.data()), (ULONG)r3.size()) != HIDP_STATUS_SUCCESS)
 		return -3;
-	if (!HidD_SetFeature(hPreset, r3.data(), (ULONG)r3.size()))
+	if (!hidSetFeature(hPreset, r3.data(), (ULONG)r3.size()))
 		return -4;
 	activePresetIndex = idx;
+	setBrightnessLocked(activePresetLocksBrightness());
 	return 0;
 }
 
 /* ============================================================ */
 std::vector<DisplayDevice> hid_enumerate() {
+	TRACE_SCOPE("hid_enumerate");
 	struct Candidate {
 		DisplayDevice dev;
 		bool exactMatch;
 	};
 	std::vector<Candidate> candidates;
 	std::vector<DisplayDevice> result;
+	g_mHidEnumerations.add();
+	MetricTimer timer(g_mHidEnumerateUs);
 
 	// 0xFF20 color-preset interfaces (same display as brightness, matched later by ContainerId)
 	struct PresetIface {
@@ -479,11 +526,11 @@ std::vector<DisplayDevice> hid_enumerate() {
 		if (profile) {
 			dev.type    = profile->type;
 			dev.name    = profile->name;
-			dev.maxNits = profile->maxNits;
+			dev.maxNits() = profile->maxNits;
 		} else {
 			dev.type    = DisplayType::AppleGeneric;
 			dev.name    = L"Apple Display (Unknown)";
-			dev.maxNits = 600.f;
+			dev.maxNits() = 600.f;
 			Log::Warn(L"  PID 0x%04X not in profiles, using generic mode", pid);
 		}
 
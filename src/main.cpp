@@ -35,6 +35,13 @@
 #include "HdrMonitor.h"
 #include "NvHdr.h"
 #include "PresetConfirm.h"
+#include "Timeline.h"
+#include "HidAls.h"
+#include "Metrics.h"
+#include "MetricsEndpoint.h"
+#include "DisplayStateFile.h"
+#include "ProfiledMutex.h"
+#include "Trace.h"
 
 #pragma comment(lib, "hid.lib")
 #pragma comment(lib, "sensorsapi.lib")
@@ -60,12 +67,25 @@ constexpr UINT_PTR ID_UPDATE_TIMER    = 0xA001;
 constexpr UINT_PTR ID_HDR_TIMER       = 0xA002;
 static std::atomic<bool> g_updateAvailable{false};
 static std::atomic<bool> g_updateChecking{false};
-static std::mutex        g_updateMutex;
+static ProfiledMutex     g_updateMutex{"update"};
 static UpdateInfo        g_updateInfo;
 
 // HDR state of Apple displays, tracked live. Brightness control is unavailable while HDR is on.
 static std::atomic<bool> g_hdrActive{false};
 
+/* ---------- metrics (MetricsEndpoint.h; read with metrics-query.exe) ---------- */
+static const uint64_t kTickUsBounds[] = {100, 500, 1000, 5000, 10000, 50000, 100000, 500000};
+static MetricCounter   g_mWorkerTicks("sbpp_worker_ticks_total", "Worker loop iterations (every 100 ms)");
+static MetricHistogram g_mWorkerTickUs("sbpp_worker_tick_us", "Worker loop work per tick, excluding the sleep",
+                                       kTickUsBounds);
+static MetricCounter   g_mRampsStarted("sbpp_ramps_started_total", "Auto-brightness ramps started");
+static MetricCounter   g_mRampSteps("sbpp_ramp_steps_total", "Auto-brightness ramp steps written");
+static MetricGauge     g_mDisplays("sbpp_displays", "Connected displays");
+static MetricCounter   g_mAlsSamples("sbpp_als_sensor_samples_total", "Lux samples from Sensor API listeners");
+static MetricHistogram g_mLinkedSkewUs("sbpp_linked_skew_us",
+                                       "Linked writes: first to last display write completing", kTickUsBounds);
+static MetricsEndpoint g_metricsEndpoint;
+
 /* ---------- system tray icon ---------- */
 // Re-add the tray icon when the shell (re)creates the taskbar: Explorer restart, or we
 // started before the taskbar was ready at boot. Registered in WinMain, handled in WndProc.
@@ -73,7 +93,100 @@ static UINT g_wmTaskbarCreated = 0;
 
 /* ---------- multi-display state ---------- */
 static std::vector<DisplayDevice> g_displays;
-static std::mutex                 g_displayMutex;
+static ProfiledMutex              g_displayMutex{"display"};
+
+/* ---------- Per-display saved state (%LOCALAPPDATA%\...\displays.sbstate, by ContainerId) ---------- */
+// Saved after every write and preset change, restored when a display connects so it is usable before
+// the first HID read. Saves happen with g_displayMutex held.
+static DisplayStateFile g_stateFile;
+
+static std::wstring displayStatePath() {
+	wchar_t      base[MAX_PATH];
+	DWORD        n   = GetEnvironmentVariableW(L"LOCALAPPDATA", base, MAX_PATH);
+	std::wstring dir = (n > 0 && n < MAX_PATH) ? std::wstring(base) : L".";
+	dir += L"\\StudioBrightnessPlusPlus";
+	CreateDirectoryW(dir.c_str(), nullptr);
+	return dir + L"\\displays.sbstate";
+}
+
+static void saveDisplayState(const DisplayDevice &dev) {
+	static const GUID zero = {};
+	if (memcmp(&dev.containerId, &zero, sizeof(GUID)) == 0)
+		return; // nothing to find it by next time
+	DisplayState s = {};
+	memcpy(s.containerId, &dev.containerId, sizeof(GUID));
+	s.minB        = dev.minBrightness();
+	s.maxB        = dev.maxBrightness();
+	s.current     = dev.currentBrightness();
+	s.base        = dev.baseBrightness();
+	s.baseLux     = dev.baseLux();
+	s.capPage     = dev.featCaps.page;
+	s.capUsage    = dev.featCaps.usage;
+	s.capLen      = dev.featCaps.len;
+	s.capId       = dev.featCaps.id;
+	s.presetIndex = dev.hPreset != INVALID_HANDLE_VALUE ? dev.activePresetIndex : -1;
+	g_stateFile.save(s);
+}
+
+// Takes the saved brightness, anchor and preset when the display still resolves to the same cap
+// and range (a firmware update can change the descriptor). False: read the device as before.
+static bool restoreDisplayState(DisplayDevice &dev) {
+	uint8_t cid[16];
+	memcpy(cid, &dev.containerId, sizeof(GUID));
+	DisplayState s;
+	if (!g_stateFile.load(cid, s))
+		return false;
+	if (s.capPage != dev.featCaps.page || s.capUsage != dev.featCaps.usage || s.capLen != dev.featCaps.len ||
+	    s.capId != dev.featCaps.id || s.minB != dev.minBrightness() || s.maxB != dev.maxBrightness() ||
+	    s.current < s.minB || s.current > s.maxB) {
+		Log::Info(L"Saved state of %s no longer matches its descriptor, reading the device", dev.name.c_str());
+		return false;
+	}
+	dev.currentBrightness() = s.current;
+	dev.baseBrightness()    = std::clamp(s.base, s.minB, s.maxB);
+	dev.baseLux()           = s.baseLux;
+	if (dev.hPreset != INVALID_HANDLE_VALUE && s.presetIndex >= 0)
+		dev.activePresetIndex = s.presetIndex;
+	return true;
+}
+
+// Confirm a restored display against the device, behind anything the user asks for.
+static void postReadback(DisplayDevice &dev) {
+	auto rb            = std::make_shared<DisplayDevice::Readback>();
+	rb->expected       = dev.currentBrightness();
+	rb->expectedPreset = dev.activePresetIndex;
+	rb->tx             = dev.tx->post(TxClass::Probe, [&dev, r = rb.get()] {
+		int rc = dev.getBrightness(&r->brightness);
+		if (rc == 0 && dev.hPreset != INVALID_HANDLE_VALUE && dev.readActivePreset(&r->preset) != 0)
+			r->preset = -1;
+		return rc;
+	});
+	dev.readback = std::move(rb);
+}
+
+// The readback is done: adopt what the device says unless something was written since. Worker,
+// g_displayMutex held.
+static void settleReadback(DisplayDevice &dev) {
+	auto rb = std::move(dev.readback);
+	if (rb->tx->result() != 0)
+		return; // cancelled, or gone: the liveness probe will tell
+	bool stale = false;
+	if (rb->brightness != rb->expected && dev.currentBrightness() == rb->expected) {
+		Log::Info(L"Saved state of %s was stale: brightness %u, device at %lu", dev.name.c_str(), rb->expected,
+		          rb->brightness);
+		dev.currentBrightness() = rb->brightness;
+		stale                   = true;
+	}
+	if (rb->preset >= 0 && rb->preset != rb->expectedPreset && dev.activePresetIndex == rb->expectedPreset) {
+		Log::Info(L"Saved state of %s was stale: preset %d, device at %d", dev.name.c_str(), rb->expectedPreset,
+		          rb->preset);
+		dev.activePresetIndex = rb->preset;
+		dev.setBrightnessLocked(dev.activePresetLocksBrightness());
+		stale = true;
+	}
+	if (stale)
+		saveDisplayState(dev);
+}
 
 /* ---------- Per-display color-preset persistence (HKCU\...\Presets\{ContainerId}) ---------- */
 static std::wstring guidToString(const GUID &g) {
@@ -84,11 +197,12 @@ static std::wstring guidToString(const GUID &g) {
 // Revert a display's color preset to a previous index, located by ContainerId so it still works
 // after the HID re-enumeration a preset switch triggers (the DisplayDevice object gets replaced).
 static bool tryRevertPreset(const GUID &cid, int prevIdx) {
-	std::lock_guard<std::mutex> lock(g_displayMutex);
+	PROFILED_LOCK(g_displayMutex);
 	for (auto &dev : g_displays)
 		if (memcmp(&dev.containerId, &cid, sizeof(GUID)) == 0 && dev.hPreset != INVALID_HANDLE_VALUE) {
-			if (dev.setActivePreset(prevIdx) == 0) {
+			if (dev.runTx(TxClass::Preset, [&] { return dev.setActivePreset(prevIdx); }) == 0) {
 				Log::Info(L"Color preset reverted to %d on %s", prevIdx, dev.name.c_str());
+				saveDisplayState(dev);
 				return true;
 			}
 		}
@@ -97,6 +211,7 @@ static bool tryRevertPreset(const GUID &cid, int prevIdx) {
 static void RevertPresetByContainer(const GUID &cid, int prevIdx) {
 	if (prevIdx < 0) return;
 	Log::Info(L"Reverting color preset to %d", prevIdx);
+	Log::FlushFile();
 	if (tryRevertPreset(cid, prevIdx))
 		return;
 	// The switch re-enumerates the display's HID interface (a disconnect), so the device may not
@@ -144,13 +259,7 @@ static std::set<std::wstring>                           g_presetRestored;
 // GDI+
 static ULONG_PTR gdiplusToken;
 
-// --- Apple-style auto-brightness transition (hysteresis + asymmetric perceptual ramp) ---
-constexpr float  kRelLuxHysteresis = 0.20f;   // re-target only when |dLux|/lastTargetLux >= 20%
-constexpr double kRampBrightenMs   = 1500.0;  // fast brightening
-constexpr double kRampDimMs        = 5000.0;  // slow, gentle dimming
-
-static double brightToPerc(ULONG v) { return std::log2((double)v + 1.0); }
-static ULONG  percToBright(double l) { return (ULONG)std::llround(std::exp2(l) - 1.0); }
+// Auto-brightness transition constants and ramp math live in AutoBrightness.h.
 static double nowMs() {
 	using namespace std::chrono;
 	return duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
@@ -162,13 +271,14 @@ static void unregisterHotkeys(HWND h) {
 }
 static bool registerHotkeys(HWND h) {
 	unregisterHotkeys(h);
-	if (!g_settings.enableCustomHotkeys)
+	const SettingsValues &s = g_settings.snapshot();
+	if (!s.enableCustomHotkeys)
 		return true;
 	bool ok = true;
-	if (g_settings.hkUp.vk)
-		ok = ok && RegisterHotKey(h, ID_HOTKEY_UP, g_settings.hkUp.mods, g_settings.hkUp.vk);
-	if (g_settings.hkDown.vk)
-		ok = ok && RegisterHotKey(h, ID_HOTKEY_DOWN, g_settings.hkDown.mods, g_settings.hkDown.vk);
+	if (s.hkUp.vk)
+		ok = ok && RegisterHotKey(h, ID_HOTKEY_UP, s.hkUp.mods, s.hkUp.vk);
+	if (s.hkDown.vk)
+		ok = ok && RegisterHotKey(h, ID_HOTKEY_DOWN, s.hkDown.mods, s.hkDown.vk);
 	return ok;
 }
 
@@ -213,6 +323,7 @@ static void ShowUpdateBalloon(const wchar_t *title, const wchar_t *text) {
 // moment HDR turns on. This closes the "pick a reference mode, then enable HDR" trap, and it is
 // the same recovery a user would do by hand from a second machine.
 static void RefreshHdrState() {
+	TRACE_SCOPE("RefreshHdrState");
 	bool now  = HdrAnyAppleDisplayActive();
 	bool prev = g_hdrActive.exchange(now);
 	if (now != prev) {
@@ -220,7 +331,7 @@ static void RefreshHdrState() {
 		NvapiLogHdrState(now ? L"HDR on" : L"HDR off");
 		if (now) {
 			PresetConfirm::Cancel(); // a pending keep/revert prompt is superseded by the rescue
-			std::lock_guard<std::mutex> lock(g_displayMutex);
+			PROFILED_LOCK(g_displayMutex);
 			for (auto &dev : g_displays) {
 				if (!dev.hasPresets() || !dev.presetsClassifiable())
 					continue;
@@ -231,7 +342,10 @@ static void RefreshHdrState() {
 				if (tgt >= 0 && tgt != dev.activePresetIndex) {
 					Log::Info(L"HDR enabled with \"%s\" active on %s: switching to preset %d for HDR compatibility",
 					          ap->name.c_str(), dev.name.c_str(), tgt);
-					if (dev.setActivePreset(tgt) != 0)
+					Log::FlushFile();
+					if (dev.runTx(TxClass::Preset, [&] { return dev.setActivePreset(tgt); }) == 0)
+						saveDisplayState(dev);
+					else
 						Log::Warn(L"HDR rescue preset switch failed on %s", dev.name.c_str());
 				}
 			}
@@ -243,9 +357,9 @@ static void StartUpdateCheck(bool manual) {
 	bool expected = false;
 	if (!g_updateChecking.compare_exchange_strong(expected, true)) return; // a check is already running
 	std::thread([manual]() {
-		UpdateInfo info = CheckForUpdate(g_settings.updateChannel, kAppVersion);
+		UpdateInfo info = CheckForUpdate(g_settings->updateChannel, kAppVersion);
 		{
-			std::lock_guard<std::mutex> lk(g_updateMutex);
+			PROFILED_LOCK(g_updateMutex);
 			g_updateInfo = info;
 		}
 		g_updateAvailable.store(info.available);
@@ -257,7 +371,7 @@ static void StartUpdateCheck(bool manual) {
 static void StartUpdateInstall() {
 	UpdateInfo info;
 	{
-		std::lock_guard<std::mutex> lk(g_updateMutex);
+		PROFILED_LOCK(g_updateMutex);
 		info = g_updateInfo;
 	}
 	if (!info.available) return;
@@ -272,7 +386,13 @@ static void StartUpdateInstall() {
 }
 
 /* ---------- ALS via ISensorEvents ---------- */
-class AlsSensorListener : public ISensorEvents {
+// Fallback for displays without a ContainerId-matched sensor: the first sensor that delivers data.
+static std::atomic<LuxSource *> g_alsMaster{nullptr};
+// Set from sensor callbacks when a sensor first delivers data or leaves; the worker then
+// re-resolves the bindings (bindings only ever change on the worker, under g_displayMutex).
+static std::atomic<bool>        g_alsBindingsStale{false};
+
+class AlsSensorListener : public ISensorEvents, public LuxSource {
 public:
 	AlsSensorListener() : refCount_(1) {}
 
@@ -305,88 +425,217 @@ public:
 				lux = v.fltVal;
 			else if (v.vt == VT_R8)
 				lux = static_cast<float>(v.dblVal);
-			lastLux_.store(lux, std::memory_order_relaxed);
-			alive_.store(true, std::memory_order_relaxed);
+			deliver(nowMs(), lux);
+			samples_.fetch_add(1, std::memory_order_relaxed);
+			g_mAlsSamples.add();
+			if (!alive_.exchange(true, std::memory_order_relaxed))
+				g_alsBindingsStale.store(true);
+			Timeline::Lux(slot, lux); // raw, so recordings can be replayed through other filters
 		}
 		PropVariantClear(&v);
 		return S_OK;
 	}
 	STDMETHODIMP OnEvent(ISensor *, REFGUID, IPortableDeviceValues *) override { return S_OK; }
-	STDMETHODIMP OnLeave(REFSENSOR_ID) override { return S_OK; }
+	STDMETHODIMP OnLeave(REFSENSOR_ID) override {
+		markLeft(); // released by the worker once no display is bound to it
+		return S_OK;
+	}
 
-	float    lux()     const { return lastLux_.load(std::memory_order_relaxed); }
-	bool     alive()   const { return alive_.load(std::memory_order_relaxed); }
+	bool     alive()   const override {
+		return alive_.load(std::memory_order_relaxed) && !left_.load(std::memory_order_relaxed);
+	}
+	uint32_t samples() const override { return samples_.load(std::memory_order_relaxed); }
+	bool     left()    const { return left_.load(); }
+	void     markLeft()      { left_.store(true); g_alsBindingsStale.store(true); }
+
+	// The driver may clamp the request to its own minimum; achievedHz() on the policy shows what we got.
+	void setReportInterval(uint32_t ms) override {
+		ComPtr<IPortableDeviceValues> params;
+		if (sensor && SUCCEEDED(CoCreateInstance(CLSID_PortableDeviceValues, nullptr, CLSCTX_INPROC_SERVER,
+		                                         IID_PPV_ARGS(&params)))) {
+			params->SetUnsignedIntegerValue(SENSOR_PROPERTY_CURRENT_REPORT_INTERVAL, ms);
+			sensor->SetProperties(params.Get(), nullptr);
+		}
+	}
 
+	SENSOR_ID id          = {};
 	GUID     containerId = {};
+	uint8_t  slot        = 0; // sensor index in the Timeline recording
 	ComPtr<ISensor> sensor;
 
 private:
 	LONG              refCount_;
-	std::atomic<float> lastLux_{100.f};
 	std::atomic<bool>  alive_{false};
+	std::atomic<bool>  left_{false};
+	std::atomic<uint32_t> samples_{0};
 };
 
 static std::vector<AlsSensorListener *> g_alsListeners;
-static std::mutex                       g_alsMutex;
+static ProfiledMutex                    g_alsMutex{"als"};
 static std::atomic<float>               g_lastKnownLux{100.f}; // last good lux; survives ALS re-init
 
-// Extract ContainerId from a sensor device path by looking up its parent chain.
-// The sensor path typically contains the HID instance ID which shares a ContainerId
-// with the display's USB composite device.
-static GUID getContainerIdFromDevicePath(const std::wstring &devPath) {
-	GUID cid = {};
-
-	if (!StrStrIW(devPath.c_str(), L"VID_05AC"))
-		return cid;
-
-	// Sensor device path: \\?\HID#VID_05AC&PID_xxxx&MI_08#inst#{guid}\{sub}
-	// Instance ID:         HID\VID_05AC&PID_xxxx&MI_08\inst
-	// Match by converting instId separators (\->#) and checking if it appears in devPath.
+// Sensor instance ID -> ContainerId, built with ONE SetupAPI walk of the sensor class and reused
+// for every sensor until the set of present sensors changes (a sensor arrives). The sensor path
+// typically contains the HID instance ID, which shares a ContainerId with the display's USB
+// composite device.
+//
+// Sensor device path: \\?\HID#VID_05AC&PID_xxxx&MI_08#inst#{guid}\{sub}
+// Instance ID:         HID\VID_05AC&PID_xxxx&MI_08\inst
+// Keys are stored with the instId separators converted (\->#) so they can be found in devPath.
+static std::vector<std::pair<std::wstring, GUID>> g_sensorCidIndex; // g_alsMutex
+static bool                                       g_sensorCidIndexStale = true;
+
+static void buildSensorContainerIndex() { // g_alsMutex held
 	static const GUID GUID_DEVCLASS_SENSOR = {0x5175D334, 0xC371, 0x4806,
 	                                           {0xB3, 0xBA, 0x71, 0xFD, 0x53, 0xC9, 0x25, 0x8D}};
+	auto t0 = nowMs();
+	g_sensorCidIndex.clear();
+	g_sensorCidIndexStale = false;
 
 	HDEVINFO set = SetupDiGetClassDevsW(&GUID_DEVCLASS_SENSOR, nullptr, 0, DIGCF_PRESENT);
-	if (set == INVALID_HANDLE_VALUE) return cid;
+	if (set == INVALID_HANDLE_VALUE) return;
 
 	SP_DEVINFO_DATA devInfo{sizeof(devInfo)};
 	for (DWORD i = 0; SetupDiEnumDeviceInfo(set, i, &devInfo); ++i) {
 		wchar_t instId[512] = {};
 		if (!SetupDiGetDeviceInstanceIdW(set, &devInfo, instId, 512, nullptr))
 			continue;
-
-		// Convert backslashes to # to match device path format
-		std::wstring normalized = instId;
-		for (auto &ch : normalized)
-			if (ch == L'\\') ch = L'#';
-
-		// Check if this instance ID matches the sensor device path
-		if (!StrStrIW(devPath.c_str(), normalized.c_str()))
+		if (!StrStrIW(instId, L"VID_05AC"))
 			continue;
 
+		GUID  cid  = {};
 		DWORD type = 0, size = 0;
 		SetupDiGetDevicePropertyW(set, &devInfo, &DEVPKEY_Device_ContainerId,
 		                          &type, nullptr, 0, &size, 0);
-		if (size == sizeof(GUID)) {
-			SetupDiGetDevicePropertyW(set, &devInfo, &DEVPKEY_Device_ContainerId,
-			                          &type, (PBYTE)&cid, sizeof(GUID), nullptr, 0);
-			break;
-		}
+		if (size != sizeof(GUID) ||
+		    !SetupDiGetDevicePropertyW(set, &devInfo, &DEVPKEY_Device_ContainerId,
+		                               &type, (PBYTE)&cid, sizeof(GUID), nullptr, 0))
+			continue;
+
+		std::wstring normalized = instId;
+		for (auto &ch : normalized)
+			if (ch == L'\\') ch = L'#';
+		g_sensorCidIndex.emplace_back(std::move(normalized), cid);
 	}
 
 	SetupDiDestroyDeviceInfoList(set);
-	return cid;
+	Log::Info(L"ALS: Sensor ContainerId index built in %.1f ms (%zu Apple sensor(s))",
+	          nowMs() - t0, g_sensorCidIndex.size());
+}
+
+// Look up the ContainerId of a sensor from its device path. g_alsMutex held.
+static GUID getContainerIdFromDevicePath(const std::wstring &devPath) {
+	if (!StrStrIW(devPath.c_str(), L"VID_05AC"))
+		return {};
+	if (g_sensorCidIndexStale)
+		buildSensorContainerIndex();
+	for (const auto &entry : g_sensorCidIndex)
+		if (StrStrIW(devPath.c_str(), entry.first.c_str()))
+			return entry.second;
+	return {};
+}
+
+static ComPtr<ISensorManager> g_sensorMgr;     // kept alive for the arrival events
+static uint8_t                g_alsNextSlot = 0; // Timeline slot of the next sensor
+
+// Bring up one ambient light sensor: resolve its ContainerId, register a listener, set the report
+// interval. g_alsMutex held. Skips a sensor that already has a live listener.
+static void addAlsSensor(ISensor *sensor) {
+	auto t0 = nowMs();
+	SENSOR_ID sid = {};
+	sensor->GetID(&sid);
+	for (auto *l : g_alsListeners)
+		if (!l->left() && l->id == sid)
+			return;
+
+	PROPVARIANT pv;
+	PropVariantInit(&pv);
+	std::wstring sensorInfo = L"(unknown)";
+	if (SUCCEEDED(sensor->GetProperty(SENSOR_PROPERTY_FRIENDLY_NAME, &pv))) {
+		if (pv.vt == VT_LPWSTR && pv.pwszVal)
+			sensorInfo = pv.pwszVal;
+	}
+	PropVariantClear(&pv);
+
+	// Try to get device path for ContainerId matching
+	GUID cid = {};
+	PropVariantInit(&pv);
+	if (SUCCEEDED(sensor->GetProperty(SENSOR_PROPERTY_DEVICE_PATH, &pv))) {
+		if (pv.vt == VT_LPWSTR && pv.pwszVal) {
+			std::wstring devPath = pv.pwszVal;
+			cid = getContainerIdFromDevicePath(devPath);
+			Log::Info(L"ALS: Sensor device path: %s", devPath.c_str());
+		}
+	}
+	PropVariantClear(&pv);
+
+	auto *listener        = new AlsSensorListener();
+	listener->sensor      = sensor;
+	listener->id          = sid;
+	listener->containerId = cid;
+	listener->slot        = g_alsNextSlot++;
+
+	HRESULT hr = sensor->SetEventSink(listener);
+	if (SUCCEEDED(hr)) {
+		// Start at the normal rate; tuneAlsSampling moves it from there
+		listener->setReportInterval(listener->sampling.applied);
+		Log::Info(L"ALS: Registered listener for sensor %u: %s (up in %.1f ms)",
+		          listener->slot, sensorInfo.c_str(), nowMs() - t0);
+		g_alsListeners.push_back(listener);
+		g_alsBindingsStale.store(true);
+	} else {
+		Log::Warn(L"ALS: SetEventSink failed for sensor %u (0x%08X)", listener->slot, hr);
+		listener->Release();
+	}
 }
 
+// Sensor arrivals. Departures come per sensor through AlsSensorListener::OnLeave.
+class AlsManagerEvents : public ISensorManagerEvents {
+public:
+	STDMETHODIMP QueryInterface(REFIID riid, void **ppv) override {
+		if (riid == IID_IUnknown || riid == __uuidof(ISensorManagerEvents)) {
+			*ppv = static_cast<ISensorManagerEvents *>(this);
+			AddRef();
+			return S_OK;
+		}
+		*ppv = nullptr;
+		return E_NOINTERFACE;
+	}
+	STDMETHODIMP_(ULONG) AddRef() override { return InterlockedIncrement(&refCount_); }
+	STDMETHODIMP_(ULONG) Release() override {
+		ULONG c = InterlockedDecrement(&refCount_);
+		if (c == 0) delete this;
+		return c;
+	}
+
+	STDMETHODIMP OnSensorEnter(ISensor *pSensor, SensorState) override {
+		SENSOR_TYPE_ID type = {};
+		if (!pSensor || FAILED(pSensor->GetType(&type)) || type != SENSOR_TYPE_AMBIENT_LIGHT)
+			return S_OK;
+		PROFILED_LOCK(g_alsMutex);
+		g_sensorCidIndexStale = true; // a new sensor device: its instance ID is not indexed yet
+		addAlsSensor(pSensor);
+		return S_OK;
+	}
+
+private:
+	LONG refCount_ = 1;
+};
+
+// Bring up every present sensor and subscribe to arrivals. Called once, on the worker (MTA).
 static void initAlsSensors() {
-	ComPtr<ISensorManager> mgr;
 	if (FAILED(CoCreateInstance(CLSID_SensorManager, nullptr, CLSCTX_INPROC_SERVER,
-	                            IID_PPV_ARGS(&mgr)))) {
+	                            IID_PPV_ARGS(&g_sensorMgr)))) {
 		Log::Warn(L"ALS: Failed to create SensorManager");
 		return;
 	}
+	auto *events = new AlsManagerEvents();
+	if (FAILED(g_sensorMgr->SetEventSink(events)))
+		Log::Warn(L"ALS: Sensor arrival events unavailable");
+	events->Release(); // the manager holds its own reference
 
 	ComPtr<ISensorCollection> col;
-	if (FAILED(mgr->GetSensorsByType(SENSOR_TYPE_AMBIENT_LIGHT, &col))) {
+	if (FAILED(g_sensorMgr->GetSensorsByType(SENSOR_TYPE_AMBIENT_LIGHT, &col))) {
 		Log::Info(L"ALS: No ambient light sensors found");
 		return;
 	}
@@ -395,202 +644,246 @@ static void initAlsSensors() {
 	col->GetCount(&count);
 	Log::Info(L"ALS: Found %lu ambient light sensor(s)", count);
 
-	std::lock_guard<std::mutex> lock(g_alsMutex);
-
+	PROFILED_LOCK(g_alsMutex);
 	for (ULONG i = 0; i < count; ++i) {
 		ComPtr<ISensor> sensor;
-		if (FAILED(col->GetAt(i, &sensor)))
-			continue;
-
-		// Get sensor ID for logging
-		SENSOR_ID sid = {};
-		sensor->GetID(&sid);
+		if (SUCCEEDED(col->GetAt(i, &sensor)))
+			addAlsSensor(sensor.Get());
+	}
+}
 
-		// Get device path for ContainerId correlation
-		PROPVARIANT pvPath;
-		PropVariantInit(&pvPath);
+// Reconcile the listeners with the sensors present now, touching only what changed: a sensor that
+// went stale across a display reconfiguration is dropped, a new one is brought up. Safety net for
+// the reconnect path in case an enter/leave event was missed; normally a no-op.
+static void syncAlsSensors() {
+	if (!g_sensorMgr)
+		return;
+	ComPtr<ISensorCollection> col;
+	ULONG count = 0;
+	if (FAILED(g_sensorMgr->GetSensorsByType(SENSOR_TYPE_AMBIENT_LIGHT, &col)) || !col)
+		count = 0;
+	else
+		col->GetCount(&count);
 
-		std::wstring sensorInfo = L"(unknown)";
-		if (SUCCEEDED(sensor->GetProperty(SENSOR_PROPERTY_FRIENDLY_NAME, &pvPath))) {
-			if (pvPath.vt == VT_LPWSTR && pvPath.pwszVal)
-				sensorInfo = pvPath.pwszVal;
+	std::vector<ComPtr<ISensor>> present;
+	std::vector<SENSOR_ID>       presentIds;
+	for (ULONG i = 0; i < count; ++i) {
+		ComPtr<ISensor> sensor;
+		SENSOR_ID       sid = {};
+		if (SUCCEEDED(col->GetAt(i, &sensor)) && SUCCEEDED(sensor->GetID(&sid))) {
+			present.push_back(sensor);
+			presentIds.push_back(sid);
 		}
-		PropVariantClear(&pvPath);
-
-		// Try to get device path for ContainerId matching
-		GUID cid = {};
-		PropVariantInit(&pvPath);
-		if (SUCCEEDED(sensor->GetProperty(SENSOR_PROPERTY_DEVICE_PATH, &pvPath))) {
-			if (pvPath.vt == VT_LPWSTR && pvPath.pwszVal) {
-				std::wstring devPath = pvPath.pwszVal;
-				cid = getContainerIdFromDevicePath(devPath);
-				Log::Info(L"ALS: Sensor %lu device path: %s", i, devPath.c_str());
-			}
+	}
+
+	PROFILED_LOCK(g_alsMutex);
+	for (auto *l : g_alsListeners)
+		if (!l->left() && std::find(presentIds.begin(), presentIds.end(), l->id) == presentIds.end()) {
+			Log::Info(L"ALS: Sensor %u is gone", l->slot);
+			l->markLeft();
 		}
-		PropVariantClear(&pvPath);
-
-		auto *listener       = new AlsSensorListener();
-		listener->sensor     = sensor;
-		listener->containerId = cid;
-
-		HRESULT hr = sensor->SetEventSink(listener);
-		if (SUCCEEDED(hr)) {
-			// Request ~500ms update interval
-			ComPtr<IPortableDeviceValues> params;
-			if (SUCCEEDED(CoCreateInstance(CLSID_PortableDeviceValues, nullptr,
-			                               CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&params)))) {
-				params->SetUnsignedIntegerValue(SENSOR_PROPERTY_CURRENT_REPORT_INTERVAL, 500);
-				sensor->SetProperties(params.Get(), nullptr);
+	for (size_t i = 0; i < present.size(); ++i) {
+		bool known = false;
+		for (auto *l : g_alsListeners)
+			if (!l->left() && l->id == presentIds[i]) {
+				known = true;
+				break;
 			}
-			Log::Info(L"ALS: Registered listener for sensor %lu: %s", i, sensorInfo.c_str());
-			g_alsListeners.push_back(listener);
-		} else {
-			Log::Warn(L"ALS: SetEventSink failed for sensor %lu (0x%08X)", i, hr);
-			listener->Release();
+		if (!known) {
+			g_sensorCidIndexStale = true; // rebuilt at most once for this whole batch
+			addAlsSensor(present[i].Get());
 		}
 	}
 }
 
-static void cleanupAlsSensors() {
-	std::lock_guard<std::mutex> lock(g_alsMutex);
-	for (auto *l : g_alsListeners) {
-		if (l->sensor)
-			l->sensor->SetEventSink(nullptr);
-		l->Release();
-	}
-	g_alsListeners.clear();
-}
-
-// Get lux from the best available sensor for a given display.
-// If the display has an ALS (matched by ContainerId), use it.
-// Otherwise use the master sensor (index 0 or user-selected).
-static float getAmbientLux(const DisplayDevice &dev) {
-	std::lock_guard<std::mutex> lock(g_alsMutex);
-
-	// Try to find a sensor matching this display's ContainerId
-	GUID zero = {};
+// Native HID lux readers for displays whose Sensor API ALS is unusable (Studio Display XDR), one
+// per ContainerId. Created and destroyed on the worker with g_displayMutex held.
+static std::vector<std::unique_ptr<HidLuxSource>> g_hidLux;
+
+// Resolve which sensor a display reads: the Sensor API sensor sharing its ContainerId (preferring
+// one that already delivers data), else a native HID reader on the same display, or none so the
+// reader falls back to g_alsMaster. g_alsMutex held.
+static void bindAlsSensor(DisplayDevice &dev) {
+	static const GUID zero = {};
+	AlsSensorListener *match = nullptr;
+	LuxSource         *bound = nullptr;
 	if (memcmp(&dev.containerId, &zero, sizeof(GUID)) != 0) {
 		for (auto *l : g_alsListeners) {
-			if (memcmp(&l->containerId, &dev.containerId, sizeof(GUID)) == 0 && l->alive()) {
-				float lx = l->lux();
-				g_lastKnownLux.store(lx, std::memory_order_relaxed);
-				return lx;
-			}
+			if (l->left() || memcmp(&l->containerId, &dev.containerId, sizeof(GUID)) != 0)
+				continue;
+			if (!match || (!match->alive() && l->alive()))
+				match = l;
 		}
+		bound = match;
+		if (!bound)
+			for (auto &h : g_hidLux)
+				if (memcmp(&h->containerId, &dev.containerId, sizeof(GUID)) == 0) {
+					bound = h.get();
+					break;
+				}
 	}
+	dev.luxSource.store(bound, std::memory_order_release);
+}
 
-	// Fallback: use first alive sensor (master)
-	for (auto *l : g_alsListeners) {
+// Start a native HID lux reader for a display the Sensor API has no sensor for. g_displayMutex held.
+static void openHidLuxSource(DisplayDevice &dev) {
+	static const GUID zero = {};
+	if (dev.luxSource.load() || memcmp(&dev.containerId, &zero, sizeof(GUID)) == 0)
+		return;
+	for (auto &h : g_hidLux)
+		if (memcmp(&h->containerId, &dev.containerId, sizeof(GUID)) == 0)
+			return;
+	auto src = HidLuxSource::Open(dev.containerId, [] { g_alsBindingsStale.store(true); });
+	if (!src)
+		return;
+	src->slot = (uint8_t)(0x80 + g_hidLux.size());
+	Log::Info(L"ALS: %s uses its native HID light sensor", dev.name.c_str());
+	dev.luxSource.store(src.get(), std::memory_order_release);
+	g_hidLux.push_back(std::move(src));
+}
+
+// Re-resolve the master sensor and every display's binding, then release the sensors that left
+// (nothing points at them any more). Called on the worker with g_displayMutex held, whenever the
+// sensor list or the display list changes.
+static void rebindAlsSensors() {
+	PROFILED_LOCK(g_alsMutex);
+	g_alsBindingsStale.store(false);
+	LuxSource *master = nullptr;
+	for (auto *l : g_alsListeners)
 		if (l->alive()) {
-			float lx = l->lux();
-			g_lastKnownLux.store(lx, std::memory_order_relaxed);
-			return lx;
+			master = l;
+			break;
 		}
+	for (size_t i = 0; !master && i < g_hidLux.size(); ++i)
+		if (g_hidLux[i]->alive())
+			master = g_hidLux[i].get();
+	g_alsMaster.store(master, std::memory_order_release);
+	for (auto &dev : g_displays)
+		bindAlsSensor(dev);
+
+	auto gone = std::stable_partition(g_alsListeners.begin(), g_alsListeners.end(),
+	                                  [](const AlsSensorListener *l) { return !l->left(); });
+	for (auto it = gone; it != g_alsListeners.end(); ++it) {
+		if ((*it)->sensor)
+			(*it)->sensor->SetEventSink(nullptr);
+		(*it)->Release();
 	}
-
-	// No live sensor yet (e.g. just after an ALS re-init): use the last known value, not a hard default.
-	return g_lastKnownLux.load(std::memory_order_relaxed);
-}
-
-/* ---------- mapping lux to brightness ---------- */
-static ULONG mapLuxToBrightness(float lux, const DisplayDevice &dev) {
-	float scale = std::clamp(lux, 2.f, 5000.f) / dev.baseLux;
-	float tgt   = dev.baseBrightness * scale;
-	return static_cast<ULONG>(std::clamp(tgt, (float)dev.minBrightness, (float)dev.maxBrightness));
+	g_alsListeners.erase(gone, g_alsListeners.end());
 }
 
-/* ---------- Central Brightness Setter ---------- */
-static void SetBrightness(DisplayDevice &dev, ULONG val, bool isUserAction, bool showOSD) {
-	if (g_hdrActive.load()) return;   // brightness writes are no-ops under HDR; Windows owns it
-	if (dev.activePresetLocksBrightness()) return; // reference modes fix brightness (macOS locks it too)
-	ULONG safeVal = std::clamp(val, dev.minBrightness, dev.maxBrightness);
-	if (safeVal != dev.currentBrightness) {
-		int rc = dev.setBrightness(safeVal);
-		if (rc != 0) {
-			Log::Warn(L"setBrightness failed on %s (rc=%d)", dev.name.c_str(), rc);
-			return;
-		}
-		dev.currentBrightness = safeVal;
-
-		if (isUserAction) {
-			dev.baseBrightness = safeVal;
-			if (safeVal != dev.minBrightness && safeVal != dev.maxBrightness)
-				dev.baseLux = getAmbientLux(dev);
-			// Stop any auto ramp and drop the hysteresis anchor so auto re-syncs to the user.
-			dev.rampDurationMs = 0.0;
-			dev.lastTargetLux  = 0.f;
+// Move each sensor's report interval with demand (see AlsSampling.h). A source is consumed when
+// auto-brightness is on, HDR is off and some adjustable display reads it, either through its own
+// binding or through the master fallback. Worker, g_displayMutex held.
+static void tuneAlsSampling() {
+	bool       autoOn = g_settings->autoAdjustEnabled && !g_hdrActive.load();
+	LuxSource *master = g_alsMaster.load(std::memory_order_acquire);
+	double     now    = nowMs();
+	auto tune = [&](LuxSource *src, uint8_t slot) {
+		bool consumed = false, ramp = false;
+		if (autoOn)
+			for (auto &dev : g_displays) {
+				if (dev.maxBrightness() <= dev.minBrightness() || dev.activePresetLocksBrightness())
+					continue;
+				LuxSource *b = dev.luxSource.load(std::memory_order_relaxed);
+				if (b != src && !(src == master && (!b || !b->alive())))
+					continue;
+				consumed = true;
+				ramp     = ramp || dev.ramp().active();
+			}
+		uint32_t ms = src->sampling.update(now, src->lux(), src->samples(), consumed, ramp);
+		if (ms != src->sampling.applied) {
+			Log::Info(L"ALS: sensor %u report interval %u -> %u ms (achieved %.2f Hz)", slot,
+			          src->sampling.applied, ms, src->sampling.achievedHz());
+			src->sampling.applied = ms;
+			src->setReportInterval(ms);
 		}
+	};
+	PROFILED_LOCK(g_alsMutex);
+	for (auto *l : g_alsListeners)
+		if (!l->left())
+			tune(l, l->slot);
+	for (auto &h : g_hidLux)
+		tune(h.get(), h->slot);
+}
 
-		if (showOSD && g_settings.showOSD)
-			OSDWindow::Show((int)dev.currentBrightness, (int)dev.maxBrightness);
+// Drop every listener (shutdown). Caller holds g_displayMutex: the bindings are cleared before the
+// listeners they point to are released, so no reader can see a dangling source.
+static void cleanupAlsSensors() {
+	g_alsMaster.store(nullptr);
+	for (auto &dev : g_displays)
+		dev.luxSource.store(nullptr);
+	g_hidLux.clear();
+	if (g_sensorMgr) {
+		g_sensorMgr->SetEventSink(nullptr);
+		g_sensorMgr.Reset();
+	}
+	PROFILED_LOCK(g_alsMutex);
+	for (auto *l : g_alsListeners) {
+		if (l->sensor)
+			l->sensor->SetEventSink(nullptr);
+		l->Release();
 	}
+	g_alsListeners.clear();
 }
 
-// Map a brightness value from one display's range to another using nit calibration.
-// This ensures perceived brightness matches across displays with different nit ceilings.
-static ULONG mapBrightnessAcrossDisplays(ULONG val, const DisplayDevice &from, const DisplayDevice &to) {
-	if (from.maxNits == to.maxNits && from.maxBrightness == to.maxBrightness && from.minBrightness == to.minBrightness)
-		return val;
-	float fromRange = (float)(from.maxBrightness - from.minBrightness);
-	if (fromRange <= 0.f) return val;
-	float pct  = (float)(val - from.minBrightness) / fromRange;
-	float nits = pct * from.maxNits;
-	float toPct = std::clamp(nits / to.maxNits, 0.f, 1.f);
-	return to.minBrightness + (ULONG)(toPct * (float)(to.maxBrightness - to.minBrightness));
+// Get lux from the best available sensor for a given display: its bound sensor (matched by
+// ContainerId) if that one is live, otherwise the master sensor. Lock-free: the binding is resolved
+// ahead of time by rebindAlsSensors, so this is a couple of atomic loads per call. `predicted`
+// returns the trend-extrapolated value instead (LuxPredictor.h); the fallback is the same.
+static float getAmbientLux(const DisplayDevice &dev, bool predicted = false) {
+	return resolveAmbientLux(dev.luxSource, g_alsMaster, g_lastKnownLux, predicted);
 }
 
-// Apply brightness to all connected displays (linked mode, proportional nit mapping)
-static void SetBrightnessLinked(ULONG val, const DisplayDevice &refDev, bool isUserAction, bool showOSD) {
-	for (auto &dev : g_displays) {
-		ULONG mapped = mapBrightnessAcrossDisplays(val, refDev, dev);
-		SetBrightness(dev, mapped, isUserAction, showOSD);
-	}
+/* ---------- Central Brightness Setter ---------- */
+// Position of a connected display in g_displays, as recorded in the Timeline (0xFF = not listed).
+static uint8_t displaySlot(const BrightnessDisplay &dev) {
+	size_t i = (size_t)(static_cast<const DisplayDevice *>(&dev) - g_displays.data());
+	return i < g_displays.size() ? (uint8_t)i : 0xFF;
 }
 
+// The app around the brightness policy (BrightnessCore.h): HDR, sensors, timeline, log, OSD.
+class AppBrightnessHost : public BrightnessHost {
+public:
+	bool  writesSuspended() override { return g_hdrActive.load(); }
+	float ambientLux(const BrightnessDisplay &dev, bool predicted) override {
+		return getAmbientLux(static_cast<const DisplayDevice &>(dev), predicted);
+	}
+	void userAction(const BrightnessDisplay &dev, uint32_t val) override { Timeline::User(displaySlot(dev), val); }
+	void written(const BrightnessDisplay &dev, uint32_t val) override {
+		Timeline::Write(displaySlot(dev), val);
+		saveDisplayState(static_cast<const DisplayDevice &>(dev));
+	}
+	void writeFailed(const BrightnessDisplay &dev, int rc) override {
+		Log::Warn(L"setBrightness failed on %s (rc=%d)", static_cast<const DisplayDevice &>(dev).name.c_str(), rc);
+	}
+	void showOsd(const BrightnessDisplay &dev) override {
+		if (g_settings->showOSD)
+			OSDWindow::Show((int)dev.currentBrightness(), (int)dev.maxBrightness());
+	}
+	void linkedWritten(size_t displays, uint64_t skewUs) override {
+		g_mLinkedSkewUs.observe(skewUs);
+		if (skewUs >= kVisibleSkewUs) // one 60 Hz frame: the panels visibly change one after the other
+			Log::Warn(L"Linked write: %zu displays changed %.1f ms apart", displays, skewUs / 1000.0);
+	}
+
+private:
+	static constexpr uint64_t kVisibleSkewUs = 16000;
+};
+static AppBrightnessHost g_brightnessHost;
+static BrightnessCore    g_brightness(g_brightnessHost); // g_displayMutex held for every call
+
 // Apply brightness change based on current mode (linked or single display)
 static void ApplyBrightness(ULONG val, bool isUserAction, bool showOSD) {
-	std::lock_guard<std::mutex> lock(g_displayMutex);
-	if (g_displays.empty()) return;
-
-	if (g_settings.linkedMode || g_displays.size() == 1) {
-		ULONG idx = std::min((ULONG)(g_displays.size() - 1), g_settings.activeDisplayIndex);
-		SetBrightnessLinked(val, g_displays[idx], isUserAction, showOSD);
-	} else {
-		ULONG idx = std::min((ULONG)(g_displays.size() - 1), g_settings.activeDisplayIndex);
-		SetBrightness(g_displays[idx], val, isUserAction, showOSD);
-	}
+	const SettingsValues &s = g_settings.snapshot();
+	PROFILED_LOCK(g_displayMutex);
+	g_brightness.ApplyBrightness(g_displays, s.activeDisplayIndex, s.linkedMode, val, isUserAction, showOSD);
 }
 
 /* ---------- helpers: brightness step ---------- */
 static void adjustBrightnessByStep(int direction) {
-	std::lock_guard<std::mutex> lock(g_displayMutex);
-	if (g_displays.empty()) return;
-
-	ULONG idx = std::min((ULONG)(g_displays.size() - 1), g_settings.activeDisplayIndex);
-	auto &ref = g_displays[idx];
-	ULONG step = (ref.maxBrightness - ref.minBrightness) / g_settings.brightnessSteps;
-	if (step < 1) step = 1;
-
-	ULONG newBrightness = ref.currentBrightness;
-	if (direction > 0) {
-		if (ref.currentBrightness < ref.maxBrightness) {
-			ULONG actualStep = std::min(step, ref.maxBrightness - ref.currentBrightness);
-			newBrightness    = ref.currentBrightness + actualStep;
-		}
-	} else if (direction < 0) {
-		if (ref.currentBrightness > ref.minBrightness) {
-			ULONG actualStep = std::min(step, ref.currentBrightness - ref.minBrightness);
-			newBrightness    = ref.currentBrightness - actualStep;
-		}
-	}
-
-	if (newBrightness != ref.currentBrightness) {
-		if (g_settings.linkedMode || g_displays.size() == 1) {
-			SetBrightnessLinked(newBrightness, ref, true, true);
-		} else {
-			SetBrightness(ref, newBrightness, true, true);
-		}
-	}
+	const SettingsValues &s = g_settings.snapshot();
+	PROFILED_LOCK(g_displayMutex);
+	g_brightness.adjustBrightnessByStep(g_displays, s.activeDisplayIndex, s.linkedMode, s.brightnessSteps, direction);
 }
 
 /* ---------- Options Dialog ---------- */
@@ -617,7 +910,8 @@ INT_PTR CALLBACK OptionsDlgProc(HWND d, UINT msg, WPARAM wp, LPARAM lp) {
 	UNREFERENCED_PARAMETER(lp);
 	switch (msg) {
 	case WM_INITDIALOG: {
-		CheckDlgButton(d, IDC_AUTO_BRIGHTNESS, g_settings.autoAdjustEnabled.load() ? BST_CHECKED : BST_UNCHECKED);
+		const SettingsValues &s = g_settings.snapshot();
+		CheckDlgButton(d, IDC_AUTO_BRIGHTNESS, s.autoAdjustEnabled ? BST_CHECKED : BST_UNCHECKED);
 		// Snapshot the active display's preset state once; the combo fill, the control
 		// disabling and the tooltips below all key off it.
 		bool hdrOn = g_hdrActive.load();
@@ -627,9 +921,9 @@ INT_PTR CALLBACK OptionsDlgProc(HWND d, UINT msg, WPARAM wp, LPARAM lp) {
 		bool have           = false;
 		bool lockBrightness = false;
 		{
-			std::lock_guard<std::mutex> lock(g_displayMutex);
+			PROFILED_LOCK(g_displayMutex);
 			if (!g_displays.empty()) {
-				ULONG idx      = std::min((ULONG)(g_displays.size() - 1), g_settings.activeDisplayIndex);
+				ULONG idx      = std::min((ULONG)(g_displays.size() - 1), (ULONG)s.activeDisplayIndex);
 				dispName       = g_displays[idx].name;
 				presetsCopy    = g_displays[idx].presets;
 				active         = g_displays[idx].activePresetIndex;
@@ -639,17 +933,20 @@ INT_PTR CALLBACK OptionsDlgProc(HWND d, UINT msg, WPARAM wp, LPARAM lp) {
 		}
 		// Auto-brightness is unavailable while Windows owns brightness (HDR) and while a
 		// reference-mode preset fixes it (macOS locks it there too).
-		if (hdrOn || lockBrightness)
+		if (hdrOn || lockBrightness) {
 			EnableWindow(GetDlgItem(d, IDC_AUTO_BRIGHTNESS), FALSE);
-		CheckDlgButton(d, IDC_SHOW_OSD, g_settings.showOSD ? BST_CHECKED : BST_UNCHECKED);
-		CheckDlgButton(d, IDC_RUN_AT_STARTUP, g_settings.runAtStartup ? BST_CHECKED : BST_UNCHECKED);
-		CheckDlgButton(d, IDC_ENABLE_HOTKEYS, g_settings.enableCustomHotkeys ? BST_CHECKED : BST_UNCHECKED);
-		EnableWindow(GetDlgItem(d, IDC_HOTKEY_UP), g_settings.enableCustomHotkeys);
-		EnableWindow(GetDlgItem(d, IDC_HOTKEY_DOWN), g_settings.enableCustomHotkeys);
-		setDlgHotkey(d, IDC_HOTKEY_UP, g_settings.hkUp);
-		setDlgHotkey(d, IDC_HOTKEY_DOWN, g_settings.hkDown);
+			EnableWindow(GetDlgItem(d, IDC_PREDICTIVE_ALS), FALSE);
+		}
+		CheckDlgButton(d, IDC_SHOW_OSD, s.showOSD ? BST_CHECKED : BST_UNCHECKED);
+		CheckDlgButton(d, IDC_PREDICTIVE_ALS, s.predictiveAls ? BST_CHECKED : BST_UNCHECKED);
+		CheckDlgButton(d, IDC_RUN_AT_STARTUP, s.runAtStartup ? BST_CHECKED : BST_UNCHECKED);
+		CheckDlgButton(d, IDC_ENABLE_HOTKEYS, s.enableCustomHotkeys ? BST_CHECKED : BST_UNCHECKED);
+		EnableWindow(GetDlgItem(d, IDC_HOTKEY_UP), s.enableCustomHotkeys);
+		EnableWindow(GetDlgItem(d, IDC_HOTKEY_DOWN), s.enableCustomHotkeys);
+		setDlgHotkey(d, IDC_HOTKEY_UP, s.hkUp);
+		setDlgHotkey(d, IDC_HOTKEY_DOWN, s.hkDown);
 		SendDlgItemMessageW(d, IDC_BRIGHTNESS_STEPS_SPIN, UDM_SETRANGE32, kMinBrightnessSteps, kMaxBrightnessSteps);
-		SendDlgItemMessageW(d, IDC_BRIGHTNESS_STEPS_SPIN, UDM_SETPOS32, 0, g_settings.brightnessSteps);
+		SendDlgItemMessageW(d, IDC_BRIGHTNESS_STEPS_SPIN, UDM_SETPOS32, 0, s.brightnessSteps);
 
 		// Color preset combo for the active display. Under HDR only the main "Apple XDR Display"
 		// presets stay listed (the only ones compatible with HDR): switching between those is
@@ -747,24 +1044,25 @@ INT_PTR CALLBACK OptionsDlgProc(HWND d, UINT msg, WPARAM wp, LPARAM lp) {
 			return TRUE;
 		}
 		if (id == IDOK) {
-			g_settings.autoAdjustEnabled.store(IsDlgButtonChecked(d, IDC_AUTO_BRIGHTNESS) == BST_CHECKED);
-			g_settings.showOSD            = (IsDlgButtonChecked(d, IDC_SHOW_OSD) == BST_CHECKED);
-			g_settings.runAtStartup        = (IsDlgButtonChecked(d, IDC_RUN_AT_STARTUP) == BST_CHECKED);
-			g_settings.enableCustomHotkeys = (IsDlgButtonChecked(d, IDC_ENABLE_HOTKEYS) == BST_CHECKED);
-			if (g_settings.enableCustomHotkeys) {
-				getDlgHotkey(d, IDC_HOTKEY_UP, g_settings.hkUp);
-				getDlgHotkey(d, IDC_HOTKEY_DOWN, g_settings.hkDown);
-			} else {
-				g_settings.hkUp   = {0, 0};
-				g_settings.hkDown = {0, 0};
-			}
+			ULONG steps = (ULONG)SendDlgItemMessageW(d, IDC_BRIGHTNESS_STEPS_SPIN, UDM_GETPOS32, 0, 0);
+			g_settings.Update([&](SettingsValues &v) {
+				v.autoAdjustEnabled   = IsDlgButtonChecked(d, IDC_AUTO_BRIGHTNESS) == BST_CHECKED;
+				v.showOSD             = IsDlgButtonChecked(d, IDC_SHOW_OSD) == BST_CHECKED;
+				v.predictiveAls       = IsDlgButtonChecked(d, IDC_PREDICTIVE_ALS) == BST_CHECKED;
+				v.runAtStartup        = IsDlgButtonChecked(d, IDC_RUN_AT_STARTUP) == BST_CHECKED;
+				v.enableCustomHotkeys = IsDlgButtonChecked(d, IDC_ENABLE_HOTKEYS) == BST_CHECKED;
+				if (v.enableCustomHotkeys) {
+					getDlgHotkey(d, IDC_HOTKEY_UP, v.hkUp);
+					getDlgHotkey(d, IDC_HOTKEY_DOWN, v.hkDown);
+				} else {
+					v.hkUp   = {0, 0};
+					v.hkDown = {0, 0};
+				}
+				v.brightnessSteps = std::clamp(steps, kMinBrightnessSteps, kMaxBrightnessSteps);
+			});
 			if (!registerHotkeys(g_hMain))
 				MessageBoxW(d, L"Failed to register one or more hotkeys.", L"StudioBrightnessPlusPlus", MB_ICONERROR);
-
-			ULONG steps            = (ULONG)SendDlgItemMessageW(d, IDC_BRIGHTNESS_STEPS_SPIN, UDM_GETPOS32, 0, 0);
-			g_settings.brightnessSteps = std::clamp(steps, kMinBrightnessSteps, kMaxBrightnessSteps);
-			g_settings.Save();
-			g_settings.SetStartup(g_settings.runAtStartup);
+			g_settings.SetStartup(g_settings->runAtStartup);
 
 			// Apply the chosen color preset to the active display, then prompt to keep or auto-revert.
 			// Not persisted: a preset resets to the default at startup, changed only by hand here.
@@ -777,15 +1075,15 @@ INT_PTR CALLBACK OptionsDlgProc(HWND d, UINT msg, WPARAM wp, LPARAM lp) {
 					int  prevIdx  = -1;
 					bool switched = false;
 					{
-						std::lock_guard<std::mutex> lock(g_displayMutex);
+						PROFILED_LOCK(g_displayMutex);
 						if (!g_displays.empty()) {
-							ULONG idx = std::min((ULONG)(g_displays.size() - 1), g_settings.activeDisplayIndex);
+							ULONG idx = std::min((ULONG)(g_displays.size() - 1), (ULONG)g_settings->activeDisplayIndex);
 							auto &dev = g_displays[idx];
 							if (dev.hPreset != INVALID_HANDLE_VALUE && hwIdx != dev.activePresetIndex) {
 								prevIdx = dev.activePresetIndex;
-								// Log the intent BEFORE the write (the file log flushes per line):
-								// if this switch takes the GPU driver down, the log still shows
-								// exactly what ran.
+								// Log the intent and flush the file log BEFORE the write: if this
+								// switch takes the GPU driver down, the log still shows exactly
+								// what ran.
 								const ColorPreset *from  = dev.activePreset();
 								const wchar_t     *toName = L"?";
 								for (const auto &p : dev.presets)
@@ -793,9 +1091,11 @@ INT_PTR CALLBACK OptionsDlgProc(HWND d, UINT msg, WPARAM wp, LPARAM lp) {
 								Log::Info(L"Switching color preset on %s: %d (%s) -> %d (%s), HDR=%d",
 								          dev.name.c_str(), prevIdx, from ? from->name.c_str() : L"?",
 								          hwIdx, toName, g_hdrActive.load() ? 1 : 0);
-								if (dev.setActivePreset(hwIdx) == 0) {
+								Log::FlushFile();
+								if (dev.runTx(TxClass::Preset, [&] { return dev.setActivePreset(hwIdx); }) == 0) {
 									cid      = dev.containerId;
 									switched = true;
+									saveDisplayState(dev);
 								} else {
 									Log::Warn(L"Preset switch failed on %s", dev.name.c_str());
 								}
@@ -824,14 +1124,14 @@ INT_PTR CALLBACK OptionsDlgProc(HWND d, UINT msg, WPARAM wp, LPARAM lp) {
 
 /* ---------- helpers for tray menu display list ---------- */
 static bool activeDisplayPresetLocked() {
-	std::lock_guard<std::mutex> lock(g_displayMutex);
+	PROFILED_LOCK(g_displayMutex);
 	if (g_displays.empty()) return false;
-	ULONG idx = std::min((ULONG)(g_displays.size() - 1), g_settings.activeDisplayIndex);
+	ULONG idx = std::min((ULONG)(g_displays.size() - 1), (ULONG)g_settings->activeDisplayIndex);
 	return g_displays[idx].activePresetLocksBrightness();
 }
 
 static std::wstring buildDisplayStatusLine() {
-	std::lock_guard<std::mutex> lock(g_displayMutex);
+	PROFILED_LOCK(g_displayMutex);
 	if (g_displays.empty())
 		return L"\U0001F534 No Display Detected";
 
@@ -856,6 +1156,7 @@ LRESULT CALLBACK HiddenWndProc(HWND h, UINT m, WPARAM wParam, LPARAM lParam) {
 		return 0;
 	}
 	if (m == WM_HOTKEY) {
+		TRACE_SCOPE("ui.WM_HOTKEY");
 		if (wParam == ID_HOTKEY_UP) {
 			adjustBrightnessByStep(+1);
 			return 0;
@@ -866,6 +1167,7 @@ LRESULT CALLBACK HiddenWndProc(HWND h, UINT m, WPARAM wParam, LPARAM lParam) {
 		}
 	}
 	if (m == WM_INPUT) {
+		TRACE_SCOPE("ui.WM_INPUT");
 		UINT dwSize = 0;
 		GetRawInputData((HRAWINPUT)lParam, RID_INPUT, nullptr, &dwSize, sizeof(RAWINPUTHEADER));
 		if (dwSize) {
@@ -895,7 +1197,7 @@ LRESULT CALLBACK HiddenWndProc(HWND h, UINT m, WPARAM wParam, LPARAM lParam) {
 		} else if (g_updateAvailable.load()) {
 			std::wstring v;
 			{
-				std::lock_guard<std::mutex> lk(g_updateMutex);
+				PROFILED_LOCK(g_updateMutex);
 				v = g_updateInfo.version;
 			}
 			std::wstring text = L"Version " + v + L" is available. Click here to install.";
@@ -915,6 +1217,7 @@ LRESULT CALLBACK HiddenWndProc(HWND h, UINT m, WPARAM wParam, LPARAM lParam) {
 	}
 	if (m == WMAPP_NOTIFYCALLBACK) {
 		if (LOWORD(lParam) == WM_LBUTTONUP) {
+			TRACE_SCOPE("ui.trayClick");
 			if (g_hdrActive.load()) {
 				TrayPopup::Show(h, 0, nullptr, true, L"Brightness controlled by Windows (HDR)");
 				return 0;
@@ -924,16 +1227,16 @@ LRESULT CALLBACK HiddenWndProc(HWND h, UINT m, WPARAM wParam, LPARAM lParam) {
 			ULONG refMax = 60000;
 			bool  locked = false;
 			{
-				std::lock_guard<std::mutex> lock(g_displayMutex);
+				PROFILED_LOCK(g_displayMutex);
 				if (g_displays.empty()) return 0;
-				ULONG idx = std::min((ULONG)(g_displays.size() - 1), g_settings.activeDisplayIndex);
+				ULONG idx = std::min((ULONG)(g_displays.size() - 1), (ULONG)g_settings->activeDisplayIndex);
 				auto &ref = g_displays[idx];
 				locked = ref.activePresetLocksBrightness();
-				int range = ref.maxBrightness - ref.minBrightness;
+				int range = ref.maxBrightness() - ref.minBrightness();
 				if (range <= 0) range = 1;
-				pct    = (int)((float)(ref.currentBrightness - ref.minBrightness) / (float)range * 100.0f);
-				refMin = ref.minBrightness;
-				refMax = ref.maxBrightness;
+				pct    = (int)((float)(ref.currentBrightness() - ref.minBrightness()) / (float)range * 100.0f);
+				refMin = ref.minBrightness();
+				refMax = ref.maxBrightness();
 			}
 			if (locked) { // reference-mode preset: brightness is fixed (macOS locks it there too)
 				TrayPopup::Show(h, 0, nullptr, true, L"Brightness fixed by the color preset");
@@ -961,26 +1264,29 @@ LRESULT CALLBACK HiddenWndProc(HWND h, UINT m, WPARAM wParam, LPARAM lParam) {
 
 			// Display list with selection (only when multiple)
 			{
-				std::lock_guard<std::mutex> lock(g_displayMutex);
+				PROFILED_LOCK(g_displayMutex);
 				if (g_displays.size() > 1) {
-					ULONG activeIdx = std::min((ULONG)(g_displays.size() - 1), g_settings.activeDisplayIndex);
-					for (size_t i = 0; i < g_displays.size(); ++i) {
+					const SettingsValues &s = g_settings.snapshot();
+					bool  linked    = s.linkedMode;
+					ULONG activeIdx = std::min((ULONG)(g_displays.size() - 1), (ULONG)s.activeDisplayIndex);
+					size_t shown = std::min(g_displays.size(), (size_t)(IDM_SELECT_DISPLAY_LAST - IDM_SELECT_DISPLAY + 1));
+					for (size_t i = 0; i < shown; ++i) {
 						std::wstring item = L"    \U0001F7E2 " + g_displays[i].name;
 						UINT flags = MF_STRING;
-						if (g_settings.linkedMode) {
+						if (linked) {
 							flags |= MF_CHECKED | MF_GRAYED;
 						} else {
 							flags |= (i == activeIdx) ? MF_CHECKED : MF_UNCHECKED;
 						}
 						AppendMenuW(hMenu, flags, IDM_SELECT_DISPLAY + i, item.c_str());
 					}
-					AppendMenuW(hMenu, MF_STRING | (g_settings.linkedMode ? MF_CHECKED : 0),
+					AppendMenuW(hMenu, MF_STRING | (linked ? MF_CHECKED : 0),
 					            IDM_LINKED_MODE, L"Linked Displays");
 				}
 			}
 
 			AppendMenuW(hMenu, MF_SEPARATOR, 0, nullptr);
-			UINT autoFlags = MF_STRING | (g_settings.autoAdjustEnabled.load() ? MF_CHECKED : 0u)
+			UINT autoFlags = MF_STRING | (g_settings->autoAdjustEnabled ? MF_CHECKED : 0u)
 			                 | ((g_hdrActive.load() || activeDisplayPresetLocked())
 			                        ? (UINT)(MF_GRAYED | MF_DISABLED) : 0u);
 			AppendMenuW(hMenu, autoFlags, IDM_TOGGLE_AUTO, L"Automatic Brightness");
@@ -989,7 +1295,7 @@ LRESULT CALLBACK HiddenWndProc(HWND h, UINT m, WPARAM wParam, LPARAM lParam) {
 			if (g_updateAvailable.load()) {
 				std::wstring lbl;
 				{
-					std::lock_guard<std::mutex> lk(g_updateMutex);
+					PROFILED_LOCK(g_updateMutex);
 					lbl = L"Install update " + g_updateInfo.version;
 				}
 				AppendMenuW(hMenu, MF_STRING, IDM_INSTALL_UPDATE, lbl.c_str());
@@ -997,9 +1303,9 @@ LRESULT CALLBACK HiddenWndProc(HWND h, UINT m, WPARAM wParam, LPARAM lParam) {
 				AppendMenuW(hMenu, MF_STRING, IDM_CHECK_UPDATE, L"Check update");
 			}
 			HMENU hChannel = CreatePopupMenu();
-			AppendMenuW(hChannel, MF_STRING | (g_settings.updateChannel == 0 ? MF_CHECKED : 0),
+			AppendMenuW(hChannel, MF_STRING | (g_settings->updateChannel == 0 ? MF_CHECKED : 0),
 			            IDM_CHANNEL_STABLE, L"Stable only");
-			AppendMenuW(hChannel, MF_STRING | (g_settings.updateChannel == 1 ? MF_CHECKED : 0),
+			AppendMenuW(hChannel, MF_STRING | (g_settings->updateChannel == 1 ? MF_CHECKED : 0),
 			            IDM_CHANNEL_BETA, L"Include betas");
 			AppendMenuW(hMenu, MF_POPUP, (UINT_PTR)hChannel, L"Update channel");
 			wchar_t versionLabel[40];
@@ -1014,15 +1320,13 @@ LRESULT CALLBACK HiddenWndProc(HWND h, UINT m, WPARAM wParam, LPARAM lParam) {
 			int cmd = TrackPopupMenu(hMenu, TPM_RETURNCMD | TPM_NONOTIFY, pt.x, pt.y, 0, h, nullptr);
 			DestroyMenu(hMenu);
 
+			TRACE_SCOPE("ui.menuCommand"); // after the menu closes: the time it was open is the user's
 			if (cmd == IDM_TOGGLE_AUTO) {
-				g_settings.autoAdjustEnabled.store(!g_settings.autoAdjustEnabled.load());
-				g_settings.Save();
+				g_settings.Update([](SettingsValues &v) { v.autoAdjustEnabled = !v.autoAdjustEnabled; });
 			} else if (cmd == IDM_LINKED_MODE) {
-				g_settings.linkedMode = !g_settings.linkedMode;
-				g_settings.Save();
-			} else if (cmd >= IDM_SELECT_DISPLAY && cmd < IDM_SELECT_DISPLAY + 16) {
-				g_settings.activeDisplayIndex = (ULONG)(cmd - IDM_SELECT_DISPLAY);
-				g_settings.Save();
+				g_settings.Update([](SettingsValues &v) { v.linkedMode = !v.linkedMode; });
+			} else if (cmd >= IDM_SELECT_DISPLAY && cmd <= IDM_SELECT_DISPLAY_LAST) {
+				g_settings.Update([&](SettingsValues &v) { v.activeDisplayIndex = (uint32_t)(cmd - IDM_SELECT_DISPLAY); });
 			} else if (cmd == IDM_OPTIONS) {
 				DialogBoxParamW(g_hInst, MAKEINTRESOURCE(IDD_OPTIONS), h, OptionsDlgProc, 0);
 			} else if (cmd == IDM_SHOW_LOGS) {
@@ -1032,11 +1336,9 @@ LRESULT CALLBACK HiddenWndProc(HWND h, UINT m, WPARAM wParam, LPARAM lParam) {
 			} else if (cmd == IDM_INSTALL_UPDATE) {
 				StartUpdateInstall();
 			} else if (cmd == IDM_CHANNEL_STABLE) {
-				g_settings.updateChannel = 0;
-				g_settings.Save();
+				g_settings.Update([](SettingsValues &v) { v.updateChannel = 0; });
 			} else if (cmd == IDM_CHANNEL_BETA) {
-				g_settings.updateChannel = 1;
-				g_settings.Save();
+				g_settings.Update([](SettingsValues &v) { v.updateChannel = 1; });
 			} else if (cmd == IDM_EXIT) {
 				PostMessage(h, WM_CLOSE, 0, 0);
 			}
@@ -1044,9 +1346,13 @@ LRESULT CALLBACK HiddenWndProc(HWND h, UINT m, WPARAM wParam, LPARAM lParam) {
 		}
 	}
 	if (m == WM_DESTROY) {
-		cleanupAlsSensors();
+		Timeline::Flush(true); // the recording stays on (Settings) and restarts with the next launch
+		Log::FlushFile();
+		g_settings.Flush(); // a change made just before quitting is still on its way to the registry
+		g_metricsEndpoint.stop();
 		{
-			std::lock_guard<std::mutex> lock(g_displayMutex);
+			PROFILED_LOCK(g_displayMutex);
+			cleanupAlsSensors();
 			g_displays.clear(); // destructors close handles
 		}
 		DeleteNotificationIcon();
@@ -1079,6 +1385,7 @@ bool RegisterHiddenClass() {
 void startWorker() {
 	std::thread([] {
 		CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+		Trace::NameThread("worker");
 
 		// Initialize ALS sensors
 		initAlsSensors();
@@ -1088,33 +1395,68 @@ void startWorker() {
 		constexpr DWORD kEnumerateCooldownMs = 3000; // re-scan every 3s at most
 
 		for (;;) {
+			auto tickStart = std::chrono::steady_clock::now();
+			g_mWorkerTicks.add();
+			TRACE_SCOPE("worker.tick");
 			/* ---------- device (re)connection attempt ---------- */
 			{
-				std::lock_guard<std::mutex> lock(g_displayMutex);
+				PROFILED_LOCK(g_displayMutex);
 
-				// Check existing devices are still alive
+				// A sensor came alive or left since the last tick: re-resolve the display bindings
+				if (g_alsBindingsStale.load())
+					rebindAlsSensors();
+
+				// Check existing devices are still alive: a read posted on the display's queue behind
+				// anything the user asked for, and looked at on the next pass (never waited for here)
 				bool anyDead = false;
-				for (auto &dev : g_displays) {
-					ULONG tmp;
-					if (dev.getBrightness(&tmp) != 0) {
-						Log::Warn(L"Device %s disconnected", dev.name.c_str());
-						dev.close();
-						anyDead = true;
+				{
+					TRACE_SCOPE("worker.liveness");
+					for (auto &dev : g_displays) {
+						if (dev.readback && dev.readback->tx->done())
+							settleReadback(dev);
+						if (dev.probeTx && dev.probeTx->done()) {
+							int rc = dev.probeTx->result();
+							dev.probeTx.reset();
+							if (rc != 0 && rc != kTxCancelled) {
+								Log::Warn(L"Device %s disconnected", dev.name.c_str());
+								dev.close();
+								anyDead = true;
+								continue;
+							}
+						}
+						if (!dev.probeTx)
+							dev.probeTx = dev.tx->post(TxClass::Probe, [&dev] {
+								ULONG tmp;
+								return dev.getBrightness(&tmp);
+							});
 					}
 				}
 
-				// Remove dead devices
+				// Remove dead devices, then the native HID lux readers of displays that are gone
 				if (anyDead) {
 					g_displays.erase(
 					    std::remove_if(g_displays.begin(), g_displays.end(),
 					                   [](const DisplayDevice &d) { return !d.isOpen(); }),
 					    g_displays.end());
+					auto orphan = std::stable_partition(g_hidLux.begin(), g_hidLux.end(), [](const auto &h) {
+						for (const auto &d : g_displays)
+							if (memcmp(&d.containerId, &h->containerId, sizeof(GUID)) == 0)
+								return true;
+						return false;
+					});
+					if (orphan != g_hidLux.end()) {
+						std::vector<std::unique_ptr<HidLuxSource>> gone(std::make_move_iterator(orphan),
+						                                                 std::make_move_iterator(g_hidLux.end()));
+						g_hidLux.erase(orphan, g_hidLux.end());
+						rebindAlsSensors(); // the master may have been one of them
+					}
 				}
 
 				// Re-scan for new devices only when needed (empty or device lost)
 				DWORD now = GetTickCount();
 				bool needScan = g_displays.empty() || anyDead;
 				if (needScan && now - lastEnumerateTick >= kEnumerateCooldownMs) {
+					TRACE_SCOPE("worker.enumerate");
 					lastEnumerateTick = now;
 
 					auto found = hid_enumerate();
@@ -1132,22 +1474,35 @@ void startWorker() {
 						}
 
 						// Initialize new device. On a reconnect the old ISensor goes stale across the
-						// display reconfiguration, so re-bind the ALS to the freshly settled sensor
+						// display reconfiguration; the sensor leave/enter events normally handle that,
+						// and syncAlsSensors catches a missed one by re-binding only what changed
 						// (skip the first add: initAlsSensors already ran at worker startup).
 						if (firstAddDone) {
-							cleanupAlsSensors();
-							initAlsSensors();
+							syncAlsSensors();
+							rebindAlsSensors();
 						}
 						firstAddDone = true;
 
-						newDev.getBrightnessRange(&newDev.minBrightness, &newDev.maxBrightness);
-						if (newDev.getBrightness(&newDev.currentBrightness) == 0) {
-							newDev.baseBrightness = newDev.currentBrightness;
-							newDev.baseLux = getAmbientLux(newDev);
+						ULONG minB = newDev.minBrightness(), maxB = newDev.maxBrightness(), cur = 0;
+						newDev.getBrightnessRange(&minB, &maxB); // left as they were on failure
+						newDev.minBrightness() = minB;
+						newDev.maxBrightness() = maxB;
+						{
+							PROFILED_LOCK(g_alsMutex);
+							bindAlsSensor(newDev);
 						}
-						Log::Info(L"Device %s ready [range %lu-%lu, current %lu]",
-						          newDev.name.c_str(), newDev.minBrightness, newDev.maxBrightness,
-						          newDev.currentBrightness);
+						openHidLuxSource(newDev);
+						// From the saved state when it still fits (read back once the display is up),
+						// else from the device, anchoring auto-brightness at the current light.
+						bool restored = restoreDisplayState(newDev);
+						if (!restored && newDev.getBrightness(&cur) == 0) {
+							newDev.currentBrightness() = cur;
+							newDev.baseBrightness() = newDev.currentBrightness();
+							newDev.baseLux() = getAmbientLux(newDev);
+						}
+						Log::Info(L"Device %s ready [range %u-%u, current %u%s]",
+						          newDev.name.c_str(), newDev.minBrightness(), newDev.maxBrightness(),
+						          newDev.currentBrightness(), restored ? L", saved state" : L"");
 
 						// Color presets: enumerate ONCE per physical display (cached), reset to the default ONCE per run.
 						// Re-enumerating or re-restoring on every reconnect loops, because switching a
@@ -1162,67 +1517,56 @@ void startWorker() {
 								if (!newDev.presets.empty())
 									g_presetCache[cidKey] = newDev.presets;
 							}
-							newDev.getActivePreset(&newDev.activePresetIndex);
+							// On a reconnect within this run the saved index stands in for the read (the
+							// readback confirms it); the first time, the reset below needs the real one.
+							if (restored && g_presetRestored.count(cidKey))
+								newDev.setBrightnessLocked(newDev.activePresetLocksBrightness());
+							else
+								newDev.getActivePreset(&newDev.activePresetIndex);
 							if (g_presetRestored.insert(cidKey).second) { // once per run, per display
 								// Reset to the default reference mode (index 0) at startup if not already
 								// there. No persistence/restore of the user's choice; a preset is changed
 								// only by manual action, and this stops a saved preset from re-blanking
-								// some XDR units on every launch. Log first (the file log flushes per
-								// line) so a write that blanks the panel still shows in the log.
+								// some XDR units on every launch. Log and flush first so a write that
+								// blanks the panel still shows in the log.
 								if (!newDev.presets.empty() && newDev.activePresetIndex != 0) {
 									Log::Info(L"Startup: resetting %s to its default color preset (was %d)",
 									          newDev.name.c_str(), newDev.activePresetIndex);
+									Log::FlushFile();
 									if (newDev.setActivePreset(0) != 0)
 										Log::Warn(L"Default preset reset failed on %s", newDev.name.c_str());
 								}
 							}
 						}
 
+						newDev.tx = std::make_unique<DeviceScheduler>();
+						g_brightness.attach(newDev); // the mark moves with the slot
 						g_displays.push_back(std::move(newDev));
+						DisplayDevice &added = g_displays.back();
+						saveDisplayState(added);
+						if (restored)
+							postReadback(added); // after the move: the transaction holds on to the device
 					}
 				}
 			}
 
 			/* ---------- auto-brightness (Apple-style hysteresis + asymmetric perceptual ramp) ---------- */
-			if (g_settings.autoAdjustEnabled.load()) {
-				std::lock_guard<std::mutex> lock(g_displayMutex);
-				for (auto &dev : g_displays) {
-					if (dev.maxBrightness <= dev.minBrightness)
-						continue; // brightness locked (e.g. a calibrated color preset); nothing to adjust
-					if (dev.activePresetLocksBrightness())
-						continue; // reference mode active: brightness is fixed (macOS parity)
-					float lux = getAmbientLux(dev); // per-device, ContainerId-matched sensor
-
-					bool retarget = (dev.lastTargetLux <= 0.f) ||
-					                (std::fabs(lux - dev.lastTargetLux) / dev.lastTargetLux >= kRelLuxHysteresis);
-					if (retarget) {
-						ULONG goal = mapLuxToBrightness(lux, dev);
-						if (goal != dev.rampGoal || dev.rampDurationMs == 0.0) {
-							dev.rampStart      = dev.currentBrightness;
-							dev.rampGoal       = goal;
-							dev.rampStartMs    = nowMs();
-							dev.rampDurationMs = (goal >= dev.currentBrightness) ? kRampBrightenMs : kRampDimMs;
-						}
-						dev.lastTargetLux = lux;
-					}
-
-					if (dev.rampDurationMs > 0.0) {
-						double t = (nowMs() - dev.rampStartMs) / dev.rampDurationMs;
-						if (t >= 1.0) {
-							if (dev.currentBrightness != dev.rampGoal)
-								SetBrightness(dev, dev.rampGoal, false, false);
-							dev.rampDurationMs = 0.0;
-						} else {
-							if (t < 0.0) t = 0.0;
-							double a = brightToPerc(dev.rampStart), b = brightToPerc(dev.rampGoal);
-							ULONG  next = percToBright(a + t * (b - a));
-							next = std::clamp(next, dev.minBrightness, dev.maxBrightness);
-							if (next != dev.currentBrightness)
-								SetBrightness(dev, next, false, false);
-						}
-					}
-				}
+			if (g_settings->autoAdjustEnabled) {
+				PROFILED_LOCK(g_displayMutex);
+				TRACE_SCOPE("worker.autoBrightness");
+				auto tick = g_brightness.autoBrightnessTick(nowMs(), g_settings->predictiveAls);
+				g_mRampSteps.add(tick.steps);
+				g_mRampsStarted.add(tick.rampsStarted);
+			}
+			{
+				PROFILED_LOCK(g_displayMutex);
+				TRACE_SCOPE("worker.tuneAlsSampling");
+				tuneAlsSampling();
+				g_mDisplays.set((int64_t)g_displays.size());
 			}
+			Timeline::Flush();
+			g_mWorkerTickUs.observe((uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+			                            std::chrono::steady_clock::now() - tickStart).count());
 			std::this_thread::sleep_for(std::chrono::milliseconds(100));
 		}
 	}).detach();
@@ -1241,19 +1585,27 @@ int APIENTRY wWinMain(HINSTANCE hInst, HINSTANCE, PWSTR, int) {
 
 	CoInitializeEx(nullptr, COINIT_APARTMENTTHREADED | COINIT_DISABLE_OLE1DDE);
 	g_hInst = hInst;
+	Trace::NameThread("ui");
 	INITCOMMONCONTROLSEX icc{sizeof(icc), ICC_WIN95_CLASSES};
 	InitCommonControlsEx(&icc);
 
 	g_settings.Load();
 	bool realStartup = g_settings.IsStartupEnabled();
-	if (g_settings.runAtStartup != realStartup) {
+	if (g_settings->runAtStartup != realStartup) {
 		// Sync the Run key with the saved preference: rewrite the (now path-checked) entry if we
 		// should auto-start, or remove a stale/leftover entry if we shouldn't.
-		g_settings.SetStartup(g_settings.runAtStartup);
+		g_settings.SetStartup(g_settings->runAtStartup);
 	}
 
+	Log::SetDurable(g_settings->logSurviveReset);
 	Log::ResumeIfPending();   // resume a file-log session that was still running before a restart
 	Log::Info(L"Studio Brightness++ v%s starting", kAppVersion);
+	if (!g_stateFile.open(displayStatePath()))
+		Log::Warn(L"Display state file unavailable: every display is read at connect");
+	if (g_settings->recordTimeline)
+		Timeline::Start();
+	if (!g_metricsEndpoint.start())
+		Log::Warn(L"Metrics endpoint unavailable");
 
 	if (!RegisterHiddenClass()) {
 		CloseHandle(hSingleInstance);
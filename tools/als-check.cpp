@@ -0,0 +1,297 @@
+// als-check: checks the ambient light pieces the app builds on, against fake sources and synthetic
+// data, on any platform.
+//
+//   als-check --binding    resolveAmbientLux (include/LuxSource.h): the bound source, then the
+//                          master, then the last known value; and reads that never wait on the lock
+//                          the bindings are changed under
+//   als-check --hid        HidAlsLayout (include/HidAlsReport.h) on synthetic reports shaped like the
+//                          Studio Display XDR's MI_07 sensor collections: report-ID filter, bit
+//                          extraction, unit exponent and the raw-to-lux conversion
+//   als-check --sampling   AlsSamplingPolicy (include/AlsSampling.h) on synthetic timelines: idle,
+//                          fast on changing lux or a ramp, the hold, and the achieved rate
+//
+// Exit 1 on any failure.
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+#include "AlsSampling.h"
+#include "HidAlsReport.h"
+#include "LuxSource.h"
+
+using Clock = std::chrono::steady_clock;
+
+static bool g_fail = false;
+
+static void check(bool ok, const char *what) {
+	printf("%-4s %s\n", ok ? "ok" : "FAIL", what);
+	g_fail |= !ok;
+}
+
+/* ---------- binding ---------- */
+
+class FakeLuxSource : public LuxSource {
+public:
+	bool     alive() const override { return alive_.load(std::memory_order_relaxed); }
+	uint32_t samples() const override { return samples_; }
+	void     setReportInterval(uint32_t) override {}
+
+	void feed(double nowMs, float raw) {
+		deliver(nowMs, raw);
+		++samples_;
+		alive_.store(true, std::memory_order_relaxed);
+	}
+	void leave() { alive_.store(false, std::memory_order_relaxed); }
+
+private:
+	std::atomic<bool> alive_{false};
+	uint32_t          samples_ = 0;
+};
+
+static_assert(std::atomic<LuxSource *>::is_always_lock_free, "a binding must be read without a lock");
+static_assert(std::atomic<float>::is_always_lock_free, "lux must be read without a lock");
+
+static void binding() {
+	FakeLuxSource            own, other;
+	std::atomic<LuxSource *> bound{nullptr}, master{nullptr};
+	std::atomic<float>       lastKnown{100.f};
+	auto                     lux = [&](bool predicted = false) {
+		return resolveAmbientLux(bound, master, lastKnown, predicted);
+	};
+
+	check(lux() == 100.f, "nothing bound: the last known value");
+	own.feed(0, 400.f);
+	other.feed(0, 50.f);
+	bound.store(&own);
+	check(lux() == own.lux() && std::fabs(own.lux() - 400.f) < 1.f, "a live bound source is read");
+	master.store(&other);
+	check(lux() == own.lux(), "the bound source wins over the master");
+	for (double t = 100; t <= 2000; t += 100)
+		own.feed(t, 400.f * (float)std::exp2(t / 1000.0)); // rising: the prediction leads
+	check(lux(true) == own.predictedLux() && lux(true) > lux(false), "predicted reads the trend-extrapolated value");
+
+	own.leave();
+	check(lux() == other.lux(), "a bound source that left: the master");
+	bound.store(nullptr);
+	check(lux() == other.lux(), "no bound source: the master");
+	float fromMaster = lux();
+	other.leave();
+	check(lux() == fromMaster && lastKnown.load() == fromMaster,
+	      "no live source: the last value read, not a default");
+	master.store(nullptr);
+	check(lux(true) == fromMaster, "predicted falls back the same way");
+
+	// The app rebinds with g_displayMutex held; the read path must not need it. A reader keeps
+	// resolving while another thread rebinds under the lock, and while the lock is held outright.
+	own.feed(3000, 200.f);
+	other.feed(3000, 800.f);
+	std::mutex            displayMutex;
+	std::atomic<bool>     stop{false};
+	std::atomic<uint64_t> reads{0}, strays{0};
+	std::thread           reader([&] {
+		while (!stop.load(std::memory_order_relaxed)) {
+			float lx = resolveAmbientLux(bound, master, lastKnown, false);
+			if (lx != own.lux() && lx != other.lux())
+				strays.fetch_add(1, std::memory_order_relaxed);
+			reads.fetch_add(1, std::memory_order_relaxed);
+		}
+	});
+	std::thread rebinder([&] {
+		for (int i = 0; !stop.load(std::memory_order_relaxed); ++i) {
+			std::lock_guard<std::mutex> lock(displayMutex);
+			bound.store(i & 1 ? &own : nullptr, std::memory_order_release);
+			master.store(i & 2 ? &own : &other, std::memory_order_release);
+		}
+	});
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	uint64_t held;
+	{
+		std::lock_guard<std::mutex> lock(displayMutex);
+		uint64_t before = reads.load();
+		auto     until  = Clock::now() + std::chrono::milliseconds(200);
+		while (Clock::now() < until && reads.load() < before + 1000)
+			std::this_thread::yield();
+		held = reads.load() - before;
+	}
+	stop = true;
+	reader.join();
+	rebinder.join();
+	printf("     %llu reads, %llu of them while the lock was held\n", (unsigned long long)reads.load(),
+	       (unsigned long long)held);
+	check(held >= 1000, "reads go on while the binding lock is held");
+	check(strays.load() == 0, "every read under rebinding is one of the bound sources");
+}
+
+/* ---------- hid ---------- */
+
+// Writes `value` into `size` bits at `offset`, little-endian, the way a device lays out a field.
+static void putBits(uint8_t *report, unsigned offset, unsigned size, uint64_t value) {
+	for (unsigned i = 0; i < size; ++i) {
+		unsigned bit = offset + i;
+		report[bit / 8] = (uint8_t)((report[bit / 8] & ~(1u << bit % 8)) | ((value >> i & 1) << bit % 8));
+	}
+}
+
+static HidAlsLayout layout(uint16_t page, uint16_t usage, uint8_t reportId, uint16_t bitOffset, uint16_t bitSize,
+                           uint32_t unitsExp) {
+	HidAlsLayout l;
+	l.page      = page;
+	l.usage     = usage;
+	l.reportId  = reportId;
+	l.bitOffset = bitOffset;
+	l.bitSize   = bitSize;
+	l.scale     = hidUnitScale(unitsExp);
+	return l;
+}
+
+static bool near(float a, float b) { return std::fabs(a - b) <= 1e-4f * std::fabs(b); }
+
+static void hid() {
+	check(hidUnitScale(0x0) == 1.f && hidUnitScale(0x2) == 100.f && near(hidUnitScale(0x7), 1e7f),
+	      "unit exponent 0x0-0x7: 10^0 to 10^7");
+	check(near(hidUnitScale(0xF), 0.1f) && near(hidUnitScale(0xE), 0.01f) && near(hidUnitScale(0x8), 1e-8f),
+	      "unit exponent 0x8-0xF: 10^-8 to 10^-1");
+	check(near(hidUnitScale(0x1E), 0.01f), "unit exponent: only the low nibble counts");
+
+	// MI_07&col01: 0x000F/0x0050, 16-bit, 0-20000; report 0x01, a status byte, then the value.
+	HidAlsLayout col01 = layout(0x000F, 0x0050, 0x01, 16, 16, 0x0);
+	uint8_t      r1[8] = {0x01, 0x5A};
+	putBits(r1, 16, 16, 20000);
+	uint32_t raw = 0;
+	check(col01.decode(r1, sizeof(r1), raw) && raw == 20000 && col01.lux(raw) == 20000.f,
+	      "0x000F/0x0050: 16-bit value, exponent 0: raw is lux");
+	uint8_t other[8] = {0x02, 0x5A};
+	putBits(other, 16, 16, 123);
+	check(!col01.decode(other, sizeof(other), raw), "another report ID on the collection is skipped");
+	check(!col01.decode(r1, 3, raw) && !col01.decode(r1, 0, raw), "a report too short for the field is skipped");
+
+	// MI_07&col02: 0x0020/0x030E, 32-bit; report 0x05, sensor state and event bytes first.
+	HidAlsLayout col02  = layout(0x0020, 0x030E, 0x05, 24, 32, 0xE); // centilux
+	uint8_t      r2[16] = {0x05, 0x02, 0x01};
+	putBits(r2, 24, 32, 123456);
+	check(col02.decode(r2, sizeof(r2), raw) && raw == 123456 && near(col02.lux(raw), 1234.56f),
+	      "0x0020/0x030E: 32-bit value, exponent 0xE: raw / 100");
+	putBits(r2, 24, 32, 0xFFFFFFFFu);
+	check(col02.decode(r2, sizeof(r2), raw) && raw == 0xFFFFFFFFu, "a 32-bit value keeps all its bits");
+	putBits(r2, 56, 8, 0xFF); // the next field: not part of the value
+	putBits(r2, 24, 32, 7);
+	check(col02.decode(r2, sizeof(r2), raw) && raw == 7, "neighbouring fields do not leak into the value");
+
+	// Fields that do not start on a byte, and a collection without report IDs (byte 0 is 0).
+	HidAlsLayout packed = layout(0x0020, 0x04D1, 0x00, 13, 12, 0x0);
+	uint8_t      r3[6]  = {};
+	putBits(r3, 8, 5, 0x1F);
+	putBits(r3, 13, 12, 0xABC);
+	putBits(r3, 25, 7, 0x7F);
+	check(packed.decode(r3, sizeof(r3), raw) && raw == 0xABC, "a 12-bit value at bit 13 is extracted exactly");
+	r3[0] = 0x01;
+	check(!packed.decode(r3, sizeof(r3), raw), "a collection without report IDs expects byte 0 to be 0");
+	HidAlsLayout bad = layout(0x0020, 0x04D1, 0x00, 8, 0, 0x0);
+	check(!bad.decode(r3, sizeof(r3), raw), "a layout without a value decodes nothing");
+}
+
+/* ---------- sampling ---------- */
+
+// A source that samples at whatever interval the policy last asked for, driven by the 100 ms worker
+// tick the way main.cpp drives it.
+struct SampledTimeline {
+	static constexpr double kTickMs = 100.0;
+
+	AlsSamplingPolicy policy;
+	double            nowMs    = 0.0;
+	double            nextMs   = 0.0; // next sample
+	uint32_t          samples  = 0;
+	uint32_t          interval = AlsSamplingPolicy::kNormalMs;
+
+	// Runs until `untilMs`; lux(t) is the light at time t. Returns the interval at the last tick.
+	template <class Lux>
+	uint32_t run(double untilMs, Lux &&lux, bool consumed = true, bool rampActive = false) {
+		for (; nowMs < untilMs; nowMs += kTickMs) {
+			if (nowMs >= nextMs) {
+				++samples;
+				nextMs = nowMs + interval;
+			}
+			interval = policy.update(nowMs, lux(nowMs), samples, consumed, rampActive);
+		}
+		return interval;
+	}
+};
+
+static void sampling() {
+	using P     = AlsSamplingPolicy;
+	auto steady = [](double) { return 300.f; };
+
+	{
+		SampledTimeline tl;
+		check(tl.run(1000, steady, false) == P::kIdleMs, "nothing consumes the source: kIdleMs");
+		check(tl.run(2000, [](double t) { return (float)(50.0 * std::exp2(t / 200.0)); }, false) == P::kIdleMs,
+		      "idle even while lux changes fast");
+		check(tl.run(3000, steady, false, true) == P::kIdleMs, "idle even with a ramp running");
+	}
+	{
+		SampledTimeline tl;
+		check(tl.run(5000, steady) == P::kNormalMs, "consumed, steady light: kNormalMs");
+
+		double rampEnd = tl.nowMs + 500;
+		check(tl.run(rampEnd, steady, true, true) == P::kFastMs, "a ramp running: kFastMs");
+		uint32_t held = tl.run(rampEnd + P::kFastHoldMs - SampledTimeline::kTickMs, steady);
+		check(held == P::kFastMs, "fast is held for kFastHoldMs after the ramp ends");
+		check(tl.run(rampEnd + P::kFastHoldMs + SampledTimeline::kTickMs, steady) == P::kNormalMs,
+		      "then back to kNormalMs");
+	}
+	{
+		// Daylight, then the blinds open: lux doubles twice within a second and settles.
+		SampledTimeline tl;
+		auto            blinds = [](double t) {
+			return t < 10000 ? 300.f : t < 11000 ? (float)(300.0 * std::exp2((t - 10000) / 500.0)) : 1200.f;
+		};
+		check(tl.run(10000, blinds) == P::kNormalMs, "before the change: kNormalMs");
+		bool   fast = false;
+		double lastTrigger = 0, backToNormal = 0;
+		while (tl.nowMs < 20000) {
+			uint32_t iv = tl.run(tl.nowMs + SampledTimeline::kTickMs, blinds);
+			fast |= iv == P::kFastMs;
+			if (tl.policy.changeRate() >= P::kFastRate)
+				lastTrigger = tl.nowMs - SampledTimeline::kTickMs;
+			if (iv == P::kNormalMs && fast && !backToNormal)
+				backToNormal = tl.nowMs - SampledTimeline::kTickMs;
+		}
+		printf("     lux change: fast until %.0f ms after the last fast sample\n", backToNormal - lastTrigger);
+		check(fast, "lux doubling within a second: kFastMs");
+		check(backToNormal >= lastTrigger + P::kFastHoldMs && backToNormal < lastTrigger + P::kFastHoldMs + 1000,
+		      "fast is held for kFastHoldMs after the light settles, then kNormalMs");
+	}
+	{
+		SampledTimeline tl;
+		tl.run(P::kRateWindow - SampledTimeline::kTickMs, steady);
+		check(tl.policy.achievedHz() == 0.0, "no achieved rate before a full window");
+		tl.run(P::kRateWindow + SampledTimeline::kTickMs, steady);
+		double normalHz = tl.policy.achievedHz();
+		tl.run(4 * P::kRateWindow, steady, false);
+		double idleHz = tl.policy.achievedHz();
+		tl.run(7 * P::kRateWindow, steady, true, true);
+		double fastHz = tl.policy.achievedHz();
+		printf("     achieved %.2f Hz at kNormalMs, %.2f Hz idle, %.2f Hz fast\n", normalHz, idleHz, fastHz);
+		check(std::fabs(normalHz - 1000.0 / P::kNormalMs) < 0.15, "achievedHz over a window at kNormalMs: 2 Hz");
+		check(std::fabs(idleHz - 1000.0 / P::kIdleMs) < 0.15, "achievedHz over a window at kIdleMs: 0.2 Hz");
+		check(std::fabs(fastHz - 1000.0 / P::kFastMs) < 0.15, "achievedHz over a window at kFastMs: 5 Hz");
+	}
+}
+
+int main(int argc, char **argv) {
+	if (argc > 1 && !strcmp(argv[1], "--binding"))
+		binding();
+	else if (argc > 1 && !strcmp(argv[1], "--hid"))
+		hid();
+	else if (argc > 1 && !strcmp(argv[1], "--sampling"))
+		sampling();
+	else {
+		fprintf(stderr, "usage: als-check --binding | --hid | --sampling\n");
+		return 2;
+	}
+	return g_fail ? 1 : 0;
+}
@@ -0,0 +1,303 @@
+// core-bench: micro-benchmarks of the operations the app runs most, against fake displays whose
+// writes cost nothing: what is left is our own code on the hot path, the part a profiler sees when
+// it is run under perf or a sanitizer on Linux.
+//
+//   SetBrightness                 one write to one display, reference-mode check included
+//   SetBrightnessLinked/N         the linked write across N = 1..8 displays, one after the other:
+//                                 the policy's own cost
+//   SetBrightnessLinked/N+lanes   the same through LinkedFanOut's threads, as the app does it: the
+//                                 handoff and the barrier (1/100 of the iterations; ~10 us each)
+//   mapBrightnessAcrossDisplays   the nit mapping between two displays' ranges
+//   autoBrightnessTick/N          one auto-brightness tick over N = 1, 8, 32 displays, as the
+//                                 worker runs it: the walk over DisplayStates, getAmbientLux
+//                                 through the bound sensor, the ramp, and the write when it steps
+//                                 (also per display: flat when the tick scales linearly)
+//   Log::Info, Log::Info+file     a typical line through Log::Store (collapse, site limit, ring),
+//                                 without and with the file log (UTF-8 into a mapped segment)
+//   allowsBrightness/presets      the reference-mode classification of a full XDR preset list (once
+//                                 per display per tick before brightnessLocked() was cached)
+//
+// Each benchmark runs 5 times and reports the median ns per operation. --json prints one object
+// instead of the table, for tracking the numbers across releases:
+//
+//   {"bench":"core-bench","iterations":N,"results":[{"name":"SetBrightness","ns_per_op":11.2},...]}
+//
+// (the tick results also carry "displays" and "ns_per_display")
+//
+//   core-bench [iterations] [--json]     (default 200000)
+#define _CRT_SECURE_NO_WARNINGS
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "BrightnessCore.h"
+#include "ColorPreset.h"
+#include "LogFile.h"
+#include "LogRecord.h"
+#include "LogSiteLimiter.h"
+#include "LuxSource.h"
+#include "ProfiledMutex.h"
+
+using Clock = std::chrono::steady_clock;
+
+#ifdef _MSC_VER
+#define BENCH_NOINLINE __declspec(noinline)
+#else
+#define BENCH_NOINLINE __attribute__((noinline))
+#endif
+
+// Keeps a result alive without the compiler folding the loop away.
+static volatile uint32_t g_sink;
+
+/* ---------- fakes ---------- */
+
+// The factory list of a Pro Display XDR: two general-use modes, the rest reference modes.
+static std::vector<ColorPreset> xdrPresets() {
+	const wchar_t *names[] = {
+	    L"Pro Display XDR (P3-1600 nits)", L"Apple Display (P3-500 nits)",  L"HDR Video (P3-ST 2084)",
+	    L"HDTV Video (BT.709-BT.1886)",    L"NTSC Video (BT.601 SMPTE-C)",  L"PAL & SECAM Video (BT.601 EBU)",
+	    L"Digital Cinema (P3-DCI)",        L"Digital Cinema (P3-D65)",      L"Design & Print (P3-D50)",
+	    L"Photography (P3-D65)",           L"Internet & Web (sRGB)",
+	};
+	std::vector<ColorPreset> list;
+	for (uint32_t i = 0; i < sizeof(names) / sizeof(names[0]); ++i)
+		list.push_back({i, names[i], L""});
+	return list;
+}
+
+class FakeLuxSource : public LuxSource {
+public:
+	bool     alive() const override { return true; }
+	uint32_t samples() const override { return samples_; }
+	void     setReportInterval(uint32_t) override {}
+	void     feed(double nowMs, float raw) {
+		deliver(nowMs, raw);
+		++samples_;
+	}
+
+private:
+	uint32_t samples_ = 0;
+};
+
+// A DisplayDevice without the HID handle: the same preset lock and sensor binding, free writes.
+struct FakeDisplay : BrightnessDisplay {
+	std::vector<ColorPreset> presets = xdrPresets();
+	int                      activePresetIndex = 0;
+	std::atomic<LuxSource *> luxSource{nullptr};
+	uint64_t                 writes = 0;
+
+	FakeDisplay() { setBrightnessLocked(presetLocksBrightness(presets, activePresetIndex)); }
+	FakeDisplay(FakeDisplay &&o) noexcept
+	    : BrightnessDisplay(std::move(o)), presets(std::move(o.presets)), activePresetIndex(o.activePresetIndex),
+	      luxSource(o.luxSource.load()), writes(o.writes) {}
+	int writeBrightness(uint32_t) override {
+		++writes;
+		return 0;
+	}
+};
+
+// getAmbientLux as the app resolves it: the bound sensor, else the master, else the last known.
+class FakeHost : public BrightnessHost {
+public:
+	std::atomic<LuxSource *> master{nullptr};
+	std::atomic<float>       lastKnownLux{100.f};
+
+	float ambientLux(const BrightnessDisplay &dev, bool predicted) override {
+		return resolveAmbientLux(static_cast<const FakeDisplay &>(dev).luxSource, master, lastKnownLux, predicted);
+	}
+};
+
+// Log::Record and Log::Store minus Win32: collapse, site limit, ring, and the file log line. The
+// tick advances past the limiter's refill span each line, so every line is stored (a loop logging
+// one site as fast as it can would measure suppression instead).
+class FakeLog {
+public:
+	explicit FakeLog(bool fileLog) {
+		if (!fileLog)
+			return;
+		file_.reset(new char[kLogFileBytes]);
+		writer_ = std::make_unique<LogFileWriter>(file_.get(), kTime, 0);
+	}
+	~FakeLog() { delete ring_; }
+
+	template <class... A>
+	BENCH_NOINLINE void info(const wchar_t *fmt, A... a) {
+		using R = LogRecord<A...>;
+		alignas(8) unsigned char data[LogRing::kMaxRecordBytes];
+		size_t bytes = R::size(a...);
+		R::pack(data, a...);
+		store(LogLevel::Info, fmt, &R::format, data, bytes);
+	}
+
+private:
+	static constexpr uint16_t kTime[7] = {2026, 1, 1, 0, 0, 0, 0};
+
+	void store(LogLevel level, const wchar_t *fmt, LogFormatFn fn, const void *data, size_t bytes) {
+		tick_ += LogSiteLimiter::kRefillMs;
+		PROFILED_LOCK(lock_);
+		uint32_t dropped = 0;
+		if (ring_->repeat(tick_, level, fmt, fn, data, bytes) || !limiter_.admit(fmt, tick_, dropped))
+			return;
+		LogView v = ring_->append(tick_, level, fmt, fn, data, bytes, dropped);
+		if (!writer_)
+			return;
+		wchar_t line[LogRing::kLineChars];
+		v.format(line, LogRing::kLineChars);
+		char   utf8[LogRing::kLineChars * 3];
+		size_t len = 0;
+		for (const wchar_t *p = line; *p; ++p) // the app's lines are ASCII; WideCharToMultiByte there
+			utf8[len++] = (char)*p;
+		if (!writer_->fits(len))
+			writer_ = std::make_unique<LogFileWriter>(file_.get(), kTime, 0);
+		writer_->write(kTime, (uint8_t)level, utf8, len);
+	}
+
+	ProfiledMutex                  lock_{"log"};
+	LogRing                       *ring_ = new LogRing(); // ~610 KB
+	LogSiteLimiter                 limiter_;
+	std::unique_ptr<char[]>        file_;
+	std::unique_ptr<LogFileWriter> writer_;
+	uint32_t                       tick_ = 0;
+};
+
+/* ---------- harness ---------- */
+
+struct Result {
+	std::string name;
+	double      nsPerOp;
+	size_t      displays = 0; // a per-tick result: the displays it covers
+};
+static std::vector<Result> g_results;
+static size_t              g_iterations = 200000;
+
+template <class F>
+static void run(const std::string &name, F &&body, size_t iterations = g_iterations) {
+	constexpr int kRuns = 5;
+	double        ns[kRuns];
+	iterations = std::max<size_t>(1, iterations);
+	for (int r = 0; r < kRuns; ++r) {
+		auto t0 = Clock::now();
+		for (size_t i = 0; i < iterations; ++i)
+			body(i);
+		ns[r] = std::chrono::duration<double, std::nano>(Clock::now() - t0).count() / (double)iterations;
+	}
+	std::sort(ns, ns + kRuns);
+	g_results.push_back({name, ns[kRuns / 2]});
+}
+
+/* ---------- benchmarks ---------- */
+
+static void benchBrightness() {
+	FakeHost                 host;
+	BrightnessCore           core(host);
+	std::vector<FakeDisplay> displays(8);
+	for (size_t i = 0; i < displays.size(); ++i)
+		displays[i].maxNits() = i % 3 == 0 ? 1600.f : i % 3 == 1 ? 600.f : 500.f;
+
+	run("SetBrightness", [&](size_t i) { core.SetBrightness(displays[0], i % 2 ? 20000 : 40000, false, false); });
+
+	auto linked = [&](size_t n, bool lanes) {
+		FakeDisplay *first = displays.data();
+		struct Span { // the first n displays, as the container SetBrightnessLinked walks
+			FakeDisplay *b, *e;
+			FakeDisplay *begin() { return b; }
+			FakeDisplay *end() { return e; }
+		} span{first, first + n};
+		core.setConcurrentLinked(lanes);
+		run("SetBrightnessLinked/" + std::to_string(n) + (lanes ? "+lanes" : ""),
+		    [&](size_t i) { core.SetBrightnessLinked(span, i % 2 ? 20000 : 40000, *first, false, false); },
+		    lanes ? g_iterations / 100 : g_iterations);
+	};
+	for (size_t n = 1; n <= displays.size(); ++n)
+		linked(n, false);
+	for (size_t n : {2, 4, 8})
+		linked(n, true);
+
+	run("mapBrightnessAcrossDisplays", [&](size_t i) {
+		g_sink = mapBrightnessAcrossDisplays(1000 + (uint32_t)(i % 59000), displays[0], displays[1]);
+	});
+}
+
+static void benchAutoTick() {
+	for (size_t n : {1, 8, 32}) {
+		FakeHost                 host;
+		BrightnessCore           core(host);
+		std::vector<FakeDisplay> displays(n);
+		FakeLuxSource            sensor;
+		sensor.feed(0, 100.f);
+		host.master.store(&sensor);
+		for (auto &dev : displays) {
+			dev.luxSource.store(&sensor);
+			core.attach(dev);
+		}
+
+		// A 10 Hz tick against a sensor reporting at 5 Hz, the room switching between two levels
+		// every 20 s, so part of the ticks ramp and write and the rest hold.
+		double t = 0;
+		run("autoBrightnessTick/" + std::to_string(n), [&](size_t i) {
+			t += 100;
+			if (i % 2 == 0)
+				sensor.feed(t, (i / 200) % 2 ? 400.f : 60.f);
+			core.autoBrightnessTick(t, false);
+		});
+		g_results.back().displays = n;
+	}
+}
+
+static void benchLog() {
+	for (bool fileLog : {false, true}) {
+		FakeLog log(fileLog);
+		run(fileLog ? "Log::Info+file" : "Log::Info", [&](size_t i) {
+			log.info(L"Brightness %u on %s (display %d)", (unsigned)(i % 60000), L"Pro Display XDR", (int)(i % 3));
+		});
+	}
+}
+
+static void benchPresets() {
+	std::vector<ColorPreset> presets = xdrPresets();
+	run("allowsBrightness/presets", [&](size_t i) {
+		g_sink = presetLocksBrightness(presets, (int)(i % presets.size()));
+	});
+}
+
+int main(int argc, char **argv) {
+	bool json = false;
+	for (int i = 1; i < argc; ++i) {
+		if (!strcmp(argv[i], "--json"))
+			json = true;
+		else
+			g_iterations = std::max<size_t>(1, (size_t)atoll(argv[i]));
+	}
+
+	benchBrightness();
+	benchAutoTick();
+	benchLog();
+	benchPresets();
+
+	if (json) {
+		printf("{\"bench\":\"core-bench\",\"iterations\":%zu,\"results\":[", g_iterations);
+		for (size_t i = 0; i < g_results.size(); ++i) {
+			const Result &r = g_results[i];
+			printf("%s{\"name\":\"%s\",\"ns_per_op\":%.2f", i ? "," : "", r.name.c_str(), r.nsPerOp);
+			if (r.displays)
+				printf(",\"displays\":%zu,\"ns_per_display\":%.2f", r.displays, r.nsPerOp / (double)r.displays);
+			printf("}");
+		}
+		printf("]}\n");
+		return 0;
+	}
+	printf("%zu iterations, median of 5 runs\n%-32s %10s %12s\n", g_iterations, "", "ns/op", "ns/display");
+	for (const auto &r : g_results) {
+		printf("%-32s %10.1f", r.name.c_str(), r.nsPerOp);
+		if (r.displays)
+			printf(" %12.1f", r.nsPerOp / (double)r.displays);
+		printf("\n");
+	}
+	return 0;
+}
@@ -0,0 +1,195 @@
+// display-state: lists the per-display records the app keeps across restarts and reconnects
+// (include/DisplayStateFile.h), and checks the store itself.
+//
+//   display-state <file>     one line per display (the app's file is
+//                            %LOCALAPPDATA%\StudioBrightnessPlusPlus\displays.sbstate)
+//   display-state --verify   round trip, reopen, torn and corrupt slots, reuse when full, and
+//                            readers against a writer (build with -fsanitize=thread to have the
+//                            race detector watch it); exit 1 on any failure
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <thread>
+#include <vector>
+
+#include "DisplayStateFile.h"
+
+using Clock = std::chrono::steady_clock;
+
+// A ContainerId the way Windows prints a GUID.
+static void printContainerId(const uint8_t (&id)[16]) {
+	uint32_t d1;
+	uint16_t d2, d3;
+	memcpy(&d1, id, 4);
+	memcpy(&d2, id + 4, 2);
+	memcpy(&d3, id + 6, 2);
+	printf("{%08X-%04X-%04X-%02X%02X-", d1, d2, d3, id[8], id[9]);
+	for (int i = 10; i < 16; ++i)
+		printf("%02X", id[i]);
+	printf("}");
+}
+
+static int list(const char *path) {
+	if (!std::filesystem::exists(path)) {
+		fprintf(stderr, "%s: no such file\n", path);
+		return 1;
+	}
+	DisplayStateFile file;
+	if (!file.open(path)) {
+		fprintf(stderr, "%s: cannot map\n", path);
+		return 1;
+	}
+	size_t n = file.forEach([](const DisplayState &s) {
+		printContainerId(s.containerId);
+		printf("  range %u-%u  current %u  anchor %u @ %.1f lux  cap %04X:%04X id 0x%02X len %u  preset %d\n", s.minB,
+		       s.maxB, s.current, s.base, s.baseLux, s.capPage, s.capUsage, s.capId, s.capLen, s.presetIndex);
+	});
+	printf("%zu display(s)\n", n);
+	return 0;
+}
+
+/* ---------- verify ---------- */
+
+static DisplayState makeState(uint32_t id, uint32_t v) {
+	DisplayState s = {};
+	memcpy(s.containerId, &id, sizeof(id));
+	s.containerId[15] = 0xA5;
+	s.minB            = 1000;
+	s.maxB            = 60000;
+	s.current         = v;
+	s.base            = v + 1;
+	s.baseLux         = (float)v * 0.5f;
+	s.capPage         = 0x0082;
+	s.capUsage        = 0x0010;
+	s.capLen          = 7;
+	s.capId           = 1;
+	s.presetIndex     = (int32_t)(v % 11);
+	return s;
+}
+
+// The ties makeState keeps; a record that breaks one was read half-written.
+static bool consistent(const DisplayState &s) {
+	return s.base == s.current + 1 && s.baseLux == (float)s.current * 0.5f && s.presetIndex == (int32_t)(s.current % 11);
+}
+
+static bool same(const DisplayState &a, const DisplayState &b) { return memcmp(&a, &b, sizeof(a)) == 0; }
+
+// Overwrites bytes of the file behind the mapping's back (a crash, a bad sector).
+static void poke(const std::filesystem::path &path, long offset, const void *bytes, size_t n) {
+	FILE *f = fopen(path.string().c_str(), "r+b");
+	fseek(f, offset, SEEK_SET);
+	fwrite(bytes, 1, n, f);
+	fclose(f);
+}
+
+static int verify() {
+	bool fail  = false;
+	auto check = [&](bool ok, const char *what) {
+		printf("%-4s %s\n", ok ? "ok" : "FAIL", what);
+		fail |= !ok;
+	};
+	auto path = std::filesystem::temp_directory_path() / "sbpp-display-state-verify.sbstate";
+	std::filesystem::remove(path);
+	constexpr long kSlot0 = sizeof(DisplayStateFileHeader);
+
+	{
+		DisplayStateFile file;
+		check(file.open(path) && file.forEach([](const DisplayState &) {}) == 0, "a new file opens empty");
+		bool ok = true;
+		for (uint32_t id = 1; id <= 3; ++id)
+			ok &= file.save(makeState(id, 20000 + id));
+		DisplayState got;
+		for (uint32_t id = 1; id <= 3; ++id)
+			ok &= file.load(makeState(id, 0).containerId, got) && same(got, makeState(id, 20000 + id));
+		check(ok, "saved records load back as saved");
+		file.save(makeState(2, 31000));
+		check(file.load(makeState(2, 0).containerId, got) && got.current == 31000 &&
+		          file.forEach([](const DisplayState &) {}) == 3,
+		      "a second save of a display replaces its record");
+		check(!file.load(makeState(9, 0).containerId, got), "an unknown display has no record");
+	}
+	{
+		DisplayStateFile file;
+		DisplayState     got;
+		check(file.open(path) && file.load(makeState(2, 0).containerId, got) && same(got, makeState(2, 31000)),
+		      "records survive closing and reopening");
+	}
+	{
+		uint32_t odd = 7; // slot 0 left mid-save by a crash
+		poke(path, kSlot0, &odd, sizeof(odd));
+		uint8_t flip = 0xFF; // slot 1's current brightness damaged on disk
+		poke(path, kSlot0 + 64 + 4 + 16 + 8, &flip, 1);
+		DisplayStateFile file;
+		DisplayState     got;
+		file.open(path);
+		check(!file.load(makeState(1, 0).containerId, got), "a slot torn by a crash is dropped on open");
+		check(!file.load(makeState(2, 0).containerId, got), "a record that fails its checksum is not loaded");
+		check(file.load(makeState(3, 0).containerId, got) && same(got, makeState(3, 20003)),
+		      "the other records are untouched");
+	}
+	{
+		poke(path, 0, "GARBAGE!", 8);
+		DisplayStateFile file;
+		check(file.open(path) && file.forEach([](const DisplayState &) {}) == 0, "a file that is not ours starts over");
+		for (uint32_t id = 1; id <= DisplayStateFile::kRecords + 5; ++id)
+			file.save(makeState(id, id));
+		DisplayState got;
+		bool         newest = true;
+		for (uint32_t id = 6; id <= DisplayStateFile::kRecords + 5; ++id)
+			newest &= file.load(makeState(id, 0).containerId, got);
+		check(file.forEach([](const DisplayState &) {}) == DisplayStateFile::kRecords && newest &&
+		          !file.load(makeState(1, 0).containerId, got) && !file.load(makeState(5, 0).containerId, got),
+		      "when full, the least recently saved records make room");
+	}
+	{
+		// One writer (the app saves under its display lock), readers in this process and through a
+		// second mapping of the same file, as another process would read it.
+		DisplayStateFile writer, other;
+		writer.open(path);
+		other.open(path);
+		constexpr uint32_t kSaves = 200000;
+		std::atomic<bool>     stop{false};
+		std::atomic<uint64_t> torn{0}, reads{0};
+		auto reader = [&](const DisplayStateFile &f) {
+			DisplayState got;
+			while (!stop.load(std::memory_order_relaxed)) {
+				for (uint32_t id = 1; id <= 4; ++id)
+					if (f.load(makeState(id, 0).containerId, got)) {
+						torn.fetch_add(!consistent(got), std::memory_order_relaxed);
+						reads.fetch_add(1, std::memory_order_relaxed);
+					}
+			}
+		};
+		std::thread r1(reader, std::cref(writer)), r2(reader, std::cref(other));
+		auto        t0 = Clock::now();
+		for (uint32_t i = 0; i < kSaves; ++i)
+			writer.save(makeState(1 + i % 4, 1000 + i));
+		double saveNs = std::chrono::duration<double, std::nano>(Clock::now() - t0).count() / kSaves;
+		stop          = true;
+		r1.join();
+		r2.join();
+		check(torn.load() == 0, "readers never see half a record while it is saved");
+
+		DisplayState got;
+		t0 = Clock::now();
+		for (uint32_t i = 0; i < 100000; ++i)
+			other.load(makeState(1 + i % 4, 0).containerId, got);
+		double loadNs = std::chrono::duration<double, std::nano>(Clock::now() - t0).count() / 100000;
+		check(got.current == 1000 + kSaves - 1 && consistent(got), "the other mapping sees the last save");
+		printf("     %llu concurrent reads; save %.0f ns, load %.0f ns (%zu slots)\n",
+		       (unsigned long long)reads.load(), saveNs, loadNs, DisplayStateFile::kRecords);
+	}
+	std::filesystem::remove(path);
+	return fail ? 1 : 0;
+}
+
+int main(int argc, char **argv) {
+	if (argc > 1 && !strcmp(argv[1], "--verify"))
+		return verify();
+	if (argc > 1)
+		return list(argv[1]);
+	fprintf(stderr, "usage: display-state <file> | --verify\n");
+	return 2;
+}
@@ -0,0 +1,563 @@
+// hotkey-latency-bench: time from a brightness hotkey to the feature write on the display, with the
+// worker loading the machine the way a busy one does. Pure C++, no Win32: simulated displays
+// stand in for the HID transport (each read and write blocks for a set time, as HidD_Get/SetFeature
+// does) and the threads lock the way src/main.cpp does:
+//
+//   - a UI thread takes injected steps from its queue (WM_HOTKEY / WM_INPUT) and runs
+//     adjustBrightnessByStep: g_displayMutex, then BrightnessCore's step and write to every
+//     linked display (concurrently, LinkedFanOut.h; --sequential for one after the other),
+//     logging each write
+//   - the worker ticks every 100 ms under g_displayMutex: a liveness read of every display, a
+//     re-enumeration when a display dropped (churn), and BrightnessCore's auto-brightness tick
+//   - logging goes to the file log (LogFileWriter into a 4 MB segment) under the log lock
+//   - every display has its DeviceScheduler, as in the app: user writes are User transactions,
+//     the liveness reads Probe and the ramp steps Ramp, both posted (--no-scheduler: every call
+//     made on the calling thread, under the lock, as before the scheduler)
+//
+// A display write is setBrightness's read-modify-write: a read (--read-us) then a write
+// (--write-us, or one per display: --write-us 2000,3500,5000 for panels on slower hubs).
+//
+// The latency of one step is from the injection to the moment the active display's write
+// completes; the skew of a linked step is from the first display's write completing to the last.
+// Prints percentiles of both and the schedulers' wait per class, or one JSON object with --json;
+// with --gate / --gate-skew it is a regression gate: exit 1 when the latency p99 / the skew p50 is
+// over the limit. (The skew's tail is the first writes, before the per-display send times are
+// known.)
+//
+// --verify instead checks the scheduler's rules against one slow display (priority order, a user
+// write cancelling the queued ramp step, ramp steps coalescing, the user's wait bounded by the one
+// transaction on the wire) and exits 1 on the first that does not hold.
+//
+//   hotkey-latency-bench [--seconds S] [--rate HZ] [--displays N] [--write-us US[,US...]]
+//                        [--read-us US] [--enum-ms MS] [--churn-ms MS] [--no-ramps] [--no-churn]
+//                        [--no-log] [--sequential] [--no-scheduler] [--json] [--gate P99_US]
+//                        [--gate-skew P50_US]
+//   hotkey-latency-bench --verify
+#define _CRT_SECURE_NO_WARNINGS
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BrightnessCore.h"
+#include "LogFile.h"
+#include "Metrics.h"
+#include "ProfiledMutex.h"
+
+using Clock = std::chrono::steady_clock;
+
+struct Config {
+	double           seconds    = 10;
+	double           rateHz     = 20; // hotkey steps per second
+	int              displays   = 3;
+	std::vector<int> writeUs    = {2000}; // one HidD_SetFeature, per display (the last one repeats)
+	int              readUs     = 800;    // one HidD_GetFeature
+	int              enumMs     = 120;    // one hid_enumerate (SetupAPI walk, opening every candidate)
+	int              churnMs    = 1500;   // a display drops this often (0 = never)
+	bool             ramps      = true;
+	bool             fileLog    = true;
+	bool             sequential = false;
+	bool             schedulers = true;
+	bool             json       = false;
+	bool             verify     = false;
+	uint64_t         gateP99Us  = 0;
+	uint64_t         gateSkewUs = 0;
+	uint32_t         steps      = 10; // g_settings.brightnessSteps
+};
+static Config g_cfg;
+
+static double nowMs() {
+	return std::chrono::duration<double, std::milli>(Clock::now().time_since_epoch()).count();
+}
+
+static void blockFor(int us) {
+	std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+/* ---------- simulated transport ---------- */
+
+struct SimDisplay : BrightnessDisplay {
+	bool     open    = true;
+	int      writeUs = 2000;
+	uint32_t panel = 0, staged = 0; // what the display shows; touched only by the thread on the wire
+
+	std::unique_ptr<DeviceScheduler> tx; // as DisplayDevice
+	std::shared_ptr<TxTicket>        probeTx;
+
+	int getBrightness(uint32_t *v) {
+		blockFor(g_cfg.readUs);
+		*v = panel;
+		return open ? 0 : -1;
+	}
+	// setBrightness: read the report, set the value, write it back
+	int writeBrightness(uint32_t v) override {
+		int rc = stageBrightness(v);
+		return rc ? rc : commitBrightness();
+	}
+	int stageBrightness(uint32_t v) override {
+		blockFor(g_cfg.readUs);
+		staged = v;
+		return 0;
+	}
+	int              commitBrightness() override;
+	DeviceScheduler *scheduler() override { return tx.get(); }
+};
+
+static std::vector<SimDisplay> g_displays;
+static ProfiledMutex           g_displayMutex{"display"};
+static size_t                  g_activeDisplay = 0;
+static bool                    g_linkedMode    = true;
+
+// Set by the UI thread while it handles an injected step: when the injected step's write to the
+// active display lands (on whichever thread sends it), its latency is recorded.
+static std::atomic<int64_t> g_injectedAtNs{0};
+static std::atomic<bool>    g_pending{false};
+static std::atomic<uint32_t> g_pendingVal{0}; // its value on the active display (a ramp step may land first)
+static std::vector<uint64_t> g_latencyUs; // appended while the UI thread holds g_displayMutex
+static std::vector<uint64_t> g_skewUs;    // same
+
+int SimDisplay::commitBrightness() {
+	blockFor(writeUs);
+	panel = staged;
+	if (g_pending.load() && this == &g_displays[g_activeDisplay] && staged == g_pendingVal.load() &&
+	    g_pending.exchange(false))
+		g_latencyUs.push_back((uint64_t)(LinkedFanOut::nowNs() - g_injectedAtNs.load()) / 1000);
+	return 0;
+}
+
+/* ---------- file log ---------- */
+
+static ProfiledMutex                g_logMutex{"log"};
+static std::unique_ptr<char[]>      g_logFile(new char[kLogFileBytes]);
+static std::unique_ptr<LogFileWriter> g_logWriter;
+static std::atomic<uint64_t>        g_logLines{0};
+
+static void logLine(const char *fmt, uint32_t a, uint32_t b) {
+	char line[160];
+	int  n = snprintf(line, sizeof(line), fmt, a, b);
+	PROFILED_LOCK(g_logMutex);
+	g_logLines.fetch_add(1, std::memory_order_relaxed);
+	if (!g_cfg.fileLog)
+		return;
+	static const uint16_t kTime[7] = {2026, 1, 1, 0, 0, 0, 0};
+	if (!g_logWriter || !g_logWriter->fits((size_t)n)) // next segment
+		g_logWriter = std::make_unique<LogFileWriter>(g_logFile.get(), kTime, 0);
+	g_logWriter->write(kTime, 0, line, (size_t)n);
+}
+
+/* ---------- the control path: BrightnessCore, as src/main.cpp drives it ---------- */
+
+static double g_startMs = 0;
+
+class BenchHost : public BrightnessHost {
+public:
+	// The ambient level jumps every 2 s (out of phase across displays), so the ramps keep running
+	float ambientLux(const BrightnessDisplay &dev, bool) override {
+		size_t i = static_cast<const SimDisplay *>(&dev) - g_displays.data();
+		return ((int)((nowMs() - g_startMs) / 2000) + (int)i) % 2 ? 400.f : 60.f;
+	}
+	void written(const BrightnessDisplay &dev, uint32_t val) override {
+		logLine("set brightness %u (display %u)", val,
+		        (uint32_t)(static_cast<const SimDisplay *>(&dev) - g_displays.data()));
+	}
+	void userAction(const BrightnessDisplay &dev, uint32_t val) override {
+		if (&dev == &g_displays[g_activeDisplay])
+			g_pendingVal.store(val);
+	}
+	void linkedWritten(size_t, uint64_t skewUs) override { g_skewUs.push_back(skewUs); }
+};
+static BenchHost      g_host;
+static BrightnessCore g_brightness(g_host);
+
+static void adjustBrightnessByStep(int direction, Clock::time_point injectedAt) {
+	PROFILED_LOCK(g_displayMutex);
+	g_injectedAtNs.store(std::chrono::duration_cast<std::chrono::nanoseconds>(injectedAt.time_since_epoch()).count());
+	g_pending.store(true);
+	g_brightness.adjustBrightnessByStep(g_displays, g_activeDisplay, g_linkedMode, g_cfg.steps, direction);
+	g_pending.store(false); // no write (already at the end): no sample
+}
+
+/* ---------- threads ---------- */
+
+struct Injected {
+	Clock::time_point at;
+	int               direction;
+};
+static std::mutex              g_queueMutex;
+static std::condition_variable g_queueCv;
+static std::deque<Injected>    g_queue;
+static std::atomic<bool>       g_stop{false};
+
+static void uiThread() {
+	for (;;) {
+		Injected e;
+		{
+			std::unique_lock<std::mutex> lock(g_queueMutex);
+			g_queueCv.wait(lock, [] { return !g_queue.empty() || g_stop.load(); });
+			if (g_queue.empty())
+				return;
+			e = g_queue.front();
+			g_queue.pop_front();
+		}
+		adjustBrightnessByStep(e.direction, e.at);
+	}
+}
+
+static void workerThread() {
+	auto   start     = Clock::now();
+	double lastChurn = 0;
+	g_startMs        = nowMs();
+	while (!g_stop.load()) {
+		double t = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+		{
+			PROFILED_LOCK(g_displayMutex);
+			// Liveness: one read per display, posted and settled on the next tick as the app does
+			bool anyDead = false;
+			for (auto &dev : g_displays) {
+				uint32_t tmp;
+				if (!dev.tx) {
+					anyDead = anyDead || dev.getBrightness(&tmp) != 0;
+					continue;
+				}
+				if (dev.probeTx && dev.probeTx->done()) {
+					int rc  = dev.probeTx->result();
+					anyDead = anyDead || (rc != 0 && rc != kTxCancelled);
+					dev.probeTx.reset();
+				}
+				if (!dev.probeTx)
+					dev.probeTx = dev.tx->post(TxClass::Probe, [&dev] {
+						uint32_t v;
+						return dev.getBrightness(&v);
+					});
+			}
+			if (g_cfg.churnMs > 0 && t - lastChurn >= g_cfg.churnMs) { // a display drops and comes back
+				lastChurn = t;
+				anyDead   = true;
+			}
+			if (anyDead) { // hid_enumerate runs under the display lock
+				uint32_t n = (uint32_t)g_displays.size();
+				logLine("device %u of %u disconnected, rescanning", n - 1, n);
+				std::this_thread::sleep_for(std::chrono::milliseconds(g_cfg.enumMs));
+				logLine("device %u of %u ready", n - 1, n);
+			}
+			// Auto-brightness (BenchHost::ambientLux keeps the ramps moving)
+			if (g_cfg.ramps)
+				g_brightness.autoBrightnessTick(nowMs(), false);
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	}
+}
+
+// Steps at the configured rate, 5 up then 5 down so the brightness never pins at an end.
+static void injectorThread() {
+	auto   start  = Clock::now();
+	auto   period = std::chrono::duration<double>(1.0 / g_cfg.rateHz);
+	size_t n      = 0;
+	while (std::chrono::duration<double>(Clock::now() - start).count() < g_cfg.seconds) {
+		std::this_thread::sleep_until(start + std::chrono::duration_cast<Clock::duration>(period * (double)n));
+		{
+			std::lock_guard<std::mutex> lock(g_queueMutex);
+			g_queue.push_back({Clock::now(), (n / 5) % 2 ? -1 : 1});
+		}
+		g_queueCv.notify_one();
+		++n;
+	}
+}
+
+/* ---------- report ---------- */
+
+static uint64_t percentile(const std::vector<uint64_t> &sorted, double p) {
+	if (sorted.empty())
+		return 0;
+	size_t i = (size_t)std::ceil(p / 100.0 * (double)sorted.size());
+	return sorted[std::min(sorted.size() - 1, i ? i - 1 : 0)];
+}
+
+/* ---------- --verify: the scheduler's rules ---------- */
+
+// A transaction holding the device until released: one long HID call on the wire.
+class WireHold {
+public:
+	int hold() {
+		std::unique_lock<std::mutex> lock(m_);
+		entered_ = true;
+		cv_.notify_all();
+		cv_.wait(lock, [this] { return released_; });
+		return 0;
+	}
+	void waitEntered() {
+		std::unique_lock<std::mutex> lock(m_);
+		cv_.wait(lock, [this] { return entered_; });
+	}
+	void release() {
+		std::lock_guard<std::mutex> lock(m_);
+		released_ = true;
+		cv_.notify_all();
+	}
+
+private:
+	std::mutex              m_;
+	std::condition_variable cv_;
+	bool                    entered_ = false, released_ = false;
+};
+
+class VerifyHost : public BrightnessHost {
+public:
+	int   failed = 0;
+	float ambientLux(const BrightnessDisplay &, bool) override { return 400.f; }
+	void  writeFailed(const BrightnessDisplay &, int) override { ++failed; }
+};
+
+static bool check(bool ok, const char *what) {
+	printf("%s: %s\n", ok ? "ok  " : "FAIL", what);
+	return ok;
+}
+
+static double msSince(Clock::time_point t) {
+	return std::chrono::duration<double, std::milli>(Clock::now() - t).count();
+}
+
+static bool verifyScheduler() {
+	bool ok = true;
+	{
+		DeviceScheduler      tx;
+		WireHold             wire;
+		std::vector<TxClass> order; // appended on the scheduler's thread, read after idle()
+		tx.post(TxClass::Probe, [&] { return wire.hold(); });
+		wire.waitEntered();
+		for (TxClass c : {TxClass::Probe, TxClass::User, TxClass::Ramp, TxClass::Preset}) // a ramp after the user's
+			tx.post(c, [&order, c] {
+				order.push_back(c);
+				return 0;
+			});
+		wire.release();
+		tx.idle();
+		ok &= check(order == std::vector<TxClass>{TxClass::User, TxClass::Preset, TxClass::Ramp, TxClass::Probe},
+		            "the most urgent class goes first: user, preset, ramp, probe");
+	}
+	{
+		DeviceScheduler tx;
+		WireHold        wire;
+		tx.post(TxClass::Probe, [&] { return wire.hold(); });
+		wire.waitEntered();
+		auto r1 = tx.post(TxClass::Ramp, [] { return 0; });
+		auto r2 = tx.post(TxClass::Ramp, [] { return 0; });
+		ok &= check(r1->done() && r1->result() == kTxCancelled && !r2->done(), "a new ramp step replaces the waiting one");
+		auto user = tx.post(TxClass::User, [] { return 0; });
+		ok &= check(r2->done() && r2->result() == kTxCancelled, "a user write cancels the waiting ramp step");
+		wire.release();
+		ok &= check(user->wait() == 0, "the user write runs once the wire is free");
+		tx.idle();
+		DeviceScheduler::Stats ramp = tx.stats(TxClass::Ramp), u = tx.stats(TxClass::User);
+		ok &= check(ramp.done == 0 && ramp.cancelled == 2 && ramp.depthMax == 1 && u.done == 1 && u.waitUsTotal > 0,
+		            "per-class stats: done, cancelled, depth, wait");
+	}
+	{
+		// Through BrightnessCore, against a display whose every write takes 30 ms: the ramp steps are
+		// posted (the worker does not wait), and a user step waits for the one on the wire only.
+		constexpr int kWriteUs = 30000;
+		g_cfg.readUs           = 0;
+		VerifyHost     host;
+		BrightnessCore core(host);
+		SimDisplay     dev;
+		dev.writeUs           = kWriteUs;
+		dev.tx                = std::make_unique<DeviceScheduler>();
+		dev.currentBrightness() = dev.baseBrightness() = 10000; // at 100 lux; the room is at 400 now
+		core.autoBrightnessStep(dev, 0, false);             // starts the ramp
+		auto t0 = Clock::now();
+		bool a  = core.autoBrightnessStep(dev, 500, false);
+		while (dev.tx->depth(TxClass::Ramp)) // on the wire
+			std::this_thread::yield();
+		bool   b      = core.autoBrightnessStep(dev, 1000, false);
+		double postMs = msSince(t0);
+		ok &= check(a && b && postMs < kWriteUs / 1000.0 / 2, "auto-brightness steps are posted, not waited for");
+		auto waiting = dev.rampTx;
+		auto t1      = Clock::now();
+		core.SetBrightness(dev, 20000, true, false);
+		double userMs = msSince(t1);
+		char   what[128];
+		snprintf(what, sizeof(what), "a user write behind a 30 ms ramp step takes one more write, not two (%.1f ms)",
+		         userMs);
+		ok &= check(userMs < 2.5 * kWriteUs / 1000.0, what);
+		ok &= check(waiting->done() && waiting->result() == kTxCancelled, "the ramp step left waiting was cancelled");
+		ok &= check(dev.panel == 20000 && dev.currentBrightness() == 20000, "the user's level is the one shown");
+		core.autoBrightnessStep(dev, 1100, false); // settles the cancelled step
+		ok &= check(!dev.rampTx && host.failed == 0, "a cancelled step is neither written nor failed");
+	}
+	std::string text = metricsText();
+	ok &= check(text.find("sbpp_tx_wait_us_count{class=\"user\"}") != std::string::npos &&
+	                text.find("sbpp_tx_cancelled_total{class=\"ramp\"}") != std::string::npos &&
+	                text.find("sbpp_tx_queue_depth{class=\"probe\"} 0") != std::string::npos,
+	            "queue depth, wait and cancellations exported per class");
+	return ok;
+}
+
+static bool parseArgs(int argc, char **argv) {
+	for (int i = 1; i < argc; ++i) {
+		const char *a    = argv[i];
+		bool        more = i + 1 < argc;
+		if (!strcmp(a, "--seconds") && more)
+			g_cfg.seconds = atof(argv[++i]);
+		else if (!strcmp(a, "--rate") && more)
+			g_cfg.rateHz = atof(argv[++i]);
+		else if (!strcmp(a, "--displays") && more)
+			g_cfg.displays = atoi(argv[++i]);
+		else if (!strcmp(a, "--write-us") && more) {
+			g_cfg.writeUs.clear();
+			char *p = argv[++i];
+			do
+				g_cfg.writeUs.push_back((int)strtol(p, &p, 10));
+			while (*p++ == ',');
+		}
+		else if (!strcmp(a, "--read-us") && more)
+			g_cfg.readUs = atoi(argv[++i]);
+		else if (!strcmp(a, "--enum-ms") && more)
+			g_cfg.enumMs = atoi(argv[++i]);
+		else if (!strcmp(a, "--churn-ms") && more)
+			g_cfg.churnMs = atoi(argv[++i]);
+		else if (!strcmp(a, "--gate") && more)
+			g_cfg.gateP99Us = strtoull(argv[++i], nullptr, 10);
+		else if (!strcmp(a, "--gate-skew") && more)
+			g_cfg.gateSkewUs = strtoull(argv[++i], nullptr, 10);
+		else if (!strcmp(a, "--no-ramps"))
+			g_cfg.ramps = false;
+		else if (!strcmp(a, "--no-churn"))
+			g_cfg.churnMs = 0;
+		else if (!strcmp(a, "--no-log"))
+			g_cfg.fileLog = false;
+		else if (!strcmp(a, "--sequential"))
+			g_cfg.sequential = true;
+		else if (!strcmp(a, "--no-scheduler"))
+			g_cfg.schedulers = false;
+		else if (!strcmp(a, "--verify"))
+			g_cfg.verify = true;
+		else if (!strcmp(a, "--json"))
+			g_cfg.json = true;
+		else
+			return false;
+	}
+	return g_cfg.seconds > 0 && g_cfg.rateHz > 0 && g_cfg.displays > 0 && g_cfg.displays <= 64 &&
+	       !g_cfg.writeUs.empty();
+}
+
+int main(int argc, char **argv) {
+	if (!parseArgs(argc, argv)) {
+		fprintf(stderr, "usage: hotkey-latency-bench [--seconds S] [--rate HZ] [--displays N] [--write-us US[,US...]]\n"
+		                "                            [--read-us US] [--enum-ms MS] [--churn-ms MS] [--no-ramps]\n"
+		                "                            [--no-churn] [--no-log] [--sequential] [--no-scheduler] [--json]\n"
+		                "                            [--gate P99_US] [--gate-skew P50_US]\n"
+		                "       hotkey-latency-bench --verify\n");
+		return 2;
+	}
+	if (g_cfg.verify)
+		return verifyScheduler() ? 0 : 1;
+	// A mix like a real desk: a Studio Display, an XDR, more Studio Displays
+	g_displays.resize((size_t)g_cfg.displays);
+	for (size_t i = 0; i < g_displays.size(); ++i) {
+		g_displays[i].writeUs = g_cfg.writeUs[std::min(i, g_cfg.writeUs.size() - 1)];
+		if (i % 2) {
+			g_displays[i].maxNits()       = 1000.f;
+			g_displays[i].minBrightness() = 400;
+		}
+		if (g_cfg.schedulers)
+			g_displays[i].tx = std::make_unique<DeviceScheduler>();
+		g_brightness.attach(g_displays[i]);
+	}
+	g_brightness.setConcurrentLinked(!g_cfg.sequential);
+
+	std::thread ui(uiThread), worker(workerThread), injector(injectorThread);
+	injector.join();
+	g_stop.store(true);
+	g_queueCv.notify_all();
+	ui.join();
+	worker.join();
+	for (auto &dev : g_displays)
+		if (dev.tx)
+			dev.tx->idle(); // the last posts
+
+	std::vector<uint64_t> s = g_latencyUs, k = g_skewUs;
+	std::sort(s.begin(), s.end());
+	std::sort(k.begin(), k.end());
+	uint64_t p50 = percentile(s, 50), p90 = percentile(s, 90), p99 = percentile(s, 99), p999 = percentile(s, 99.9);
+	uint64_t max = s.empty() ? 0 : s.back();
+	uint64_t skew50 = percentile(k, 50), skew99 = percentile(k, 99), skewMax = k.empty() ? 0 : k.back();
+	bool     failed = (g_cfg.gateP99Us && p99 > g_cfg.gateP99Us) || (g_cfg.gateSkewUs && skew50 > g_cfg.gateSkewUs);
+
+	std::string writes;
+	for (size_t i = 0; i < g_cfg.writeUs.size(); ++i)
+		writes += (i ? "," : "") + std::to_string(g_cfg.writeUs[i]);
+
+	// The schedulers' wait per class, across the displays
+	DeviceScheduler::Stats tx[kTxClasses];
+	for (const auto &dev : g_displays)
+		for (size_t c = 0; dev.tx && c < kTxClasses; ++c) {
+			DeviceScheduler::Stats d = dev.tx->stats((TxClass)c);
+			tx[c].done += d.done;
+			tx[c].cancelled += d.cancelled;
+			tx[c].waitUsTotal += d.waitUsTotal;
+			tx[c].waitUsMax = std::max(tx[c].waitUsMax, d.waitUsMax);
+			tx[c].depthMax  = std::max(tx[c].depthMax, d.depthMax);
+		}
+	auto waitAvgUs = [&](size_t c) { return tx[c].done ? tx[c].waitUsTotal / tx[c].done : 0; };
+	std::string txJson;
+	for (size_t c = 0; g_cfg.schedulers && c < kTxClasses; ++c) {
+		char buf[192];
+		snprintf(buf, sizeof(buf),
+		         "%s\"%s\": {\"done\": %llu, \"cancelled\": %llu, \"wait_avg_us\": %llu, \"wait_max_us\": %llu, "
+		         "\"depth_max\": %zu}",
+		         c ? ", " : "", txClassName((TxClass)c), (unsigned long long)tx[c].done,
+		         (unsigned long long)tx[c].cancelled, (unsigned long long)waitAvgUs(c),
+		         (unsigned long long)tx[c].waitUsMax, tx[c].depthMax);
+		txJson += buf;
+	}
+	if (g_cfg.json) {
+		printf("{\"bench\": \"hotkey-latency\", \"samples\": %zu, \"p50_us\": %llu, \"p90_us\": %llu, "
+		       "\"p99_us\": %llu, \"p999_us\": %llu, \"max_us\": %llu, \"skew_samples\": %zu, \"skew_p50_us\": %llu, "
+		       "\"skew_p99_us\": %llu, \"skew_max_us\": %llu, \"log_lines\": %llu, \"tx\": {%s}, "
+		       "\"config\": {\"seconds\": %g, \"rate_hz\": %g, \"displays\": %d, \"write_us\": [%s], \"read_us\": %d, "
+		       "\"enum_ms\": %d, \"churn_ms\": %d, \"ramps\": %s, \"file_log\": %s, \"sequential\": %s, "
+		       "\"schedulers\": %s}, "
+		       "\"gate_p99_us\": %llu, \"gate_skew_us\": %llu, \"passed\": %s}\n",
+		       s.size(), (unsigned long long)p50, (unsigned long long)p90, (unsigned long long)p99,
+		       (unsigned long long)p999, (unsigned long long)max, k.size(), (unsigned long long)skew50,
+		       (unsigned long long)skew99, (unsigned long long)skewMax, (unsigned long long)g_logLines.load(),
+		       txJson.c_str(),
+		       g_cfg.seconds, g_cfg.rateHz, g_cfg.displays, writes.c_str(), g_cfg.readUs, g_cfg.enumMs, g_cfg.churnMs,
+		       g_cfg.ramps ? "true" : "false", g_cfg.fileLog ? "true" : "false", g_cfg.sequential ? "true" : "false",
+		       g_cfg.schedulers ? "true" : "false", (unsigned long long)g_cfg.gateP99Us, (unsigned long long)g_cfg.gateSkewUs, failed ? "false" : "true");
+	} else {
+		printf("hotkey -> feature write, %zu steps over %.0f s, %d displays linked (%s, %s)\n", s.size(),
+		       g_cfg.seconds, g_cfg.displays, g_cfg.sequential ? "sequential" : "concurrent",
+		       g_cfg.schedulers ? "schedulers" : "no schedulers");
+		char churn[64] = "off";
+		if (g_cfg.churnMs > 0)
+			snprintf(churn, sizeof(churn), "%d ms every %d ms", g_cfg.enumMs, g_cfg.churnMs);
+		printf("  load: write %s us, read %d us, enumeration %s, ramps %s, file log %s\n", writes.c_str(),
+		       g_cfg.readUs, churn, g_cfg.ramps ? "on" : "off", g_cfg.fileLog ? "on" : "off");
+		printf("  p50 %8.2f ms\n  p90 %8.2f ms\n  p99 %8.2f ms\n  p99.9 %6.2f ms\n  max %8.2f ms\n", p50 / 1000.0,
+		       p90 / 1000.0, p99 / 1000.0, p999 / 1000.0, max / 1000.0);
+		if (!k.empty())
+			printf("  linked skew, first to last display: p50 %.2f ms, p99 %.2f ms, max %.2f ms (%zu writes)\n",
+			       skew50 / 1000.0, skew99 / 1000.0, skewMax / 1000.0, k.size());
+		for (size_t c = 0; g_cfg.schedulers && c < kTxClasses; ++c)
+			printf("  %-6s queue wait avg %.2f ms, max %.2f ms, depth max %zu (%llu run, %llu cancelled)\n",
+			       txClassName((TxClass)c), waitAvgUs(c) / 1000.0, tx[c].waitUsMax / 1000.0, tx[c].depthMax,
+			       (unsigned long long)tx[c].done, (unsigned long long)tx[c].cancelled);
+		if (g_cfg.gateP99Us)
+			printf("%s: p99 %.2f ms, gate %.2f ms\n", p99 > g_cfg.gateP99Us ? "FAIL" : "ok", p99 / 1000.0,
+			       g_cfg.gateP99Us / 1000.0);
+		if (g_cfg.gateSkewUs)
+			printf("%s: skew p50 %.2f ms, gate %.2f ms\n", skew50 > g_cfg.gateSkewUs ? "FAIL" : "ok", skew50 / 1000.0,
+			       g_cfg.gateSkewUs / 1000.0);
+	}
+	return failed || s.empty() ? 1 : 0;
+}
@@ -0,0 +1,188 @@
+// log-decode: turn a file-log segment back into text. Reads both the live memory-mapped .sblog
+// (include/LogFile.h) and the compact .sbz it is re-encoded to when it is closed
+// (include/LogSegment.h). The app converts finished segments itself; this is for export and for
+// the files left behind by a crash or a reset.
+//
+//   log-decode <file.sblog|file.sbz> [out.log]   (default: stdout)
+//   log-decode --verify <file.sblog>             compact it and check the .sbz decodes to the same text
+//   log-decode --selftest                        the same round trip on synthetic segments, in memory
+#define _CRT_SECURE_NO_WARNINGS
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "LogSegment.h"
+
+static bool readFile(const char *path, std::vector<char> &data) {
+	FILE *f = fopen(path, "rb");
+	if (!f) {
+		fprintf(stderr, "cannot open %s\n", path);
+		return false;
+	}
+	char   buf[65536];
+	size_t n;
+	while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+		data.insert(data.end(), buf, buf + n);
+	fclose(f);
+	return true;
+}
+
+static std::string decode(const std::vector<char> &data) {
+	std::string text = logFileText(data.data(), data.size());
+	return text.empty() ? logSegmentText(data.data(), data.size()) : text;
+}
+
+static int verify(const char *path) {
+	std::vector<char> data;
+	if (!readFile(path, data))
+		return 1;
+	std::string text = logFileText(data.data(), data.size());
+	if (text.empty()) {
+		fprintf(stderr, "%s is not an .sblog file log\n", path);
+		return 1;
+	}
+	std::string seg  = compactLogFile(data.data(), data.size());
+	std::string back = logSegmentText(seg.data(), seg.size());
+	printf(".sblog %zu bytes, as text %zu bytes, .sbz %zu bytes (%.1fx smaller than the text)\n", data.size(),
+	       text.size(), seg.size(), (double)text.size() / (double)seg.size());
+	if (back != text) {
+		size_t at = 0;
+		while (at < back.size() && at < text.size() && back[at] == text[at])
+			++at;
+		printf("MISMATCH at byte %zu\n", at);
+		return 1;
+	}
+	printf("round trip exact\n");
+	return 0;
+}
+
+/* ---------- selftest ---------- */
+
+static bool g_fail = false;
+
+static void check(bool ok, const char *what) {
+	printf("%-4s %s\n", ok ? "ok" : "FAIL", what);
+	g_fail |= !ok;
+}
+
+struct TestLine {
+	uint16_t    time[7];
+	uint8_t     level;
+	std::string text;
+};
+
+// Write `lines` into an in-memory segment with LogFileWriter, as Log does, and check that the
+// .sblog reads back as `expect` (the lines that survive) and that the compact form decodes to the
+// same text, whole and cut short (at every byte of a small one).
+static void roundTrip(const char *what, const uint16_t (&start)[7], const std::vector<TestLine> &lines,
+                      const std::string &expect) {
+	std::vector<char> file(kLogFileBytes);
+	LogFileWriter     writer(file.data(), start, 0);
+	for (const TestLine &l : lines)
+		writer.write(l.time, l.level, l.text.data(), l.text.size());
+
+	char        name[160];
+	std::string text = logFileText(file.data(), file.size());
+	snprintf(name, sizeof(name), "%s: the .sblog reads back as written", what);
+	check(text == expect, name);
+
+	std::string seg  = compactLogFile(file.data(), file.size());
+	std::string back = logSegmentText(seg.data(), seg.size());
+	snprintf(name, sizeof(name), "%s: the .sbz decodes to the same text (%zu -> %zu bytes)", what, text.size(),
+	         seg.size());
+	check(!seg.empty() && back == text, name);
+	snprintf(name, sizeof(name), "%s: the .sbz is smaller than the text", what);
+	check(seg.size() < text.size(), name);
+
+	bool   prefixes = true; // a truncated .sbz decodes up to its last complete line
+	size_t step     = seg.size() / 500 + 1;
+	for (size_t cut = sizeof(LogSegmentHeader); cut < seg.size() && prefixes; cut += step) {
+		std::string part = logSegmentText(seg.data(), cut);
+		prefixes         = part.size() >= 2 && part.compare(part.size() - 2, 2, "\r\n") == 0 &&
+		           text.compare(0, part.size(), part) == 0;
+	}
+	snprintf(name, sizeof(name), "%s: a cut .sbz decodes to whole lines of the text", what);
+	check(prefixes, name);
+}
+
+static std::string expectedText(const uint16_t (&start)[7], const TestLine *first, const TestLine *end) {
+	std::string out;
+	appendLogTextHeader(out, start);
+	for (const TestLine *l = first; l != end; ++l)
+		appendLogTextLine(out, l->time, l->level, l->text.data(), l->text.size());
+	return out;
+}
+
+static int selftest() {
+	// Lines that exercise the encoder: numbers (template values), 0x runs and leading zeros (kept as
+	// strings), text that uses the placeholder bytes itself (kSegRaw), empty lines, lines spread over
+	// several records, and clock steps forwards over a month end, backwards, and within a millisecond.
+	const uint16_t        start[7] = {2026, 2, 28, 23, 59, 58, 250};
+	std::vector<TestLine> lines    = {
+		{{2026, 2, 28, 23, 59, 58, 250}, 0, "File log started (30 minutes)"},
+		{{2026, 2, 28, 23, 59, 58, 253}, 0, "Display 1: brightness 40 -> 41 (250 nits)"},
+		{{2026, 2, 28, 23, 59, 58, 253}, 0, "Display 2: brightness 7 -> 100 (0 nits)"},
+		{{2026, 2, 28, 23, 59, 59, 999}, 1, ""},
+		{{2026, 3, 1, 0, 0, 0, 1}, 2, "HID write failed: 0x8007001F, handle 0x0000abcd, mask 0X0"},
+		{{2026, 3, 1, 0, 0, 0, 2}, 0, "not hex: 0x, 0xg and a trailing 0x"},
+		{{2026, 3, 1, 0, 0, 0, 2}, 0, "codes 007 0 00 0123 100, 18446744073709551615 and 123456789012345678901234"},
+		{{2026, 3, 1, 0, 0, 1, 0}, 0, std::string("placeholders \x11 and \x12 in the text, 42")},
+		{{2026, 2, 28, 23, 59, 59, 500}, 1, "clock set back: 1 step"},
+		{{2026, 3, 1, 0, 0, 2, 0}, 0, "42"},
+		{{2026, 3, 1, 0, 0, 2, 0}, 0, "0"},
+		{{2026, 3, 1, 0, 0, 2, 0}, 0, "\xC3\x89" "cran 5 \xC2\xB5" "s"},
+		{{2026, 3, 1, 0, 0, 2, 0}, 0, "Display 3: brightness 1 -> 2 (9 nits)"},
+	};
+	std::string record(sizeof(LogFileRecord::text), 'r'); // exactly one record, then one byte over
+	lines.push_back({{2026, 3, 1, 0, 0, 3, 0}, 0, record});
+	lines.push_back({{2026, 3, 1, 0, 0, 3, 0}, 0, record + "7"});
+	std::string longLine;
+	for (int i = 0; longLine.size() < 600; ++i)
+		longLine += "chunk " + std::to_string(i) + " at 0x" + std::to_string(1000 + i) + " 0" + std::to_string(i) + "; ";
+	lines.push_back({{2026, 3, 1, 0, 0, 4, 0}, 2, longLine});
+	lines.push_back({{2026, 3, 1, 0, 0, 4, 0}, 0, "after the long line"});
+	roundTrip("mixed lines", start, lines, expectedText(start, lines.data(), lines.data() + lines.size()));
+
+	// A segment that wrapped (Log only lets one wrap while no next segment is ready): the oldest lines are
+	// gone, the rest reads back and round-trips.
+	std::vector<TestLine> wrapped;
+	for (size_t i = 0; i < kLogFileRecords + 100; ++i) {
+		TestLine l = {{2026, 3, 1, 12, (uint16_t)(i / 60000 % 60), (uint16_t)(i / 1000 % 60), (uint16_t)(i % 1000)},
+		              (uint8_t)(i % 3), "line " + std::to_string(i) + " of the wrapped segment"};
+		wrapped.push_back(l);
+	}
+	roundTrip("wrapped segment", start, wrapped,
+	          expectedText(start, wrapped.data() + 100, wrapped.data() + wrapped.size()));
+	return g_fail ? 1 : 0;
+}
+
+int main(int argc, char **argv) {
+	if (argc > 2 && !strcmp(argv[1], "--verify"))
+		return verify(argv[2]);
+	if (argc > 1 && !strcmp(argv[1], "--selftest"))
+		return selftest();
+	if (argc < 2) {
+		fprintf(stderr, "usage: log-decode <file.sblog|file.sbz> [out.log] | --verify <file.sblog> | --selftest\n");
+		return 2;
+	}
+	std::vector<char> data;
+	if (!readFile(argv[1], data))
+		return 1;
+	std::string text = decode(data);
+	if (text.empty()) {
+		fprintf(stderr, "%s is not a file-log segment (.sblog or .sbz)\n", argv[1]);
+		return 1;
+	}
+	FILE *out = argc > 2 ? fopen(argv[2], "wb") : stdout;
+	if (!out) {
+		fprintf(stderr, "cannot create %s\n", argv[2]);
+		return 1;
+	}
+	if (out == stdout)
+		text.erase(0, 3); // no BOM on a console
+	fwrite(text.data(), 1, text.size(), out);
+	if (out != stdout)
+		fclose(out);
+	return 0;
+}
@@ -0,0 +1,463 @@
+// log-ring-bench: cost of one log line in the preallocated LogRing (include/LogRing.h) against the
+// std::deque<LogEntry{std::wstring}> store it replaced, and the peak heap each one needs.
+// "deque" is the old Log::Add (format into a stack buffer, copy into a new std::wstring, push_back,
+// pop_front past 2000 entries), "ring" formats in place, "record" is what Log::Info does now: pack
+// the arguments (include/LogRecord.h) and print only when read.
+//
+//   log-ring-bench [lines]     (default 1000000)
+//   log-ring-bench --verify    deferred records must print exactly what printf prints; exit 1 if not
+//   log-ring-bench --storm     hammer one call site; the lines logged before the storm must survive,
+//                              and repeated enumerations must not be limited
+//   log-ring-bench --viewer [lines] [batch]   log viewer cost per update (default 100000 lines,
+//                              batches of 50): the old append-to-EDIT refresh against the virtual list
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <initializer_list>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "LogRecord.h"
+#include "LogRows.h"
+#include "LogSiteLimiter.h"
+
+// Heap accounting: every allocation carries its size in front so delete can subtract it. Kept out
+// of line so the compiler does not look through the header trick.
+#ifdef _MSC_VER
+#define BENCH_NOINLINE __declspec(noinline)
+#else
+#define BENCH_NOINLINE __attribute__((noinline))
+#endif
+static std::atomic<size_t> g_heapNow{0}, g_heapPeak{0};
+
+BENCH_NOINLINE void *operator new(size_t n) {
+	auto *p = static_cast<size_t *>(std::malloc(n + sizeof(max_align_t)));
+	if (!p)
+		throw std::bad_alloc();
+	*p       = n;
+	size_t now = g_heapNow += n;
+	size_t peak = g_heapPeak.load();
+	while (now > peak && !g_heapPeak.compare_exchange_weak(peak, now)) {
+	}
+	return reinterpret_cast<char *>(p) + sizeof(max_align_t);
+}
+BENCH_NOINLINE void operator delete(void *q) noexcept {
+	if (!q)
+		return;
+	auto *p = reinterpret_cast<size_t *>(static_cast<char *>(q) - sizeof(max_align_t));
+	g_heapNow -= *p;
+	std::free(p);
+}
+BENCH_NOINLINE void operator delete(void *q, size_t) noexcept { operator delete(q); }
+
+struct LogEntry {
+	uint32_t     tick;
+	LogLevel     level;
+	std::wstring message;
+};
+
+struct DequeLog {
+	std::deque<LogEntry> entries;
+	template <class... A>
+	void add(uint32_t tick, LogLevel level, const wchar_t *fmt, A... a) {
+		wchar_t buf[1024];
+		logPrintf(buf, 1024, fmt, a...);
+		LogEntry e;
+		e.tick    = tick;
+		e.level   = level;
+		e.message = buf;
+		entries.push_back(std::move(e));
+		if (entries.size() > LogRing::kSlots)
+			entries.pop_front();
+	}
+};
+
+template <class Store, class... A>
+static void line(Store &s, uint32_t tick, LogLevel level, const wchar_t *fmt, A... a) {
+	s.add(tick, level, fmt, a...);
+}
+
+struct RingLog {
+	LogRing *ring = new LogRing();
+	~RingLog() { delete ring; }
+	template <class... A>
+	LogView add(uint32_t tick, LogLevel level, const wchar_t *fmt, A... a) {
+		return ring->appendText(tick, level, [&](wchar_t *dst, size_t cap) { return logPrintf(dst, cap, fmt, a...); });
+	}
+};
+
+// Log::Record without the storm handling: a record unless the arguments are bigger than the
+// printed line.
+struct RecordLog : RingLog {
+	template <class... A>
+	LogView add(uint32_t tick, LogLevel level, const wchar_t *fmt, A... a) {
+		using R      = LogRecord<A...>;
+		size_t bytes = R::size(a...);
+		if (bytes > LogRing::kMaxRecordBytes)
+			return RingLog::add(tick, level, fmt, a...);
+		alignas(8) unsigned char data[LogRing::kMaxRecordBytes];
+		R::pack(data, a...);
+		return ring->append(tick, level, fmt, &R::format, data, bytes);
+	}
+};
+
+// Log::Record + Log::Store as the app runs them: collapse identical lines, then the site limiter.
+struct StormLog : RingLog {
+	LogSiteLimiter limiter;
+	uint32_t       stored = 0, collapsed = 0, suppressed = 0;
+	template <class... A>
+	void add(uint32_t tick, LogLevel level, const wchar_t *fmt, A... a) {
+		using R = LogRecord<A...>;
+		alignas(8) unsigned char data[LogRing::kMaxRecordBytes];
+		size_t bytes = R::size(a...);
+		R::pack(data, a...);
+		uint32_t dropped = 0;
+		if (ring->repeat(tick, level, fmt, &R::format, data, bytes)) {
+			++collapsed;
+			return;
+		}
+		if (!limiter.admit(fmt, tick, dropped)) {
+			++suppressed;
+			return;
+		}
+		ring->append(tick, level, fmt, &R::format, data, bytes, dropped);
+		++stored;
+	}
+};
+
+// The kinds of lines the app actually emits: a short status, a HID cap dump, a device path.
+// `longLines` makes every line hit the 1023-character limit instead (the deque's worst case).
+template <class Store>
+static double run(Store &s, size_t lines, bool longLines) {
+	static wchar_t big[1200];
+	if (!big[0]) {
+		for (size_t i = 0; i + 1 < sizeof(big) / sizeof(big[0]); ++i)
+			big[i] = L'a' + (wchar_t)(i % 26);
+	}
+	const wchar_t *name = L"Studio Display XDR";
+	const wchar_t *path = L"\\\\?\\hid#vid_05ac&pid_1116&mi_07&col01#8&2f2c7a1e&0&0000#{4d1e55b2-f16f-11cf-88cb-001111000030}";
+	auto t0 = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < lines; ++i) {
+		if (longLines) {
+			line(s, (uint32_t)i, LogLevel::Info, L"%ls", big);
+			continue;
+		}
+		switch (i % 3) {
+		case 0: line(s, (uint32_t)i, LogLevel::Warn, L"setBrightness failed on %ls (rc=%d)", name, (int)(i & 7)); break;
+		case 1:
+			line(s, (uint32_t)i, LogLevel::Info, L"ValueCap[%u]: Page=0x%04X Usage=0x%04X ReportID=%u Bits=%u Min=%ld Max=%ld",
+			     (unsigned)(i % 12), 0x0Fu, 0x10u, 1u, 16u, 400L, 60000L);
+			break;
+		default: line(s, (uint32_t)i, LogLevel::Info, L"HID ALS: reading usage 0x%04X/0x%04X on %ls", 0x20u, 0x4D1u, path);
+		}
+	}
+	auto t1 = std::chrono::steady_clock::now();
+	return std::chrono::duration<double, std::nano>(t1 - t0).count() / (double)lines;
+}
+
+template <class Store>
+static void report(const char *name, size_t lines, bool longLines) {
+	g_heapNow  = 0;
+	g_heapPeak = 0;
+	double ns;
+	{
+		Store s;
+		run(s, lines / 10, longLines); // warm up: fill the store so eviction is in the measurement
+		ns = run(s, lines, longLines);
+	}
+	printf("%-8s %10.1f %12.1f\n", name, ns, g_heapPeak.load() / 1024.0);
+}
+
+/* ---------- --verify ---------- */
+
+#ifdef _WIN32
+#define NARROW L"%hs"
+#else
+#define NARROW L"%s"
+#endif
+
+enum class Phase : uint16_t { Off, On };
+
+static unsigned g_checked = 0, g_failed = 0;
+
+// Log one line both ways: straight printf, and through a record printed back from the ring.
+template <class... A>
+static void check(RecordLog &log, std::vector<std::wstring> &expect, const wchar_t *fmt, A... a) {
+	wchar_t direct[LogRing::kLineChars], deferred[LogRing::kLineChars];
+	logPrintf(direct, LogRing::kLineChars, fmt, a...);
+	LogView v = log.add((uint32_t)log.ring->total(), LogLevel::Info, fmt, a...);
+	v.format(deferred, LogRing::kLineChars);
+	expect[(log.ring->total() - 1) % LogRing::kSlots] = direct;
+	++g_checked;
+	if (wcscmp(direct, deferred) != 0) {
+		++g_failed;
+		printf("MISMATCH for \"%ls\"\n  printf: %ls\n  record: %ls\n", fmt, direct, deferred);
+	}
+}
+
+// The app's own format strings (with %ls for wide strings, as the portable printf wants) and the
+// argument types its call sites pass, plus the edges: promotions, null strings, truncation, and
+// arguments too big for a record.
+static void corpus(RecordLog &log, std::vector<std::wstring> &expect, unsigned i) {
+	static wchar_t big[1200];
+	static char    bigNarrow[1200];
+	if (!big[0]) {
+		for (size_t k = 0; k + 1 < sizeof(big) / sizeof(big[0]); ++k) {
+			big[k]       = L'a' + (wchar_t)(k % 26);
+			bigNarrow[k] = (char)('A' + k % 26);
+		}
+	}
+	wchar_t        deviceName[32] = L"\\\\.\\DISPLAY1";
+	wchar_t       *name           = (i & 1) ? deviceName : nullptr;
+	const wchar_t *studio         = L"Studio Display";
+	unsigned short page = 0xFF20, usage = (unsigned short)(0x10 + i);
+	unsigned char  reportId = (unsigned char)i;
+	long           lmin = -(long)i, lmax = 60000L + i;
+	unsigned long  err  = 0x80070005UL + i;
+	float          lux  = 12.25f * (float)i;
+	double         ms   = 1.0 / (i + 3);
+	size_t         n    = i * 1000003u;
+	Phase          ph   = (i & 2) ? Phase::On : Phase::Off;
+
+	check(log, expect, L"  ValueCap[%u]: Page=0x%04X Usage=0x%04X ReportID=0x%02X BitSize=%u ReportCount=%u LogMin=%ld LogMax=%ld",
+	      i % 12, page, usage, reportId, (unsigned short)16, (unsigned short)1, lmin, lmax);
+	check(log, expect, L"HID ALS: %ls usage 0x%04X/0x%04X (%ls report 0x%02X, range %ld-%ld, exp %lu) on %ls",
+	      (i & 1) ? L"reading" : L"polling", 0x20, 0x4D1, L"Input", reportId, lmin, lmax, err, studio);
+	check(log, expect, L"HID ALS: raw %lu -> %.1f lux", err, lux);
+	check(log, expect, L"ALS: sensor %u report interval %u -> %u ms (achieved %.2f Hz)", i, 500u, 200u, ms);
+	check(log, expect, L"Enumeration complete: %zu display(s) found", n);
+	check(log, expect, L"Switching color preset on %ls: %d (%ls) -> %d (%ls), HDR=%d", studio, -1, L"Apple Display (P3-500 nits)",
+	      (int)i, L"?", (i & 4) ? 1 : 0);
+	check(log, expect, L"NVAPI [%ls] %ls: HdrColorControl rc=%d", L"HDR on", deviceName, -(int)i);
+	check(log, expect, L"Device %ls disconnected (name %ls)", studio, name); // null string: both print "(null)"
+	check(log, expect, L"phase %d, char '%c', %lld, %llu, %5.3e, %-6hd|, %%", ph, 'x', -1LL - i, ~0ULL, ms, (short)-7);
+	check(log, expect, L"Update check: up to date (current " NARROW ")", "1.4.0");
+	check(log, expect, L"pointer %p", (const void *)&log);
+	check(log, expect, L"No arguments, 100%% literal");
+	check(log, expect, L"truncated: %ls", big + (i % 300));            // record, printed to 1023 chars
+	check(log, expect, L"narrow long: " NARROW, bigNarrow + (i % 300)); // record
+	check(log, expect, L"%ls %ls", big, big);                          // over kMaxRecordBytes: printed now
+}
+
+static int verify() {
+	RecordLog                 log;
+	std::vector<std::wstring> expect(LogRing::kSlots);
+	// Enough laps that records are evicted, wrap the arena and land at every alignment.
+	for (unsigned i = 0; i < 1000; ++i)
+		corpus(log, expect, i);
+	// Entries still live must print the same when read back later (the window, the clipboard).
+	log.ring->visit(0, [&](size_t index, const LogView &v) {
+		wchar_t text[LogRing::kLineChars];
+		v.format(text, LogRing::kLineChars);
+		++g_checked;
+		if (expect[index % LogRing::kSlots] != text) {
+			++g_failed;
+			printf("MISMATCH reading back entry %zu: %ls\n", index, text);
+		}
+	});
+	printf("%u lines checked, %u mismatches\n", g_checked, g_failed);
+	return g_failed ? 1 : 0;
+}
+
+/* ---------- --storm ---------- */
+
+// A display stuck failing: the same site on every 100 ms tick, first for a day with the same
+// arguments (collapsed into one entry), then for an hour with a changing return code (rate
+// limited once it is a storm). The lines that explain how it started must still be in the ring
+// afterwards. Then the opposite case: bursts that end, which must never be limited.
+static int storm() {
+	StormLog       log;
+	const wchar_t *name   = L"Studio Display";
+	const uint32_t day    = 24u * 3600u * 10u; // ticks
+	const uint32_t hour   = 3600u * 10u;
+	int            failed = 0;
+	auto expect = [&](bool ok, const char *what) {
+		printf("%-4s %s\n", ok ? "ok" : "FAIL", what);
+		failed += ok ? 0 : 1;
+	};
+
+	log.add(0, LogLevel::Info, L"Device %ls ready [range %lu-%lu, current %lu]", name, 400UL, 60000UL, 30000UL);
+	log.add(0, LogLevel::Warn, L"Preset switch failed on %ls", name);
+	size_t before = log.ring->total();
+
+	auto t0 = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < day; ++i)
+		log.add(100 + i * 100, LogLevel::Warn, L"setBrightness failed on %ls (rc=%d)", name, -5);
+	auto    t1 = std::chrono::steady_clock::now();
+	LogView v  = log.ring->newest();
+	expect(log.ring->total() == before + 1 && v.repeats == day - 1, "a day of identical lines is one entry");
+	expect(v.tick == 100 && v.lastTick == 100 + (day - 1) * 100, "...with the first and last timestamps");
+
+	uint32_t start = 100 + day * 100, stored = log.stored;
+	for (uint32_t i = 0; i < hour; ++i)
+		log.add(start + i * 100, LogLevel::Warn, L"setBrightness failed on %ls (rc=%d)", name, (int)(i % 7));
+	auto     t2     = std::chrono::steady_clock::now();
+	// before the site counts as a storm, then one line per kRefillMs
+	uint32_t onset  = (LogSiteLimiter::kStormWindows + 1) * LogSiteLimiter::kWindowMs / 100;
+	uint32_t budget = onset + hour * 100 / LogSiteLimiter::kRefillMs + 1;
+	printf("     an hour of changing lines: %u stored, %u suppressed (budget %u)\n", log.stored - stored,
+	       log.suppressed, budget);
+	expect(log.stored - stored <= budget, "a changing line stays within the site budget");
+	expect(log.stored + log.suppressed + log.collapsed == 3 + day + hour - 1,
+	       "every line is stored, collapsed or counted as suppressed");
+	expect(log.ring->first() == 0, "the lines before the storm are still in the ring");
+	// the next admitted line from the site reports what was left out since the last one
+	log.add(start + hour * 100 + LogSiteLimiter::kRefillMs, LogLevel::Warn, L"setBrightness failed on %ls (rc=%d)", name, 1);
+	uint32_t counted = 0;
+	log.ring->visit(0, [&](size_t, const LogView &e) { counted += e.suppressed; });
+	expect(counted == log.suppressed, "suppressed counts are carried on the admitted lines");
+
+	// Reconnects, e.g. switching between calibrated presets: each one re-runs hid_enumerate, which
+	// logs every interface and every Feature cap from the same two sites within a few hundred ms.
+	// None of it is a storm, so every enumeration is kept in full.
+	StormLog enumLog;
+	uint32_t enumLines = 0;
+	for (uint32_t e = 0; e < 60; ++e) { // one every 5 s for 5 minutes
+		uint32_t t = e * 5000;
+		for (unsigned iface = 0; iface < 4; ++iface) {
+			enumLog.add(t, LogLevel::Info, L"Found %ls (PID 0x%04X): %ls", L"Studio Display", 0x1114u,
+			            L"hid#vid_05ac&pid_1114&mi_07");
+			for (unsigned vi = 0; vi < 40; ++vi, t += 1)
+				enumLog.add(t, LogLevel::Info,
+				            L"  ValueCap[%u]: Page=0x%04X Usage=0x%04X ReportID=0x%02X BitSize=%u ReportCount=%u "
+				            L"LogMin=%ld LogMax=%ld",
+				            vi, 0x0082u, 0x0010u + vi, iface, 16u, 1u, 0L, 65535L);
+			enumLines += 41;
+		}
+	}
+	printf("     60 enumerations: %u of %u lines stored\n", enumLog.stored, enumLines);
+	expect(enumLog.suppressed == 0 && enumLog.stored == enumLines, "repeated enumerations are logged in full");
+
+	auto ns = [](auto a, auto b, uint32_t n) { return std::chrono::duration<double, std::nano>(b - a).count() / n; };
+	printf("\nns/line: collapsed %.1f, rate limited %.1f\n", ns(t0, t1, day), ns(t1, t2, hour));
+	printf("a rate-limited storm fills the %zu-entry ring in %.1f h (was %.1f min)\n", LogRing::kSlots,
+	       (double)(LogRing::kSlots - onset) / (3600000.0 / LogSiteLimiter::kRefillMs),
+	       LogRing::kSlots / 10.0 / 60.0);
+	return failed ? 1 : 0;
+}
+
+/* ---------- --viewer ---------- */
+
+// Log::AppendLine without the Win32 printf: what the viewer shows for one entry.
+static void appendLine(std::wstring &out, const LogView &v) {
+	static const wchar_t *const kTags[] = {L"INFO ", L"WARN ", L"ERROR"};
+	wchar_t                     buf[LogRing::kLineChars];
+	int n = logPrintf(buf, 64, L"[%02u:%02u:%02u.%03u] [%ls] ", v.tick / 3600000 % 24, v.tick / 60000 % 60,
+	                  v.tick / 1000 % 60, v.tick % 1000, kTags[(int)v.level]);
+	out.append(buf, (size_t)n);
+	out.append(buf, v.format(buf, LogRing::kLineChars));
+	if (v.repeats) {
+		n = logPrintf(buf, 64, L"  (x%u)", v.repeats + 1);
+		out.append(buf, (size_t)n);
+	}
+	out += L"\r\n";
+}
+
+struct BatchStats {
+	std::vector<double> us;
+	void                add(std::chrono::steady_clock::time_point a, std::chrono::steady_clock::time_point b) {
+		us.push_back(std::chrono::duration<double, std::micro>(b - a).count());
+	}
+	void print(const char *name) {
+		std::vector<double> sorted = us;
+		std::sort(sorted.begin(), sorted.end());
+		double sum = 0, early = 0, late = 0;
+		size_t tenth = us.size() / 10 ? us.size() / 10 : 1;
+		for (size_t i = 0; i < us.size(); ++i) {
+			sum += us[i];
+			early += i < tenth ? us[i] : 0;
+			late += i >= us.size() - tenth ? us[i] : 0;
+		}
+		printf("%-14s %9.1f %9.1f %9.1f %11.1f %11.1f\n", name, sum / us.size(), sorted[sorted.size() * 99 / 100],
+		       sorted.back(), early / tenth, late / tenth);
+	}
+};
+
+// The app's lines arrive in batches between viewer updates. The old viewer copied and printed each
+// new entry and appended it to an EDIT control that keeps every line; the model here only appends
+// to a std::wstring, a lower bound (the control also re-wraps and repaints its text). The virtual
+// list syncs row indices (LogRows) and prints the rows on screen.
+static int viewer(size_t lines, size_t batch) {
+	constexpr size_t kVisibleRows = 40;
+	RecordLog        log;
+	LogRows          rows;
+	std::wstring     edit, page, text;
+	size_t           shown = 0;
+	BatchStats       before, after;
+	const wchar_t   *name = L"Studio Display";
+	for (size_t done = 0; done < lines;) {
+		for (size_t end = done + batch; done < end && done < lines; ++done) {
+			uint32_t tick = (uint32_t)done * 7;
+			switch (done % 10) {
+			case 0: log.add(tick, LogLevel::Warn, L"setBrightness failed on %ls (rc=%d)", name, (int)(done & 7)); break;
+			case 1: log.add(tick, LogLevel::Error, L"HID write timed out on %ls after %u ms", name, 500u); break;
+			default:
+				log.add(tick, LogLevel::Info, L"ValueCap[%u]: Page=0x%04X Usage=0x%04X ReportID=%u Bits=%u Min=%ld Max=%ld",
+				        (unsigned)(done % 12), 0x0Fu, 0x10u, 1u, 16u, 400L, 60000L);
+			}
+		}
+
+		auto t0 = std::chrono::steady_clock::now();
+		text.clear();
+		log.ring->visit(shown, [&](size_t, const LogView &v) { appendLine(text, v); });
+		shown = log.ring->total();
+		edit += text; // EM_REPLACESEL at the end
+		auto t1 = std::chrono::steady_clock::now();
+		rows.sync(*log.ring);
+		page.clear();
+		size_t top = rows.size() > kVisibleRows ? rows.size() - kVisibleRows : 0;
+		for (size_t r = top; r < rows.size(); ++r) {
+			LogView v;
+			if (log.ring->get(rows.at(r), v))
+				appendLine(page, v);
+		}
+		auto t2 = std::chrono::steady_clock::now();
+		before.add(t0, t1);
+		after.add(t1, t2);
+	}
+	printf("%zu lines in batches of %zu, %zu visible rows\n\n%-14s %9s %9s %9s %11s %11s\n", lines, batch, kVisibleRows,
+	       "us/batch", "mean", "p99", "max", "first 10%", "last 10%");
+	before.print("edit append");
+	after.print("virtual list");
+	printf("\nEDIT text at the end: %.1f MB and still growing; the list holds %zu row indices (%zu KB)\n",
+	       edit.size() * sizeof(wchar_t) / 1048576.0, rows.size(), rows.size() * sizeof(size_t) / 1024);
+
+	// Changing the level filter: the old viewer would print the whole ring again
+	auto t0 = std::chrono::steady_clock::now();
+	text.clear();
+	log.ring->visit(0, [&](size_t, const LogView &v) {
+		if (v.level != LogLevel::Info)
+			appendLine(text, v);
+	});
+	auto t1 = std::chrono::steady_clock::now();
+	rows.setMinLevel(LogLevel::Warn);
+	rows.sync(*log.ring);
+	auto t2 = std::chrono::steady_clock::now();
+	printf("filter to warnings (%zu of %zu rows): reprint %.1f us, re-index %.1f us\n", rows.size(), log.ring->count(),
+	       std::chrono::duration<double, std::micro>(t1 - t0).count(),
+	       std::chrono::duration<double, std::micro>(t2 - t1).count());
+	return 0;
+}
+
+int main(int argc, char **argv) {
+	if (argc > 1 && !strcmp(argv[1], "--verify"))
+		return verify();
+	if (argc > 1 && !strcmp(argv[1], "--storm"))
+		return storm();
+	if (argc > 1 && !strcmp(argv[1], "--viewer"))
+		return viewer(argc > 2 ? (size_t)atoll(argv[2]) : 100000, argc > 3 ? (size_t)atoll(argv[3]) : 50);
+	size_t lines = argc > 1 ? (size_t)atoll(argv[1]) : 1000000;
+	printf("%zu lines, up to %zu entries kept, wchar_t = %zu bytes\n", lines, LogRing::kSlots, sizeof(wchar_t));
+	for (bool longLines : {false, true}) {
+		printf("\n%s lines\n%-8s %10s %12s\n", longLines ? "1023-char" : "typical", "", "ns/line", "peak KB");
+		report<DequeLog>("deque", lines, longLines);
+		report<RingLog>("ring", lines, longLines);
+		report<RecordLog>("record", lines, longLines);
+	}
+	return 0;
+}
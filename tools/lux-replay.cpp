@@ -0,0 +1,258 @@
+// lux-replay: run a recorded ALS trace (.sbtl, see include/Timeline.h) through the auto-brightness
+// engine raw, filtered, and filtered + predicted, and report per variant:
+//   - ramps and brightness writes per hour (noise-driven churn)
+//   - time until within 5% of the final brightness after each ambient step (perceived lag)
+// Pure C++, no Win32: the engine, filter and predictor are the headers the app uses.
+//
+//   lux-replay <trace.sbtl> [--sensor N] [--base-brightness B]
+//   lux-replay --demo          (synthetic hour: drifting daylight, flicker, shadows, outliers,
+//                               lights on/off, blinds opening/closing)
+#define _CRT_SECURE_NO_WARNINGS
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "AutoBrightness.h"
+#include "LuxFilter.h"
+#include "LuxPredictor.h"
+#include "Timeline.h"
+
+struct LuxPoint {
+	double tMs;
+	float  lux;
+};
+
+// An ambient step found in the raw trace, and the brightness the engine should settle at.
+struct Step {
+	double   tMs;
+	uint32_t finalBrightness;
+};
+
+struct ReplayResult {
+	unsigned            ramps  = 0;
+	unsigned            writes = 0;
+	std::vector<double> settleMs; // per step; negative = never got within 5%
+};
+
+enum class Variant { Raw, Filtered, Predicted };
+
+constexpr double   kTickMs       = 100.0; // worker loop period
+constexpr double   kSettleCapMs  = 30e3;  // give up on a step after this long
+constexpr double   kStepLog2     = 1.0;   // a 2x change of the 5 s raw median counts as a step
+constexpr double   kSettledAfter = 10e3;  // the room has settled this long after the step
+constexpr uint32_t kMinB = 1000, kMaxB = 60000;
+
+static double median(std::vector<float> v) {
+	if (v.empty())
+		return 0.0;
+	std::nth_element(v.begin(), v.begin() + v.size() / 2, v.end());
+	return v[v.size() / 2];
+}
+
+// Median raw lux over [t0, t1). `pts` is in time order.
+static double medianLux(const std::vector<LuxPoint> &pts, double t0, double t1) {
+	auto byTime = [](const LuxPoint &p, double t) { return p.tMs < t; };
+	auto lo     = std::lower_bound(pts.begin(), pts.end(), t0, byTime);
+	auto hi     = std::lower_bound(lo, pts.end(), t1, byTime);
+	std::vector<float> v;
+	for (auto it = lo; it != hi; ++it)
+		v.push_back(it->lux);
+	return median(std::move(v));
+}
+
+// Steps: the 2 s raw median moves 2x against the 2 s median 5 s earlier. The step time is the
+// earliest sample of that window; its final brightness maps the median well after it settled.
+static std::vector<Step> findSteps(const std::vector<LuxPoint> &pts, float baseLux, uint32_t baseB) {
+	std::vector<Step> steps;
+	double            last = -1e18;
+	for (auto &p : pts) {
+		double t = p.tMs;
+		if (t - last < 30e3 || t < pts.front().tMs + 7e3 || t + kSettledAfter + 2e3 > pts.back().tMs)
+			continue;
+		double now = medianLux(pts, t, t + 2e3), before = medianLux(pts, t - 7e3, t - 5e3);
+		if (now < 1.0 || before < 1.0 || std::fabs(std::log2(now / before)) < kStepLog2)
+			continue;
+		// walk back to where the change began: the last time the lux was still at `before`
+		double onset = t;
+		for (double u = t; u > t - 5e3; u -= 500.0)
+			if (std::fabs(std::log2(std::max(1.0, medianLux(pts, u - 1e3, u)) / before)) < 0.3) {
+				onset = u;
+				break;
+			}
+		double settled = medianLux(pts, onset + kSettledAfter, onset + kSettledAfter + 2e3);
+		steps.push_back({onset, mapLuxToBrightness((float)settled, baseLux, baseB, kMinB, kMaxB)});
+		last = t;
+	}
+	return steps;
+}
+
+static ReplayResult replay(const std::vector<LuxPoint> &pts, const std::vector<Step> &steps, Variant v,
+                           float baseLux, uint32_t baseBrightness) {
+	ReplayResult r;
+	LuxFilter    filter;
+	LuxPredictor predictor;
+	AutoRamp     ramp;
+	uint32_t     current = baseBrightness;
+	float        lux     = pts[0].lux;
+	size_t       i = 0, s = 0;
+	double       settleFrom = -1.0;
+	r.settleMs.assign(steps.size(), -1.0);
+	for (double t = pts[0].tMs; t <= pts.back().tMs; t += kTickMs) {
+		for (; i < pts.size() && pts[i].tMs <= t; ++i) {
+			if (v == Variant::Raw) {
+				lux = pts[i].lux;
+				continue;
+			}
+			float f = filter.push(pts[i].tMs, pts[i].lux);
+			lux     = v == Variant::Predicted ? predictor.push(pts[i].tMs, f) : f;
+		}
+		double   started = ramp.startMs;
+		uint32_t next    = 0;
+		if (ramp.step(t, lux, mapLuxToBrightness(lux, baseLux, baseBrightness, kMinB, kMaxB), current, kMinB, kMaxB,
+		              next)) {
+			current = next;
+			++r.writes;
+		}
+		if (ramp.startMs != started)
+			++r.ramps;
+
+		if (s < steps.size() && t >= steps[s].tMs && settleFrom < 0.0)
+			settleFrom = steps[s].tMs;
+		if (settleFrom >= 0.0) {
+			double goal = steps[s].finalBrightness;
+			if (std::fabs((double)current - goal) <= 0.05 * goal) {
+				r.settleMs[s] = t - settleFrom;
+				settleFrom    = -1.0;
+				++s;
+			} else if (t - settleFrom > kSettleCapMs || (s + 1 < steps.size() && t >= steps[s + 1].tMs)) {
+				settleFrom = -1.0; // never settled (or the next step began first)
+				++s;
+			}
+		}
+	}
+	return r;
+}
+
+static bool loadTrace(const char *path, int sensor, std::vector<LuxPoint> &out) {
+	FILE *f = fopen(path, "rb");
+	if (!f) {
+		fprintf(stderr, "cannot open %s\n", path);
+		return false;
+	}
+	std::vector<char> data;
+	char              buf[65536];
+	size_t            n;
+	while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+		data.insert(data.end(), buf, buf + n);
+	fclose(f);
+
+	TimelineCursor cur(data.data(), data.size());
+	if (!cur.valid()) {
+		fprintf(stderr, "%s is not an .sbtl trace\n", path);
+		return false;
+	}
+	TimelineSample s;
+	while (cur.next(s)) {
+		if (s.kind != TimelineKind::Lux)
+			continue;
+		if (sensor < 0)
+			sensor = s.source; // first sensor in the file
+		if (s.source == sensor)
+			out.push_back({(double)s.tMs, s.lux()});
+	}
+	return true;
+}
+
+// One hour at a 500 ms report interval. Deterministic, so runs are comparable.
+static void makeDemo(std::vector<LuxPoint> &out) {
+	uint32_t rng  = 12345;
+	auto     rand = [&] {
+		rng = rng * 1664525u + 1013904223u;
+		return (double)(rng >> 8) / 16777216.0;
+	};
+	auto ramp = [](double t, double t0, double dur) { return t < t0 ? 0.0 : (t >= t0 + dur ? 1.0 : (t - t0) / dur); };
+	for (double t = 0; t < 3600e3; t += 500.0) {
+		double lux = 300.0 + 150.0 * std::sin(t / 3600e3 * 6.283);              // slow daylight drift
+		lux *= 1.0 + 0.25 * (rand() - 0.5);                                      // flicker / sensor noise
+		if (std::fmod(t, 300e3) < 4e3) lux *= 0.6;                               // a shadow every 5 minutes
+		if (t >= 1200e3 && t < 1800e3) lux *= 4.0;                               // lights on for 10 minutes
+		lux *= std::exp2(3.0 * (ramp(t, 2400e3, 2e3) - ramp(t, 3000e3, 2e3)));  // blinds open, later closed
+		if (rand() < 0.005) lux *= rand() < 0.5 ? 8.0 : 0.1;                     // single bad reports
+		out.push_back({t, (float)lux});
+	}
+}
+
+static void printSettle(const char *name, const ReplayResult &r) {
+	std::vector<float> ok;
+	for (double ms : r.settleMs)
+		if (ms >= 0.0)
+			ok.push_back((float)ms);
+	if (ok.empty()) {
+		printf("%-10s %8s\n", name, "-");
+		return;
+	}
+	double sum = 0;
+	for (float ms : ok)
+		sum += ms;
+	printf("%-10s %8.2f %8.2f %8.2f %6zu/%zu\n", name, median(ok) / 1000.0, sum / ok.size() / 1000.0,
+	       *std::max_element(ok.begin(), ok.end()) / 1000.0, ok.size(), r.settleMs.size());
+}
+
+int main(int argc, char **argv) {
+	const char *path = nullptr;
+	bool        demo = false;
+	int         sensor = -1;
+	uint32_t    base   = 30000;
+	for (int i = 1; i < argc; ++i) {
+		if (!strcmp(argv[i], "--demo"))
+			demo = true;
+		else if (!strcmp(argv[i], "--sensor") && i + 1 < argc)
+			sensor = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--base-brightness") && i + 1 < argc)
+			base = (uint32_t)atoi(argv[++i]);
+		else
+			path = argv[i];
+	}
+	if (!demo && !path) {
+		fprintf(stderr, "usage: lux-replay <trace.sbtl> [--sensor N] [--base-brightness B] | --demo\n");
+		return 2;
+	}
+
+	std::vector<LuxPoint> pts;
+	if (demo)
+		makeDemo(pts);
+	else if (!loadTrace(path, sensor, pts))
+		return 1;
+	if (pts.size() < 2) {
+		fprintf(stderr, "no lux samples\n");
+		return 1;
+	}
+
+	float             baseLux = pts[0].lux > 1.f ? pts[0].lux : 1.f;
+	std::vector<Step> steps   = findSteps(pts, baseLux, base);
+	double            hours   = (pts.back().tMs - pts.front().tMs) / 3600e3;
+	ReplayResult      raw     = replay(pts, steps, Variant::Raw, baseLux, base);
+	ReplayResult      flt     = replay(pts, steps, Variant::Filtered, baseLux, base);
+	ReplayResult      prd     = replay(pts, steps, Variant::Predicted, baseLux, base);
+
+	printf("%zu samples over %.2f h, %zu ambient steps\n\n", pts.size(), hours, steps.size());
+	printf("%-10s %8s %9s %8s %9s\n", "", "ramps", "ramps/h", "writes", "writes/h");
+	const struct {
+		const char         *name;
+		const ReplayResult &r;
+	} rows[] = {{"raw", raw}, {"filtered", flt}, {"predicted", prd}};
+	for (auto &row : rows)
+		printf("%-10s %8u %9.1f %8u %9.1f\n", row.name, row.r.ramps, row.r.ramps / hours, row.r.writes,
+		       row.r.writes / hours);
+	if (raw.ramps && raw.writes)
+		printf("filter reduction: ramps %.0f%%, writes %.0f%%\n", 100.0 * (1.0 - (double)flt.ramps / raw.ramps),
+		       100.0 * (1.0 - (double)flt.writes / raw.writes));
+
+	printf("\ntime until within 5%% of final brightness (s)\n");
+	printf("%-10s %8s %8s %8s %8s\n", "", "median", "mean", "max", "settled");
+	for (auto &row : rows)
+		printSettle(row.name, row.r);
+	return 0;
+}
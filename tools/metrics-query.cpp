@@ -0,0 +1,250 @@
+// metrics-query: read the running app's metrics (include/Metrics.h) from its local endpoint
+// (include/MetricsEndpoint.h) and print them, the way fleet tooling scrapes it.
+//
+//   metrics-query [text|json]   Prometheus text (default) or JSON from the running app
+//   metrics-query locks         lock call sites (include/ProfiledMutex.h), longest wait first
+//   metrics-query --selftest    serve a few metrics in-process, read them back over the endpoint
+//                               as a client, and check both formats; exit 1 if anything is off
+#define _CRT_SECURE_NO_WARNINGS
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "MetricsEndpoint.h"
+#include "ProfiledMutex.h"
+
+/* ---------- lock report ---------- */
+
+struct LockRow {
+	std::string labels;
+	double      waitSum = 0, waitCount = 0, holdSum = 0, maxWait = 0;
+};
+
+// The value of `label` in `mutex="display",site="main.cpp:104",fn="..."`.
+static std::string labelValue(const std::string &labels, const char *label) {
+	std::string key = std::string(label) + "=\"";
+	size_t      at  = labels.find(key);
+	if (at == std::string::npos)
+		return "";
+	at += key.size();
+	return labels.substr(at, labels.find('"', at) - at);
+}
+
+// One row per lock call site from the Prometheus text, longest wait first.
+static std::string lockReport(const std::string &text) {
+	std::vector<LockRow> rows;
+	auto row = [&](const std::string &labels) -> LockRow & {
+		for (auto &r : rows)
+			if (r.labels == labels)
+				return r;
+		rows.push_back({labels});
+		return rows.back();
+	};
+	size_t pos = 0;
+	while (pos < text.size()) {
+		size_t      end  = text.find('\n', pos);
+		std::string line = text.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+		pos              = end == std::string::npos ? text.size() : end + 1;
+		size_t open = line.find('{'), close = line.rfind('}');
+		if (line.compare(0, 10, "sbpp_lock_") != 0 || open == std::string::npos || close == std::string::npos)
+			continue;
+		std::string name   = line.substr(0, open);
+		std::string labels = line.substr(open + 1, close - open - 1);
+		double      value  = atof(line.c_str() + close + 1);
+		if (name == "sbpp_lock_wait_us_sum")
+			row(labels).waitSum = value;
+		else if (name == "sbpp_lock_wait_us_count")
+			row(labels).waitCount = value;
+		else if (name == "sbpp_lock_hold_us_sum")
+			row(labels).holdSum = value;
+		else if (name == "sbpp_lock_wait_max_us")
+			row(labels).maxWait = value;
+	}
+	std::sort(rows.begin(), rows.end(), [](const LockRow &a, const LockRow &b) { return a.maxWait > b.maxWait; });
+
+	std::string out;
+	char        buf[512];
+	snprintf(buf, sizeof(buf), "%12s %12s %12s %10s  %-8s %-22s %s\n", "max wait us", "avg wait us", "avg hold us",
+	         "locks", "mutex", "site", "function");
+	out += buf;
+	for (const auto &r : rows) {
+		double n = r.waitCount > 0 ? r.waitCount : 1;
+		snprintf(buf, sizeof(buf), "%12.0f %12.1f %12.1f %10.0f  %-8s %-22s %s\n", r.maxWait, r.waitSum / n,
+		         r.holdSum / n, r.waitCount, labelValue(r.labels, "mutex").c_str(),
+		         labelValue(r.labels, "site").c_str(), labelValue(r.labels, "fn").c_str());
+		out += buf;
+	}
+	return out;
+}
+
+static const uint64_t kTestBounds[] = {100, 1000, 10000};
+
+// A client that connects and then never sends its request.
+class IdleClient {
+public:
+	explicit IdleClient(const std::string &path) {
+#ifdef _WIN32
+		h_ = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, 0, nullptr);
+#else
+		fd_              = socket(AF_UNIX, SOCK_STREAM, 0);
+		sockaddr_un addr = {};
+		addr.sun_family  = AF_UNIX;
+		strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+		if (fd_ >= 0 && connect(fd_, (const sockaddr *)&addr, sizeof(addr)) != 0) {
+			close(fd_);
+			fd_ = -1;
+		}
+#endif
+	}
+	~IdleClient() {
+#ifdef _WIN32
+		if (h_ != INVALID_HANDLE_VALUE)
+			CloseHandle(h_);
+#else
+		if (fd_ >= 0)
+			close(fd_);
+#endif
+	}
+	bool connected() const {
+#ifdef _WIN32
+		return h_ != INVALID_HANDLE_VALUE;
+#else
+		return fd_ >= 0;
+#endif
+	}
+
+private:
+#ifdef _WIN32
+	HANDLE h_;
+#else
+	int fd_;
+#endif
+};
+
+static double msSince(std::chrono::steady_clock::time_point t) {
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t).count();
+}
+
+static int selftest() {
+	// Contention: the worker holds the lock for 30 ms while this thread waits for it
+	static ProfiledMutex testMutex{"selftest"};
+	std::atomic<bool>    held{false};
+	std::thread          holder([&] {
+		PROFILED_LOCK(testMutex);
+		held.store(true);
+		std::this_thread::sleep_for(std::chrono::milliseconds(30));
+	});
+	while (!held.load())
+		std::this_thread::yield();
+	{
+		PROFILED_LOCK(testMutex);
+	}
+	holder.join();
+
+	static MetricCounter   writes("sbpp_selftest_writes_total", "Writes counted by four threads");
+	static MetricGauge     displays("sbpp_selftest_displays", "A gauge");
+	static MetricHistogram latency("sbpp_selftest_latency_us", "A histogram", kTestBounds);
+
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 4; ++t)
+		threads.emplace_back([] {
+			for (int i = 0; i < 100000; ++i) {
+				writes.add();
+				latency.observe((uint64_t)(i % 4) * 3000); // 0, 3000, 6000, 9000 us
+			}
+		});
+	for (auto &t : threads)
+		t.join();
+	displays.set(2);
+
+	MetricsEndpoint endpoint;
+	const char     *name = "StudioBrightnessPlusPlus.metrics-selftest";
+	if (!endpoint.start(name)) {
+		printf("FAIL could not open the endpoint\n");
+		return 1;
+	}
+	std::string path = MetricsEndpoint::endpointPath(name), text, json;
+	bool        gotText = MetricsEndpoint::metricsQuery(path, "text", text);
+	bool        gotJson = MetricsEndpoint::metricsQuery(path, "json", json);
+	std::string locks   = lockReport(text);
+
+	// A client that connects and goes quiet holds up the next one for kClientTimeoutMs at most, and
+	// one that is still connected does not hold up stop().
+	std::string afterIdle;
+	auto        t0       = std::chrono::steady_clock::now();
+	IdleClient  idle(path);
+	bool        gotAfter = MetricsEndpoint::metricsQuery(path, "text", afterIdle);
+	double      waitedMs = msSince(t0);
+	IdleClient  idleAtStop(path);
+	std::this_thread::sleep_for(std::chrono::milliseconds(50)); // the server is waiting for its request
+	t0 = std::chrono::steady_clock::now();
+	endpoint.stop();
+	double stopMs = msSince(t0);
+
+	int  failed = 0;
+	auto expect = [&](bool ok, const char *what) {
+		printf("%-4s %s\n", ok ? "ok" : "FAIL", what);
+		failed += ok ? 0 : 1;
+	};
+	auto has = [](const std::string &s, const char *what) { return s.find(what) != std::string::npos; };
+	expect(gotText && gotJson, "a local client reads the endpoint");
+	char what[128];
+	snprintf(what, sizeof(what), "a client that sends nothing delays the next by %.0f ms (limit %d ms)", waitedMs,
+	         MetricsEndpoint::kClientTimeoutMs);
+	expect(idle.connected() && gotAfter && has(afterIdle, "sbpp_selftest_displays 2\n") &&
+	           waitedMs < 3 * MetricsEndpoint::kClientTimeoutMs,
+	       what);
+	snprintf(what, sizeof(what), "stop() returns in %.1f ms with an idle client connected", stopMs);
+	expect(idleAtStop.connected() && stopMs < MetricsEndpoint::kClientTimeoutMs / 2, what);
+	expect(has(text, "# TYPE sbpp_selftest_writes_total counter\nsbpp_selftest_writes_total 400000\n"),
+	       "text: counter adds from four threads are all counted");
+	expect(has(text, "sbpp_selftest_displays 2\n"), "text: gauge");
+	expect(has(text, "sbpp_selftest_latency_us_bucket{le=\"100\"} 100000\n") &&
+	           has(text, "sbpp_selftest_latency_us_bucket{le=\"10000\"} 400000\n") &&
+	           has(text, "sbpp_selftest_latency_us_bucket{le=\"+Inf\"} 400000\n") &&
+	           has(text, "sbpp_selftest_latency_us_sum 1800000000\n"),
+	       "text: histogram buckets are cumulative, with sum and count");
+	expect(has(json, "\"sbpp_selftest_writes_total\": 400000") && has(json, "\"sbpp_selftest_displays\": 2") &&
+	           has(json, "\"sbpp_selftest_latency_us\": {\"le\": [100,1000,10000], \"counts\": [100000,0,300000,0]"),
+	       "json: the same values");
+#if SBPP_LOCK_PROFILING
+	std::string waiter = "mutex=\"selftest\",site=\"metrics-query.cpp:";
+	size_t      first  = locks.find('\n') + 1; // the longest wait comes first
+	expect(text.find("sbpp_lock_wait_us_bucket{" + waiter) != std::string::npos &&
+	           text.find("# TYPE sbpp_lock_wait_us histogram") != std::string::npos,
+	       "text: lock sites are labelled series of one family");
+	expect(atof(locks.c_str() + first) >= 20000 && locks.find("selftest", first) < locks.find('\n', first),
+	       "locks: the waiting site is first, with the 30 ms wait");
+#endif
+	std::string after;
+	expect(!MetricsEndpoint::metricsQuery(path, "text", after), "the endpoint is gone after stop");
+	if (failed)
+		printf("\n%s\n%s\n%s", text.c_str(), json.c_str(), locks.c_str());
+	return failed ? 1 : 0;
+}
+
+int main(int argc, char **argv) {
+	if (argc > 1 && !strcmp(argv[1], "--selftest"))
+		return selftest();
+	const char *request = argc > 1 ? argv[1] : "text";
+	bool        locks   = !strcmp(request, "locks");
+	if (strcmp(request, "text") && strcmp(request, "json") && !locks) {
+		fprintf(stderr, "usage: metrics-query [text|json|locks] | --selftest\n");
+		return 2;
+	}
+	std::string out;
+	if (!MetricsEndpoint::metricsQuery(MetricsEndpoint::endpointPath(MetricsEndpoint::kDefaultName),
+	                                   locks ? "text" : request, out)) {
+		fprintf(stderr, "Studio Brightness++ is not running (no metrics endpoint)\n");
+		return 1;
+	}
+	if (locks)
+		out = lockReport(out);
+	fwrite(out.data(), 1, out.size(), stdout);
+	return 0;
+}
@@ -0,0 +1,240 @@
+// settings-stress: flips settings (include/SettingsStore.h) from two writers while the engine runs
+// on them, the way the tray menu and the log window change them under the worker and the hotkeys.
+// Build it with -fsanitize=thread to have the race detector watch the whole thing.
+//
+//   writer     the Options dialog: steps, display, linked mode, auto-brightness, in one Update each
+//   toggler    the log window: record-timeline on and off
+//   engine     the worker: a snapshot per pass, the auto-brightness tick and a step on fake displays
+//   hotkeys    a step up or down per snapshot
+//   readers    snapshots in a loop
+//
+// Every snapshot anyone reads must be one whole version: the writer keeps its fields tied to each
+// other, so a torn read shows up as a broken tie. Versions never go backwards for any reader. The
+// backend must only ever see keys that changed, and once flushed hold exactly the last snapshot.
+//
+//   settings-stress [flips]     (default 100000; exit 1 on any failure)
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cwchar>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "BrightnessCore.h"
+#include "SettingsStore.h"
+
+using Clock = std::chrono::steady_clock;
+
+constexpr uint32_t kDisplays = 4;
+
+struct FakeDisplay : BrightnessDisplay {
+	std::atomic<uint64_t> writes{0};
+	int                   writeBrightness(uint32_t) override {
+		writes.fetch_add(1, std::memory_order_relaxed);
+		return 0;
+	}
+};
+
+// The registry, minus the registry: what the store has written, per key.
+class FakeBackend {
+public:
+	void persist(uint32_t mask, const SettingsValues &v) {
+		std::lock_guard<std::mutex> lock(m_);
+		++calls_;
+		for (size_t i = 0; i < kSettingKeyCount; ++i)
+			if (mask & (1u << i)) {
+				values_[i] = kSettingKeys[i].get(v);
+				++writes_[i];
+			}
+	}
+	uint64_t calls() {
+		std::lock_guard<std::mutex> lock(m_);
+		return calls_;
+	}
+	uint64_t writes(size_t key) {
+		std::lock_guard<std::mutex> lock(m_);
+		return writes_[key];
+	}
+	uint32_t value(size_t key) {
+		std::lock_guard<std::mutex> lock(m_);
+		return values_[key];
+	}
+
+private:
+	std::mutex m_;
+	uint64_t   calls_                    = 0;
+	uint64_t   writes_[kSettingKeyCount] = {};
+	uint32_t   values_[kSettingKeyCount] = {};
+};
+
+static size_t keyIndex(const wchar_t *name) {
+	for (size_t i = 0; i < kSettingKeyCount; ++i)
+		if (!wcscmp(kSettingKeys[i].name, name))
+			return i;
+	fprintf(stderr, "unknown key %ls\n", name);
+	exit(2);
+}
+
+// The ties the writer keeps; a snapshot that breaks one was read half-written.
+static bool consistent(const SettingsValues &s) {
+	return s.activeDisplayIndex == s.brightnessSteps % kDisplays && s.linkedMode == ((s.brightnessSteps & 1) != 0) &&
+	       s.predictiveAls == s.autoAdjustEnabled && s.hkUp.vk == s.brightnessSteps && s.hkDown.vk == s.hkUp.vk + 1;
+}
+
+int main(int argc, char **argv) {
+	uint64_t flips = argc > 1 ? (uint64_t)atoll(argv[1]) : 100000;
+
+	FakeBackend   backend;
+	SettingsStore store([&](uint32_t mask, const SettingsValues &v) { backend.persist(mask, v); });
+
+	// What Load publishes: consistent, and never persisted.
+	SettingsValues loaded;
+	loaded.brightnessSteps    = 10;
+	loaded.activeDisplayIndex = 10 % kDisplays;
+	loaded.linkedMode         = false;
+	loaded.autoAdjustEnabled  = false;
+	loaded.hkUp               = {0, 10};
+	loaded.hkDown             = {0, 11};
+	loaded.showOSD            = false;
+	loaded.updateChannel      = 1;
+	store.Reset(loaded);
+
+	std::vector<FakeDisplay> displays(kDisplays);
+	BrightnessHost           host;
+	BrightnessCore           core(host);
+	std::mutex               displayMutex; // g_displayMutex
+	for (auto &d : displays)
+		core.attach(d);
+
+	std::atomic<bool>     stop{false};
+	std::atomic<uint64_t> torn{0}, backwards{0}, reads{0}, engineTicks{0}, steps{0};
+
+	// One reader's view: every snapshot whole, versions only going forward.
+	auto read = [&](uint64_t &lastVersion) -> const SettingsValues & {
+		const SettingsValues &s = store.snapshot();
+		if (!consistent(s))
+			torn.fetch_add(1, std::memory_order_relaxed);
+		if (s.version < lastVersion)
+			backwards.fetch_add(1, std::memory_order_relaxed);
+		lastVersion = s.version;
+		reads.fetch_add(1, std::memory_order_relaxed);
+		return s;
+	};
+
+	std::thread engine([&] {
+		uint64_t last = 0;
+		double   now  = 0;
+		while (!stop.load(std::memory_order_relaxed)) {
+			const SettingsValues &s = read(last);
+			std::lock_guard<std::mutex> lock(displayMutex);
+			if (s.autoAdjustEnabled)
+				core.autoBrightnessTick(now += 250, s.predictiveAls);
+			engineTicks.fetch_add(1, std::memory_order_relaxed);
+		}
+	});
+	std::thread hotkeys([&] {
+		uint64_t last = 0;
+		int      dir  = 1;
+		while (!stop.load(std::memory_order_relaxed)) {
+			const SettingsValues &s = read(last);
+			std::lock_guard<std::mutex> lock(displayMutex);
+			core.adjustBrightnessByStep(displays, s.activeDisplayIndex, s.linkedMode, s.brightnessSteps, dir = -dir);
+			steps.fetch_add(1, std::memory_order_relaxed);
+		}
+	});
+	std::thread readers[2];
+	for (auto &r : readers)
+		r = std::thread([&] {
+			uint64_t last = 0;
+			while (!stop.load(std::memory_order_relaxed))
+				read(last);
+		});
+
+	std::atomic<uint64_t> toggles{0};
+	std::thread           toggler([&] {
+		while (!stop.load(std::memory_order_relaxed)) {
+			store.Update([](SettingsValues &v) { v.recordTimeline = !v.recordTimeline; });
+			toggles.fetch_add(1, std::memory_order_relaxed);
+			std::this_thread::yield();
+		}
+	});
+
+	auto     t0        = Clock::now();
+	uint64_t unchanged = 0, published = 0;
+	uint64_t lastWriter  = store.snapshot().version;
+	bool     writerOrder = true;
+	for (uint64_t i = 0; i < flips; ++i) {
+		uint32_t stepsN = 10 + (uint32_t)(i % 41);
+		uint32_t mask   = store.Update([&](SettingsValues &v) {
+			v.brightnessSteps    = stepsN;
+			v.activeDisplayIndex = stepsN % kDisplays;
+			v.linkedMode         = (stepsN & 1) != 0;
+			v.autoAdjustEnabled  = (i / 7) % 2 != 0;
+			v.predictiveAls      = v.autoAdjustEnabled;
+			v.hkUp               = {0, stepsN};
+			v.hkDown             = {0, stepsN + 1};
+		});
+		published += mask != 0;
+		uint64_t version = store.snapshot().version;
+		if (version <= lastWriter && mask != 0)
+			writerOrder = false;
+		lastWriter = version;
+		// Writing what is already there publishes nothing.
+		if ((i & 1023) == 0 && store.Update([](SettingsValues &) {}) != 0)
+			++unchanged;
+	}
+	stop = true;
+	toggler.join();
+	engine.join();
+	hotkeys.join();
+	for (auto &r : readers)
+		r.join();
+	double secs = std::chrono::duration<double>(Clock::now() - t0).count();
+
+	store.Flush();
+	const SettingsValues &last = store.snapshot();
+
+	const size_t written[] = {keyIndex(L"BrightnessSteps"),       keyIndex(L"ActiveDisplayIndex"),
+	                          keyIndex(L"LinkedMode"),            keyIndex(L"AutoBrightnessEnabled"),
+	                          keyIndex(L"PredictiveAutoBrightness"), keyIndex(L"HotkeyUpVK"),
+	                          keyIndex(L"HotkeyDownVK"),          keyIndex(L"RecordTimeline")};
+	bool onlyChanged = true, persisted = true;
+	for (size_t k = 0; k < kSettingKeyCount; ++k) {
+		bool touched = false;
+		for (size_t w : written)
+			touched |= w == k;
+		if (!touched && backend.writes(k) != 0) {
+			printf("     %ls written %llu times, never changed\n", kSettingKeys[k].name,
+			       (unsigned long long)backend.writes(k));
+			onlyChanged = false;
+		}
+		if (touched && backend.value(k) != kSettingKeys[k].get(last)) {
+			printf("     %ls persisted %u, last snapshot %u\n", kSettingKeys[k].name, backend.value(k),
+			       kSettingKeys[k].get(last));
+			persisted = false;
+		}
+	}
+
+	printf("%llu flips + %llu toggles in %.2f s, %llu snapshots read (%.1f M/s), %llu ticks, %llu steps\n",
+	       (unsigned long long)flips, (unsigned long long)toggles.load(), secs, (unsigned long long)reads.load(),
+	       reads.load() / secs / 1e6, (unsigned long long)engineTicks.load(), (unsigned long long)steps.load());
+	printf("version %llu, %llu backend calls (changes coalesce while one is written)\n",
+	       (unsigned long long)last.version, (unsigned long long)backend.calls());
+
+	bool fail  = false;
+	auto check = [&](bool ok, const char *what) {
+		printf("%-4s %s\n", ok ? "ok" : "FAIL", what);
+		fail |= !ok;
+	};
+	check(torn.load() == 0, "every snapshot read is one whole version");
+	check(backwards.load() == 0, "versions never go backwards for a reader");
+	check(writerOrder, "each published change gets a newer version");
+	check(unchanged == 0, "an update that changes nothing publishes nothing");
+	check(last.version == 1 + published + toggles.load(), "one version per published change");
+	check(onlyChanged, "only keys that changed reach the backend");
+	check(persisted, "after Flush the backend holds the last snapshot");
+	check(backend.calls() <= published + toggles.load(), "no backend call without a change");
+	return fail ? 1 : 0;
+}